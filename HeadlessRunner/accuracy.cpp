@@ -0,0 +1,343 @@
+// Accuracy benchmark: steps small reference scenes with every integrator over
+// a sweep of time steps and measures the position error at the end against an
+// analytic or a high precision solution, next to the time it took. Prints one
+// table per scene with its Pareto front (no other run is both cheaper and more
+// accurate) and writes the results as JSON.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "SceneBuilder.h"
+#include "common.h"
+
+static const char* SCENES[] = { "oscillator", "pendulum", "cloth" };
+
+// the reference run uses this fraction of the smallest step of the sweep
+static const int REFERENCE_REFINEMENT = 16;
+// scenes use unit spacing, a run further off than that has blown up
+static const double DIVERGED_ERROR = 1;
+
+struct Options {
+	std::vector<std::string> scenes;
+	std::vector<int> integrators;
+	// powers of two, so every step count covers the duration exactly
+	std::vector<float> timeSteps = { 1.f / 32, 1.f / 64, 1.f / 128, 1.f / 256, 1.f / 512, 1.f / 1024, 1.f / 2048 };
+	float duration = 1;
+	float minTime = 0.05f;
+	float budget = 0; // 0 = none
+	std::string jsonPath = "accuracy.json";
+};
+
+struct Result {
+	std::string scene;
+	int integrator;
+	float timeStep;
+	int steps;
+	double seconds;           // per run
+	double forceEvaluations;  // per run
+	double error;             // RMS position error at the end, infinite if diverged
+	bool pareto;
+
+	bool diverged() const { return !std::isfinite(error); }
+	double msPerSimulatedSecond(float duration) const { return 1e3 * seconds / duration; }
+};
+
+static void printUsage(const char* program)
+{
+	std::cerr
+		<< "usage: " << program << " [options]\n"
+		<< "  --scenes L       oscillator, pendulum, cloth (default all)\n"
+		<< "  --integrators L  integrator names as for headless_runner (default all)\n"
+		<< "  --dts L          time steps, should divide the duration exactly\n"
+		<< "                   (default 1/32 .. 1/2048 in powers of two)\n"
+		<< "  --duration T     simulated seconds per run (default 1)\n"
+		<< "  --min-time T     seconds to repeat each run for the timing (default 0.05)\n"
+		<< "  --budget E       report the cheapest run per scene with an error of at most E\n"
+		<< "  --json FILE      result file (default accuracy.json)\n"
+		<< "lists are comma separated\n";
+}
+
+static bool parseOptions(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--help" || arg == "-h") return false;
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << arg << "\n";
+			return false;
+		}
+		const char* value = argv[++i];
+		bool ok = true;
+		if (arg == "--scenes") {
+			options.scenes = splitList(value);
+			for (const std::string& scene : options.scenes) {
+				ok &= std::find_if(std::begin(SCENES), std::end(SCENES), [&](const char* s) { return scene == s; }) != std::end(SCENES);
+			}
+		}
+		else if (arg == "--integrators") {
+			options.integrators.clear();
+			for (const std::string& item : splitList(value)) {
+				options.integrators.push_back(findIntegrator(item.c_str()));
+				ok &= options.integrators.back() >= 0;
+			}
+		}
+		else if (arg == "--dts") {
+			options.timeSteps.clear();
+			for (const std::string& item : splitList(value)) {
+				float timeStep;
+				ok &= parseFloat(item.c_str(), timeStep) && timeStep > 0;
+				options.timeSteps.push_back(timeStep);
+			}
+			ok &= !options.timeSteps.empty();
+		}
+		else if (arg == "--duration") {
+			ok = parseFloat(value, options.duration) && options.duration > 0;
+		}
+		else if (arg == "--min-time") {
+			ok = parseFloat(value, options.minTime) && options.minTime >= 0;
+		}
+		else if (arg == "--budget") {
+			ok = parseFloat(value, options.budget) && options.budget > 0;
+		}
+		else if (arg == "--json") {
+			options.jsonPath = value;
+		}
+		else {
+			std::cerr << "unknown option " << arg << "\n";
+			return false;
+		}
+		if (!ok) {
+			std::cerr << "invalid value '" << value << "' for " << arg << "\n";
+			return false;
+		}
+	}
+
+	if (options.scenes.empty()) options.scenes.assign(std::begin(SCENES), std::end(SCENES));
+	if (options.integrators.empty()) {
+		for (const auto& entry : INTEGRATORS) options.integrators.push_back(entry.id);
+	}
+	return true;
+}
+
+// The two-point oscillator of the tests (mass 10, stiffness 40, rest length 1),
+// moving along its spring so that it has a closed form solution.
+static const double OSCILLATOR_LENGTH = 1.5;
+static const double OSCILLATOR_SPEED = 0.5;
+
+// undamped, without floor, one thread: the error is the integrator's alone
+static void buildScene(MassSpringSystemSimulator& sim, const std::string& scene)
+{
+	sim.setConsoleLogging(false);
+	sim.setThreadCount(1);
+	sim.setDampingFactor(0);
+	if (scene == "oscillator") {
+		sim.setMass(10);
+		sim.setStiffness(40);
+		const int p0 = sim.addMassPoint(Vec3(0, 0, 0), Vec3(0, -OSCILLATOR_SPEED, 0), false);
+		const int p1 = sim.addMassPoint(Vec3(0, OSCILLATOR_LENGTH, 0), Vec3(0, OSCILLATOR_SPEED, 0), false);
+		sim.addSpring(p0, p1, 1);
+	}
+	else if (scene == "pendulum") {
+		// horizontal rope released under gravity, fixed at one end
+		sim.setMass(1);
+		sim.setStiffness(500);
+		sim.setGravityEnabled(true);
+		buildChain(&sim, 8);
+	}
+	else {
+		sim.setMass(0.1f);
+		sim.setStiffness(200);
+		sim.setGravityEnabled(true);
+		buildCloth(&sim, 8, 8);
+	}
+}
+
+static std::vector<Vec3> positions(MassSpringSystemSimulator& sim)
+{
+	std::vector<Vec3> result(sim.getNumberOfMassPoints());
+	for (size_t i = 0; i < result.size(); ++i) result[i] = sim.getPositionOfMassPoint((int)i);
+	return result;
+}
+
+// Relative coordinate r = L + (r0 - L) cos(wt) + r0' / w sin(wt) with the
+// reduced mass m / 2; the centre of mass does not move.
+static std::vector<Vec3> oscillatorSolution(double time)
+{
+	const double omega = std::sqrt(40.0 / (10.0 / 2));
+	const double r = 1 + (OSCILLATOR_LENGTH - 1) * std::cos(omega * time) + 2 * OSCILLATOR_SPEED / omega * std::sin(omega * time);
+	const double centre = OSCILLATOR_LENGTH / 2;
+	return { Vec3(0, centre - r / 2, 0), Vec3(0, centre + r / 2, 0) };
+}
+
+// Dormand-Prince at a fraction of the smallest step; the difference to a run at
+// twice that step estimates how far the reference itself is off.
+static std::vector<Vec3> referenceSolution(const Options& options, const std::string& scene, double& referenceError)
+{
+	if (scene == "oscillator") {
+		referenceError = 0;
+		return oscillatorSolution(options.duration);
+	}
+	const float smallest = *std::min_element(options.timeSteps.begin(), options.timeSteps.end());
+	std::vector<Vec3> solutions[2];
+	for (int coarse = 0; coarse < 2; ++coarse) {
+		const float timeStep = smallest / REFERENCE_REFINEMENT * (coarse ? 2 : 1);
+		MassSpringSystemSimulator sim;
+		buildScene(sim, scene);
+		sim.setIntegrator(DORMAND_PRINCE);
+		const int steps = (int)std::lround(options.duration / timeStep);
+		for (int i = 0; i < steps; ++i) sim.simulateTimestep(timeStep);
+		solutions[coarse] = positions(sim);
+	}
+	double sum = 0;
+	for (size_t i = 0; i < solutions[0].size(); ++i) sum += normNoSqrt(solutions[0][i] - solutions[1][i]);
+	referenceError = std::sqrt(sum / solutions[0].size());
+	return solutions[0];
+}
+
+static double rmsError(const std::vector<Vec3>& a, const std::vector<Vec3>& b)
+{
+	double sum = 0;
+	for (size_t i = 0; i < a.size(); ++i) {
+		const Vec3 d = a[i] - b[i];
+		if (!std::isfinite(d.x) || !std::isfinite(d.y) || !std::isfinite(d.z)) return INFINITY;
+		sum += normNoSqrt(d);
+	}
+	return std::sqrt(sum / a.size());
+}
+
+static Result runOne(const Options& options, const std::string& scene, int integrator, float timeStep, const std::vector<Vec3>& reference)
+{
+	Result result;
+	result.scene = scene;
+	result.integrator = integrator;
+	result.timeStep = timeStep;
+	result.steps = std::max(1, (int)std::lround(options.duration / timeStep));
+	result.seconds = INFINITY;
+	result.pareto = false;
+
+	// repeat the run for the timing, the scene setup is not part of it
+	double total = 0;
+	int runs = 0;
+	while (runs == 0 || total < options.minTime) {
+		std::unique_ptr<MassSpringSystemSimulator> sim(new MassSpringSystemSimulator());
+		buildScene(*sim, scene);
+		sim->setIntegrator(integrator);
+		const auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < result.steps; ++i) sim->simulateTimestep(timeStep);
+		const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		result.seconds = std::min(result.seconds, seconds);
+		total += seconds;
+		runs++;
+
+		if (runs == 1) {
+			result.forceEvaluations = (double)sim->getForceEvaluationCount();
+			result.error = rmsError(positions(*sim), reference);
+			if (result.error > DIVERGED_ERROR) result.error = INFINITY;
+			// a blown up run is not worth timing twice
+			if (result.diverged()) break;
+		}
+	}
+	return result;
+}
+
+// marks the runs no other run beats in both time and error
+static void markPareto(std::vector<Result>& results)
+{
+	std::vector<Result*> order;
+	for (Result& r : results) {
+		if (!r.diverged()) order.push_back(&r);
+	}
+	std::sort(order.begin(), order.end(), [](const Result* a, const Result* b) {
+		return a->seconds != b->seconds ? a->seconds < b->seconds : a->error < b->error;
+	});
+	double bestError = INFINITY;
+	for (Result* r : order) {
+		r->pareto = r->error < bestError;
+		bestError = std::min(bestError, r->error);
+	}
+}
+
+static bool writeJson(const std::string& path, const Options& options, const std::vector<Result>& results)
+{
+	std::ofstream out(path.c_str());
+	if (!out) return false;
+	out << "{\n";
+	out << "  \"benchmark\": \"integrator-accuracy\",\n";
+	out << "  \"version\": 1,\n";
+	out << "  \"settings\": {\"duration\": " << options.duration << ", \"minTime\": " << options.minTime
+		<< ", \"referenceRefinement\": " << REFERENCE_REFINEMENT << "},\n";
+	out << "  \"results\": [";
+	for (size_t r = 0; r < results.size(); ++r) {
+		const Result& x = results[r];
+		out << (r ? ",\n" : "\n")
+			<< "    {\"scene\": \"" << x.scene << "\", \"integrator\": \"" << integratorName(x.integrator) << "\", \"dt\": " << x.timeStep
+			<< ", \"steps\": " << x.steps << ", \"seconds\": " << x.seconds << ", \"forceEvaluations\": " << x.forceEvaluations
+			<< ", \"error\": ";
+		// JSON has no infinity
+		if (x.diverged()) out << "null"; else out << x.error;
+		out << ", \"pareto\": " << (x.pareto ? "true" : "false") << "}";
+	}
+	out << "\n  ]\n}\n";
+	return (bool)out;
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage(argv[0]);
+		return 2;
+	}
+
+	std::vector<Result> results;
+	for (const std::string& scene : options.scenes) {
+		double referenceError;
+		const std::vector<Vec3> reference = referenceSolution(options, scene, referenceError);
+		std::vector<Result> sceneResults;
+		for (int integrator : options.integrators) {
+			for (float timeStep : options.timeSteps) {
+				sceneResults.push_back(runOne(options, scene, integrator, timeStep, reference));
+			}
+		}
+		markPareto(sceneResults);
+		std::sort(sceneResults.begin(), sceneResults.end(), [](const Result& a, const Result& b) { return a.seconds < b.seconds; });
+
+		if (referenceError > 0) {
+			std::printf("%s, %g s, reference error about %.1e (errors below are not resolved)\n", scene.c_str(), options.duration, referenceError);
+		} else {
+			std::printf("%s, %g s, analytic reference\n", scene.c_str(), options.duration);
+		}
+		std::printf("  %-9s %10s %7s %12s %12s %10s\n", "integr.", "dt", "steps", "ms/sim s", "evals/sim s", "rms error");
+		const Result* cheapest = nullptr;
+		for (const Result& r : sceneResults) {
+			std::printf("  %-9s %10.6f %7d %12.3f %12.0f ", integratorName(r.integrator), r.timeStep, r.steps,
+				r.msPerSimulatedSecond(options.duration), r.forceEvaluations / options.duration);
+			if (r.diverged()) std::printf("%10s\n", "diverged"); else std::printf("%10.2e%s\n", r.error, r.pareto ? "  pareto" : "");
+			if (!cheapest && options.budget > 0 && r.error <= options.budget) cheapest = &r;
+		}
+		if (options.budget > 0) {
+			if (cheapest) {
+				std::printf("  cheapest within %g: %s at dt %g\n", options.budget, integratorName(cheapest->integrator), cheapest->timeStep);
+			} else {
+				std::printf("  no run within %g\n", options.budget);
+			}
+		}
+		std::printf("\n");
+		std::fflush(stdout);
+		results.insert(results.end(), sceneResults.begin(), sceneResults.end());
+	}
+
+	if (!writeJson(options.jsonPath, options, results)) {
+		std::cerr << "cannot write " << options.jsonPath << "\n";
+		return 1;
+	}
+	std::cout << "results written to " << options.jsonPath << "\n";
+	return 0;
+}
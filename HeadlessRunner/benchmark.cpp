@@ -0,0 +1,291 @@
+// Benchmark suite: generated scenes from 1e2 to 1e6 points, stepped with every
+// integrator and thread count. Prints a table and writes the results as JSON,
+// so two runs can be diffed.
+//
+// Thread counts above the hardware threads share cores, so their rows time
+// the overhead of the parallel paths, not scaling; they are marked as
+// oversubscribed. Multi-core scaling has not been measured yet.
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "SceneBuilder.h"
+#include "util/cpuinfo.h"
+#include "common.h"
+
+// Memory traffic model of one force evaluation plus the integrator work that
+// comes with it, in bytes. Counts every array element touched once per use,
+// so it is an estimate of the data the step streams through, not a measured
+// DRAM bandwidth.
+//  spring: point1, point2, restLength, stiffness (24), position and velocity
+//          of both ends (96), read and write of both end forces (96)
+//  point:  clearing the force (24), reading x, v, f, 1/m and writing x, v (128)
+static const double SPRING_BYTES = 216;
+static const double POINT_BYTES = 152;
+
+static const char* SCENES[] = { "chain", "cloth", "volume", "random" };
+
+struct Options {
+	std::vector<std::string> scenes;
+	std::vector<int> sizes;
+	std::vector<int> integrators;
+	std::vector<int> threads;
+	float timeStep = 0.001f;
+	float minTime = 0.2f;
+	int minSteps = 3;
+	std::string jsonPath = "benchmark.json";
+};
+
+struct Result {
+	std::string scene;
+	int points, springs;
+	int integrator;
+	int threads;
+	const char* kernel;
+	int steps;
+	double seconds;
+	double forceEvaluationsPerStep;
+	int solverIterations;
+	bool diverged;
+
+	double nsPerStep() const { return 1e9 * seconds / steps; }
+	double nsPerPointStep() const { return points ? nsPerStep() / points : 0; }
+	double nsPerSpringStep() const { return springs ? nsPerStep() / springs : 0; }
+	double bytesPerStep() const { return forceEvaluationsPerStep * (SPRING_BYTES * springs + POINT_BYTES * points); }
+	double gigabytesPerSecond() const { return bytesPerStep() * steps / seconds * 1e-9; }
+};
+
+static void printUsage(const char* program)
+{
+	std::cerr
+		<< "usage: " << program << " [options]\n"
+		<< "  --scenes L       chain, cloth, volume, random (default all)\n"
+		<< "  --sizes L        approximate point counts (default 100,1000,10000,100000,1000000)\n"
+		<< "  --integrators L  integrator names as for headless_runner (default all)\n"
+		<< "  --threads L      thread counts (default 1, 2, 4, .. up to the hardware threads)\n"
+		<< "  --dt T           time step (default 0.001)\n"
+		<< "  --min-time T     seconds to measure per run (default 0.2)\n"
+		<< "  --min-steps N    steps to measure per run at least (default 3)\n"
+		<< "  --json FILE      result file (default benchmark.json)\n"
+		<< "lists are comma separated\n";
+}
+
+static bool parseOptions(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--help" || arg == "-h") return false;
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << arg << "\n";
+			return false;
+		}
+		const char* value = argv[++i];
+		bool ok = true;
+		if (arg == "--scenes") {
+			options.scenes = splitList(value);
+			for (const std::string& scene : options.scenes) {
+				ok &= std::find_if(std::begin(SCENES), std::end(SCENES), [&](const char* s) { return scene == s; }) != std::end(SCENES);
+			}
+		}
+		else if (arg == "--sizes" || arg == "--threads") {
+			std::vector<int>& list = arg == "--sizes" ? options.sizes : options.threads;
+			list.clear();
+			for (const std::string& item : splitList(value)) {
+				float number; // accepts 1e5
+				ok &= parseFloat(item.c_str(), number) && number >= 1;
+				list.push_back((int)number);
+			}
+		}
+		else if (arg == "--integrators") {
+			options.integrators.clear();
+			for (const std::string& item : splitList(value)) {
+				options.integrators.push_back(findIntegrator(item.c_str()));
+				ok &= options.integrators.back() >= 0;
+			}
+		}
+		else if (arg == "--dt") {
+			ok = parseFloat(value, options.timeStep) && options.timeStep > 0;
+		}
+		else if (arg == "--min-time") {
+			ok = parseFloat(value, options.minTime) && options.minTime >= 0;
+		}
+		else if (arg == "--min-steps") {
+			ok = parseInt(value, options.minSteps) && options.minSteps > 0;
+		}
+		else if (arg == "--json") {
+			options.jsonPath = value;
+		}
+		else {
+			std::cerr << "unknown option " << arg << "\n";
+			return false;
+		}
+		if (!ok) {
+			std::cerr << "invalid value '" << value << "' for " << arg << "\n";
+			return false;
+		}
+	}
+
+	if (options.scenes.empty()) options.scenes.assign(std::begin(SCENES), std::end(SCENES));
+	if (options.sizes.empty()) options.sizes = { 100, 1000, 10000, 100000, 1000000 };
+	if (options.integrators.empty()) {
+		for (const auto& entry : INTEGRATORS) options.integrators.push_back(entry.id);
+	}
+	if (options.threads.empty()) {
+		const int hardware = std::max(1, (int)std::thread::hardware_concurrency());
+		for (int t = 1; t < hardware; t *= 2) options.threads.push_back(t);
+		options.threads.push_back(hardware);
+	}
+	return true;
+}
+
+// builds the scene with about the requested number of points
+static void buildScene(MassSpringSystemSimulator& sim, const std::string& scene, int size)
+{
+	if (scene == "chain") {
+		buildChain(&sim, size, 0.1f);
+	}
+	else if (scene == "cloth") {
+		const int side = std::max(2, (int)std::lround(std::sqrt((double)size)));
+		buildCloth(&sim, side, side, 0.1f);
+	}
+	else if (scene == "volume") {
+		const int side = std::max(2, (int)std::lround(std::cbrt((double)size)));
+		buildVolumeLattice(&sim, side, side, side, 0.1f);
+	}
+	else {
+		buildRandomGraph(&sim, size, 4);
+	}
+}
+
+static Result runOne(const Options& options, const std::string& scene, int size, int integrator, int threads)
+{
+	std::unique_ptr<MassSpringSystemSimulator> sim(new MassSpringSystemSimulator());
+	sim->setConsoleLogging(false);
+	buildScene(*sim, scene, size);
+	sim->setIntegrator(integrator);
+	sim->setThreadCount(threads);
+
+	// the first step builds the colouring and adjacency, keep it out of the timing
+	sim->simulateTimestep(options.timeStep);
+
+	Result result;
+	result.scene = scene;
+	result.points = sim->getNumberOfMassPoints();
+	result.springs = sim->getNumberOfSprings();
+	result.integrator = integrator;
+	result.threads = sim->getThreadCount();
+	result.kernel = springKernelName(sim->getSpringKernel());
+
+	const unsigned long long evaluationsBefore = sim->getForceEvaluationCount();
+	const auto start = std::chrono::steady_clock::now();
+	int steps = 0;
+	double seconds = 0;
+	while (steps < options.minSteps || seconds < options.minTime) {
+		sim->simulateTimestep(options.timeStep);
+		steps++;
+		seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	}
+	result.steps = steps;
+	result.seconds = seconds;
+	result.forceEvaluationsPerStep = (double)(sim->getForceEvaluationCount() - evaluationsBefore) / steps;
+	result.solverIterations = integrator == IMPLICIT_EULER ? sim->getLastSolverIterations() : 0;
+
+	result.diverged = false;
+	for (int i = 0; i < result.points && !result.diverged; ++i) {
+		const Vec3 p = sim->getPositionOfMassPoint(i);
+		result.diverged = !std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z);
+	}
+	return result;
+}
+
+static std::string compilerName()
+{
+#if defined(__clang__)
+	return std::string("clang ") + __clang_version__;
+#elif defined(__GNUC__)
+	return std::string("gcc ") + __VERSION__;
+#elif defined(_MSC_VER)
+	return "msvc " + std::to_string(_MSC_VER);
+#else
+	return "unknown";
+#endif
+}
+
+static bool writeJson(const std::string& path, const Options& options, const std::vector<Result>& results)
+{
+	std::ofstream out(path.c_str());
+	if (!out) return false;
+	char date[32];
+	const std::time_t now = std::time(nullptr);
+	std::strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+	const CpuFeatures& cpu = cpuFeatures();
+
+	out << "{\n";
+	out << "  \"benchmark\": \"mass-spring\",\n";
+	out << "  \"version\": 1,\n";
+	out << "  \"date\": \"" << date << "\",\n";
+	out << "  \"machine\": {\"compiler\": \"" << compilerName() << "\", \"hardwareThreads\": " << std::thread::hardware_concurrency()
+		<< ", \"sse2\": " << cpu.sse2 << ", \"avx2\": " << cpu.avx2 << ", \"fma\": " << cpu.fma << ", \"avx512f\": " << cpu.avx512f << "},\n";
+	out << "  \"settings\": {\"dt\": " << options.timeStep << ", \"minTime\": " << options.minTime << ", \"minSteps\": " << options.minSteps
+		<< ", \"springBytes\": " << SPRING_BYTES << ", \"pointBytes\": " << POINT_BYTES << "},\n";
+	out << "  \"results\": [";
+	for (size_t r = 0; r < results.size(); ++r) {
+		const Result& x = results[r];
+		out << (r ? ",\n" : "\n")
+			<< "    {\"scene\": \"" << x.scene << "\", \"points\": " << x.points << ", \"springs\": " << x.springs
+			<< ", \"integrator\": \"" << integratorName(x.integrator) << "\", \"threads\": " << x.threads
+			<< ", \"kernel\": \"" << x.kernel << "\", \"steps\": " << x.steps << ", \"seconds\": " << x.seconds
+			<< ", \"nsPerStep\": " << x.nsPerStep() << ", \"nsPerPointStep\": " << x.nsPerPointStep()
+			<< ", \"nsPerSpringStep\": " << x.nsPerSpringStep() << ", \"forceEvaluationsPerStep\": " << x.forceEvaluationsPerStep
+			<< ", \"solverIterations\": " << x.solverIterations << ", \"estimatedBytesPerStep\": " << x.bytesPerStep()
+			<< ", \"estimatedGBps\": " << x.gigabytesPerSecond() << ", \"diverged\": " << (x.diverged ? "true" : "false") << "}";
+	}
+	out << "\n  ]\n}\n";
+	return (bool)out;
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage(argv[0]);
+		return 2;
+	}
+
+	std::printf("%-7s %8s %8s %-9s %3s %9s %12s %10s %10s %6s %7s\n",
+		"scene", "points", "springs", "integr.", "thr", "steps", "ns/step", "ns/point", "ns/spring", "evals", "GB/s");
+	const int hardware = std::max(1, (int)std::thread::hardware_concurrency());
+	std::vector<Result> results;
+	for (const std::string& scene : options.scenes) {
+		for (int size : options.sizes) {
+			for (int integrator : options.integrators) {
+				for (int threads : options.threads) {
+					const Result r = runOne(options, scene, size, integrator, threads);
+					std::printf("%-7s %8d %8d %-9s %3d %9d %12.0f %10.2f %10.2f %6.2f %7.2f%s%s\n",
+						r.scene.c_str(), r.points, r.springs, integratorName(r.integrator), r.threads, r.steps,
+						r.nsPerStep(), r.nsPerPointStep(), r.nsPerSpringStep(), r.forceEvaluationsPerStep,
+						r.gigabytesPerSecond(), r.diverged ? "  diverged" : "", r.threads > hardware ? "  oversubscribed" : "");
+					std::fflush(stdout);
+					results.push_back(r);
+				}
+			}
+		}
+	}
+
+	if (!writeJson(options.jsonPath, options, results)) {
+		std::cerr << "cannot write " << options.jsonPath << "\n";
+		return 1;
+	}
+	std::cout << "results written to " << options.jsonPath << "\n";
+	return 0;
+}
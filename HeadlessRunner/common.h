@@ -0,0 +1,87 @@
+#ifndef __common_h__
+#define __common_h__
+
+// Command line helpers shared by the headless runner and the benchmarks.
+
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "MassSpringSystemSimulator.h"
+
+static const struct { const char* name; int id; } INTEGRATORS[] = {
+	{ "euler", EULER },
+	{ "leapfrog", LEAPFROG },
+	{ "midpoint", MIDPOINT },
+	{ "verlet", VELOCITY_VERLET },
+	{ "yoshida4", YOSHIDA4 },
+	{ "implicit", IMPLICIT_EULER },
+	{ "heun", HEUN },
+	{ "rk4", RK4 },
+	{ "dopri", DORMAND_PRINCE },
+};
+
+static const struct { const char* name; SpringKernelIsa isa; } KERNELS[] = {
+	{ "scalar", SPRING_KERNEL_SCALAR },
+	{ "sse2", SPRING_KERNEL_SSE2 },
+	{ "avx2", SPRING_KERNEL_AVX2 },
+	{ "avx512", SPRING_KERNEL_AVX512 },
+};
+
+inline const char* integratorName(int id)
+{
+	for (const auto& entry : INTEGRATORS) {
+		if (entry.id == id) return entry.name;
+	}
+	return "scene default";
+}
+
+// returns -1 for an unknown name
+inline int findIntegrator(const char* name)
+{
+	for (const auto& entry : INTEGRATORS) {
+		if (std::strcmp(entry.name, name) == 0) return entry.id;
+	}
+	return -1;
+}
+
+inline int findKernel(const char* name)
+{
+	for (const auto& entry : KERNELS) {
+		if (std::strcmp(entry.name, name) == 0) return entry.isa;
+	}
+	return -1;
+}
+
+inline bool parseInt(const char* text, int& value)
+{
+	char* end;
+	long parsed = std::strtol(text, &end, 10);
+	if (end == text || *end != '\0') return false;
+	value = (int)parsed;
+	return true;
+}
+
+inline bool parseFloat(const char* text, float& value)
+{
+	char* end;
+	value = std::strtof(text, &end);
+	return end != text && *end == '\0';
+}
+
+// splits "a,b,c"; empty items are dropped
+inline std::vector<std::string> splitList(const std::string& text)
+{
+	std::vector<std::string> items;
+	size_t start = 0;
+	while (start <= text.size()) {
+		size_t comma = text.find(',', start);
+		if (comma == std::string::npos) comma = text.size();
+		if (comma > start) items.push_back(text.substr(start, comma - start));
+		start = comma + 1;
+	}
+	return items;
+}
+
+#endif
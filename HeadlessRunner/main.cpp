@@ -0,0 +1,347 @@
+// Headless runner: steps a mass-spring scene without window, renderer or UI
+// and reports the throughput. Links only the simulation core (simcore).
+
+#include <chrono>
+#include <cmath>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "SceneBuilder.h"
+#include "util/frametimes.h"
+#include "util/metrics.h"
+#include "util/perfcounters.h"
+#include "util/profiler.h"
+#include "util/trace.h"
+#include "common.h"
+
+struct Options {
+	std::string scene = "demo4";
+	int integrator = -1; // keep the scene's own
+	float timeStep = 0.005f;
+	int steps = 1000;
+	int threads = 0;
+	bool adaptive = false;
+	int kernel = -1;
+	bool profile = false;
+	bool counters = false;
+	bool memory = false;
+	bool energy = false;
+	bool autoTimestep = false;
+	bool pointCollisions = false;
+	bool selfCollisions = false;
+	bool continuousCollisions = false;
+	int obstacles = 0;
+	PointBroadphase broadphase = POINT_BROADPHASE_HASH_GRID;
+	std::string tracePath;
+	std::string frameDumpPath;
+	float dumpInterval = 10;
+	std::string metricsPath;
+	float metricsInterval = 5;
+};
+
+static void printUsage(const char* program)
+{
+	std::cerr
+		<< "usage: " << program << " [options]\n"
+		<< "  --scene S        demo2..demo5, lattice:WxH, cloud:N (N free points falling\n"
+		<< "                   onto the floor), cloth:WxH (hanging cloth, crumpled by\n"
+		<< "                   gravity) or a scene file (default demo4)\n"
+		<< "  --integrator I   euler, leapfrog, midpoint, verlet, yoshida4, implicit,\n"
+		<< "                   heun, rk4, dopri (default: the scene's own)\n"
+		<< "  --dt T           time step in seconds (default 0.005)\n"
+		<< "  --steps N        number of steps (default 1000)\n"
+		<< "  --threads N      spring force threads, 0 = hardware threads (default 0)\n"
+		<< "  --adaptive       error controlled substepping inside each step\n"
+		<< "  --kernel K       scalar, sse2, avx2 or avx512 (default: best supported)\n"
+		<< "  --profile        print the profiler zones of the run\n"
+		<< "  --counters       hardware counters per phase and thread (Linux), printed at exit\n"
+		<< "  --memory         print the memory use per subsystem after the run\n"
+		<< "  --energy         monitor energy and momentum drift, warn once it exceeds 1%\n"
+		<< "  --auto-dt        adapt the step to the energy drift (implies --energy)\n"
+		<< "  --point-collisions\n"
+		<< "                   mass points collide with each other as spheres\n"
+		<< "  --broadphase B   grid or sap (sweep-and-prune) for --point-collisions\n"
+		<< "                   (default grid)\n"
+		<< "  --self-collisions\n"
+		<< "                   cloth triangles collide with each other\n"
+		<< "  --ccd            sweep the points against the floor over each step\n"
+		<< "  --obstacles N    N static spheres, boxes and capsules in the cube a\n"
+		<< "                   cloud:N scene fills, tested in batches per shape type\n"
+		<< "  --trace FILE     record a Chrome trace (ui.perfetto.dev) of the run\n"
+		<< "  --frame-dump F   append step time percentiles to the CSV file F (soak tests)\n"
+		<< "  --dump-every S   seconds per block of --frame-dump (default 10)\n"
+		<< "  --metrics F      keep Prometheus style metrics in the file F up to date\n"
+		<< "  --export-every S seconds between rewrites of --metrics (default 5)\n";
+}
+
+static bool parseOptions(int argc, char** argv, Options& options)
+{
+	for (int i = 1; i < argc; ++i) {
+		const std::string arg = argv[i];
+		if (arg == "--help" || arg == "-h") return false;
+		if (arg == "--adaptive") {
+			options.adaptive = true;
+			continue;
+		}
+		if (arg == "--profile") {
+			options.profile = true;
+			continue;
+		}
+		if (arg == "--counters") {
+			options.counters = true;
+			continue;
+		}
+		if (arg == "--memory") {
+			options.memory = true;
+			continue;
+		}
+		if (arg == "--point-collisions") {
+			options.pointCollisions = true;
+			continue;
+		}
+		if (arg == "--self-collisions") {
+			options.selfCollisions = true;
+			continue;
+		}
+		if (arg == "--ccd") {
+			options.continuousCollisions = true;
+			continue;
+		}
+		if (arg == "--energy" || arg == "--auto-dt") {
+			options.energy = true;
+			options.autoTimestep = options.autoTimestep || arg == "--auto-dt";
+			continue;
+		}
+		if (i + 1 >= argc) {
+			std::cerr << "missing value for " << arg << "\n";
+			return false;
+		}
+		const char* value = argv[++i];
+		bool ok = true;
+		if (arg == "--scene") {
+			options.scene = value;
+		}
+		else if (arg == "--integrator") {
+			options.integrator = findIntegrator(value);
+			ok = options.integrator >= 0;
+		}
+		else if (arg == "--trace") {
+			options.tracePath = value;
+		}
+		else if (arg == "--frame-dump") {
+			options.frameDumpPath = value;
+		}
+		else if (arg == "--dump-every") {
+			ok = parseFloat(value, options.dumpInterval) && options.dumpInterval > 0;
+		}
+		else if (arg == "--metrics") {
+			options.metricsPath = value;
+		}
+		else if (arg == "--export-every") {
+			ok = parseFloat(value, options.metricsInterval) && options.metricsInterval > 0;
+		}
+		else if (arg == "--dt") {
+			ok = parseFloat(value, options.timeStep) && options.timeStep > 0;
+		}
+		else if (arg == "--steps") {
+			ok = parseInt(value, options.steps) && options.steps > 0;
+		}
+		else if (arg == "--obstacles") {
+			ok = parseInt(value, options.obstacles) && options.obstacles >= 0;
+		}
+		else if (arg == "--threads") {
+			ok = parseInt(value, options.threads) && options.threads >= 0;
+		}
+		else if (arg == "--broadphase") {
+			const std::string name = value;
+			options.broadphase = name == "sap" ? POINT_BROADPHASE_SWEEP_AND_PRUNE : POINT_BROADPHASE_HASH_GRID;
+			ok = name == "sap" || name == "grid";
+		}
+		else if (arg == "--kernel") {
+			options.kernel = findKernel(value);
+			ok = options.kernel >= 0 && isSpringKernelSupported((SpringKernelIsa)options.kernel);
+		}
+		else {
+			std::cerr << "unknown option " << arg << "\n";
+			return false;
+		}
+		if (!ok) {
+			std::cerr << "invalid value '" << value << "' for " << arg << "\n";
+			return false;
+		}
+	}
+	return true;
+}
+
+static bool setupScene(MassSpringSystemSimulator& sim, const std::string& scene)
+{
+	// Demo1 only prints a precomputed step, so the runnable demos start at Demo2
+	if (scene.size() == 5 && scene.compare(0, 4, "demo") == 0 && scene[4] >= '2' && scene[4] <= '5') {
+		sim.notifyCaseChanged(scene[4] - '1');
+		return true;
+	}
+	int width, height;
+	char separator;
+	if (scene.compare(0, 8, "lattice:") == 0) {
+		std::istringstream in(scene.substr(8));
+		if (in >> width >> separator >> height && separator == 'x' && width > 0 && height > 0) {
+			buildLattice(&sim, width, height, 0.2f);
+			return true;
+		}
+		std::cerr << "invalid lattice size '" << scene.substr(8) << "', expected WxH\n";
+		return false;
+	}
+	if (scene.compare(0, 6, "cloth:") == 0) {
+		std::istringstream in(scene.substr(6));
+		if (in >> width >> separator >> height && separator == 'x' && width > 1 && height > 1) {
+			// the jitter lets the cloth fold onto itself instead of swinging flat
+			buildCloth(&sim, width, height, 0.1f);
+			sim.setGravityEnabled(true);
+			return true;
+		}
+		std::cerr << "invalid cloth size '" << scene.substr(6) << "', expected WxH\n";
+		return false;
+	}
+	if (scene.compare(0, 6, "cloud:") == 0) {
+		int count;
+		if (parseInt(scene.c_str() + 6, count) && count > 0) {
+			buildRandomGraph(&sim, count, 0);
+			sim.setGravityEnabled(true);
+			sim.setCollisionEnabled(true);
+			return true;
+		}
+		std::cerr << "invalid point count '" << scene.substr(6) << "'\n";
+		return false;
+	}
+	std::string error;
+	if (!loadScene(&sim, scene, error)) {
+		std::cerr << error << "\n";
+		return false;
+	}
+	return true;
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	if (!parseOptions(argc, argv, options)) {
+		printUsage(argv[0]);
+		return 2;
+	}
+
+	profilerSetThreadName("main");
+	MassSpringSystemSimulator sim;
+	sim.setConsoleLogging(false);
+	if (!setupScene(sim, options.scene)) return 1;
+	if (options.obstacles > 0) buildObstacles(&sim, options.obstacles, cbrtf((float)sim.getNumberOfMassPoints()));
+	// the demos choose their own integrator, the command line overrides it
+	if (options.integrator >= 0) sim.setIntegrator(options.integrator);
+	sim.setThreadCount(options.threads);
+	if (options.kernel >= 0) sim.setSpringKernel((SpringKernelIsa)options.kernel);
+	sim.setAdaptiveStepping(options.adaptive);
+	sim.setEnergyMonitoring(options.energy);
+	sim.setAutoTimestep(options.autoTimestep);
+	sim.setPointCollisionEnabled(options.pointCollisions);
+	sim.setPointBroadphase(options.broadphase);
+	sim.setSelfCollisionEnabled(options.selfCollisions);
+	sim.setContinuousCollisionEnabled(options.continuousCollisions);
+	sim.getEnergyMonitor().onDrift = [](const EnergySample& sample, Real drift) {
+		std::cerr << "energy drift " << drift * 100 << "% at t = " << sample.time << " s\n";
+	};
+
+	const int points = sim.getNumberOfMassPoints();
+	const int springs = sim.getNumberOfSprings();
+	std::cout << "scene       " << options.scene << " (" << points << " points, " << springs << " springs)\n";
+	std::cout << "integrator  " << integratorName(options.integrator) << (options.adaptive ? " adaptive" : "")
+		<< ", dt " << options.timeStep << ", " << options.steps << " steps\n";
+	std::cout << "threads     " << sim.getThreadCount() << ", kernel " << springKernelName(sim.getSpringKernel()) << "\n";
+
+	// scene setup is not part of the profile
+	profilerClear();
+	profilerSetEnabled(options.profile);
+	if (options.counters) {
+#ifdef GAMEPHYSICS_NO_PROFILE
+		std::cout << "counter phases are compiled out (GAMEPHYSICS_PROFILE=OFF)\n";
+#else
+		if (!perfCountersSetEnabled(true)) std::cerr << perfCountersStatus() << "\n";
+		perfCountersClear();
+		perfCountersDumpAtExit();
+#endif
+	}
+	if (!options.tracePath.empty() && !traceStart(options.tracePath)) {
+		std::cerr << "cannot write " << options.tracePath << "\n";
+		return 1;
+	}
+	if (!options.frameDumpPath.empty() && !frameTimesStartDump(options.frameDumpPath, options.dumpInterval)) {
+		std::cerr << "cannot write " << options.frameDumpPath << "\n";
+		return 1;
+	}
+	if (!options.metricsPath.empty() && !metricsStartExport(options.metricsPath, options.metricsInterval)) {
+		std::cerr << "cannot write " << options.metricsPath << "\n";
+		return 1;
+	}
+	frameTimesReset();
+	const auto start = std::chrono::steady_clock::now();
+	for (int step = 0; step < options.steps; ++step) {
+		options.timeStep = sim.suggestTimestep(options.timeStep);
+		{
+			FrameTimer timer(FRAME_STAGE_SIMULATION);
+			sim.simulateTimestep(options.timeStep);
+		}
+		traceFlush();
+		frameTimesPoll();
+	}
+	const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	if (traceIsActive()) {
+		traceStop();
+		std::cout << "trace       " << options.tracePath << ", " << traceDroppedEvents() << " events dropped\n";
+	}
+	frameTimesStopDump();
+	metricsStopExport();
+
+	const double stepsPerSecond = options.steps / seconds;
+	std::cout << "time        " << seconds << " s\n";
+	std::cout << "steps/s     " << stepsPerSecond << "\n";
+	std::cout << "points/s    " << stepsPerSecond * points << "\n";
+	std::cout << "springs/s   " << stepsPerSecond * springs << "\n";
+	// the mean hides the spikes a frame budget cares about
+	const LatencyHistogram& stepTimes = frameTimesTotal(FRAME_STAGE_SIMULATION);
+	std::cout << "step ms     p50 " << stepTimes.percentile(50) * 1e-6 << ", p95 " << stepTimes.percentile(95) * 1e-6
+		<< ", p99 " << stepTimes.percentile(99) * 1e-6 << ", max " << stepTimes.max() * 1e-6 << "\n";
+	if (options.pointCollisions) std::cout << "contacts    " << sim.getLastPointContacts() << " between points in the last step\n";
+	if (options.selfCollisions) std::cout << "contacts    " << sim.getLastSelfContacts() << " cloth self-contacts in the last step\n";
+	if (options.continuousCollisions) std::cout << "contacts    " << sim.getLastStaticContacts() << " swept in the last step\n";
+	if (options.obstacles > 0) std::cout << "contacts    " << sim.getLastColliderContacts() << " with obstacles in the last step\n";
+	if (options.adaptive) {
+		const AdaptiveStepStats& stats = sim.getAdaptiveStepStats();
+		std::cout << "substeps    " << stats.acceptedSteps << " accepted, " << stats.rejectedSteps << " rejected\n";
+	}
+	if (options.energy) {
+		const EnergyMonitor& monitor = sim.getEnergyMonitor();
+		std::cout << "energy      " << monitor.latest().total() << " J, drift " << monitor.drift() * 100
+			<< "% since t = " << monitor.reference().time << " s\n";
+		std::cout << "momentum    drift " << monitor.momentumDrift() << " kg m/s\n";
+		if (options.autoTimestep) std::cout << "final dt    " << options.timeStep << "\n";
+	}
+
+	if (options.memory) std::cout << "\n" << sim.getMemoryReport();
+
+	if (options.profile) {
+#ifdef GAMEPHYSICS_NO_PROFILE
+		std::cout << "profiler zones are compiled out (GAMEPHYSICS_PROFILE=OFF)\n";
+#else
+		std::cout << "\n" << profilerReport();
+#endif
+	}
+
+	// a blown up simulation is a failure, not a benchmark result
+	for (int i = 0; i < points; ++i) {
+		Vec3 p = sim.getPositionOfMassPoint(i);
+		if (!std::isfinite(p.x) || !std::isfinite(p.y) || !std::isfinite(p.z)) {
+			std::cerr << "mass point " << i << " diverged\n";
+			return 1;
+		}
+	}
+	return 0;
+}
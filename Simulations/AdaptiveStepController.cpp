@@ -0,0 +1,70 @@
+#include "AdaptiveStepController.h"
+
+#include <algorithm>
+
+static const Real SAFETY = 0.9;
+static const Real MIN_FACTOR = 0.2;
+static const Real MAX_FACTOR = 5.0;
+
+AdaptiveStepController::AdaptiveStepController()
+	: absoluteTolerance(1e-4), relativeTolerance(1e-3), minStep(1e-6), maxStep(0.05)
+{
+	reset();
+	resetStats();
+}
+
+void AdaptiveStepController::reset()
+{
+	m_fStep = 1e-3;
+	m_fPreviousError = 1;
+}
+
+void AdaptiveStepController::resetStats()
+{
+	m_stats.acceptedSteps = 0;
+	m_stats.rejectedSteps = 0;
+	m_stats.simulatedTime = 0;
+	m_stats.lastStep = 0;
+	m_stats.smallestStep = 0;
+	m_stats.largestStep = 0;
+}
+
+Real AdaptiveStepController::nextStep(Real remaining) const
+{
+	const Real h = std::min(std::max(m_fStep, minStep), maxStep);
+	if (remaining <= h) return remaining;
+	if (remaining < 2 * h) return 0.5 * remaining;
+	return h;
+}
+
+bool AdaptiveStepController::judge(Real error, Real step, int errorOrder)
+{
+	const bool accepted = error <= 1 || step <= minStep;
+	const Real e = std::max(error, Real(1e-10));
+	const Real k = errorOrder;
+	Real factor;
+
+	if (accepted) {
+		// PI control (Gustafsson): damps the step size oscillation of pure I control
+		factor = SAFETY * pow(e, -0.7 / k) * pow(m_fPreviousError, 0.4 / k);
+		m_fPreviousError = e;
+
+		if (m_stats.acceptedSteps == 0 || step < m_stats.smallestStep) m_stats.smallestStep = step;
+		if (step > m_stats.largestStep) m_stats.largestStep = step;
+		m_stats.acceptedSteps++;
+		m_stats.simulatedTime += step;
+		m_stats.lastStep = step;
+	}
+	else {
+		// never grow right after a rejection
+		factor = std::min(Real(1), SAFETY * pow(e, -1.0 / k));
+		m_stats.rejectedSteps++;
+	}
+	factor = std::min(std::max(factor, MIN_FACTOR), MAX_FACTOR);
+
+	Real proposal = step * factor;
+	// a step clipped to the end of the interval says nothing against the old size
+	if (accepted && factor >= 1) proposal = std::max(proposal, m_fStep);
+	m_fStep = std::min(std::max(proposal, minStep), maxStep);
+	return accepted;
+}
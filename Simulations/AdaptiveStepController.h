@@ -0,0 +1,49 @@
+#ifndef ADAPTIVESTEPCONTROLLER_h
+#define ADAPTIVESTEPCONTROLLER_h
+
+#include "util/vectorbase.h"
+
+using namespace GamePhysics;
+
+struct AdaptiveStepStats {
+	int acceptedSteps;
+	int rejectedSteps;
+	Real simulatedTime;
+	Real lastStep;
+	Real smallestStep; // accepted steps only
+	Real largestStep;
+};
+
+// Step size control for error estimating integrators.
+// The caller takes a trial step of nextStep(), measures its local error
+// scaled by the tolerances (<= 1 means acceptable) and passes it to judge(),
+// which decides whether the step is kept and proposes the next step size
+// with a PI controller. Steps at minStep are always accepted so that a
+// frame is never left unfinished.
+class AdaptiveStepController {
+public:
+	AdaptiveStepController();
+
+	Real absoluteTolerance;
+	Real relativeTolerance;
+	Real minStep;
+	Real maxStep;
+
+	// trial step for the remaining time of the current interval; a short
+	// remainder is split evenly instead of leaving a tiny last step
+	Real nextStep(Real remaining) const;
+	// errorOrder is the exponent of h in the local error estimate
+	bool judge(Real error, Real step, int errorOrder);
+
+	const AdaptiveStepStats& getStats() const { return m_stats; }
+	void resetStats();
+	// forgets the step size history, e.g. after a scene change
+	void reset();
+
+private:
+	Real m_fStep;
+	Real m_fPreviousError;
+	AdaptiveStepStats m_stats;
+};
+
+#endif
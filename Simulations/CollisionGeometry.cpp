@@ -0,0 +1,192 @@
+#include "CollisionGeometry.h"
+
+#include <algorithm>
+#include <limits>
+
+// triangle edge tests accept points this far outside (relative to the
+// doubled area), so a path through a shared edge hits one of the triangles
+static const Real EDGE_TOLERANCE = 1e-9;
+
+bool sweepPlane(const Vec3& normal, Real offset, const Vec3& a, const Vec3& b, Real radius, SweepHit& hit)
+{
+	const Real sa = dot(normal, a) - offset;
+	if (sa < 0) return false;
+	// a sphere already closer than its radius stops at once if it moves in
+	const Real skin = std::min(radius, sa);
+	const Real da = sa - skin;
+	const Real db = dot(normal, b) - offset - skin;
+	if (db >= 0) return false;
+	hit.t = da / (da - db);
+	hit.normal = normal;
+	return true;
+}
+
+int CollisionGeometry::addPlane(const Vec3& normal, Real offset)
+{
+	const Plane plane = { normal, offset };
+	m_planes.push_back(plane);
+	return (int)m_planes.size() - 1;
+}
+
+int CollisionGeometry::addBox(const Vec3& lo, const Vec3& hi)
+{
+	const Box box = { lo, hi };
+	m_boxes.push_back(box);
+	return (int)m_boxes.size() - 1;
+}
+
+int CollisionGeometry::addMesh(const Vec3* vertices, int numVertices, const int* indices, int numTriangles)
+{
+	const int first = this->numTriangles();
+	const int base = (int)m_px.size();
+	for (int i = 0; i < numVertices; ++i) {
+		m_px.push_back(vertices[i].x);
+		m_py.push_back(vertices[i].y);
+		m_pz.push_back(vertices[i].z);
+	}
+	for (int i = 0; i < 3 * numTriangles; ++i) m_triangles.push_back(base + indices[i]);
+	m_meshBVH.build(m_triangles.data(), this->numTriangles(), m_px.data(), m_py.data(), m_pz.data());
+	return first;
+}
+
+void CollisionGeometry::clear()
+{
+	m_planes.clear();
+	m_boxes.clear();
+	m_px.clear();
+	m_py.clear();
+	m_pz.clear();
+	m_triangles.clear();
+	m_meshBVH.clear();
+}
+
+// Slab test of the segment against the box grown by the radius: the sphere
+// enters where the last of the three slabs is entered.
+static bool sweepBox(const Vec3& lo, const Vec3& hi, const Vec3& a, const Vec3& b, Real radius, SweepHit& hit)
+{
+	const Vec3 d = b - a;
+	Real enter = -std::numeric_limits<Real>::max(), exit = std::numeric_limits<Real>::max();
+	int axis = -1;
+	for (unsigned k = 0; k < 3; ++k) {
+		const Real slabLo = lo[k] - radius, slabHi = hi[k] + radius;
+		if (d[k] == 0) {
+			if (a[k] <= slabLo || a[k] >= slabHi) return false;
+			continue;
+		}
+		Real t0 = (slabLo - a[k]) / d[k], t1 = (slabHi - a[k]) / d[k];
+		if (t0 > t1) std::swap(t0, t1);
+		if (t0 > enter) {
+			enter = t0;
+			axis = k;
+		}
+		exit = std::min(exit, t1);
+	}
+	// a start inside the grown box is left to pushOut()
+	if (axis < 0 || enter < 0 || enter > 1 || enter >= exit) return false;
+	hit.t = enter;
+	hit.normal = Vec3(0, 0, 0);
+	hit.normal[axis] = d[axis] > 0 ? -1 : 1;
+	return true;
+}
+
+// The face offset by the radius towards the side the sphere starts on,
+// like sweepPlane(), and the contact point inside the triangle.
+static bool sweepTriangle(const Vec3& v0, const Vec3& v1, const Vec3& v2, const Vec3& a, const Vec3& b, Real radius, SweepHit& hit)
+{
+	const Vec3 face = cross(v1 - v0, v2 - v0);
+	const Real area = norm(face);
+	if (area == 0) return false;
+	Vec3 normal = face / area;
+	Real sa = dot(normal, a - v0);
+	if (sa < 0 || (sa == 0 && dot(normal, b - a) > 0)) {
+		normal = -normal;
+		sa = -sa;
+	}
+	const Real skin = std::min(radius, sa);
+	const Real da = sa - skin;
+	const Real db = dot(normal, b - v0) - skin;
+	if (db >= 0) return false;
+	const Real t = da / (da - db);
+	const Vec3 p = a + (b - a) * t - normal * skin;
+	const Real tolerance = -EDGE_TOLERANCE * area;
+	if (dot(cross(v1 - v0, p - v0), face) < tolerance || dot(cross(v2 - v1, p - v1), face) < tolerance || dot(cross(v0 - v2, p - v2), face) < tolerance) return false;
+	hit.t = t;
+	hit.normal = normal;
+	return true;
+}
+
+bool CollisionGeometry::sweep(const Vec3& a, const Vec3& b, Real radius, SweepHit& hit) const
+{
+	bool found = false;
+	hit.t = std::numeric_limits<Real>::max();
+	SweepHit candidate;
+	for (const Plane& plane : m_planes) {
+		if (sweepPlane(plane.normal, plane.offset, a, b, radius, candidate) && candidate.t < hit.t) {
+			hit = candidate;
+			found = true;
+		}
+	}
+	for (const Box& box : m_boxes) {
+		if (sweepBox(box.lo, box.hi, a, b, radius, candidate) && candidate.t < hit.t) {
+			hit = candidate;
+			found = true;
+		}
+	}
+	if (!m_triangles.empty()) {
+		const Real lo[3] = { std::min(a.x, b.x) - radius, std::min(a.y, b.y) - radius, std::min(a.z, b.z) - radius };
+		const Real hi[3] = { std::max(a.x, b.x) + radius, std::max(a.y, b.y) + radius, std::max(a.z, b.z) + radius };
+		m_meshBVH.forEachTriangle(lo, hi, [&](int t) {
+			const int* T = &m_triangles[3 * t];
+			const Vec3 v0(m_px[T[0]], m_py[T[0]], m_pz[T[0]]);
+			const Vec3 v1(m_px[T[1]], m_py[T[1]], m_pz[T[1]]);
+			const Vec3 v2(m_px[T[2]], m_py[T[2]], m_pz[T[2]]);
+			if (sweepTriangle(v0, v1, v2, a, b, radius, candidate) && candidate.t < hit.t) {
+				hit = candidate;
+				found = true;
+			}
+		});
+	}
+	return found;
+}
+
+int CollisionGeometry::pushOut(Vec3& position, Real radius, Vec3& normal) const
+{
+	int pushes = 0;
+	for (const Plane& plane : m_planes) {
+		const Real s = dot(plane.normal, position) - plane.offset;
+		if (s >= radius) continue;
+		position += plane.normal * (radius - s);
+		normal = plane.normal;
+		pushes++;
+	}
+	for (const Box& box : m_boxes) {
+		// the face of the grown box nearest to the centre
+		Real nearest = std::numeric_limits<Real>::max();
+		unsigned axis = 0;
+		Real side = 0;
+		for (unsigned k = 0; k < 3; ++k) {
+			const Real below = position[k] - (box.lo[k] - radius);
+			const Real above = box.hi[k] + radius - position[k];
+			if (below <= 0 || above <= 0) {
+				nearest = -1;
+				break;
+			}
+			if (below < nearest) {
+				nearest = below;
+				axis = k;
+				side = -1;
+			}
+			if (above < nearest) {
+				nearest = above;
+				axis = k;
+				side = 1;
+			}
+		}
+		if (nearest < 0) continue;
+		position[axis] += side * nearest;
+		normal = Vec3(0, 0, 0);
+		normal[axis] = side;
+		pushes++;
+	}
+	return pushes;
+}
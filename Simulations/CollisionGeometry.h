@@ -0,0 +1,69 @@
+#ifndef COLLISIONGEOMETRY_h
+#define COLLISIONGEOMETRY_h
+
+#include "util/vectorbase.h"
+#include "util/memorytags.h"
+#include "TriangleBVH.h"
+
+using namespace GamePhysics;
+
+// First contact of a swept sphere: the fraction t of the path at which it
+// touches, and the surface normal pointing towards the sphere.
+struct SweepHit {
+	Real t;
+	Vec3 normal;
+};
+
+// Static obstacles for continuous collision: half spaces, axis aligned
+// boxes and two sided triangle meshes. sweep() moves a sphere along a
+// segment and returns the first touching shape, so an object cannot pass
+// through a shape thinner than its step, as a test of the end position
+// alone would let it.
+//
+// Boxes are grown by the radius on every side, so their corners and edges
+// are square instead of rounded; meshes are tested against their faces
+// offset by the radius. Both err on the side of an early contact. All
+// triangles go into one tree, built when a mesh is added.
+class CollisionGeometry {
+public:
+	// dot(normal, x) >= offset is free space, normal has unit length
+	int addPlane(const Vec3& normal, Real offset);
+	int addBox(const Vec3& lo, const Vec3& hi);
+	// three vertex indices per triangle; returns the index of the first triangle
+	int addMesh(const Vec3* vertices, int numVertices, const int* indices, int numTriangles);
+	void clear();
+	bool empty() const { return m_planes.empty() && m_boxes.empty() && m_triangles.empty(); }
+	int numPlanes() const { return (int)m_planes.size(); }
+	int numBoxes() const { return (int)m_boxes.size(); }
+	int numTriangles() const { return (int)m_triangles.size() / 3; }
+
+	// First contact of a sphere of the given radius moving from a to b.
+	// A sphere that starts inside a plane or box does not hit it; see
+	// pushOut().
+	bool sweep(const Vec3& a, const Vec3& b, Real radius, SweepHit& hit) const;
+	// Moves a sphere that overlaps a plane or box to its surface and
+	// returns the number of shapes it was pushed out of; normal is the last
+	// push direction.
+	int pushOut(Vec3& position, Real radius, Vec3& normal) const;
+
+private:
+	struct Plane {
+		Vec3 normal;
+		Real offset;
+	};
+	struct Box {
+		Vec3 lo, hi;
+	};
+
+	TaggedVector<Plane, MEMORY_TAG_COLLISION> m_planes;
+	TaggedVector<Box, MEMORY_TAG_COLLISION> m_boxes;
+	TaggedVector<Real, MEMORY_TAG_COLLISION> m_px, m_py, m_pz;
+	TaggedVector<int, MEMORY_TAG_COLLISION> m_triangles;
+	TriangleBVH m_meshBVH;
+};
+
+// First contact of a sphere moving from a to b with one side of a plane,
+// the half space dot(normal, x) >= offset being free.
+bool sweepPlane(const Vec3& normal, Real offset, const Vec3& a, const Vec3& b, Real radius, SweepHit& hit);
+
+#endif
@@ -0,0 +1,92 @@
+#include "EnergyMonitor.h"
+
+#include <algorithm>
+#include <cmath>
+
+EnergyMonitor::EnergyMonitor()
+	: driftThreshold(0.01), m_iNext(0), m_iCount(0), m_reference(), m_fScale(0), m_fDrift(0),
+	  m_bArmed(true)
+{
+	setHistoryLength(256);
+}
+
+void EnergyMonitor::reset()
+{
+	m_iNext = 0;
+	m_iCount = 0;
+	m_fDrift = 0;
+	m_bArmed = true;
+}
+
+void EnergyMonitor::setHistoryLength(int length)
+{
+	m_history.assign(std::max(length, 2), EnergySample());
+	reset();
+}
+
+void EnergyMonitor::record(const EnergySample& sample)
+{
+	if (m_iCount == 0) {
+		m_reference = sample;
+		m_fScale = fabs(sample.kinetic) + fabs(sample.elastic) + fabs(sample.gravity);
+	}
+	m_history[m_iNext] = sample;
+	m_iNext = (m_iNext + 1) % (int)m_history.size();
+	m_iCount = std::min(m_iCount + 1, (int)m_history.size());
+
+	// a scene at rest has no energy scale, any change then counts in full
+	const Real scale = m_fScale > 1e-12 ? m_fScale : 1;
+	m_fDrift = (sample.total() - m_reference.total()) / scale;
+	if (std::isnan(m_fDrift)) m_fDrift = INFINITY;
+
+	if (fabs(m_fDrift) > driftThreshold) {
+		if (m_bArmed && onDrift) onDrift(sample, m_fDrift);
+		m_bArmed = false;
+	}
+	else {
+		m_bArmed = true;
+	}
+}
+
+const EnergySample& EnergyMonitor::sample(int age) const
+{
+	const int n = (int)m_history.size();
+	return m_history[((m_iNext - 1 - age) % n + n) % n];
+}
+
+Real EnergyMonitor::momentumDrift() const
+{
+	if (m_iCount == 0) return 0;
+	return norm(latest().momentum - m_reference.momentum);
+}
+
+Real EnergyMonitor::suggestTimestep(Real timeStep, Real minStep, Real maxStep)
+{
+	if (m_iCount < 2) return timeStep;
+	const Real scale = m_fScale > 1e-12 ? m_fScale : 1;
+
+	// largest climb of the energy above an earlier sample of the window
+	Real lowest = INFINITY;
+	Real gain = 0;
+	for (int age = m_iCount - 1; age >= 0; --age) {
+		const Real e = sample(age).total();
+		if (!std::isfinite(e)) { gain = INFINITY; break; }
+		lowest = std::min(lowest, e);
+		gain = std::max(gain, e - lowest);
+	}
+	gain /= scale;
+
+	Real next = timeStep;
+	if (gain > 0.5 * driftThreshold || m_fDrift > driftThreshold) {
+		next = timeStep * 0.5;
+	}
+	else if (m_iCount == (int)m_history.size() && gain < 0.125 * driftThreshold) {
+		next = timeStep * 1.25;
+	}
+	next = std::min(std::max(next, minStep), maxStep);
+	if (next != timeStep) {
+		// judge the new step on its own samples, against a fresh reference
+		reset();
+	}
+	return next;
+}
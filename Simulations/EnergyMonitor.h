@@ -0,0 +1,72 @@
+#ifndef ENERGYMONITOR_h
+#define ENERGYMONITOR_h
+
+#include <functional>
+#include <vector>
+#include "util/memorytags.h"
+#include "util/vectorbase.h"
+
+using namespace GamePhysics;
+
+struct EnergySample {
+	Real time;
+	Real kinetic;
+	Real elastic;  // spring potential
+	Real gravity;  // m g y, relative to y = 0
+	Vec3 momentum;
+
+	Real total() const { return kinetic + elastic + gravity; }
+};
+
+// Watches the total energy and linear momentum of a simulation for numerical
+// drift. Samples go into a rolling history of fixed length; the first sample
+// after reset() is the reference the drift is measured against:
+//   drift = (E - E_ref) / (|T_ref| + |U_ref| + |G_ref|)
+// Damping, collisions and fixed points change energy and momentum
+// physically, so the threshold has to leave room for them in such scenes.
+//
+// suggestTimestep() turns the monitor into a step size control: growing
+// energy is the signature of an unstable step, so the step is halved as soon
+// as the energy climbs by more than half the threshold within the history
+// window, and raised by 25% after a whole window of gain below an eighth of
+// it. Energy loss is never treated as instability, implicit Euler and
+// damping dissipate by design. A change of the step restarts the history
+// and the reference.
+class EnergyMonitor {
+public:
+	EnergyMonitor();
+
+	Real driftThreshold;
+	// called with the sample and its drift when |drift| first exceeds the
+	// threshold; armed again after reset() or once the drift is back below
+	std::function<void(const EnergySample&, Real)> onDrift;
+
+	void reset();
+	// capacity of the rolling history, clears it
+	void setHistoryLength(int length);
+	void record(const EnergySample& sample);
+
+	bool hasSamples() const { return m_iCount > 0; }
+	const EnergySample& reference() const { return m_reference; }
+	const EnergySample& latest() const { return sample(0); }
+	// age 0 is the latest sample, historySize() - 1 the oldest still kept
+	const EnergySample& sample(int age) const;
+	int historySize() const { return m_iCount; }
+
+	Real drift() const { return m_fDrift; }
+	// |p - p_ref|, absolute since the reference momentum is often zero
+	Real momentumDrift() const;
+
+	Real suggestTimestep(Real timeStep, Real minStep, Real maxStep);
+
+private:
+	TaggedVector<EnergySample, MEMORY_TAG_DIAGNOSTICS> m_history; // ring
+	int m_iNext;
+	int m_iCount;
+	EnergySample m_reference;
+	Real m_fScale;
+	Real m_fDrift;
+	bool m_bArmed;
+};
+
+#endif
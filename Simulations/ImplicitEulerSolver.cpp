@@ -0,0 +1,184 @@
+#include "ImplicitEulerSolver.h"
+
+#include <algorithm>
+
+static Real dotProduct(const RealArray& a, const RealArray& b)
+{
+	Real sum = 0;
+	const size_t len = a.size();
+	for (size_t k = 0; k < len; ++k) sum += a[k] * b[k];
+	return sum;
+}
+
+static ArenaAllocator<Real> solverMemory()
+{
+	return ArenaAllocator<Real>(nullptr, MEMORY_TAG_SOLVER);
+}
+
+ImplicitEulerSolver::ImplicitEulerSolver()
+	: m_iNumPoints(0), m_fDamping(0),
+	  m_nx(solverMemory()), m_ny(solverMemory()), m_nz(solverMemory()), m_kTransverse(solverMemory()), m_kAxial(solverMemory()),
+	  m_rhs(solverMemory()), m_dv(solverMemory()), m_r(solverMemory()), m_z(solverMemory()), m_p(solverMemory()),
+	  m_Ap(solverMemory()), m_invDiag(solverMemory()), m_tmp(solverMemory()),
+	  m_fTolerance(1e-6), m_iMaxIterations(200), m_iLastIterations(0), m_fLastResidual(0)
+{
+}
+
+void ImplicitEulerSolver::linearizeSprings(const MassPointStore& points, const SpringStore& springs)
+{
+	const int m = springs.size();
+	m_nx.resize(m); m_ny.resize(m); m_nz.resize(m);
+	m_kTransverse.resize(m); m_kAxial.resize(m);
+
+	for (int s = 0; s < m; ++s) {
+		const int i = springs.point1[s];
+		const int j = springs.point2[s];
+		Real dx = points.px[i] - points.px[j];
+		Real dy = points.py[i] - points.py[j];
+		Real dz = points.pz[i] - points.pz[j];
+		Real length = sqrt(dx * dx + dy * dy + dz * dz);
+		Real invLength = length > 0 ? 1 / length : 0;
+		m_nx[s] = dx * invLength;
+		m_ny[s] = dy * invLength;
+		m_nz[s] = dz * invLength;
+
+		// df_i/dx_i = -k [ (1 - L/l)(I - nn^T) + nn^T ]
+		// the transverse part is dropped for compressed springs
+		Real k = springs.stiffness[s];
+		Real transverse = k * std::max<Real>(0, 1 - springs.restLength[s] * invLength);
+		m_kTransverse[s] = transverse;
+		m_kAxial[s] = k - transverse;
+	}
+}
+
+void ImplicitEulerSolver::applyStiffness(const SpringStore& springs, Real dampingStep, const RealArray& in, RealArray& out) const
+{
+	const int n = m_iNumPoints;
+	const int m = springs.size();
+	// df_i/dv_i = -d nn^T, the same shape as the axial stiffness
+	const Real axialDamping = dampingStep > 0 ? m_fDamping / dampingStep : 0;
+	std::fill(out.begin(), out.end(), Real(0));
+	const Real* inx = in.data();
+	const Real* iny = inx + n;
+	const Real* inz = iny + n;
+	Real* outx = out.data();
+	Real* outy = outx + n;
+	Real* outz = outy + n;
+
+	for (int s = 0; s < m; ++s) {
+		const int i = springs.point1[s];
+		const int j = springs.point2[s];
+		Real dx = inx[i] - inx[j];
+		Real dy = iny[i] - iny[j];
+		Real dz = inz[i] - inz[j];
+		Real axial = (m_kAxial[s] + axialDamping) * (m_nx[s] * dx + m_ny[s] * dy + m_nz[s] * dz);
+		Real tx = -(m_kTransverse[s] * dx + axial * m_nx[s]);
+		Real ty = -(m_kTransverse[s] * dy + axial * m_ny[s]);
+		Real tz = -(m_kTransverse[s] * dz + axial * m_nz[s]);
+		outx[i] += tx; outy[i] += ty; outz[i] += tz;
+		outx[j] -= tx; outy[j] -= ty; outz[j] -= tz;
+	}
+}
+
+void ImplicitEulerSolver::applySystem(const MassPointStore& points, const SpringStore& springs, Real h, const RealArray& in, RealArray& out) const
+{
+	const int n = m_iNumPoints;
+	// h^2 (K + D / h) = h D + h^2 K
+	applyStiffness(springs, h, in, out);
+	const Real h2 = h * h;
+	for (int c = 0; c < 3; ++c) {
+		for (int i = 0; i < n; ++i) {
+			const int k = c * n + i;
+			out[k] = points.fixed[i] ? in[k] : points.mass[i] * in[k] - h2 * out[k];
+		}
+	}
+}
+
+void ImplicitEulerSolver::step(MassPointStore& points, const SpringStore& springs, Real damping, Real timeStep)
+{
+	const int n = points.size();
+	const Real h = timeStep;
+	const Real h2 = h * h;
+	m_fDamping = damping;
+	// a changed point count invalidates the warm start
+	if (n != m_iNumPoints) m_dv.assign(3 * n, 0);
+	m_iNumPoints = n;
+	m_rhs.resize(3 * n); m_r.resize(3 * n); m_z.resize(3 * n);
+	m_p.resize(3 * n); m_Ap.resize(3 * n); m_invDiag.resize(3 * n); m_tmp.resize(3 * n);
+
+	linearizeSprings(points, springs);
+
+	// rhs = h (f + h K v)
+	for (int i = 0; i < n; ++i) {
+		m_tmp[i] = points.vx[i];
+		m_tmp[n + i] = points.vy[i];
+		m_tmp[2 * n + i] = points.vz[i];
+	}
+	applyStiffness(springs, 0, m_tmp, m_Ap);
+	for (int i = 0; i < n; ++i) {
+		const bool isFixed = points.fixed[i] != 0;
+		m_rhs[i] = isFixed ? 0 : h * (points.fx[i] + h * m_Ap[i]);
+		m_rhs[n + i] = isFixed ? 0 : h * (points.fy[i] + h * m_Ap[n + i]);
+		m_rhs[2 * n + i] = isFixed ? 0 : h * (points.fz[i] + h * m_Ap[2 * n + i]);
+		if (isFixed) m_dv[i] = m_dv[n + i] = m_dv[2 * n + i] = 0;
+	}
+
+	// Jacobi preconditioner from the diagonal of M - h D - h^2 K
+	for (int i = 0; i < n; ++i) {
+		m_invDiag[i] = m_invDiag[n + i] = m_invDiag[2 * n + i] = points.fixed[i] ? 0 : points.mass[i];
+	}
+	for (int s = 0; s < springs.size(); ++s) {
+		const Real nc[3] = { m_nx[s], m_ny[s], m_nz[s] };
+		const int ends[2] = { springs.point1[s], springs.point2[s] };
+		for (int e = 0; e < 2; ++e) {
+			if (points.fixed[ends[e]]) continue;
+			for (int c = 0; c < 3; ++c) {
+				m_invDiag[c * n + ends[e]] += h2 * (m_kTransverse[s] + m_kAxial[s] * nc[c] * nc[c]) + h * damping * nc[c] * nc[c];
+			}
+		}
+	}
+	for (int k = 0; k < 3 * n; ++k) m_invDiag[k] = m_invDiag[k] > 0 ? 1 / m_invDiag[k] : 0;
+
+	// preconditioned conjugate gradient, warm started with the previous dv
+	applySystem(points, springs, h, m_dv, m_Ap);
+	for (int k = 0; k < 3 * n; ++k) {
+		m_r[k] = m_rhs[k] - m_Ap[k];
+		m_z[k] = m_invDiag[k] * m_r[k];
+		m_p[k] = m_z[k];
+	}
+	Real rz = dotProduct(m_r, m_z);
+	const Real rhsNorm2 = dotProduct(m_rhs, m_rhs);
+	const Real threshold = m_fTolerance * m_fTolerance * std::max<Real>(rhsNorm2, 1e-30);
+	Real rr = dotProduct(m_r, m_r);
+
+	int iter = 0;
+	while (iter < m_iMaxIterations && rr > threshold) {
+		applySystem(points, springs, h, m_p, m_Ap);
+		Real pAp = dotProduct(m_p, m_Ap);
+		if (pAp <= 0) break;
+		Real alpha = rz / pAp;
+		for (int k = 0; k < 3 * n; ++k) {
+			m_dv[k] += alpha * m_p[k];
+			m_r[k] -= alpha * m_Ap[k];
+			m_z[k] = m_invDiag[k] * m_r[k];
+		}
+		Real rzNew = dotProduct(m_r, m_z);
+		Real beta = rzNew / rz;
+		rz = rzNew;
+		for (int k = 0; k < 3 * n; ++k) m_p[k] = m_z[k] + beta * m_p[k];
+		rr = dotProduct(m_r, m_r);
+		++iter;
+	}
+	m_iLastIterations = iter;
+	m_fLastResidual = rhsNorm2 > 0 ? sqrt(rr / rhsNorm2) : 0;
+
+	// v += dv, x += h v
+	for (int i = 0; i < n; ++i) {
+		points.vx[i] += m_dv[i];
+		points.vy[i] += m_dv[n + i];
+		points.vz[i] += m_dv[2 * n + i];
+		points.px[i] += h * points.vx[i];
+		points.py[i] += h * points.vy[i];
+		points.pz[i] += h * points.vz[i];
+	}
+}
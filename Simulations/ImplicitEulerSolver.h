@@ -0,0 +1,50 @@
+#ifndef IMPLICITEULERSOLVER_h
+#define IMPLICITEULERSOLVER_h
+
+#include "MassPointStore.h"
+#include "SpringStore.h"
+
+// Linearised backward Euler step for mass-spring systems.
+// Solves (M - h D - h^2 K) dv = h (f + h K v) with a Jacobi preconditioned
+// conjugate gradient, where K = df/dx and D = df/dv are applied matrix-free
+// as sums of 3x3 spring blocks. Damping acts along the spring, so D only adds
+// to the axial part of each block; treating it implicitly keeps heavily
+// damped stiff springs stable. Compressed springs drop their transverse term
+// to keep the system positive definite. Fixed points are filtered out of the solve.
+// All scratch buffers are kept between steps, so a step of unchanged size
+// does not allocate.
+class ImplicitEulerSolver {
+public:
+	ImplicitEulerSolver();
+
+	// expects points.f to hold the forces at the current positions and
+	// velocities, computed with the same damping
+	void step(MassPointStore& points, const SpringStore& springs, Real damping, Real timeStep);
+
+	void setTolerance(Real relativeResidual) { m_fTolerance = relativeResidual; }
+	void setMaxIterations(int iterations) { m_iMaxIterations = iterations; }
+	int getLastIterations() const { return m_iLastIterations; }
+	Real getLastResidual() const { return m_fLastResidual; }
+
+private:
+	void linearizeSprings(const MassPointStore& points, const SpringStore& springs);
+	// out = (K + D / dampingStep) * in for vectors laid out as
+	// [x0..xn-1, y0..yn-1, z0..zn-1]; dampingStep = 0 leaves out D
+	void applyStiffness(const SpringStore& springs, Real dampingStep, const RealArray& in, RealArray& out) const;
+	// out = (M - h D - h^2 K) * in, identity rows for fixed points
+	void applySystem(const MassPointStore& points, const SpringStore& springs, Real h, const RealArray& in, RealArray& out) const;
+
+	int m_iNumPoints;
+	Real m_fDamping;
+	// per spring: direction and the two stiffness coefficients of the 3x3 block
+	RealArray m_nx, m_ny, m_nz, m_kTransverse, m_kAxial;
+	// CG vectors of length 3n
+	RealArray m_rhs, m_dv, m_r, m_z, m_p, m_Ap, m_invDiag, m_tmp;
+
+	Real m_fTolerance;
+	int m_iMaxIterations;
+	int m_iLastIterations;
+	Real m_fLastResidual;
+};
+
+#endif
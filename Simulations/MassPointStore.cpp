@@ -0,0 +1,150 @@
+#include "MassPointStore.h"
+
+#include <algorithm>
+
+static ArenaAllocator<Real> pointMemory(SceneArena* arena)
+{
+	return ArenaAllocator<Real>(arena, MEMORY_TAG_POINTS);
+}
+
+MassPointStore::MassPointStore(SceneArena* arena)
+	: px(pointMemory(arena)), py(pointMemory(arena)), pz(pointMemory(arena)),
+	  vx(pointMemory(arena)), vy(pointMemory(arena)), vz(pointMemory(arena)),
+	  fx(pointMemory(arena)), fy(pointMemory(arena)), fz(pointMemory(arena)),
+	  mass(pointMemory(arena)), invMass(pointMemory(arena)),
+	  fixed(ArenaAllocator<unsigned char>(pointMemory(arena)))
+{
+}
+
+int MassPointStore::add(Vec3 position, Vec3 velocity, bool isFixed, Real pointMass)
+{
+	// fixed points never move, so their velocity is dropped
+	if (isFixed) velocity = Vec3(0, 0, 0);
+
+	px.push_back(position.x); py.push_back(position.y); pz.push_back(position.z);
+	vx.push_back(velocity.x); vy.push_back(velocity.y); vz.push_back(velocity.z);
+	fx.push_back(0); fy.push_back(0); fz.push_back(0);
+	mass.push_back(pointMass);
+	invMass.push_back(isFixed ? 0 : 1 / pointMass);
+	fixed.push_back(isFixed ? 1 : 0);
+	return size() - 1;
+}
+
+void MassPointStore::swap(int a, int b)
+{
+	std::swap(px[a], px[b]); std::swap(py[a], py[b]); std::swap(pz[a], pz[b]);
+	std::swap(vx[a], vx[b]); std::swap(vy[a], vy[b]); std::swap(vz[a], vz[b]);
+	std::swap(fx[a], fx[b]); std::swap(fy[a], fy[b]); std::swap(fz[a], fz[b]);
+	std::swap(mass[a], mass[b]);
+	std::swap(invMass[a], invMass[b]);
+	std::swap(fixed[a], fixed[b]);
+}
+
+void MassPointStore::reserve(int capacity)
+{
+	px.reserve(capacity); py.reserve(capacity); pz.reserve(capacity);
+	vx.reserve(capacity); vy.reserve(capacity); vz.reserve(capacity);
+	fx.reserve(capacity); fy.reserve(capacity); fz.reserve(capacity);
+	mass.reserve(capacity);
+	invMass.reserve(capacity);
+	fixed.reserve(capacity);
+}
+
+void MassPointStore::clear()
+{
+	px.clear(); py.clear(); pz.clear();
+	vx.clear(); vy.clear(); vz.clear();
+	fx.clear(); fy.clear(); fz.clear();
+	mass.clear();
+	invMass.clear();
+	fixed.clear();
+}
+
+void MassPointStore::release()
+{
+	*this = MassPointStore(px.get_allocator().arena);
+}
+
+void MassPointStore::clearForces(bool isGravityEnabled, PointDiagnostics* diagnostics)
+{
+	const int n = size();
+	const Real g = isGravityEnabled ? -9.81 : 0;
+	Real* __restrict fxp = fx.data();
+	Real* __restrict fyp = fy.data();
+	Real* __restrict fzp = fz.data();
+	const Real* __restrict m = mass.data();
+	if (!diagnostics) {
+		for (int i = 0; i < n; ++i) {
+			fxp[i] = 0;
+			fyp[i] = g * m[i];
+			fzp[i] = 0;
+		}
+		return;
+	}
+
+	const Real* __restrict vxp = vx.data();
+	const Real* __restrict vyp = vy.data();
+	const Real* __restrict vzp = vz.data();
+	const Real* __restrict pyp = py.data();
+	Real kinetic = 0, gravity = 0, mx = 0, my = 0, mz = 0;
+	for (int i = 0; i < n; ++i) {
+		fxp[i] = 0;
+		fyp[i] = g * m[i];
+		fzp[i] = 0;
+		kinetic += m[i] * (vxp[i] * vxp[i] + vyp[i] * vyp[i] + vzp[i] * vzp[i]);
+		gravity -= fyp[i] * pyp[i];
+		mx += m[i] * vxp[i];
+		my += m[i] * vyp[i];
+		mz += m[i] * vzp[i];
+	}
+	diagnostics->kinetic = 0.5 * kinetic;
+	diagnostics->gravity = gravity;
+	diagnostics->momentum = Vec3(mx, my, mz);
+}
+
+void MassPointStore::measure(bool isGravityEnabled, PointDiagnostics& diagnostics, Real velocityLag) const
+{
+	const Real g = isGravityEnabled ? 9.81 : 0;
+	Real kinetic = 0, gravity = 0, mx = 0, my = 0, mz = 0;
+	for (int i = 0; i < size(); ++i) {
+		const Real hw = velocityLag * invMass[i];
+		const Real ux = vx[i] + hw * fx[i];
+		const Real uy = vy[i] + hw * fy[i];
+		const Real uz = vz[i] + hw * fz[i];
+		kinetic += mass[i] * (ux * ux + uy * uy + uz * uz);
+		gravity += g * mass[i] * py[i];
+		mx += mass[i] * ux;
+		my += mass[i] * uy;
+		mz += mass[i] * uz;
+	}
+	diagnostics.kinetic = 0.5 * kinetic;
+	diagnostics.gravity = gravity;
+	diagnostics.momentum = Vec3(mx, my, mz);
+}
+
+void MassPointStore::setMass(Real pointMass)
+{
+	for (int i = 0; i < size(); ++i) {
+		mass[i] = pointMass;
+		invMass[i] = fixed[i] ? 0 : 1 / pointMass;
+	}
+}
+
+std::string MassPoint::toString() const {
+	return "position = " + getPosition().toString() + "; velocity = " + getVelocity().toString();
+}
+
+void MassPointStore::saveState(RealArray& state) const
+{
+	const int n = size();
+	if (state.size() < 9 * (size_t)n) state.resize(9 * (size_t)n);
+	const RealArray* src[9] = { &px, &py, &pz, &vx, &vy, &vz, &fx, &fy, &fz };
+	for (int q = 0; q < 9; ++q) std::copy(src[q]->begin(), src[q]->end(), state.begin() + q * n);
+}
+
+void MassPointStore::restoreState(const RealArray& state)
+{
+	const int n = size();
+	RealArray* dst[9] = { &px, &py, &pz, &vx, &vy, &vz, &fx, &fy, &fz };
+	for (int q = 0; q < 9; ++q) std::copy(state.begin() + q * n, state.begin() + (q + 1) * n, dst[q]->begin());
+}
@@ -0,0 +1,90 @@
+#ifndef MASSPOINTSTORE_h
+#define MASSPOINTSTORE_h
+
+#include <string>
+#include <vector>
+#include "util/vectorbase.h"
+#include "util/arena.h"
+
+using namespace GamePhysics;
+
+typedef ArenaVector<Real> RealArray;
+
+// Per point sums for the energy monitor, see MassPointStore::measure().
+struct PointDiagnostics {
+	Real kinetic;  // sum 1/2 m |v|^2
+	Real gravity;  // sum m g y, zero without gravity
+	Vec3 momentum; // sum m v
+};
+
+// Structure-of-arrays storage for all mass points of a scene.
+// Every attribute lives in its own contiguous, SIMD aligned array so that
+// the per-step passes (force clearing, spring forces, integration) stream
+// through memory instead of chasing one heap object per point.
+// Fixed points have an inverse mass of zero.
+// All arrays are allocated from the given arena (heap if none).
+class MassPointStore {
+public:
+	explicit MassPointStore(SceneArena* arena = nullptr);
+
+	RealArray px, py, pz;
+	RealArray vx, vy, vz;
+	RealArray fx, fy, fz;
+	RealArray mass;
+	RealArray invMass;
+	ArenaVector<unsigned char> fixed;
+
+	int add(Vec3 position, Vec3 velocity, bool isFixed, Real pointMass);
+	// exchanges every attribute of points a and b
+	void swap(int a, int b);
+	void reserve(int capacity);
+	void clear();
+	// drops all storage; required before the owning arena is reset
+	void release();
+	int size() const { return (int)px.size(); }
+
+	// Resets the forces to gravity. With diagnostics, the kinetic and
+	// gravitational energy and the momentum are summed in the same pass.
+	void clearForces(bool isGravityEnabled, PointDiagnostics* diagnostics = nullptr);
+	// same sums without touching the forces; with velocityLag, the kinetic
+	// energy and momentum of the velocities v + velocityLag * f / m
+	void measure(bool isGravityEnabled, PointDiagnostics& diagnostics, Real velocityLag = 0) const;
+	void setMass(Real pointMass);
+
+	// Copies positions, velocities and forces (9n values) into state and
+	// back, used to retry a step. state only grows, so repeated saves of the
+	// same scene do not allocate.
+	void saveState(RealArray& state) const;
+	void restoreState(const RealArray& state);
+
+	Vec3 getPosition(int i) const { return Vec3(px[i], py[i], pz[i]); }
+	Vec3 getVelocity(int i) const { return Vec3(vx[i], vy[i], vz[i]); }
+	Vec3 getForce(int i) const { return Vec3(fx[i], fy[i], fz[i]); }
+	void setPosition(int i, Vec3 p) { px[i] = p.x; py[i] = p.y; pz[i] = p.z; }
+	void setVelocity(int i, Vec3 v) { vx[i] = v.x; vy[i] = v.y; vz[i] = v.z; }
+	void applyForce(int i, Vec3 f) { fx[i] += f.x; fy[i] += f.y; fz[i] += f.z; }
+};
+
+// Lightweight handle onto one entry of a MassPointStore.
+// Cheap to copy; stays valid as long as the store is not cleared.
+class MassPoint {
+public:
+	MassPoint() : store(nullptr), index(-1) {}
+	MassPoint(MassPointStore* store, int index) : store(store), index(index) {}
+
+	MassPointStore* store;
+	int index;
+
+	Vec3 getPosition() const { return store->getPosition(index); }
+	Vec3 getVelocity() const { return store->getVelocity(index); }
+	Vec3 getForce() const { return store->getForce(index); }
+	void setPosition(Vec3 position) { store->setPosition(index, position); }
+	void setVelocity(Vec3 velocity) { store->setVelocity(index, velocity); }
+	bool isFixed() const { return store->fixed[index] != 0; }
+	Real getMass() const { return store->mass[index]; }
+	void applyForce(Vec3 force) { store->applyForce(index, force); }
+	Vec3 getAcceleration() const { return store->getForce(index) * store->invMass[index]; }
+	std::string toString() const;
+};
+
+#endif
@@ -1,74 +1,47 @@
 #include "MassSpringSystemSimulator.h"
-#include <queue>
+#include "util/logger.h"
+#include "util/metrics.h"
+#include "util/perfcounters.h"
+#include "util/profiler.h"
+#include "util/trace.h"
+
+#include <algorithm>
 
 constexpr auto FLOOR_Y = -1;
 constexpr auto MASSPOINT_RADIUS = .1;
-
-MassPoint::MassPoint(Vec3 position, Vec3 velocity, bool isFixed, float mass) {
-	this->position = position;
-	this->velocity = velocity;
-	this->isFixed = isFixed;
-	this->mass = mass;
-
-	clearForce(false);
-}
-
-void MassPoint::clearForce(bool isGravityEnabled) {
-	this->force = isGravityEnabled ? mass * Vec3(0, -9.81, 0) : Vec3(0, 0, 0);
-}
-
-void MassPoint::applyForce(Vec3 force) {
-	this->force += force;
-}
-
-Vec3 MassPoint::getAcceleration() {
-	return force / mass;
-}
-
-std::string MassPoint::toString() {
-	return "position = " + position.toString() + "; velocity = " + velocity.toString();
-}
-
-Spring::Spring(MassPoint* masspoint1, MassPoint* masspoint2, float initialLength, float stiffness) {
-	this->masspoint1 = masspoint1;
-	this->masspoint2 = masspoint2;
-	this->initialLength = initialLength;
-	this->stiffness = stiffness;
-}
-
-void Spring::addElasticForceToPoints() {
-	Vec3 direction = masspoint1->position - masspoint2->position;
-	float distance = sqrt(masspoint1->position.squaredDistanceTo(masspoint2->position));
-
-	// Hooke's Law
-	Vec3 force1to2 = -stiffness * (distance - this->initialLength) * (direction / distance);
-
-	masspoint1->applyForce(force1to2);
-	masspoint2->applyForce(-force1to2);
-
-	/*
-	
-	Vec3 direction = masspoint1->position - masspoint2->position;
-
-	// Hooke's Law
-	Vec3 force1to2 = -stiffness * (normalize(direction) - this->initialLength) * getNormalized(direction);
-
-	masspoint1->applyForce(force1to2);
-	masspoint2->applyForce(-force1to2);
-
-	*/
-}
+// of colliding mass points, 0 = they stop, 1 = elastic
+constexpr Real POINT_RESTITUTION = .5;
+// swept contacts per point and step before the point stays where it is
+constexpr int MAX_SWEEP_CONTACTS = 4;
+// a swept point stops this far off the surface, so the rest of its path
+// does not touch the same surface at once
+constexpr Real SWEEP_SEPARATION = 1e-9;
+constexpr int MIN_POINTS_PER_SWEEP_CHUNK = 1024;
+// Smaller scenes are not worth waking the worker threads for. Both values
+// were only checked on a single core, where threads can only add overhead;
+// how the colour-parallel forces scale over several cores is unmeasured.
+constexpr int PARALLEL_MIN_SPRINGS = 8192;
+constexpr int PARALLEL_GRAIN = 1024;
 
 MassSpringSystemSimulator::MassSpringSystemSimulator()
+	: massPoints(&sceneArena), springs(&sceneArena),
+	  stepStartState(ArenaAllocator<Real>(nullptr, MEMORY_TAG_SOLVER)), fullStepState(ArenaAllocator<Real>(nullptr, MEMORY_TAG_SOLVER))
 {
 	m_iTestCase = 0;
 	m_fMass = 10.0;
 	m_fStiffness = 40.0;
 	m_fDamping = 0.0;
 	m_iIntegrator = EULER;
-
-	teapot = NULL;
-
+	springKernel = bestSpringKernelIsa();
+	threadPool.setThreadCount(0);
+
+	teapot = -1;
+	clothThickness = MASSPOINT_RADIUS;
+	staticRestitution = .5;
+	staticFriction = .2;
+	energyMonitor.onDrift = [this](const EnergySample&, Real drift) {
+		if (isConsoleLogging) logEvent("energy drift", drift);
+	};
 }
 
 const char* MassSpringSystemSimulator::getTestCasesStr()
@@ -80,17 +53,49 @@ void MassSpringSystemSimulator::initUI(DrawingUtilitiesClass* DUC)
 {
 	this->DUC = DUC;
 
+#ifndef GAMEPHYSICS_HEADLESS
 	TwEnumVal enumVals[] = {
 		{ EULER, "Euler" },
 		{ MIDPOINT, "Midpoint" },
+		{ LEAPFROG, "Leapfrog" },
+		{ VELOCITY_VERLET, "Velocity Verlet" },
+		{ YOSHIDA4, "Yoshida 4" },
+		{ IMPLICIT_EULER, "Implicit Euler" },
+		{ HEUN, "Heun" },
+		{ RK4, "Runge-Kutta 4" },
+		{ DORMAND_PRINCE, "Dormand-Prince 5(4)" },
 	};
-	TwType TW_TYPE_TESTCASE = TwDefineEnum("Sim.Meth.", enumVals, 2);
+	TwType TW_TYPE_TESTCASE = TwDefineEnum("Sim.Meth.", enumVals, 9);
 	TwAddVarRW(DUC->g_pTweakBar, "Sim.Meth.", TW_TYPE_TESTCASE, &m_iIntegrator, "");
+	TwAddVarRW(DUC->g_pTweakBar, "Damping", TW_TYPE_FLOAT, &m_fDamping, "min=0 step=0.1");
+
+	TwEnumVal kernelVals[] = {
+		{ SPRING_KERNEL_SCALAR, "Scalar (reference)" },
+		{ SPRING_KERNEL_SSE2, "SSE2" },
+		{ SPRING_KERNEL_AVX2, "AVX2" },
+		{ SPRING_KERNEL_AVX512, "AVX-512" },
+	};
+	TwType TW_TYPE_KERNEL = TwDefineEnum("Spring Kernel", kernelVals, 4);
+	TwAddVarRW(DUC->g_pTweakBar, "Spring Kernel", TW_TYPE_KERNEL, &springKernel, "");
+
+	if (isAdaptive) {
+		TwAddVarRW(DUC->g_pTweakBar, "Abs. Tolerance", TW_TYPE_DOUBLE, &stepController.absoluteTolerance, "min=1e-9 step=1e-5");
+		TwAddVarRW(DUC->g_pTweakBar, "Rel. Tolerance", TW_TYPE_DOUBLE, &stepController.relativeTolerance, "min=1e-9 step=1e-4");
+		TwAddVarRO(DUC->g_pTweakBar, "Accepted Steps", TW_TYPE_INT32, &stepController.getStats().acceptedSteps, "");
+		TwAddVarRO(DUC->g_pTweakBar, "Rejected Steps", TW_TYPE_INT32, &stepController.getStats().rejectedSteps, "");
+	}
+
+	TwAddVarRW(DUC->g_pTweakBar, "Point Collisions", TW_TYPE_BOOLCPP, &isPointCollisionEnabled, "");
+	TwAddVarRW(DUC->g_pTweakBar, "Self Collisions", TW_TYPE_BOOLCPP, &isSelfCollisionEnabled, "");
+	TwAddVarRW(DUC->g_pTweakBar, "Swept Collisions", TW_TYPE_BOOLCPP, &isContinuousCollisionEnabled, "");
+	TwAddVarRW(DUC->g_pTweakBar, "Energy Monitor", TW_TYPE_BOOLCPP, &isEnergyMonitoring, "");
+	TwAddVarRW(DUC->g_pTweakBar, "Auto dt", TW_TYPE_BOOLCPP, &isAutoTimestep, "");
+	TwAddVarRO(DUC->g_pTweakBar, "Energy Drift", TW_TYPE_DOUBLE, &monitoredDrift, "");
 
 
 	//TwType TW_TYPE_TESTCASE = TwDefineEnumFromString("Sim.Meth.", "Euler,Midpoint");
 	//TwAddVarRW(DUC->g_pTweakBar, "Sim.Meth.", TW_TYPE_TESTCASE, &simMethDemo4, "");
-
+#endif
 }
 
 void MassSpringSystemSimulator::reset()
@@ -100,30 +105,34 @@ void MassSpringSystemSimulator::reset()
 	m_oldtrackmouse.x = m_oldtrackmouse.y = 0;
 }
 
-void MassSpringSystemSimulator::drawFrame(ID3D11DeviceContext* pd3dImmediateContext)
+void MassSpringSystemSimulator::drawFrame(ID3D11DeviceContext* /*pd3dImmediateContext*/)
 {
+#ifndef GAMEPHYSICS_HEADLESS
+	PROFILE_ZONE("drawFrame");
 	DUC->setUpLighting(Vec3(), 0.4 * Vec3(1, 1, 1), 100, 0.6 * Vec3(0.97, 0.86, 1));
 
 	// Draw teapot
-	if (teapot) {
-		DUC->drawTeapot(teapot->position,Vec3(), Vec3(0.2, 0.2, 0.2));
+	if (teapot >= 0) {
+		DUC->drawTeapot(massPoints.getPosition(teapot),Vec3(), Vec3(0.2, 0.2, 0.2));
 	}
  
 
 	// Draw mass points
-	for each (auto *p in massPoints)
+	for (int i = 0; i < massPoints.size(); ++i)
 	{
-		DUC->drawSphere(p->position, Vec3(MASSPOINT_RADIUS, MASSPOINT_RADIUS, MASSPOINT_RADIUS));
+		if (i == teapot) continue;
+		DUC->drawSphere(massPoints.getPosition(i), Vec3(MASSPOINT_RADIUS, MASSPOINT_RADIUS, MASSPOINT_RADIUS));
 	}
 
 	// Draw springs
-	for (auto spring : this->springs) {
+	for (int s = 0; s < springs.size(); ++s) {
 		DUC->beginLine();
-		auto point1 = spring->masspoint1->position;
-		auto point2 = spring->masspoint2->position;
+		auto point1 = massPoints.getPosition(springs.point1[s]);
+		auto point2 = massPoints.getPosition(springs.point2[s]);
 		this->DUC->drawLine(point1, Vec3(255, 255, 255), point2, Vec3(255, 255, 255));
 		this->DUC->endLine();
 	}
+#endif
 }
 
 void MassSpringSystemSimulator::notifyCaseChanged(int testCase)
@@ -131,6 +140,7 @@ void MassSpringSystemSimulator::notifyCaseChanged(int testCase)
 	m_iTestCase = testCase;
 	// Reset, so console log is activated again for next demo 
 	isFirstStep = true;
+	isStaticDemo = testCase == 0;
 
 	if (testCase == 0) {
 		isGravityEnabled = false;
@@ -159,9 +169,10 @@ void MassSpringSystemSimulator::notifyCaseChanged(int testCase)
 	}
 }
 
-void MassSpringSystemSimulator::externalForcesCalculations(float timeElapsed)
+void MassSpringSystemSimulator::externalForcesCalculations(float /*timeElapsed*/)
 {
-	if (teapot) {
+#ifndef GAMEPHYSICS_HEADLESS
+	if (teapot >= 0) {
 		// Apply the mouse deltas to g_vfMovableObjectPos (move along cameras view plane)
 		Point2D mouseDiff;
 		mouseDiff.x = m_trackmouse.x - m_oldtrackmouse.x;
@@ -175,66 +186,228 @@ void MassSpringSystemSimulator::externalForcesCalculations(float timeElapsed)
 			// find a proper scale!
 			float inputScale = 0.001f;
 			inputWorld = inputWorld * inputScale;
-			teapot->position = m_vfMovableObjectFinalPos + inputWorld;
+			massPoints.setPosition(teapot, m_vfMovableObjectFinalPos + inputWorld);
+			areForcesCurrent = false;
 		}
 		else {
-			m_vfMovableObjectFinalPos = teapot->position;
+			m_vfMovableObjectFinalPos = massPoints.getPosition(teapot);
 		}
 	}
+#endif
 }
 
 void MassSpringSystemSimulator::integrateEuler(float timeStep) {
-		for each (MassPoint * p in massPoints) {
-			// Integrate Position
-			p->position += timeStep * p->velocity;
-			// Integrate Velocity
-			p->velocity += timeStep * p->getAcceleration();
-		}
+	MassPointStore& s = massPoints;
+	const int n = s.size();
+	const Real h = timeStep;
+	for (int i = 0; i < n; ++i) {
+		// Integrate Position
+		s.px[i] += h * s.vx[i];
+		s.py[i] += h * s.vy[i];
+		s.pz[i] += h * s.vz[i];
+		// Integrate Velocity
+		s.vx[i] += h * s.fx[i] * s.invMass[i];
+		s.vy[i] += h * s.fy[i] * s.invMass[i];
+		s.vz[i] += h * s.fz[i] * s.invMass[i];
+	}
 }
 
-void MassSpringSystemSimulator::integrateLeapfrog(float timeStep) {
-	// TODO
+void MassSpringSystemSimulator::kick(Real h) {
+	MassPointStore& s = massPoints;
+	const int n = s.size();
+	for (int i = 0; i < n; ++i) {
+		const Real hw = h * s.invMass[i];
+		s.vx[i] += hw * s.fx[i];
+		s.vy[i] += hw * s.fy[i];
+		s.vz[i] += hw * s.fz[i];
+	}
 }
 
-void MassSpringSystemSimulator::integrateMidpoint(float timeStep) {
-	std::queue<Vec3> initialPositions;
-	std::queue<Vec3> initialVelocities;
+void MassSpringSystemSimulator::drift(Real h) {
+	MassPointStore& s = massPoints;
+	const int n = s.size();
+	for (int i = 0; i < n; ++i) {
+		s.px[i] += h * s.vx[i];
+		s.py[i] += h * s.vy[i];
+		s.pz[i] += h * s.vz[i];
+	}
+}
 
-	for each (MassPoint * p in massPoints) {
-		Vec3 initialVelocity = p->velocity;
-		Vec3 initialPosition = p->position;
+// Staggered leapfrog: the velocities live at the middle of the last step,
+// half a step behind the positions. The first step from synchronised states
+// kicks only half a step to set up the offset; later steps kick from the
+// middle of the last step to the middle of this one, so the step size may
+// change. The velocity getter, the state dump and the energy monitor add the
+// missing half kick. Adaptive stepping compares the states after different
+// step sizes, whose velocities would sit at different offsets, so it takes
+// synchronised kick-drift-kick steps instead.
+void MassSpringSystemSimulator::integrateLeapfrog(float timeStep) {
+	if (isAdaptive) {
+		integrateVelocityVerlet(timeStep);
+		return;
+	}
+	const Real lag = 0.5 * timeStep;
+	kick(leapfrogLag + lag);
+	drift(timeStep);
+	leapfrogLag = lag;
+}
 
-		initialPositions.push(initialPosition);
-		initialVelocities.push(initialVelocity);
+// Brings the leapfrog velocities up to the positions with a half kick, so
+// that another integrator (or adaptive stepping) starts from a consistent state.
+void MassSpringSystemSimulator::synchroniseVelocities() {
+	if (!areForcesCurrent) computeForces();
+	kick(leapfrogLag);
+	leapfrogLag = 0;
+	// damping depends on the velocities
+	areForcesCurrent = false;
+}
 
-		// Approximate midpoints
-		p->position += (timeStep / 2) * p->velocity;
-		p->velocity += (timeStep / 2) * p->getAcceleration();
+// Kick-drift-kick form. The forces at the end of the step are the forces at
+// the start of the next one, so only one evaluation per step is needed.
+void MassSpringSystemSimulator::integrateVelocityVerlet(float timeStep) {
+	kick(0.5 * timeStep);
+	drift(timeStep);
+	computeForces();
+	kick(0.5 * timeStep);
+	areForcesCurrent = true;
+}
 
-		p->clearForce(isGravityEnabled);
-	}
+// Yoshida's 4th order composition of three velocity Verlet steps with
+// weights w1, w0, w1. Adjacent half kicks are merged: three force
+// evaluations per step.
+void MassSpringSystemSimulator::integrateYoshida4(float timeStep) {
+	const Real cbrt2 = pow(2.0, 1.0 / 3.0);
+	const Real w1 = 1.0 / (2.0 - cbrt2);
+	const Real w0 = -cbrt2 / (2.0 - cbrt2);
+	const Real h = timeStep;
+
+	kick(0.5 * w1 * h);
+	drift(w1 * h);
+	computeForces();
+	kick(0.5 * (w1 + w0) * h);
+	drift(w0 * h);
+	computeForces();
+	kick(0.5 * (w0 + w1) * h);
+	drift(w1 * h);
+	computeForces();
+	kick(0.5 * w1 * h);
+	areForcesCurrent = true;
+}
 
-	for each (Spring * s in springs) s->addElasticForceToPoints();
+// Backward Euler linearised around the current state, stable for any
+// stiffness at the cost of numerical damping.
+void MassSpringSystemSimulator::integrateImplicitEuler(float timeStep) {
+	implicitSolver.step(massPoints, springs, m_fDamping, timeStep);
+	metricAdd(METRIC_SOLVER_ITERATIONS, implicitSolver.getLastIterations());
+}
 
-	for each (MassPoint * p in massPoints) {
-		// Compute derivatives at midpoints
-		p->position = initialPositions.front() + timeStep * p->velocity;
-		p->velocity = initialVelocities.front() + timeStep * p->getAcceleration();
+void MassSpringSystemSimulator::integrateMidpoint(float timeStep) {
+	integrateRungeKutta(RK_MIDPOINT_TABLEAU, timeStep);
+}
 
-		initialPositions.pop();
-		initialVelocities.pop();
-	}
+// Explicit Runge-Kutta driven by a Butcher tableau. The stage buffers live in
+// rungeKutta and are reused, so stepping does not allocate.
+void MassSpringSystemSimulator::integrateRungeKutta(const ButcherTableau& tableau, float timeStep) {
+	rungeKutta.step(tableau, massPoints, timeStep, [this]() { computeForces(); });
+	// first same as last: the final stage forces belong to the new state
+	areForcesCurrent = tableau.lastStageIsSolution;
 }
 
 void MassSpringSystemSimulator::simulateTimestep(float timeStep)
 {
-	if (m_iTestCase == 0) {
+	// Demo1 shows one precomputed step and ignores stepping. The check used
+	// to be m_iTestCase == 0, which is also the state of a simulator that
+	// never selected a case, so one built directly (as the public tests
+	// do) never moved.
+	if (isStaticDemo) {
 		return;
 	}
+	PROFILE_ZONE("simulateTimestep");
+	PERF_PHASE("simulateTimestep");
+
+	updateTopology();
+	// the TweakBar writes m_fDamping and the monitoring flags directly
+	if (m_fDamping != forcesDamping) areForcesCurrent = false;
+	if (isEnergyMonitoring != wasEnergyMonitoring) setEnergyMonitoring(isEnergyMonitoring);
+	if (isAutoTimestep != wasAutoTimestep) setAutoTimestep(isAutoTimestep);
+	if (leapfrogLag != 0 && (m_iIntegrator != LEAPFROG || isAdaptive)) synchroniseVelocities();
+	if (isEnergyMonitoring || isAutoTimestep) recordEnergy();
+
+	const int acceptedBefore = stepController.getStats().acceptedSteps;
+	const int rejectedBefore = stepController.getStats().rejectedSteps;
+	if (isAdaptive) {
+		simulateAdaptive(timeStep);
+	}
+	else {
+		if (isSweeping()) savePathStart();
+		advance(timeStep);
+	}
+	if (traceIsActive()) {
+		traceCounter("points", massPoints.size());
+		traceCounter("springs", springs.size());
+		traceCounter("substeps", isAdaptive ? stepController.getStats().acceptedSteps - acceptedBefore : 1);
+	}
 
-	for each (MassPoint * p in massPoints) p->clearForce(isGravityEnabled);
-	for each (Spring *s in springs) s->addElasticForceToPoints();
+	if (isFirstStep) {
+		if (isConsoleLogging) printMasspointStates();
+		isFirstStep = false;
+	}
 
+	if (isAnyCollisionEnabled() && !isAdaptive) {
+		handleCollisions();
+	}
+	simulatedTime += timeStep;
+
+	metricAdd(METRIC_STEPS);
+	metricAdd(METRIC_SUBSTEPS, isAdaptive ? stepController.getStats().acceptedSteps - acceptedBefore : 1);
+	if (isAdaptive) metricAdd(METRIC_REJECTED_SUBSTEPS, stepController.getStats().rejectedSteps - rejectedBefore);
+	metricSet(METRIC_SIMULATED_SECONDS, simulatedTime);
+	metricSet(METRIC_POINTS, massPoints.size());
+	metricSet(METRIC_SPRINGS, springs.size());
+	// external forces act for one step only
+	if (m_externalForce.x != 0 || m_externalForce.y != 0 || m_externalForce.z != 0) {
+		m_externalForce = Vec3();
+		areForcesCurrent = false;
+	}
+}
+
+// Samples the state at the start of a step. When the step would evaluate
+// the forces anyway, the energy sums ride along with that evaluation and the
+// step reuses its forces; otherwise only the point sums need a pass, the
+// spring energy is still the one of the current positions.
+void MassSpringSystemSimulator::recordEnergy()
+{
+	PointDiagnostics points;
+	if (!areForcesCurrent) {
+		computeForces(&points);
+		areForcesCurrent = true;
+	}
+	else {
+		massPoints.measure(isGravityEnabled, points);
+	}
+	// leapfrog velocities lag behind the positions the energies belong to
+	if (leapfrogLag != 0) massPoints.measure(isGravityEnabled, points, leapfrogLag);
+
+	EnergySample sample;
+	sample.time = simulatedTime;
+	sample.kinetic = points.kinetic;
+	sample.elastic = elasticEnergy;
+	sample.gravity = points.gravity;
+	sample.momentum = points.momentum;
+	energyMonitor.record(sample);
+	monitoredDrift = energyMonitor.drift();
+	metricSet(METRIC_ENERGY_DRIFT, monitoredDrift);
+}
+
+// One step of the selected integrator
+void MassSpringSystemSimulator::advance(float timeStep)
+{
+	if (!areForcesCurrent) computeForces();
+	areForcesCurrent = false;
+
+	// includes the force evaluations of the inner stages
+	PROFILE_ZONE("integrate");
+	PERF_PHASE("integrate");
 	switch (m_iIntegrator)
 	{
 	case EULER: integrateEuler(timeStep);
@@ -243,27 +416,382 @@ void MassSpringSystemSimulator::simulateTimestep(float timeStep)
 		break;
 	case MIDPOINT: integrateMidpoint(timeStep);
 		break;
+	case VELOCITY_VERLET: integrateVelocityVerlet(timeStep);
+		break;
+	case YOSHIDA4: integrateYoshida4(timeStep);
+		break;
+	case IMPLICIT_EULER: integrateImplicitEuler(timeStep);
+		break;
+	case HEUN: integrateRungeKutta(RK_HEUN_TABLEAU, timeStep);
+		break;
+	case RK4: integrateRungeKutta(RK4_TABLEAU, timeStep);
+		break;
+	case DORMAND_PRINCE: integrateRungeKutta(DORMAND_PRINCE_TABLEAU, timeStep);
+		break;
 	default: integrateEuler(timeStep);
 		break;
 	}
+}
 
-	if (isFirstStep) {
-		printMasspointStates();
-		isFirstStep = false;
+// Covers the whole duration with error controlled steps. Rejected trial
+// steps are rolled back, accepted ones get the collision response.
+void MassSpringSystemSimulator::simulateAdaptive(Real duration)
+{
+	Real remaining = duration;
+	while (remaining > 0) {
+		const Real h = stepController.nextStep(remaining);
+		massPoints.saveState(stepStartState);
+		if (isSweeping()) savePathStart();
+		int errorOrder;
+		Real error = trialStep(h, errorOrder);
+		if (stepController.judge(error, h, errorOrder)) {
+			remaining -= h;
+			if (isAnyCollisionEnabled()) handleCollisions();
+		}
+		else {
+			massPoints.restoreState(stepStartState);
+			areForcesCurrent = false;
+		}
 	}
+}
 
-	if (isCollisionEnabled) {
-		handleCollisions();
+// RMS of the difference between the store and a saved state, each component
+// scaled by absTol + relTol * |y|
+static Real scaledDistance(const MassPointStore& points, const RealArray& state, Real absTol, Real relTol)
+{
+	const int n = points.size();
+	if (n == 0) return 0;
+	const RealArray* current[6] = { &points.px, &points.py, &points.pz, &points.vx, &points.vy, &points.vz };
+	Real sum = 0;
+	for (int q = 0; q < 6; ++q) {
+		const Real* y = current[q]->data();
+		const Real* s = state.data() + q * n;
+		for (int i = 0; i < n; ++i) {
+			Real e = (y[i] - s[i]) / (absTol + relTol * max(fabs(y[i]), fabs(s[i])));
+			sum += e * e;
+		}
+	}
+	return sqrt(sum / (6 * n));
+}
+
+// Takes one step of size h and returns its scaled local error. Embedded
+// Runge-Kutta pairs estimate it for free; every other integrator is checked
+// by step doubling, keeping the more accurate two half steps.
+Real MassSpringSystemSimulator::trialStep(Real h, int& errorOrder)
+{
+	const Real absTol = stepController.absoluteTolerance;
+	const Real relTol = stepController.relativeTolerance;
+
+	if (m_iIntegrator == HEUN || m_iIntegrator == DORMAND_PRINCE) {
+		advance(h);
+		errorOrder = m_iIntegrator == HEUN ? RK_HEUN_TABLEAU.order : DORMAND_PRINCE_TABLEAU.order;
+		return rungeKutta.errorNorm(massPoints, absTol, relTol);
+	}
+
+	const int order = integratorOrder();
+	advance(h);
+	massPoints.saveState(fullStepState);
+	massPoints.restoreState(stepStartState);
+	areForcesCurrent = false;
+	advance(0.5 * h);
+	advance(0.5 * h);
+	errorOrder = order + 1;
+	// Richardson: the half step result is off by about difference / (2^p - 1)
+	return scaledDistance(massPoints, fullStepState, absTol, relTol) / (pow(2.0, order) - 1);
+}
+
+int MassSpringSystemSimulator::integratorOrder() const
+{
+	switch (m_iIntegrator)
+	{
+	case MIDPOINT:
+	case LEAPFROG: // kick-drift-kick when adaptive
+	case VELOCITY_VERLET:
+	case HEUN:
+		return 2;
+	case YOSHIDA4:
+	case RK4:
+		return 4;
+	case DORMAND_PRINCE:
+		return 5;
+	default: // Euler, implicit Euler
+		return 1;
 	}
 }
 
 void MassSpringSystemSimulator::handleCollisions() {
-	for each (MassPoint * p in massPoints) {
-		Real minY = FLOOR_Y + MASSPOINT_RADIUS;
-		if (p->position.y < minY) {
-			p->position.y = minY;
+	PROFILE_ZONE("handleCollisions");
+	PERF_PHASE("handleCollisions");
+	int contacts = 0;
+	if (isPointCollisionEnabled) contacts += resolvePointCollisions();
+	if (isSelfCollisionEnabled && !triangles.empty()) contacts += resolveSelfCollisions();
+	if (isSweeping() || !staticGeometry.empty()) contacts += resolveStaticCollisions();
+	if (!staticColliders.empty()) contacts += resolveColliderContacts();
+	// the floor goes last, nothing pushes a point through it
+	if (isCollisionEnabled) {
+		const Real minY = FLOOR_Y + MASSPOINT_RADIUS;
+		Real* py = massPoints.py.data();
+		for (int i = 0; i < massPoints.size(); ++i) {
+			if (py[i] < minY) {
+				py[i] = minY;
+				contacts++;
+			}
+		}
+	}
+	if (contacts) {
+		areForcesCurrent = false;
+		metricAdd(METRIC_COLLISION_PAIRS, contacts);
+	}
+}
+
+// Sphere-sphere contacts between the mass points. The spatial hash finds
+// the overlapping pairs in linear time, sweep-and-prune in time linear in
+// the points plus the order changes since the last step. Points joined by
+// a spring overlap by design and are skipped. Each contact is resolved
+// once, in the order the broadphase returns them: the overlap is split by
+// inverse mass and the approaching normal velocity is reflected with
+// POINT_RESTITUTION.
+int MassSpringSystemSimulator::resolvePointCollisions()
+{
+	PROFILE_ZONE("resolvePointCollisions");
+	updateTopology();
+	const Real diameter = 2 * MASSPOINT_RADIUS;
+	Real* px = massPoints.px.data();
+	Real* py = massPoints.py.data();
+	Real* pz = massPoints.pz.data();
+	if (pointBroadphase == POINT_BROADPHASE_SWEEP_AND_PRUNE) {
+		// boxes of the spheres, overlapping wherever the grid finds a pair
+		// too. Proxy i is whatever point is at index i now: a point added
+		// after the teapot takes the teapot's slot and the teapot moves to the
+		// new last one, so those two proxies just see their boxes jump.
+		Real lo[3], hi[3];
+		for (int i = 0; i < massPoints.size(); ++i) {
+			lo[0] = px[i] - MASSPOINT_RADIUS; hi[0] = px[i] + MASSPOINT_RADIUS;
+			lo[1] = py[i] - MASSPOINT_RADIUS; hi[1] = py[i] + MASSPOINT_RADIUS;
+			lo[2] = pz[i] - MASSPOINT_RADIUS; hi[2] = pz[i] + MASSPOINT_RADIUS;
+			if (i < pointSweep.numProxies()) pointSweep.setBox(i, lo, hi);
+			else pointSweep.addProxy(lo, hi);
+		}
+		pointSweep.update();
+		const ProxyPairList& pairs = pointSweep.pairs();
+		pointPairs.resize(pairs.size());
+		for (size_t k = 0; k < pairs.size(); ++k) {
+			pointPairs[k].a = pairs[k].a;
+			pointPairs[k].b = pairs[k].b;
+		}
+	}
+	else {
+		pointGrid.build(px, py, pz, massPoints.size(), diameter, threadPool);
+		pointGrid.findPairs(diameter, threadPool, pointPairs);
+	}
+
+	const Real* invMass = massPoints.invMass.data();
+	int contacts = 0;
+	for (const PointPair& pair : pointPairs) {
+		const int a = pair.a, b = pair.b;
+		const Real wa = invMass[a], wb = invMass[b];
+		if (wa + wb == 0) continue;
+		const int* first = springAdjacency.neighbors.data() + springAdjacency.offsets[a];
+		const int* last = springAdjacency.neighbors.data() + springAdjacency.offsets[a + 1];
+		if (std::find(first, last, b) != last) continue;
+
+		// earlier contacts may have moved the points apart already
+		Vec3 d = massPoints.getPosition(b) - massPoints.getPosition(a);
+		const Real distance = norm(d);
+		if (distance >= diameter) continue;
+		const Vec3 normal = distance > 0 ? d / distance : Vec3(0, 1, 0);
+		const Real w = wa + wb;
+		const Vec3 push = normal * ((diameter - distance) / w);
+		massPoints.setPosition(a, massPoints.getPosition(a) - push * wa);
+		massPoints.setPosition(b, massPoints.getPosition(b) + push * wb);
+
+		const Real approach = dot(massPoints.getVelocity(b) - massPoints.getVelocity(a), normal);
+		if (approach < 0) {
+			const Vec3 impulse = normal * (-(1 + POINT_RESTITUTION) * approach / w);
+			massPoints.setVelocity(a, massPoints.getVelocity(a) - impulse * wa);
+			massPoints.setVelocity(b, massPoints.getVelocity(b) + impulse * wb);
+		}
+		contacts++;
+	}
+	lastPointContacts = contacts;
+	return contacts;
+}
+
+// Mass points against the obstacles, and against the floor when swept.
+// The sweep follows each point from where it started the step to where
+// the integrator put it. At the first contact the point stops just off
+// the surface, the approaching normal velocity is reflected with the
+// restitution and the tangential velocity loses up to friction times the
+// normal change. The rest of the path is redirected the same way and swept
+// again, up to MAX_SWEEP_CONTACTS times. Points that end inside an
+// obstacle, and all of them without the sweep, are pushed out and lose
+// their approaching velocity.
+int MassSpringSystemSimulator::resolveStaticCollisions()
+{
+	PROFILE_ZONE("resolveStaticCollisions");
+	const int n = massPoints.size();
+	const bool isSwept = isSweeping() && (int)pathStart.size() == 3 * n;
+	const Vec3 up(0, 1, 0);
+	const int chunks = std::max(1, std::min(threadPool.threadCount(), n / MIN_POINTS_PER_SWEEP_CHUNK));
+	staticChunkContacts.assign(chunks, 0);
+	threadPool.parallelFor(0, chunks, 1, [&](int first, int last) {
+		for (int c = first; c < last; ++c) {
+			int contacts = 0;
+			const int end = (int)((int64_t)n * (c + 1) / chunks);
+			for (int i = (int)((int64_t)n * c / chunks); i < end; ++i) {
+				if (massPoints.invMass[i] == 0) continue;
+				Vec3 position = massPoints.getPosition(i);
+				Vec3 velocity = massPoints.getVelocity(i);
+				if (isSwept) {
+					Vec3 a(pathStart[i], pathStart[n + i], pathStart[2 * n + i]);
+					Vec3 b = position;
+					int k = 0;
+					for (; k < MAX_SWEEP_CONTACTS; ++k) {
+						SweepHit hit, floorHit;
+						bool found = staticGeometry.sweep(a, b, MASSPOINT_RADIUS, hit);
+						if (isCollisionEnabled && sweepPlane(up, FLOOR_Y, a, b, MASSPOINT_RADIUS, floorHit) && (!found || floorHit.t < hit.t)) {
+							hit = floorHit;
+							found = true;
+						}
+						if (!found) break;
+						contacts++;
+						const Vec3& normal = hit.normal;
+						Real keep = 1; // share of the tangential motion that survives friction
+						const Real vn = dot(velocity, normal);
+						if (vn < 0) {
+							const Vec3 tangential = velocity - normal * vn;
+							const Real speed = norm(tangential);
+							keep = speed > 0 ? std::max((Real)0, 1 - staticFriction * (1 + staticRestitution) * -vn / speed) : 0;
+							velocity = tangential * keep - normal * (staticRestitution * vn);
+						}
+						Vec3 rest = (b - a) * (1 - hit.t);
+						const Real rn = dot(rest, normal);
+						if (rn < 0) rest = (rest - normal * rn) * keep - normal * (staticRestitution * rn);
+						a = a + (b - a) * hit.t + normal * SWEEP_SEPARATION;
+						b = a + rest;
+					}
+					// out of contacts, the rest of the path is not checked
+					position = k == MAX_SWEEP_CONTACTS ? a : b;
+				}
+				Vec3 normal;
+				if (staticGeometry.pushOut(position, MASSPOINT_RADIUS, normal)) {
+					const Real vn = dot(velocity, normal);
+					if (vn < 0) velocity -= normal * vn;
+					contacts++;
+				}
+				massPoints.setPosition(i, position);
+				massPoints.setVelocity(i, velocity);
+			}
+			staticChunkContacts[c] = contacts;
 		}
+	});
+
+	int contacts = 0;
+	for (int c = 0; c < chunks; ++c) contacts += staticChunkContacts[c];
+	lastStaticContacts = contacts;
+	return contacts;
+}
+
+// Mass points against the static collider set. The set finds every
+// overlap in one batch per shape type; the contacts are then applied in
+// its order, each pushing the point out along the contact normal and
+// removing its approaching normal velocity, as pushOut() does for the
+// obstacles above.
+int MassSpringSystemSimulator::resolveColliderContacts()
+{
+	PROFILE_ZONE("resolveColliderContacts");
+	staticColliders.findContacts(massPoints.px.data(), massPoints.py.data(), massPoints.pz.data(), massPoints.size(), MASSPOINT_RADIUS, threadPool, colliderContacts);
+	int contacts = 0;
+	for (const ColliderContact& contact : colliderContacts) {
+		const int i = contact.point;
+		if (massPoints.invMass[i] == 0) continue;
+		const Vec3 normal(contact.nx, contact.ny, contact.nz);
+		massPoints.setPosition(i, massPoints.getPosition(i) + normal * contact.depth);
+		const Vec3 velocity = massPoints.getVelocity(i);
+		const Real vn = dot(velocity, normal);
+		if (vn < 0) massPoints.setVelocity(i, velocity - normal * vn);
+		contacts++;
 	}
+	lastColliderContacts = contacts;
+	return contacts;
+}
+
+void MassSpringSystemSimulator::savePathStart()
+{
+	const int n = massPoints.size();
+	pathStart.resize(3 * (size_t)n);
+	std::copy(massPoints.px.begin(), massPoints.px.end(), pathStart.begin());
+	std::copy(massPoints.py.begin(), massPoints.py.end(), pathStart.begin() + n);
+	std::copy(massPoints.pz.begin(), massPoints.pz.end(), pathStart.begin() + 2 * n);
+}
+
+// Proximity based cloth self-collision: vertex-triangle and edge-edge pairs
+// closer than the cloth thickness are pushed apart to the thickness and
+// lose their approaching normal velocity. The tree over the triangles is
+// built once and refitted every step after that.
+int MassSpringSystemSimulator::resolveSelfCollisions()
+{
+	PROFILE_ZONE("resolveSelfCollisions");
+	const Real* px = massPoints.px.data();
+	const Real* py = massPoints.py.data();
+	const Real* pz = massPoints.pz.data();
+	if (isClothDirty) {
+		clothBVH.build(triangles.data(), (int)triangles.size() / 3, px, py, pz);
+		isClothDirty = false;
+	}
+	else {
+		clothBVH.refit(px, py, pz, threadPool);
+	}
+	clothBVH.findSelfContacts(px, py, pz, clothThickness, threadPool, clothContacts);
+
+	int contacts = 0;
+	for (const ClothContact& contact : clothContacts) {
+		// The separation is sum c_k x_k: the point minus the barycentric
+		// point of the triangle, or the difference of the closest points of
+		// the edges. Both are recomputed, earlier contacts moved the points.
+		Vec3 x[4];
+		for (int k = 0; k < 4; ++k) x[k] = massPoints.getPosition(contact.vertex[k]);
+		Real c[4];
+		Vec3 fallbackNormal;
+		if (contact.isEdgeEdge) {
+			Real s, t;
+			closestPointsOnSegments(x[0], x[1], x[2], x[3], s, t);
+			c[0] = 1 - s; c[1] = s; c[2] = t - 1; c[3] = -t;
+			fallbackNormal = cross(x[1] - x[0], x[3] - x[2]);
+		}
+		else {
+			Real weights[3];
+			closestPointOnTriangle(x[0], x[1], x[2], x[3], weights);
+			c[0] = 1; c[1] = -weights[0]; c[2] = -weights[1]; c[3] = -weights[2];
+			fallbackNormal = cross(x[2] - x[1], x[3] - x[1]);
+		}
+		const Vec3 d = x[0] * c[0] + x[1] * c[1] + x[2] * c[2] + x[3] * c[3];
+		const Real distance = norm(d);
+		if (distance >= clothThickness) continue;
+		const Real fallbackLength = norm(fallbackNormal);
+		if (distance == 0 && fallbackLength == 0) continue;
+		const Vec3 normal = distance > 0 ? d / distance : fallbackNormal / fallbackLength;
+
+		Real w = 0;
+		Real invMass[4];
+		for (int k = 0; k < 4; ++k) {
+			invMass[k] = massPoints.invMass[contact.vertex[k]];
+			w += c[k] * c[k] * invMass[k];
+		}
+		if (w == 0) continue;
+		const Real push = (clothThickness - distance) / w;
+		Real approach = 0;
+		for (int k = 0; k < 4; ++k) approach += c[k] * dot(massPoints.getVelocity(contact.vertex[k]), normal);
+		const Real impulse = approach < 0 ? -approach / w : 0;
+		for (int k = 0; k < 4; ++k) {
+			const int v = contact.vertex[k];
+			massPoints.setPosition(v, x[k] + normal * (push * c[k] * invMass[k]));
+			massPoints.setVelocity(v, massPoints.getVelocity(v) + normal * (impulse * c[k] * invMass[k]));
+		}
+		contacts++;
+	}
+	lastSelfContacts = contacts;
+	return contacts;
 }
 
 void MassSpringSystemSimulator::onClick(int x, int y)
@@ -285,14 +813,16 @@ void MassSpringSystemSimulator::onMouse(int x, int y)
 void MassSpringSystemSimulator::setMass(float mass)
 {
 	m_fMass = mass;
-	for each (MassPoint * p in massPoints) p->mass = mass;
+	massPoints.setMass(mass);
+	areForcesCurrent = false;
 
 }
 
 void MassSpringSystemSimulator::setStiffness(float stiffness)
 {
 	m_fStiffness = stiffness;
-	for each (Spring * s in springs) s->stiffness = stiffness;
+	springs.setStiffness(stiffness);
+	areForcesCurrent = false;
 
 }
 
@@ -300,22 +830,36 @@ void MassSpringSystemSimulator::setStiffness(float stiffness)
 void MassSpringSystemSimulator::setDampingFactor(float damping)
 {
 	m_fDamping = damping;
+	areForcesCurrent = false;
 }
 
 int MassSpringSystemSimulator::addMassPoint(Vec3 position, Vec3 Velocity, bool isFixed)
 {
-	massPoints.push_back(new MassPoint(position, Velocity, isFixed, m_fMass));
-	return massPoints.size() - 1;
+	isTopologyDirty = true;
+	areForcesCurrent = false;
+	const int index = massPoints.add(position, Velocity, isFixed, m_fMass);
+	if (teapot < 0) return index;
+	// the teapot stays behind the public points, its springs follow it
+	const int point = teapot;
+	massPoints.swap(point, index);
+	for (int s : teapotSprings) {
+		if (springs.point1[s] == point) springs.point1[s] = index;
+		if (springs.point2[s] == point) springs.point2[s] = index;
+	}
+	teapot = index;
+	return point;
 }
 
 void MassSpringSystemSimulator::addSpring(int masspoint1, int masspoint2, float initialLength)
 {
-	springs.push_back(new Spring(massPoints[masspoint1], massPoints[masspoint2], initialLength, m_fStiffness));
+	springs.add(masspoint1, masspoint2, initialLength, m_fStiffness);
+	isTopologyDirty = true;
+	areForcesCurrent = false;
 }
 
 int MassSpringSystemSimulator::getNumberOfMassPoints()
 {
-	return massPoints.size();
+	return numPublicPoints();
 }
 
 int MassSpringSystemSimulator::getNumberOfSprings()
@@ -325,17 +869,251 @@ int MassSpringSystemSimulator::getNumberOfSprings()
 
 Vec3 MassSpringSystemSimulator::getPositionOfMassPoint(int index)
 {
-	return massPoints[index]->position;
+	return massPoints.getPosition(index);
 }
 
 Vec3 MassSpringSystemSimulator::getVelocityOfMassPoint(int index)
 {
-	return massPoints[index]->velocity;
+	if (leapfrogLag == 0) return massPoints.getVelocity(index);
+	// the leapfrog velocity taken up to the positions, without changing the state
+	if (!areForcesCurrent) {
+		computeForces();
+		areForcesCurrent = true;
+	}
+	const Real hw = leapfrogLag * massPoints.invMass[index];
+	return massPoints.getVelocity(index) + hw * Vec3(massPoints.fx[index], massPoints.fy[index], massPoints.fz[index]);
 }
 
 void MassSpringSystemSimulator::applyExternalForce(Vec3 force)
 {
-	externalForces.push_back(force); 
+	m_externalForce += force;
+	areForcesCurrent = false;
+}
+
+const SpringAdjacency& MassSpringSystemSimulator::getSpringAdjacency()
+{
+	updateTopology();
+	return springAdjacency;
+}
+
+bool MassSpringSystemSimulator::setAdaptiveStepping(bool enable)
+{
+	isAdaptive = enable;
+	stepController.reset();
+	return true;
+}
+
+void MassSpringSystemSimulator::setAdaptiveTolerances(float absoluteTolerance, float relativeTolerance)
+{
+	stepController.absoluteTolerance = absoluteTolerance;
+	stepController.relativeTolerance = relativeTolerance;
+}
+
+void MassSpringSystemSimulator::setAdaptiveStepLimits(float minStep, float maxStep)
+{
+	stepController.minStep = minStep;
+	stepController.maxStep = maxStep;
+}
+
+const AdaptiveStepStats& MassSpringSystemSimulator::getAdaptiveStepStats()
+{
+	return stepController.getStats();
+}
+
+void MassSpringSystemSimulator::resetAdaptiveStepStats()
+{
+	stepController.resetStats();
+}
+
+void MassSpringSystemSimulator::setSpringKernel(SpringKernelIsa isa)
+{
+	springKernel = isa;
+}
+
+SpringKernelIsa MassSpringSystemSimulator::getSpringKernel()
+{
+	return springKernel;
+}
+
+void MassSpringSystemSimulator::setThreadCount(int threads)
+{
+	threadPool.setThreadCount(threads);
+}
+
+int MassSpringSystemSimulator::getThreadCount()
+{
+	return threadPool.threadCount();
+}
+
+int MassSpringSystemSimulator::getNumberOfSpringColors()
+{
+	updateTopology();
+	return springColoring.numColors();
+}
+
+void MassSpringSystemSimulator::reserve(int numPoints, int numSprings)
+{
+	massPoints.reserve(numPoints);
+	springs.reserve(numSprings);
+}
+
+unsigned long long MassSpringSystemSimulator::getForceEvaluationCount()
+{
+	return forceEvaluations;
+}
+
+void MassSpringSystemSimulator::setGravityEnabled(bool enabled)
+{
+	isGravityEnabled = enabled;
+	areForcesCurrent = false;
+}
+
+void MassSpringSystemSimulator::setCollisionEnabled(bool enabled)
+{
+	isCollisionEnabled = enabled;
+}
+
+void MassSpringSystemSimulator::setPointCollisionEnabled(bool enabled)
+{
+	isPointCollisionEnabled = enabled;
+}
+
+void MassSpringSystemSimulator::setPointBroadphase(PointBroadphase broadphase)
+{
+	pointBroadphase = broadphase;
+}
+
+int MassSpringSystemSimulator::getLastPointContacts()
+{
+	return lastPointContacts;
+}
+
+int MassSpringSystemSimulator::addCollisionPlane(Vec3 normal, float offset)
+{
+	return staticGeometry.addPlane(normal / norm(normal), offset);
+}
+
+int MassSpringSystemSimulator::addCollisionBox(Vec3 lo, Vec3 hi)
+{
+	return staticGeometry.addBox(lo, hi);
+}
+
+int MassSpringSystemSimulator::addCollisionMesh(const std::vector<Vec3>& vertices, const std::vector<int>& indices)
+{
+	return staticGeometry.addMesh(vertices.data(), (int)vertices.size(), indices.data(), (int)indices.size() / 3);
+}
+
+void MassSpringSystemSimulator::setContinuousCollisionEnabled(bool enabled)
+{
+	isContinuousCollisionEnabled = enabled;
+}
+
+void MassSpringSystemSimulator::setCollisionResponse(float restitution, float friction)
+{
+	staticRestitution = restitution;
+	staticFriction = friction;
+}
+
+int MassSpringSystemSimulator::getLastStaticContacts()
+{
+	return lastStaticContacts;
+}
+
+StaticColliderSet& MassSpringSystemSimulator::getStaticColliders()
+{
+	return staticColliders;
+}
+
+int MassSpringSystemSimulator::getLastColliderContacts()
+{
+	return lastColliderContacts;
+}
+
+int MassSpringSystemSimulator::addTriangle(int masspoint1, int masspoint2, int masspoint3)
+{
+	triangles.push_back(masspoint1);
+	triangles.push_back(masspoint2);
+	triangles.push_back(masspoint3);
+	isClothDirty = true;
+	return (int)triangles.size() / 3 - 1;
+}
+
+int MassSpringSystemSimulator::getNumberOfTriangles()
+{
+	return (int)triangles.size() / 3;
+}
+
+void MassSpringSystemSimulator::setSelfCollisionEnabled(bool enabled)
+{
+	isSelfCollisionEnabled = enabled;
+}
+
+void MassSpringSystemSimulator::setClothThickness(float thickness)
+{
+	clothThickness = thickness;
+}
+
+int MassSpringSystemSimulator::getLastSelfContacts()
+{
+	return lastSelfContacts;
+}
+
+void MassSpringSystemSimulator::setConsoleLogging(bool enabled)
+{
+	isConsoleLogging = enabled;
+}
+
+void MassSpringSystemSimulator::setEnergyMonitoring(bool enabled)
+{
+	isEnergyMonitoring = enabled;
+	wasEnergyMonitoring = enabled;
+	energyMonitor.reset();
+	// cached forces carry no energy sums
+	areForcesCurrent = false;
+}
+
+EnergyMonitor& MassSpringSystemSimulator::getEnergyMonitor()
+{
+	return energyMonitor;
+}
+
+void MassSpringSystemSimulator::setAutoTimestep(bool enabled)
+{
+	isAutoTimestep = enabled;
+	wasAutoTimestep = enabled;
+	energyMonitor.reset();
+	areForcesCurrent = false;
+}
+
+MemoryTagStats MassSpringSystemSimulator::getMemoryStats(MemoryTag tag)
+{
+	return memoryTagStats(tag);
+}
+
+std::string MassSpringSystemSimulator::getMemoryReport()
+{
+	return memoryReport();
+}
+
+float MassSpringSystemSimulator::suggestTimestep(float timeStep)
+{
+	if (!isAutoTimestep) return timeStep;
+	return (float)energyMonitor.suggestTimestep(timeStep, 1e-5, 0.05);
+}
+
+int MassSpringSystemSimulator::getLastSolverIterations()
+{
+	return implicitSolver.getLastIterations();
+}
+
+size_t MassSpringSystemSimulator::getSceneBytesReserved()
+{
+	return sceneArena.bytesReserved();
+}
+
+size_t MassSpringSystemSimulator::getSceneBytesInUse()
+{
+	return sceneArena.bytesInUse();
 }
 
 
@@ -343,10 +1121,89 @@ void MassSpringSystemSimulator::applyExternalForce(Vec3 force)
 
 void MassSpringSystemSimulator::resetEnvironment()
 {
-	massPoints.clear();
-	springs.clear();
-	externalForces.clear();
-	teapot = NULL;
+	// drop every reference into the arena, then rewind it for the next scene
+	massPoints.release();
+	springs.release();
+	sceneArena.reset();
+	springAdjacency.clear();
+	springColoring.clear();
+	triangles.clear();
+	clothBVH.clear();
+	isClothDirty = true;
+	pointSweep.clear();
+	staticGeometry.clear();
+	staticColliders.clear();
+	m_externalForce = Vec3();
+	teapot = -1;
+	teapotSprings.clear();
+	isTopologyDirty = true;
+	areForcesCurrent = false;
+	leapfrogLag = 0;
+	stepController.reset();
+	energyMonitor.reset();
+	simulatedTime = 0;
+}
+
+void MassSpringSystemSimulator::updateTopology()
+{
+	if (!isTopologyDirty) return;
+	// colouring reorders the springs, so it runs before the adjacency is built
+	springColoring.build(massPoints.size(), springs);
+	springAdjacency.build(massPoints.size(), springs);
+	if (teapot >= 0) {
+		teapotSprings.clear();
+		for (int s = 0; s < springs.size(); ++s) {
+			if (springs.point1[s] == teapot || springs.point2[s] == teapot) teapotSprings.push_back(s);
+		}
+	}
+	isTopologyDirty = false;
+}
+
+// With energy monitoring, the spring energy of this evaluation goes to
+// elasticEnergy; diagnostics receives the point sums of the same pass.
+void MassSpringSystemSimulator::computeForces(PointDiagnostics* diagnostics)
+{
+	PROFILE_ZONE("computeForces");
+	PERF_PHASE("computeForces");
+	updateTopology();
+	massPoints.clearForces(isGravityEnabled, diagnostics);
+	forcesDamping = m_fDamping;
+	forceEvaluations++;
+	metricAdd(METRIC_FORCE_EVALUATIONS);
+	if (m_externalForce.x != 0 || m_externalForce.y != 0 || m_externalForce.z != 0) {
+		for (int i = 0; i < massPoints.size(); ++i) massPoints.applyForce(i, m_externalForce);
+	}
+
+	const bool isMeasuring = isEnergyMonitoring || isAutoTimestep;
+	const int m = springs.size();
+	if (threadPool.threadCount() <= 1 || m < PARALLEL_MIN_SPRINGS) {
+		elasticEnergy = 0;
+		addSpringForces(springKernel, springs, massPoints, m_fDamping, isMeasuring ? &elasticEnergy : nullptr);
+		return;
+	}
+
+	// Springs of one colour share no point, so the threads never write the
+	// same force. The colours are stored in order, which makes the per point
+	// summation order, and thus the result, independent of the thread count.
+	Real energy = 0;
+	for (int c = 0; c < springColoring.numColors(); ++c) {
+		const int first = springColoring.colorOffsets[c];
+		const int last = springColoring.colorOffsets[c + 1];
+		Real* partials = nullptr;
+		if (isMeasuring) {
+			// chunks start at multiples of the grain, one slot each
+			energyPartials.assign((last - first + PARALLEL_GRAIN - 1) / PARALLEL_GRAIN, 0);
+			partials = energyPartials.data();
+		}
+		threadPool.parallelFor(first, last, PARALLEL_GRAIN, [this, first, partials](int begin, int end) {
+			addSpringForces(springKernel, springs, massPoints, m_fDamping, begin, end,
+				partials ? partials + (begin - first) / PARALLEL_GRAIN : nullptr);
+		});
+		if (isMeasuring) {
+			for (Real e : energyPartials) energy += e;
+		}
+	}
+	elasticEnergy = energy;
 }
 
 void MassSpringSystemSimulator::setupSimpleEnvironment() {
@@ -396,35 +1253,53 @@ void MassSpringSystemSimulator::setupComplexEnvironment() {
 	addSpring(p9, p12, 1);
 	addSpring(p11, p12, 1);
 
-	teapot = new MassPoint(Vec3(0, 1.5, 0), Vec3(), false, 10);
+	// The teapot is moved by the mouse only, so it is stored as a fixed
+	// point. It is not one of the scene's points: it stays the last entry of
+	// the store, past getNumberOfMassPoints() and out of the state dump.
+	teapot = massPoints.add(Vec3(0, 1.5, 0), Vec3(), true, 10);
 	addSpringToTeapot(p1, 0.1, 100);
 	addSpringToTeapot(p4, 0.1, 100);
 	addSpringToTeapot(p8, 0.1, 100);
 	addSpringToTeapot(p12, 0.1, 100);
 }
 
+// Only copies the state, the text is formatted on the log thread. Leapfrog
+// velocities are shown at the positions: the state is saved, kicked up and
+// restored bit for bit after the copy.
 void MassSpringSystemSimulator::printMasspointStates() {
-	for (int i = 0; i < massPoints.size(); ++i) std::cout << "Point " + std::to_string(i) + ": " + massPoints[i]->toString() + "\n";
+	const bool isLagging = leapfrogLag != 0;
+	if (isLagging) {
+		if (!areForcesCurrent) {
+			computeForces();
+			areForcesCurrent = true;
+		}
+		massPoints.saveState(stepStartState);
+		kick(leapfrogLag);
+	}
+	logPointStates(massPoints.px.data(), massPoints.py.data(), massPoints.pz.data(),
+		massPoints.vx.data(), massPoints.vy.data(), massPoints.vz.data(), 0, numPublicPoints());
+	if (isLagging) massPoints.restoreState(stepStartState);
 }
 
 void MassSpringSystemSimulator::addSpringToTeapot(int masspoint, float initialLength, float stiffness)
 {
-	springs.push_back(new Spring(massPoints[masspoint], teapot, initialLength, stiffness));
+	teapotSprings.push_back(springs.size());
+	springs.add(masspoint, teapot, initialLength, stiffness);
+	isTopologyDirty = true;
+	areForcesCurrent = false;
 }
 
 void MassSpringSystemSimulator::runDemo1() {
 	setupSimpleEnvironment();
-	for each (MassPoint * p in massPoints) p->clearForce(isGravityEnabled);
-	for each (Spring * s in springs) s->addElasticForceToPoints();
+	computeForces();
 	integrateEuler(0.1);
-	std::cout << "Euler:" << std::endl;
+	logText("Euler:");
 	printMasspointStates();
 
 	setupSimpleEnvironment();
-	for each (MassPoint * p in massPoints) p->clearForce(isGravityEnabled);
-	for each (Spring * s in springs) s->addElasticForceToPoints();
+	computeForces();
 	integrateMidpoint(0.1);
-	std::cout << "Midpoint:" << std::endl;
+	logText("Midpoint:");
 	printMasspointStates();
 }
 
@@ -1,39 +1,38 @@
 #ifndef MASSSPRINGSYSTEMSIMULATOR_h
 #define MASSSPRINGSYSTEMSIMULATOR_h
 #include "Simulator.h"
+#include "MassPointStore.h"
+#include "SpringStore.h"
+#include "ImplicitEulerSolver.h"
+#include "RungeKutta.h"
+#include "AdaptiveStepController.h"
+#include "SpringKernels.h"
+#include "EnergyMonitor.h"
+#include "SpatialHashGrid.h"
+#include "SweepAndPrune.h"
+#include "TriangleBVH.h"
+#include "CollisionGeometry.h"
+#include "StaticColliderSet.h"
+#include "util/threadpool.h"
 
 // Do Not Change
 #define EULER 0
 #define LEAPFROG 1
 #define MIDPOINT 2
 // Do Not Change
+#define VELOCITY_VERLET 3
+#define YOSHIDA4 4
+#define IMPLICIT_EULER 5
+#define HEUN 6
+#define RK4 7
+#define DORMAND_PRINCE 8
 
-
-class MassPoint {
-public:
-	Vec3 position;
-	Vec3 velocity;
-	bool isFixed;
-	float mass;
-	Vec3 force;
-
-	MassPoint(Vec3 position, Vec3 velocity, bool isFixed, float mass);
-	void clearForce(bool isGravityEnabled);
-	void applyForce(Vec3 force);
-	Vec3 getAcceleration();
-	std::string toString();
+// broadphase of the point-point collisions
+enum PointBroadphase {
+	POINT_BROADPHASE_HASH_GRID,       // rebuilt every step, parallel
+	POINT_BROADPHASE_SWEEP_AND_PRUNE, // kept sorted across steps, cheap for slow motion
 };
 
-class Spring {
-public:
-	MassPoint* masspoint1;
-	MassPoint* masspoint2;
-	float initialLength;
-	float stiffness;
-
-	Spring(MassPoint* masspoint1, MassPoint* masspoint2, float initialLength, float stiffness);
-	void addElasticForceToPoints();
-};
 
 class MassSpringSystemSimulator:public Simulator{
 public:
@@ -48,6 +47,7 @@ public:
 	void notifyCaseChanged(int testCase);
 	void externalForcesCalculations(float timeElapsed);
 	void simulateTimestep(float timeStep);
+	bool setAdaptiveStepping(bool enable);
 	void onClick(int x, int y);
 	void onMouse(int x, int y);
 
@@ -62,6 +62,80 @@ public:
 	Vec3 getPositionOfMassPoint(int index);
 	Vec3 getVelocityOfMassPoint(int index);
 	void applyExternalForce(Vec3 force);
+	// Point-to-spring adjacency, rebuilt lazily after topology changes
+	const SpringAdjacency& getSpringAdjacency();
+	// Scene memory, reserved stays allocated across resets for reuse
+	size_t getSceneBytesReserved();
+	size_t getSceneBytesInUse();
+	// CG iterations of the last implicit Euler step
+	int getLastSolverIterations();
+	// Adaptive stepping: tolerances on the scaled local error and step limits
+	void setAdaptiveTolerances(float absoluteTolerance, float relativeTolerance);
+	void setAdaptiveStepLimits(float minStep, float maxStep);
+	const AdaptiveStepStats& getAdaptiveStepStats();
+	void resetAdaptiveStepStats();
+	// Instruction set of the spring force kernel, the best supported one by
+	// default. SPRING_KERNEL_SCALAR is the reference all others match exactly.
+	void setSpringKernel(SpringKernelIsa isa);
+	SpringKernelIsa getSpringKernel();
+	// Worker threads for the spring forces, 0 = hardware threads (default)
+	void setThreadCount(int threads);
+	int getThreadCount();
+	// colours of the spring graph, springs of one colour share no point
+	int getNumberOfSpringColors();
+	// preallocates storage when the final scene size is known
+	void reserve(int numPoints, int numSprings);
+	// force evaluations since construction, the cost measure of the integrators
+	unsigned long long getForceEvaluationCount();
+	void setGravityEnabled(bool enabled);
+	void setCollisionEnabled(bool enabled);
+	// mass points collide with each other as spheres (off by default)
+	void setPointCollisionEnabled(bool enabled);
+	void setPointBroadphase(PointBroadphase broadphase);
+	// point-point contacts resolved by the last collision pass
+	int getLastPointContacts();
+	// Cloth faces for self-collision, three point indices each
+	int addTriangle(int masspoint1, int masspoint2, int masspoint3);
+	int getNumberOfTriangles();
+	// cloth triangles keep the thickness (a point radius by default) apart
+	void setSelfCollisionEnabled(bool enabled);
+	void setClothThickness(float thickness);
+	// vertex-triangle and edge-edge contacts resolved by the last collision pass
+	int getLastSelfContacts();
+	// Static obstacles; the points collide with them whenever there are any
+	int addCollisionPlane(Vec3 normal, float offset);
+	int addCollisionBox(Vec3 lo, Vec3 hi);
+	// two sided triangle mesh, three vertex indices per triangle
+	int addCollisionMesh(const std::vector<Vec3>& vertices, const std::vector<int>& indices);
+	// Sweeps the path of every point over the step against the obstacles
+	// and the floor instead of testing where it ends, so that fast points
+	// cannot pass through thin shapes at large steps (off by default)
+	void setContinuousCollisionEnabled(bool enabled);
+	// velocity response of swept contacts: restitution 0 = the point
+	// stops, 1 = elastic; Coulomb friction coefficient
+	void setCollisionResponse(float restitution, float friction);
+	// obstacle contacts, and swept floor contacts, of the last collision pass
+	int getLastStaticContacts();
+	// Large numbers of spheres, boxes, capsules and planes, tested in one
+	// batch per shape type at the end of every step; the points collide
+	// with them whenever there are any
+	StaticColliderSet& getStaticColliders();
+	// point-collider overlaps resolved by the last collision pass
+	int getLastColliderContacts();
+	// print the mass points after the first step (on by default)
+	void setConsoleLogging(bool enabled);
+	// Energy and momentum drift, sampled at the start of every step. The
+	// energy terms are summed inside the force evaluation, so monitoring
+	// costs no extra pass over the springs.
+	void setEnergyMonitoring(bool enabled);
+	EnergyMonitor& getEnergyMonitor();
+	// lets suggestTimestep() adapt the frame step to the energy drift,
+	// implies energy monitoring
+	void setAutoTimestep(bool enabled);
+	float suggestTimestep(float timeStep);
+	// Memory by subsystem; the accounting is process wide, see util/memorytags.h
+	MemoryTagStats getMemoryStats(MemoryTag tag);
+	std::string getMemoryReport();
 
 	
 	// Do Not Change
@@ -77,30 +151,102 @@ private:
 	int m_iIntegrator;
 
 	// UI Attributes
-	Vec3 m_externalForce;
+	Vec3 m_externalForce; // sum of applyExternalForce() calls, acts on every point during the next step
 	Point2D m_mouse;
 	Point2D m_trackmouse;
 	Point2D m_oldtrackmouse;
 
 	// Custom stuff added by us
-	std::vector<MassPoint*> massPoints;
-	std::vector<Spring*> springs;
-	std::vector<Vec3> externalForces;
+	SceneArena sceneArena; // owns the point and spring storage, must be declared before them
+	MassPointStore massPoints;
+	SpringStore springs;
+	SpringAdjacency springAdjacency;
+	SpringColoring springColoring;
+	ThreadPool threadPool;
+	SpringKernelIsa springKernel;
+	bool isTopologyDirty = true;
+	ImplicitEulerSolver implicitSolver;
+	RungeKuttaIntegrator rungeKutta;
+	AdaptiveStepController stepController;
+	RealArray stepStartState; // state before an adaptive trial step
+	RealArray fullStepState;  // step doubling: result of the single full step
+	bool isAdaptive = false;
 	bool isFirstStep = true; // Only needed in order to print only the first step's results to the console.
+	bool isConsoleLogging = true;
 	bool isGravityEnabled = false;
 	bool isCollisionEnabled = false;
+	bool isPointCollisionEnabled = false;
+	SpatialHashGrid pointGrid;
+	PointPairList pointPairs;
+	PointBroadphase pointBroadphase = POINT_BROADPHASE_HASH_GRID;
+	SweepAndPrune pointSweep; // one proxy per point, in index order
+	int lastPointContacts = 0;
+	TaggedVector<int, MEMORY_TAG_TOPOLOGY> triangles; // three point indices each
+	TriangleBVH clothBVH;
+	ClothContactList clothContacts;
+	bool isSelfCollisionEnabled = false;
+	bool isClothDirty = true; // triangles changed, the tree needs a build
+	Real clothThickness;
+	int lastSelfContacts = 0;
+	CollisionGeometry staticGeometry;
+	bool isContinuousCollisionEnabled = false;
+	Real staticRestitution;
+	Real staticFriction;
+	TaggedVector<Real, MEMORY_TAG_COLLISION> pathStart; // positions at the start of the step, x then y then z
+	TaggedVector<int, MEMORY_TAG_COLLISION> staticChunkContacts;
+	int lastStaticContacts = 0;
+	StaticColliderSet staticColliders;
+	ColliderContactList colliderContacts;
+	int lastColliderContacts = 0;
+	bool isStaticDemo = false; // Demo1 only prints a single precomputed step
+	bool areForcesCurrent = false; // forces match the current positions, reused by the next step
+	float forcesDamping = 0; // m_fDamping of the last force evaluation
+	Real leapfrogLag = 0; // time the leapfrog velocities lag behind the positions, 0 when synchronised
+	unsigned long long forceEvaluations = 0;
+	EnergyMonitor energyMonitor;
+	bool isEnergyMonitoring = false;
+	bool isAutoTimestep = false;
+	bool wasEnergyMonitoring = false; // the flags above as of the last reset of the monitor
+	bool wasAutoTimestep = false;
+	Real simulatedTime = 0;
+	Real elasticEnergy = 0; // of the last force evaluation, when monitoring
+	Real monitoredDrift = 0; // float copy for the UI
+	TaggedVector<Real, MEMORY_TAG_DIAGNOSTICS> energyPartials; // per chunk, summed in order for a deterministic total
 
 	void resetEnvironment();
 	void setupSimpleEnvironment();
 	void setupComplexEnvironment();
+	void updateTopology();
+	void computeForces(PointDiagnostics* diagnostics = nullptr);
+	void recordEnergy();
 	void integrateEuler(float timeStep);
 	void integrateMidpoint(float timeStep);
 	void integrateLeapfrog(float timeStep);
+	void integrateVelocityVerlet(float timeStep);
+	void integrateYoshida4(float timeStep);
+	void integrateImplicitEuler(float timeStep);
+	void integrateRungeKutta(const ButcherTableau& tableau, float timeStep);
+	void advance(float timeStep);
+	void simulateAdaptive(Real duration);
+	Real trialStep(Real h, int& errorOrder);
+	int integratorOrder() const;
+	void kick(Real h);
+	void drift(Real h);
+	void synchroniseVelocities();
 	void handleCollisions();
+	int resolvePointCollisions();
+	int resolveSelfCollisions();
+	int resolveStaticCollisions();
+	int resolveColliderContacts();
+	void savePathStart();
+	bool isSweeping() const { return isContinuousCollisionEnabled && (isCollisionEnabled || !staticGeometry.empty()); }
+	bool isAnyCollisionEnabled() const { return isCollisionEnabled || isPointCollisionEnabled || isSelfCollisionEnabled || !staticGeometry.empty() || !staticColliders.empty(); }
 	void printMasspointStates();
 	void runDemo1();
 
-	MassPoint *teapot;
+	int teapot; // last index of massPoints, -1 if the scene has no teapot
+	TaggedVector<int, MEMORY_TAG_TOPOLOGY> teapotSprings; // springs ending at the teapot, found again after the colouring reorders them
+	int numPublicPoints() const { return massPoints.size() - (teapot >= 0 ? 1 : 0); }
 	Vec3  m_vfMovableObjectFinalPos;
 	void addSpringToTeapot(int masspoint, float initialLength, float stiffness);
 	// Custom stuff added by us
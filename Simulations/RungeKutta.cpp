@@ -0,0 +1,144 @@
+#include "RungeKutta.h"
+
+#include <algorithm>
+
+// Explicit midpoint
+static const Real MIDPOINT_A[] = {
+	0,   0,
+	0.5, 0,
+};
+static const Real MIDPOINT_B[] = { 0, 1 };
+static const Real MIDPOINT_C[] = { 0, 0.5 };
+const ButcherTableau RK_MIDPOINT_TABLEAU = { "Midpoint", 2, 2, MIDPOINT_A, MIDPOINT_B, nullptr, MIDPOINT_C, false };
+
+// Heun (explicit trapezoid) with embedded explicit Euler
+static const Real HEUN_A[] = {
+	0, 0,
+	1, 0,
+};
+static const Real HEUN_B[] = { 0.5, 0.5 };
+static const Real HEUN_BHAT[] = { 1, 0 };
+static const Real HEUN_C[] = { 0, 1 };
+const ButcherTableau RK_HEUN_TABLEAU = { "Heun", 2, 2, HEUN_A, HEUN_B, HEUN_BHAT, HEUN_C, false };
+
+// Classic 4th order Runge-Kutta
+static const Real RK4_A[] = {
+	0,   0,   0, 0,
+	0.5, 0,   0, 0,
+	0,   0.5, 0, 0,
+	0,   0,   1, 0,
+};
+static const Real RK4_B[] = { 1.0 / 6, 1.0 / 3, 1.0 / 3, 1.0 / 6 };
+static const Real RK4_C[] = { 0, 0.5, 0.5, 1 };
+const ButcherTableau RK4_TABLEAU = { "RK4", 4, 4, RK4_A, RK4_B, nullptr, RK4_C, false };
+
+// Dormand-Prince 5(4), first same as last
+static const Real DOPRI_A[] = {
+	0,                0,                 0,                0,              0,                 0,            0,
+	1.0 / 5,          0,                 0,                0,              0,                 0,            0,
+	3.0 / 40,         9.0 / 40,          0,                0,              0,                 0,            0,
+	44.0 / 45,        -56.0 / 15,        32.0 / 9,         0,              0,                 0,            0,
+	19372.0 / 6561,   -25360.0 / 2187,   64448.0 / 6561,   -212.0 / 729,   0,                 0,            0,
+	9017.0 / 3168,    -355.0 / 33,       46732.0 / 5247,   49.0 / 176,     -5103.0 / 18656,   0,            0,
+	35.0 / 384,       0,                 500.0 / 1113,     125.0 / 192,    -2187.0 / 6784,    11.0 / 84,    0,
+};
+static const Real DOPRI_B[] = { 35.0 / 384, 0, 500.0 / 1113, 125.0 / 192, -2187.0 / 6784, 11.0 / 84, 0 };
+static const Real DOPRI_BHAT[] = { 5179.0 / 57600, 0, 7571.0 / 16695, 393.0 / 640, -92097.0 / 339200, 187.0 / 2100, 1.0 / 40 };
+static const Real DOPRI_C[] = { 0, 1.0 / 5, 3.0 / 10, 4.0 / 5, 8.0 / 9, 1, 1 };
+const ButcherTableau DORMAND_PRINCE_TABLEAU = { "Dormand-Prince", 7, 5, DOPRI_A, DOPRI_B, DOPRI_BHAT, DOPRI_C, true };
+
+RungeKuttaIntegrator::RungeKuttaIntegrator()
+	: m_iNumPoints(0), m_iStages(0),
+	  m_y0(ArenaAllocator<Real>(nullptr, MEMORY_TAG_SOLVER)), m_k(ArenaAllocator<Real>(nullptr, MEMORY_TAG_SOLVER)),
+	  m_err(ArenaAllocator<Real>(nullptr, MEMORY_TAG_SOLVER)), m_bHasError(false)
+{
+}
+
+void RungeKuttaIntegrator::resize(int numPoints, int stages)
+{
+	if (numPoints == m_iNumPoints && stages <= m_iStages) return;
+	m_iNumPoints = numPoints;
+	m_iStages = std::max(stages, m_iStages);
+	m_y0.resize(6 * (size_t)numPoints);
+	m_k.resize(6 * (size_t)numPoints * m_iStages);
+	m_err.resize(6 * (size_t)numPoints);
+}
+
+void RungeKuttaIntegrator::saveInitialState(const MassPointStore& points)
+{
+	const int n = points.size();
+	const Real* src[6] = { points.px.data(), points.py.data(), points.pz.data(), points.vx.data(), points.vy.data(), points.vz.data() };
+	for (int q = 0; q < 6; ++q) std::copy(src[q], src[q] + n, m_y0.begin() + q * n);
+}
+
+void RungeKuttaIntegrator::storeStage(int s, const MassPointStore& points)
+{
+	const int n = points.size();
+	Real* k = m_k.data() + (size_t)s * 6 * n;
+	std::copy(points.vx.begin(), points.vx.end(), k);
+	std::copy(points.vy.begin(), points.vy.end(), k + n);
+	std::copy(points.vz.begin(), points.vz.end(), k + 2 * n);
+	for (int i = 0; i < n; ++i) {
+		k[3 * n + i] = points.fx[i] * points.invMass[i];
+		k[4 * n + i] = points.fy[i] * points.invMass[i];
+		k[5 * n + i] = points.fz[i] * points.invMass[i];
+	}
+}
+
+// Writes y0 + h * sum_j w_j k_j into the store, skipping zero weights
+static void combineStages(const Real* y0, const Real* k, const Real* w, int stages, int n, Real h, MassPointStore& points)
+{
+	Real* dst[6] = { points.px.data(), points.py.data(), points.pz.data(), points.vx.data(), points.vy.data(), points.vz.data() };
+	for (int q = 0; q < 6; ++q) {
+		Real* out = dst[q];
+		const Real* y = y0 + q * n;
+		std::copy(y, y + n, out);
+		for (int j = 0; j < stages; ++j) {
+			if (w[j] == 0) continue;
+			const Real hw = h * w[j];
+			const Real* kj = k + ((size_t)j * 6 + q) * n;
+			for (int i = 0; i < n; ++i) out[i] += hw * kj[i];
+		}
+	}
+}
+
+void RungeKuttaIntegrator::setStageState(const ButcherTableau& tableau, int s, Real h, MassPointStore& points) const
+{
+	combineStages(m_y0.data(), m_k.data(), tableau.a + s * tableau.stages, s, points.size(), h, points);
+}
+
+void RungeKuttaIntegrator::finish(const ButcherTableau& tableau, Real h, MassPointStore& points)
+{
+	const int n = points.size();
+	// with FSAL the last stage state already is the solution
+	if (!tableau.lastStageIsSolution) {
+		combineStages(m_y0.data(), m_k.data(), tableau.b, tableau.stages, n, h, points);
+	}
+
+	m_bHasError = tableau.bHat != nullptr;
+	if (!m_bHasError) return;
+	std::fill(m_err.begin(), m_err.end(), Real(0));
+	for (int j = 0; j < tableau.stages; ++j) {
+		const Real w = h * (tableau.b[j] - tableau.bHat[j]);
+		if (w == 0) continue;
+		const Real* kj = m_k.data() + (size_t)j * 6 * n;
+		for (int i = 0; i < 6 * n; ++i) m_err[i] += w * kj[i];
+	}
+}
+
+Real RungeKuttaIntegrator::errorNorm(const MassPointStore& points, Real absTol, Real relTol) const
+{
+	if (!m_bHasError) return 0;
+	const int n = points.size();
+	if (n == 0) return 0;
+	const Real* y1[6] = { points.px.data(), points.py.data(), points.pz.data(), points.vx.data(), points.vy.data(), points.vz.data() };
+	Real sum = 0;
+	for (int q = 0; q < 6; ++q) {
+		for (int i = 0; i < n; ++i) {
+			Real scale = absTol + relTol * std::max(fabs(m_y0[q * n + i]), fabs(y1[q][i]));
+			Real e = m_err[q * n + i] / scale;
+			sum += e * e;
+		}
+	}
+	return sqrt(sum / (6 * n));
+}
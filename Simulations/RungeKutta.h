@@ -0,0 +1,75 @@
+#ifndef RUNGEKUTTA_h
+#define RUNGEKUTTA_h
+
+#include "MassPointStore.h"
+
+// Coefficients of an explicit Runge-Kutta method.
+// a is stages x stages, row-major and strictly lower triangular.
+struct ButcherTableau {
+	const char* name;
+	int stages;
+	int order;
+	const Real* a;
+	const Real* b;
+	const Real* bHat;         // embedded lower order weights, nullptr if none
+	const Real* c;
+	bool lastStageIsSolution; // FSAL: last row of a equals b
+};
+
+extern const ButcherTableau RK_MIDPOINT_TABLEAU;
+extern const ButcherTableau RK_HEUN_TABLEAU;
+extern const ButcherTableau RK4_TABLEAU;
+extern const ButcherTableau DORMAND_PRINCE_TABLEAU;
+
+// Generic explicit Runge-Kutta stepper working directly on a MassPointStore.
+// The state is y = (x, v) with dy/dt = (v, f/m). Stage states are written into
+// the store so the regular force evaluation can be reused for every stage.
+// Stage buffers are only resized when the point count or stage count grows,
+// so steady-state stepping does not allocate.
+class RungeKuttaIntegrator {
+public:
+	RungeKuttaIntegrator();
+
+	void resize(int numPoints, int stages);
+
+	// Advances points by h. Expects points.f to hold the forces at the current
+	// state; computeForces() must refill points.f for the state in the store.
+	// With an FSAL tableau the forces in the store match the new state afterwards.
+	template<class ForceFunc>
+	void step(const ButcherTableau& tableau, MassPointStore& points, Real h, ForceFunc computeForces);
+
+	// Error estimate of the last step of an embedded method, measured as the
+	// RMS over all components of err / (absTol + relTol * |y|). 0 if the
+	// tableau has no embedded weights.
+	Real errorNorm(const MassPointStore& points, Real absTol, Real relTol) const;
+	bool hasErrorEstimate() const { return m_bHasError; }
+
+private:
+	void saveInitialState(const MassPointStore& points);
+	void storeStage(int s, const MassPointStore& points);
+	void setStageState(const ButcherTableau& tableau, int s, Real h, MassPointStore& points) const;
+	void finish(const ButcherTableau& tableau, Real h, MassPointStore& points);
+
+	int m_iNumPoints;
+	int m_iStages;
+	RealArray m_y0;  // [x y z vx vy vz] blocks of n values
+	RealArray m_k;   // stage derivatives, 6n values per stage
+	RealArray m_err; // embedded error estimate, 6n values
+	bool m_bHasError;
+};
+
+template<class ForceFunc>
+void RungeKuttaIntegrator::step(const ButcherTableau& tableau, MassPointStore& points, Real h, ForceFunc computeForces)
+{
+	resize(points.size(), tableau.stages);
+	saveInitialState(points);
+	storeStage(0, points);
+	for (int s = 1; s < tableau.stages; ++s) {
+		setStageState(tableau, s, h, points);
+		computeForces();
+		storeStage(s, points);
+	}
+	finish(tableau, h, points);
+}
+
+#endif
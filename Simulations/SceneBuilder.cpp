@@ -0,0 +1,228 @@
+#include "SceneBuilder.h"
+
+#include <fstream>
+#include <random>
+#include <sstream>
+
+void buildLattice(MassSpringSystemSimulator* msss, int width, int height, float jitter)
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> offset(-jitter, jitter);
+	msss->reserve(msss->getNumberOfMassPoints() + width * height, msss->getNumberOfSprings() + 2 * width * height);
+
+	const int first = msss->getNumberOfMassPoints();
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			Vec3 position(x + offset(rng), y + offset(rng), offset(rng));
+			msss->addMassPoint(position, Vec3(), false);
+		}
+	}
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			const int p = first + y * width + x;
+			if (x + 1 < width) msss->addSpring(p, p + 1, 1);
+			if (y + 1 < height) msss->addSpring(p, p + width, 1);
+		}
+	}
+}
+
+void buildChain(MassSpringSystemSimulator* msss, int n, float jitter)
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> offset(-jitter, jitter);
+	msss->reserve(msss->getNumberOfMassPoints() + n, msss->getNumberOfSprings() + n);
+
+	const int first = msss->getNumberOfMassPoints();
+	for (int i = 0; i < n; ++i) {
+		msss->addMassPoint(Vec3(i + offset(rng), offset(rng), offset(rng)), Vec3(), i == 0);
+	}
+	for (int i = 0; i + 1 < n; ++i) {
+		msss->addSpring(first + i, first + i + 1, 1);
+	}
+}
+
+void buildCloth(MassSpringSystemSimulator* msss, int width, int height, float jitter)
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> offset(-jitter, jitter);
+	msss->reserve(msss->getNumberOfMassPoints() + width * height, msss->getNumberOfSprings() + 4 * width * height);
+
+	const int first = msss->getNumberOfMassPoints();
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			const bool isFixed = y == height - 1 && (x == 0 || x == width - 1);
+			msss->addMassPoint(Vec3(x + offset(rng), y + offset(rng), offset(rng)), Vec3(), isFixed);
+		}
+	}
+	const float diagonal = sqrtf(2.0f);
+	for (int y = 0; y < height; ++y) {
+		for (int x = 0; x < width; ++x) {
+			const int p = first + y * width + x;
+			if (x + 1 < width) msss->addSpring(p, p + 1, 1);
+			if (y + 1 < height) msss->addSpring(p, p + width, 1);
+			if (x + 1 < width && y + 1 < height) {
+				msss->addSpring(p, p + width + 1, diagonal);
+				msss->addSpring(p + 1, p + width, diagonal);
+				msss->addTriangle(p, p + 1, p + width + 1);
+				msss->addTriangle(p, p + width + 1, p + width);
+			}
+		}
+	}
+}
+
+void buildVolumeLattice(MassSpringSystemSimulator* msss, int width, int height, int depth, float jitter)
+{
+	std::mt19937 rng(1234);
+	std::uniform_real_distribution<float> offset(-jitter, jitter);
+	const int n = width * height * depth;
+	msss->reserve(msss->getNumberOfMassPoints() + n, msss->getNumberOfSprings() + 3 * n);
+
+	const int first = msss->getNumberOfMassPoints();
+	for (int z = 0; z < depth; ++z) {
+		for (int y = 0; y < height; ++y) {
+			for (int x = 0; x < width; ++x) {
+				msss->addMassPoint(Vec3(x + offset(rng), y + offset(rng), z + offset(rng)), Vec3(), false);
+			}
+		}
+	}
+	const int slice = width * height;
+	for (int z = 0; z < depth; ++z) {
+		for (int y = 0; y < height; ++y) {
+			for (int x = 0; x < width; ++x) {
+				const int p = first + z * slice + y * width + x;
+				if (x + 1 < width) msss->addSpring(p, p + 1, 1);
+				if (y + 1 < height) msss->addSpring(p, p + width, 1);
+				if (z + 1 < depth) msss->addSpring(p, p + slice, 1);
+			}
+		}
+	}
+}
+
+void buildRandomGraph(MassSpringSystemSimulator* msss, int n, int averageDegree, unsigned seed)
+{
+	std::mt19937 rng(seed);
+	const float size = cbrtf((float)n);
+	std::uniform_real_distribution<float> coordinate(0, size);
+	std::uniform_real_distribution<float> stretch(0.9f, 1.1f);
+	const int numSprings = n > 1 ? n * averageDegree / 2 : 0;
+	msss->reserve(msss->getNumberOfMassPoints() + n, msss->getNumberOfSprings() + numSprings);
+
+	const int first = msss->getNumberOfMassPoints();
+	for (int i = 0; i < n; ++i) {
+		msss->addMassPoint(Vec3(coordinate(rng), coordinate(rng), coordinate(rng)), Vec3(), false);
+	}
+	std::uniform_int_distribution<int> point(0, n - 1);
+	for (int s = 0; s < numSprings; ++s) {
+		const int i = point(rng);
+		int j = point(rng);
+		while (j == i) j = point(rng);
+		const Vec3 d = msss->getPositionOfMassPoint(first + i) - msss->getPositionOfMassPoint(first + j);
+		msss->addSpring(first + i, first + j, (float)(norm(d) * stretch(rng)));
+	}
+}
+
+void buildObstacles(MassSpringSystemSimulator* msss, int n, float size, unsigned seed)
+{
+	std::mt19937 rng(seed);
+	std::uniform_real_distribution<float> coordinate(0, size);
+	std::uniform_real_distribution<float> extent(0.01f * size, 0.05f * size);
+	StaticColliderSet& colliders = msss->getStaticColliders();
+	for (int i = 0; i < n; ++i) {
+		const Vec3 centre(coordinate(rng), coordinate(rng), coordinate(rng));
+		switch (i % 3) {
+		case 0:
+			colliders.addSphere(centre, extent(rng));
+			break;
+		case 1: {
+			const Vec3 half(extent(rng), extent(rng), extent(rng));
+			colliders.addBox(centre - half, centre + half);
+			break;
+		}
+		default: {
+			const Vec3 half(extent(rng), extent(rng), extent(rng));
+			colliders.addCapsule(centre - half, centre + half, extent(rng) * 0.5f);
+		}
+		}
+	}
+}
+
+// true if only whitespace is left on the line
+static bool isAtEnd(std::istream& in)
+{
+	std::string rest;
+	return !(in >> rest);
+}
+
+bool loadScene(MassSpringSystemSimulator* msss, const std::string& path, std::string& error)
+{
+	std::ifstream file(path.c_str());
+	if (!file) {
+		error = path + ": cannot open file";
+		return false;
+	}
+
+	const int first = msss->getNumberOfMassPoints();
+	std::string line;
+	for (int lineNumber = 1; std::getline(file, line); ++lineNumber) {
+		std::string::size_type comment = line.find('#');
+		if (comment != std::string::npos) line.erase(comment);
+		std::istringstream in(line);
+		std::string directive;
+		if (!(in >> directive)) continue;
+
+		bool ok = true;
+		if (directive == "mass" || directive == "stiffness" || directive == "damping") {
+			float value;
+			ok = (bool)(in >> value) && isAtEnd(in);
+			if (ok && directive == "mass") msss->setMass(value);
+			if (ok && directive == "stiffness") msss->setStiffness(value);
+			if (ok && directive == "damping") msss->setDampingFactor(value);
+		}
+		else if (directive == "gravity" || directive == "collision") {
+			int enabled;
+			ok = (bool)(in >> enabled) && isAtEnd(in);
+			if (ok && directive == "gravity") msss->setGravityEnabled(enabled != 0);
+			if (ok && directive == "collision") msss->setCollisionEnabled(enabled != 0);
+		}
+		else if (directive == "point") {
+			float x, y, z, vx = 0, vy = 0, vz = 0;
+			ok = (bool)(in >> x >> y >> z);
+			std::string token;
+			bool isFixed = false;
+			if (ok && in >> token) {
+				if (token == "fixed") isFixed = true;
+				else {
+					std::istringstream velocity(token);
+					ok = (bool)(velocity >> vx) && velocity.eof() && (bool)(in >> vy >> vz);
+					if (ok && in >> token) {
+						isFixed = token == "fixed";
+						ok = isFixed;
+					}
+				}
+			}
+			ok = ok && isAtEnd(in);
+			if (ok) msss->addMassPoint(Vec3(x, y, z), Vec3(vx, vy, vz), isFixed);
+		}
+		else if (directive == "spring") {
+			int i, j;
+			float length;
+			ok = (bool)(in >> i >> j >> length) && isAtEnd(in);
+			const int n = msss->getNumberOfMassPoints() - first;
+			if (ok && (i < 0 || j < 0 || i >= n || j >= n || i == j)) {
+				error = path + ":" + std::to_string(lineNumber) + ": spring refers to an unknown point";
+				return false;
+			}
+			if (ok) msss->addSpring(first + i, first + j, length);
+		}
+		else {
+			error = path + ":" + std::to_string(lineNumber) + ": unknown directive '" + directive + "'";
+			return false;
+		}
+
+		if (!ok) {
+			error = path + ":" + std::to_string(lineNumber) + ": malformed '" + directive + "' line";
+			return false;
+		}
+	}
+	return true;
+}
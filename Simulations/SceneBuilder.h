@@ -0,0 +1,49 @@
+#ifndef SCENEBUILDER_h
+#define SCENEBUILDER_h
+
+#include <string>
+#include "MassSpringSystemSimulator.h"
+
+// Procedural scenes for tests and benchmarks, built through the public
+// simulator interface on top of the current scene.
+
+// Demo4 style grid in the xy plane: unit spacing, structural springs of
+// rest length 1, about 2 * width * height springs. jitter displaces every
+// point by up to jitter per axis with a fixed seed.
+void buildLattice(MassSpringSystemSimulator* msss, int width, int height, float jitter = 0);
+
+// Benchmark scenes. All use unit spacing and rest length, jitter displaces the
+// points as above so the springs start out of rest.
+
+// Rope along x, the first point fixed: n points, n - 1 springs.
+void buildChain(MassSpringSystemSimulator* msss, int n, float jitter = 0);
+
+// Hanging cloth in the xy plane, the two top corners fixed: structural and
+// both shear diagonals, about 4 * width * height springs, and two triangles
+// per quad for self-collision.
+void buildCloth(MassSpringSystemSimulator* msss, int width, int height, float jitter = 0);
+
+// Solid block with axis aligned springs, about 3 * width * height * depth springs.
+void buildVolumeLattice(MassSpringSystemSimulator* msss, int width, int height, int depth, float jitter = 0);
+
+// n points scattered in a cube, each spring joins two uniformly chosen points,
+// so neighbours are spread over the whole store (worst case memory locality).
+// Rest lengths are the initial distances, perturbed by up to 10 percent.
+void buildRandomGraph(MassSpringSystemSimulator* msss, int n, int averageDegree, unsigned seed = 1234);
+
+// n static colliders of the simulator's collider set, spheres, boxes and
+// capsules in turn, scattered over the cube [0, size]^3. Radii and half
+// extents are up to a 20th of the size.
+void buildObstacles(MassSpringSystemSimulator* msss, int n, float size, unsigned seed = 4321);
+
+// Reads a plain text scene, one directive per line, '#' starts a comment:
+//   mass <m> | stiffness <k> | damping <c>    simulator wide, also for points
+//                                             and springs already added; the
+//                                             last one in the file wins
+//   gravity <0|1> | collision <0|1>
+//   point <x> <y> <z> [<vx> <vy> <vz>] [fixed]
+//   spring <i> <j> <rest length>              indices of points in this file
+// Returns false and a "file:line: reason" message on the first error.
+bool loadScene(MassSpringSystemSimulator* msss, const std::string& path, std::string& error);
+
+#endif
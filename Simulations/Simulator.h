@@ -7,7 +7,13 @@
 #include <cmath>
 #include <iostream>
 #include "util/vectorbase.h"
+#ifdef GAMEPHYSICS_HEADLESS
+// headless builds link no renderer, the UI hooks only see opaque types
+class DrawingUtilitiesClass;
+struct ID3D11DeviceContext;
+#else
 #include "DrawingUtilitiesClass.h"
+#endif
 
 struct Point2D {
 	int x,y;
@@ -52,6 +58,18 @@ public:
 	*/
 	virtual void simulateTimestep(float timeStep)= 0;
 	/*
+	This Function switches simulateTimestep to error controlled substepping, so that a single call
+	advances the simulation by the whole timeStep with as many internal steps as the accuracy requires
+	returns false if the simulator only supports fixed steps
+	*/
+	virtual bool setAdaptiveStepping(bool /*enable*/) { return false; }
+	/*
+	This Function lets the simulator propose the time step for the next frame, e.g. from its energy drift
+	input: timeStep is the current time step
+	returns timeStep if the simulator has no opinion
+	*/
+	virtual float suggestTimestep(float timeStep) { return timeStep; }
+	/*
 	This Function is used to notify the simulator that the scene test case is changed 
 	so that the needed changes can be handed here
 	**for more info on how to use this function take a look at the template simulator 
@@ -0,0 +1,213 @@
+#include "SpatialHashGrid.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdint.h>
+
+// smaller inputs are sorted and queried on the calling thread
+static const int MIN_POINTS_PER_CHUNK = 4096;
+// cell coordinates are clamped so that far away or broken points cannot overflow
+static const Real MAX_CELL_COORDINATE = 1 << 29;
+
+static int cellCoordinate(Real p, Real invCellSize)
+{
+	Real c = std::floor(p * invCellSize);
+	if (!(c >= -MAX_CELL_COORDINATE)) c = -MAX_CELL_COORDINATE; // also catches NaN
+	if (c > MAX_CELL_COORDINATE) c = MAX_CELL_COORDINATE;
+	return (int)c;
+}
+
+// [begin, end) of chunk c when n items are split into chunks parts
+static int chunkBegin(int n, int chunks, int c)
+{
+	return (int)((int64_t)n * c / chunks);
+}
+
+SpatialHashGrid::SpatialHashGrid()
+	: m_cellSize(1), m_iPoints(0), m_iMask(0), m_iShift(32)
+{
+}
+
+// row (cy, cz) of cells through the primes of Teschner et al. and a
+// multiplicative hash, whose high bits are the well mixed ones
+static uint32_t rowHash(int cy, int cz)
+{
+	return (((uint32_t)cy * 19349663u) ^ ((uint32_t)cz * 83492791u)) * 2654435761u;
+}
+
+// Only the row is hashed and the cells of a row take consecutive slots, so
+// the three cells of a neighbour row are one run of cellStart and points.
+int SpatialHashGrid::slotOf(int cx, int cy, int cz) const
+{
+	return (int)(((rowHash(cy, cz) >> m_iShift) + (uint32_t)cx) & (uint32_t)m_iMask);
+}
+
+// consecutive along a row as well, so a row of three is one range check
+uint32_t SpatialHashGrid::cellKey(int cx, int cy, int cz)
+{
+	uint32_t h = rowHash(cy, cz);
+	h ^= h >> 16;
+	h *= 0x7FEB352Du;
+	return (h ^ (h >> 15)) + (uint32_t)cx;
+}
+
+int SpatialHashGrid::chunkCount(ThreadPool& pool) const
+{
+	return std::max(1, std::min(pool.threadCount(), m_iPoints / MIN_POINTS_PER_CHUNK));
+}
+
+void SpatialHashGrid::build(const Real* px, const Real* py, const Real* pz, int n, Real cellSize, ThreadPool& pool)
+{
+	m_cellSize = cellSize;
+	m_iPoints = n;
+	int bits = 6;
+	while ((1 << bits) < n && bits < 30) ++bits;
+	m_iMask = (1 << bits) - 1;
+	m_iShift = 32 - bits;
+
+	const int table = tableSize();
+	const int chunks = chunkCount(pool);
+	const Real invCellSize = 1 / cellSize;
+	slots.resize(n);
+	m_pointKeys.resize(n);
+	points.resize(n);
+	keys.resize(n);
+	cellStart.resize(table + 1);
+	m_chunkCounts.assign((size_t)chunks * table, 0);
+	m_blockTotals.assign(chunks + 1, 0);
+
+	// slot of every point and how many points of each chunk fall into each slot
+	pool.parallelFor(0, chunks, 1, [&](int first, int last) {
+		for (int c = first; c < last; ++c) {
+			int* counts = &m_chunkCounts[(size_t)c * table];
+			for (int i = chunkBegin(n, chunks, c); i < chunkBegin(n, chunks, c + 1); ++i) {
+				const int cx = cellCoordinate(px[i], invCellSize);
+				const int cy = cellCoordinate(py[i], invCellSize);
+				const int cz = cellCoordinate(pz[i], invCellSize);
+				const int s = slotOf(cx, cy, cz);
+				slots[i] = s;
+				m_pointKeys[i] = cellKey(cx, cy, cz);
+				counts[s]++;
+			}
+		}
+	});
+
+	// Prefix sum over the slots, chunk by chunk within a slot. The slots are
+	// split into one block per chunk: the blocks sum up their points, a short
+	// serial scan turns the sums into block offsets, and the blocks then
+	// replace every count by the position the scatter starts writing at.
+	pool.parallelFor(0, chunks, 1, [&](int first, int last) {
+		for (int b = first; b < last; ++b) {
+			int sum = 0;
+			for (int k = chunkBegin(table, chunks, b); k < chunkBegin(table, chunks, b + 1); ++k) {
+				for (int c = 0; c < chunks; ++c) sum += m_chunkCounts[(size_t)c * table + k];
+			}
+			m_blockTotals[b + 1] = sum;
+		}
+	});
+	for (int b = 0; b < chunks; ++b) m_blockTotals[b + 1] += m_blockTotals[b];
+	pool.parallelFor(0, chunks, 1, [&](int first, int last) {
+		for (int b = first; b < last; ++b) {
+			int offset = m_blockTotals[b];
+			for (int k = chunkBegin(table, chunks, b); k < chunkBegin(table, chunks, b + 1); ++k) {
+				cellStart[k] = offset;
+				for (int c = 0; c < chunks; ++c) {
+					int& count = m_chunkCounts[(size_t)c * table + k];
+					const int inSlot = count;
+					count = offset;
+					offset += inSlot;
+				}
+			}
+		}
+	});
+	cellStart[table] = n;
+
+	// stable scatter, every chunk writes behind the earlier chunks of a slot
+	pool.parallelFor(0, chunks, 1, [&](int first, int last) {
+		for (int c = first; c < last; ++c) {
+			int* cursors = &m_chunkCounts[(size_t)c * table];
+			for (int i = chunkBegin(n, chunks, c); i < chunkBegin(n, chunks, c + 1); ++i) {
+				const int r = cursors[slots[i]]++;
+				keys[r] = m_pointKeys[i];
+				GridPoint& point = points[r];
+				point.x = px[i];
+				point.y = py[i];
+				point.z = pz[i];
+				point.index = i;
+			}
+		}
+	});
+}
+
+void SpatialHashGrid::findPairs(Real distance, ThreadPool& pool, PointPairList& pairs)
+{
+	const int chunks = chunkCount(pool);
+	if ((int)m_chunkPairs.size() < chunks) m_chunkPairs.resize(chunks);
+	const Real invCellSize = 1 / m_cellSize;
+	const Real maxDistanceSquared = distance * distance;
+	const int n = m_iPoints;
+
+	// Half of the neighbourhood is enough: a pair is found from the point
+	// whose cell comes first in (z, y, x) order, or from the earlier point
+	// of a shared cell. That leaves the rows dz = 1 and dy = 1 of dz = 0,
+	// three cells each, and the own row from the own cell on. The points
+	// are walked in slot order, consecutive points mostly share their
+	// neighbour rows, which are then still cached.
+	static const int ROWS[5][2] = { { 0, 0 }, { 1, 0 }, { -1, 1 }, { 0, 1 }, { 1, 1 } }; // dy, dz
+	pool.parallelFor(0, chunks, 1, [&](int first, int last) {
+		for (int c = first; c < last; ++c) {
+			PointPairList& out = m_chunkPairs[c];
+			out.clear();
+			for (int q = chunkBegin(n, chunks, c); q < chunkBegin(n, chunks, c + 1); ++q) {
+				const GridPoint p = points[q];
+				const int cx = cellCoordinate(p.x, invCellSize);
+				const int cy = cellCoordinate(p.y, invCellSize);
+				const int cz = cellCoordinate(p.z, invCellSize);
+				for (int row = 0; row < 5; ++row) {
+					const int dy = ROWS[row][0], dz = ROWS[row][1];
+					// cells cx .. cx+1 of the own row, cx-1 .. cx+1 of the others;
+					// their slots are consecutive but may wrap around the table end
+					const int firstCell = row == 0 ? cx : cx - 1;
+					const int firstSlot = slotOf(firstCell, cy + dy, cz + dz);
+					const int lastSlot = (firstSlot + (row == 0 ? 1 : 2)) & m_iMask;
+					const uint32_t firstKey = cellKey(firstCell, cy + dy, cz + dz);
+					const uint32_t keySpan = row == 0 ? 1 : 2;
+					const bool wraps = lastSlot < firstSlot;
+					const int ranges[2][2] = {
+						{ row == 0 ? q + 1 : cellStart[firstSlot], wraps ? n : cellStart[lastSlot + 1] },
+						{ 0, wraps ? cellStart[lastSlot + 1] : 0 } };
+					for (int range = 0; range < 2; ++range) {
+						for (int r = ranges[range][0]; r < ranges[range][1]; ++r) {
+							// other cells of the slots
+							if (keys[r] - firstKey > keySpan) continue;
+							const GridPoint& other = points[r];
+							const Real ex = other.x - p.x, ey = other.y - p.y, ez = other.z - p.z;
+							if (ex * ex + ey * ey + ez * ez >= maxDistanceSquared) continue;
+							// keys of different rows can collide, rarely; the pair
+							// only counts when its own row is the one scanned
+							if (cellCoordinate(other.y, invCellSize) != cy + dy || cellCoordinate(other.z, invCellSize) != cz + dz) continue;
+							const PointPair pair = { std::min(p.index, other.index), std::max(p.index, other.index) };
+							out.push_back(pair);
+						}
+					}
+				}
+			}
+		}
+	});
+
+	pairs.clear();
+	for (int c = 0; c < chunks; ++c) pairs.insert(pairs.end(), m_chunkPairs[c].begin(), m_chunkPairs[c].end());
+}
+
+void SpatialHashGrid::clear()
+{
+	cellStart.clear();
+	points.clear();
+	keys.clear();
+	slots.clear();
+	m_pointKeys.clear();
+	m_chunkCounts.clear();
+	m_blockTotals.clear();
+	m_chunkPairs.clear();
+	m_iPoints = 0;
+}
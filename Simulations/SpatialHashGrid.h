@@ -0,0 +1,72 @@
+#ifndef SPATIALHASHGRID_h
+#define SPATIALHASHGRID_h
+
+#include <stdint.h>
+#include <vector>
+#include "util/vectorbase.h"
+#include "util/memorytags.h"
+#include "util/threadpool.h"
+
+using namespace GamePhysics;
+
+// Two points closer than the query distance, a < b.
+struct PointPair {
+	int a, b;
+};
+
+typedef TaggedVector<PointPair, MEMORY_TAG_COLLISION> PointPairList;
+
+// Position and index of a point, copied into slot order so that the points
+// of a slot share a cache line instead of being gathered from three arrays.
+struct GridPoint {
+	Real x, y, z;
+	int index;
+};
+
+// Uniform grid broadphase for point-like objects, rebuilt from scratch every
+// step. Cells are hashed into a power of two table with about one slot per
+// point, and the points are sorted by slot with a parallel counting sort:
+// per chunk histograms, a prefix sum over the slots and a stable scatter.
+// The points of slot k are then points[cellStart[k] .. cellStart[k+1]-1],
+// in increasing index order. Build and query are linear in the number of
+// points for bounded density and give the same result for any thread
+// count. Storage only grows, so a scene of constant size does not
+// allocate after the first step.
+class SpatialHashGrid {
+public:
+	SpatialHashGrid();
+
+	TaggedVector<int, MEMORY_TAG_COLLISION> cellStart; // tableSize() + 1 offsets into points
+	TaggedVector<GridPoint, MEMORY_TAG_COLLISION> points; // sorted by slot
+	// cellKey() of every entry of points. Many cells share a slot; comparing
+	// keys skips the points of the others without loading them.
+	TaggedVector<uint32_t, MEMORY_TAG_COLLISION> keys;
+	TaggedVector<int, MEMORY_TAG_COLLISION> slots;     // slot of every point, by index
+
+	// Sorts n points into cubic cells of edge cellSize.
+	void build(const Real* px, const Real* py, const Real* pz, int n, Real cellSize, ThreadPool& pool);
+	// Replaces pairs with all pairs of built points closer than distance,
+	// which must not exceed the cell size, so neighbours are at most one
+	// cell apart. The order only depends on the positions.
+	void findPairs(Real distance, ThreadPool& pool, PointPairList& pairs);
+	void clear();
+
+	int tableSize() const { return m_iMask + 1; }
+	Real cellSize() const { return m_cellSize; }
+	int slotOf(int cx, int cy, int cz) const;
+	static uint32_t cellKey(int cx, int cy, int cz);
+
+private:
+	int chunkCount(ThreadPool& pool) const;
+
+	Real m_cellSize;
+	int m_iPoints;
+	int m_iMask;
+	int m_iShift;
+	TaggedVector<int, MEMORY_TAG_COLLISION> m_chunkCounts; // chunk major histograms, then scatter cursors
+	TaggedVector<int, MEMORY_TAG_COLLISION> m_blockTotals;
+	TaggedVector<uint32_t, MEMORY_TAG_COLLISION> m_pointKeys; // by index
+	std::vector<PointPairList> m_chunkPairs;
+};
+
+#endif
@@ -0,0 +1,246 @@
+#include "SpringKernels.h"
+#include <algorithm>
+
+#include "util/vectorkernels.h"
+
+// springs per block, the block's forces stay in L1
+static const int BLOCK = 256;
+
+struct SpringKernelArgs {
+	const int* a;
+	const int* b;
+	const Real* L;
+	const Real* k;
+	const Real* px; const Real* py; const Real* pz;
+	const Real* vx; const Real* vy; const Real* vz;
+	Real damping;
+};
+
+static inline void springForce(const SpringKernelArgs& g, int s, Real& fx, Real& fy, Real& fz, Real* e)
+{
+	const int i = g.a[s];
+	const int j = g.b[s];
+	Real dx = g.px[i] - g.px[j];
+	Real dy = g.py[i] - g.py[j];
+	Real dz = g.pz[i] - g.pz[j];
+	Real distance = sqrt(dx * dx + dy * dy + dz * dz);
+	Real dvx = g.vx[i] - g.vx[j];
+	Real dvy = g.vy[i] - g.vy[j];
+	Real dvz = g.vz[i] - g.vz[j];
+
+	// Hooke's Law, damping only acts on the velocity along the spring.
+	// One division per spring: double precision divide and square root
+	// dominate the kernel even when vectorised.
+	Real inverse = 1.0 / distance;
+	Real damping = g.damping * (dvx * dx + dvy * dy + dvz * dz) * inverse;
+	Real scale = ((g.k[s] * -1.0) * (distance - g.L[s]) - damping) * inverse;
+
+	fx = scale * dx;
+	fy = scale * dy;
+	fz = scale * dz;
+
+	// elastic energy 1/2 k x^2, only for the energy monitor
+	if (e) {
+		Real stretch = distance - g.L[s];
+		*e = 0.5 * g.k[s] * stretch * stretch;
+	}
+}
+
+static void springBlockScalar(const SpringKernelArgs& g, int begin, int end, Real* sfx, Real* sfy, Real* sfz, Real* se)
+{
+	for (int s = begin; s < end; ++s) springForce(g, s, sfx[s - begin], sfy[s - begin], sfz[s - begin], se ? se + (s - begin) : nullptr);
+}
+
+#ifdef GP_X86
+
+GP_TARGET("sse2")
+static void springBlockSSE2(const SpringKernelArgs& g, int begin, int end, Real* sfx, Real* sfy, Real* sfz, Real* se)
+{
+	const __m128d c = _mm_set1_pd(g.damping);
+	const __m128d minusOne = _mm_set1_pd(-1.0);
+	const __m128d one = _mm_set1_pd(1.0);
+	const __m128d half = _mm_set1_pd(0.5);
+	int s = begin;
+	for (; s + 2 <= end; s += 2) {
+		const int i0 = g.a[s], i1 = g.a[s + 1];
+		const int j0 = g.b[s], j1 = g.b[s + 1];
+		__m128d dx = _mm_sub_pd(_mm_set_pd(g.px[i1], g.px[i0]), _mm_set_pd(g.px[j1], g.px[j0]));
+		__m128d dy = _mm_sub_pd(_mm_set_pd(g.py[i1], g.py[i0]), _mm_set_pd(g.py[j1], g.py[j0]));
+		__m128d dz = _mm_sub_pd(_mm_set_pd(g.pz[i1], g.pz[i0]), _mm_set_pd(g.pz[j1], g.pz[j0]));
+		__m128d dvx = _mm_sub_pd(_mm_set_pd(g.vx[i1], g.vx[i0]), _mm_set_pd(g.vx[j1], g.vx[j0]));
+		__m128d dvy = _mm_sub_pd(_mm_set_pd(g.vy[i1], g.vy[i0]), _mm_set_pd(g.vy[j1], g.vy[j0]));
+		__m128d dvz = _mm_sub_pd(_mm_set_pd(g.vz[i1], g.vz[i0]), _mm_set_pd(g.vz[j1], g.vz[j0]));
+
+		__m128d distance = _mm_sqrt_pd(_mm_add_pd(_mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)), _mm_mul_pd(dz, dz)));
+		__m128d dot = _mm_add_pd(_mm_add_pd(_mm_mul_pd(dvx, dx), _mm_mul_pd(dvy, dy)), _mm_mul_pd(dvz, dz));
+		__m128d inverse = _mm_div_pd(one, distance);
+		__m128d damping = _mm_mul_pd(_mm_mul_pd(c, dot), inverse);
+		__m128d k = _mm_loadu_pd(g.k + s);
+		__m128d x = _mm_sub_pd(distance, _mm_loadu_pd(g.L + s));
+		__m128d stretch = _mm_mul_pd(_mm_mul_pd(k, minusOne), x);
+		__m128d scale = _mm_mul_pd(_mm_sub_pd(stretch, damping), inverse);
+
+		_mm_store_pd(sfx + (s - begin), _mm_mul_pd(scale, dx));
+		_mm_store_pd(sfy + (s - begin), _mm_mul_pd(scale, dy));
+		_mm_store_pd(sfz + (s - begin), _mm_mul_pd(scale, dz));
+		if (se) _mm_store_pd(se + (s - begin), _mm_mul_pd(_mm_mul_pd(_mm_mul_pd(half, k), x), x));
+	}
+	for (; s < end; ++s) springForce(g, s, sfx[s - begin], sfy[s - begin], sfz[s - begin], se ? se + (s - begin) : nullptr);
+}
+
+GP_TARGET("avx2")
+static void springBlockAVX2(const SpringKernelArgs& g, int begin, int end, Real* sfx, Real* sfy, Real* sfz, Real* se)
+{
+	const __m256d c = _mm256_set1_pd(g.damping);
+	const __m256d minusOne = _mm256_set1_pd(-1.0);
+	const __m256d one = _mm256_set1_pd(1.0);
+	const __m256d half = _mm256_set1_pd(0.5);
+	int s = begin;
+	for (; s + 4 <= end; s += 4) {
+		const __m128i i = _mm_loadu_si128((const __m128i*)(g.a + s));
+		const __m128i j = _mm_loadu_si128((const __m128i*)(g.b + s));
+		__m256d dx = _mm256_sub_pd(_mm256_i32gather_pd(g.px, i, 8), _mm256_i32gather_pd(g.px, j, 8));
+		__m256d dy = _mm256_sub_pd(_mm256_i32gather_pd(g.py, i, 8), _mm256_i32gather_pd(g.py, j, 8));
+		__m256d dz = _mm256_sub_pd(_mm256_i32gather_pd(g.pz, i, 8), _mm256_i32gather_pd(g.pz, j, 8));
+		__m256d dvx = _mm256_sub_pd(_mm256_i32gather_pd(g.vx, i, 8), _mm256_i32gather_pd(g.vx, j, 8));
+		__m256d dvy = _mm256_sub_pd(_mm256_i32gather_pd(g.vy, i, 8), _mm256_i32gather_pd(g.vy, j, 8));
+		__m256d dvz = _mm256_sub_pd(_mm256_i32gather_pd(g.vz, i, 8), _mm256_i32gather_pd(g.vz, j, 8));
+
+		__m256d distance = _mm256_sqrt_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), _mm256_mul_pd(dz, dz)));
+		__m256d dot = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dvx, dx), _mm256_mul_pd(dvy, dy)), _mm256_mul_pd(dvz, dz));
+		__m256d inverse = _mm256_div_pd(one, distance);
+		__m256d damping = _mm256_mul_pd(_mm256_mul_pd(c, dot), inverse);
+		__m256d k = _mm256_loadu_pd(g.k + s);
+		__m256d x = _mm256_sub_pd(distance, _mm256_loadu_pd(g.L + s));
+		__m256d stretch = _mm256_mul_pd(_mm256_mul_pd(k, minusOne), x);
+		__m256d scale = _mm256_mul_pd(_mm256_sub_pd(stretch, damping), inverse);
+
+		_mm256_store_pd(sfx + (s - begin), _mm256_mul_pd(scale, dx));
+		_mm256_store_pd(sfy + (s - begin), _mm256_mul_pd(scale, dy));
+		_mm256_store_pd(sfz + (s - begin), _mm256_mul_pd(scale, dz));
+		if (se) _mm256_store_pd(se + (s - begin), _mm256_mul_pd(_mm256_mul_pd(_mm256_mul_pd(half, k), x), x));
+	}
+	for (; s < end; ++s) springForce(g, s, sfx[s - begin], sfy[s - begin], sfz[s - begin], se ? se + (s - begin) : nullptr);
+}
+
+GP_TARGET("avx512f")
+static void springBlockAVX512(const SpringKernelArgs& g, int begin, int end, Real* sfx, Real* sfy, Real* sfz, Real* se)
+{
+	const __m512d c = _mm512_set1_pd(g.damping);
+	const __m512d minusOne = _mm512_set1_pd(-1.0);
+	const __m512d one = _mm512_set1_pd(1.0);
+	const __m512d half = _mm512_set1_pd(0.5);
+	int s = begin;
+	for (; s + 8 <= end; s += 8) {
+		const __m256i i = _mm256_loadu_si256((const __m256i*)(g.a + s));
+		const __m256i j = _mm256_loadu_si256((const __m256i*)(g.b + s));
+		__m512d dx = _mm512_sub_pd(_mm512_i32gather_pd(i, g.px, 8), _mm512_i32gather_pd(j, g.px, 8));
+		__m512d dy = _mm512_sub_pd(_mm512_i32gather_pd(i, g.py, 8), _mm512_i32gather_pd(j, g.py, 8));
+		__m512d dz = _mm512_sub_pd(_mm512_i32gather_pd(i, g.pz, 8), _mm512_i32gather_pd(j, g.pz, 8));
+		__m512d dvx = _mm512_sub_pd(_mm512_i32gather_pd(i, g.vx, 8), _mm512_i32gather_pd(j, g.vx, 8));
+		__m512d dvy = _mm512_sub_pd(_mm512_i32gather_pd(i, g.vy, 8), _mm512_i32gather_pd(j, g.vy, 8));
+		__m512d dvz = _mm512_sub_pd(_mm512_i32gather_pd(i, g.vz, 8), _mm512_i32gather_pd(j, g.vz, 8));
+
+		__m512d distance = _mm512_sqrt_pd(_mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(dx, dx), _mm512_mul_pd(dy, dy)), _mm512_mul_pd(dz, dz)));
+		__m512d dot = _mm512_add_pd(_mm512_add_pd(_mm512_mul_pd(dvx, dx), _mm512_mul_pd(dvy, dy)), _mm512_mul_pd(dvz, dz));
+		__m512d inverse = _mm512_div_pd(one, distance);
+		__m512d damping = _mm512_mul_pd(_mm512_mul_pd(c, dot), inverse);
+		__m512d k = _mm512_loadu_pd(g.k + s);
+		__m512d x = _mm512_sub_pd(distance, _mm512_loadu_pd(g.L + s));
+		__m512d stretch = _mm512_mul_pd(_mm512_mul_pd(k, minusOne), x);
+		__m512d scale = _mm512_mul_pd(_mm512_sub_pd(stretch, damping), inverse);
+
+		_mm512_store_pd(sfx + (s - begin), _mm512_mul_pd(scale, dx));
+		_mm512_store_pd(sfy + (s - begin), _mm512_mul_pd(scale, dy));
+		_mm512_store_pd(sfz + (s - begin), _mm512_mul_pd(scale, dz));
+		if (se) _mm512_store_pd(se + (s - begin), _mm512_mul_pd(_mm512_mul_pd(_mm512_mul_pd(half, k), x), x));
+	}
+	for (; s < end; ++s) springForce(g, s, sfx[s - begin], sfy[s - begin], sfz[s - begin], se ? se + (s - begin) : nullptr);
+}
+
+#endif
+
+bool isSpringKernelSupported(SpringKernelIsa isa)
+{
+	const CpuFeatures& cpu = cpuFeatures();
+	switch (isa) {
+	case SPRING_KERNEL_SCALAR: return true;
+#ifdef GP_X86
+	case SPRING_KERNEL_SSE2: return cpu.sse2;
+	case SPRING_KERNEL_AVX2: return cpu.avx2;
+	case SPRING_KERNEL_AVX512: return cpu.avx512f;
+#endif
+	default: return false;
+	}
+}
+
+SpringKernelIsa bestSpringKernelIsa()
+{
+	if (isSpringKernelSupported(SPRING_KERNEL_AVX512)) return SPRING_KERNEL_AVX512;
+	if (isSpringKernelSupported(SPRING_KERNEL_AVX2)) return SPRING_KERNEL_AVX2;
+	if (isSpringKernelSupported(SPRING_KERNEL_SSE2)) return SPRING_KERNEL_SSE2;
+	return SPRING_KERNEL_SCALAR;
+}
+
+const char* springKernelName(SpringKernelIsa isa)
+{
+	switch (isa) {
+	case SPRING_KERNEL_SSE2: return "SSE2";
+	case SPRING_KERNEL_AVX2: return "AVX2";
+	case SPRING_KERNEL_AVX512: return "AVX-512";
+	default: return "Scalar";
+	}
+}
+
+void addSpringForces(SpringKernelIsa isa, const SpringStore& springs, MassPointStore& points, Real damping, Real* elasticEnergy)
+{
+	addSpringForces(isa, springs, points, damping, 0, springs.size(), elasticEnergy);
+}
+
+void addSpringForces(SpringKernelIsa isa, const SpringStore& springs, MassPointStore& points, Real damping, int first, int last, Real* elasticEnergy)
+{
+	if (!isSpringKernelSupported(isa)) isa = bestSpringKernelIsa();
+
+	SpringKernelArgs g;
+	g.a = springs.point1.data();
+	g.b = springs.point2.data();
+	g.L = springs.restLength.data();
+	g.k = springs.stiffness.data();
+	g.px = points.px.data(); g.py = points.py.data(); g.pz = points.pz.data();
+	g.vx = points.vx.data(); g.vy = points.vy.data(); g.vz = points.vz.data();
+	g.damping = damping;
+
+	Real* fx = points.fx.data();
+	Real* fy = points.fy.data();
+	Real* fz = points.fz.data();
+	alignas(GP_SIMD_ALIGNMENT) Real sfx[BLOCK];
+	alignas(GP_SIMD_ALIGNMENT) Real sfy[BLOCK];
+	alignas(GP_SIMD_ALIGNMENT) Real sfz[BLOCK];
+	alignas(GP_SIMD_ALIGNMENT) Real sEnergy[BLOCK];
+	Real* se = elasticEnergy ? sEnergy : nullptr;
+	Real energy = 0;
+
+	for (int begin = first; begin < last; begin += BLOCK) {
+		const int end = std::min(begin + BLOCK, last);
+		switch (isa) {
+#ifdef GP_X86
+		case SPRING_KERNEL_AVX512: springBlockAVX512(g, begin, end, sfx, sfy, sfz, se); break;
+		case SPRING_KERNEL_AVX2: springBlockAVX2(g, begin, end, sfx, sfy, sfz, se); break;
+		case SPRING_KERNEL_SSE2: springBlockSSE2(g, begin, end, sfx, sfy, sfz, se); break;
+#endif
+		default: springBlockScalar(g, begin, end, sfx, sfy, sfz, se); break;
+		}
+
+		// scatter in spring order, identical for every instruction set
+		for (int s = begin; s < end; ++s) {
+			const int i = g.a[s];
+			const int j = g.b[s];
+			fx[i] += sfx[s - begin]; fy[i] += sfy[s - begin]; fz[i] += sfz[s - begin];
+			fx[j] -= sfx[s - begin]; fy[j] -= sfy[s - begin]; fz[j] -= sfz[s - begin];
+		}
+		if (se) {
+			for (int s = begin; s < end; ++s) energy += se[s - begin];
+		}
+	}
+	if (elasticEnergy) *elasticEnergy += energy;
+}
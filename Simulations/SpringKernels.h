@@ -0,0 +1,36 @@
+#ifndef SPRINGKERNELS_h
+#define SPRINGKERNELS_h
+
+#include "MassPointStore.h"
+#include "SpringStore.h"
+
+// Instruction sets of the spring force kernel. Real is double, so a vector
+// holds 2 (SSE2), 4 (AVX2) or 8 (AVX-512) springs.
+enum SpringKernelIsa {
+	SPRING_KERNEL_SCALAR,
+	SPRING_KERNEL_SSE2,
+	SPRING_KERNEL_AVX2,
+	SPRING_KERNEL_AVX512,
+};
+
+bool isSpringKernelSupported(SpringKernelIsa isa);
+// widest instruction set supported by this CPU and OS
+SpringKernelIsa bestSpringKernelIsa();
+const char* springKernelName(SpringKernelIsa isa);
+
+// Adds Hooke's law plus damping of the relative velocity along each spring
+// to the point forces:
+//   f_1 = -(k (|d| - L) + c (dv . d) / |d|) d / |d|,   f_2 = -f_1
+// Springs are processed in blocks: the vector code computes the per-spring
+// forces, which are then scattered in spring order. Every instruction set
+// uses the same operations in the same order without fused multiply-add,
+// so all of them match SPRING_KERNEL_SCALAR bit for bit; the scalar path
+// serves as the reference mode. Unsupported instruction sets fall back to
+// the best supported one.
+// If elasticEnergy is given, the spring potential sum 1/2 k (|d| - L)^2 is
+// added to it, computed in the same pass from the stretch the force uses.
+void addSpringForces(SpringKernelIsa isa, const SpringStore& springs, MassPointStore& points, Real damping, Real* elasticEnergy = nullptr);
+// same for springs [first, last) only
+void addSpringForces(SpringKernelIsa isa, const SpringStore& springs, MassPointStore& points, Real damping, int first, int last, Real* elasticEnergy = nullptr);
+
+#endif
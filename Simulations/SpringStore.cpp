@@ -0,0 +1,163 @@
+#include "SpringStore.h"
+
+#include <algorithm>
+
+SpringStore::SpringStore(SceneArena* arena)
+	: point1(ArenaAllocator<int>(arena, MEMORY_TAG_SPRINGS)), point2(ArenaAllocator<int>(arena, MEMORY_TAG_SPRINGS)),
+	  restLength(ArenaAllocator<Real>(arena, MEMORY_TAG_SPRINGS)), stiffness(ArenaAllocator<Real>(arena, MEMORY_TAG_SPRINGS))
+{
+}
+
+int SpringStore::add(int masspoint1, int masspoint2, Real initialLength, Real springStiffness)
+{
+	point1.push_back(masspoint1);
+	point2.push_back(masspoint2);
+	restLength.push_back(initialLength);
+	stiffness.push_back(springStiffness);
+	return size() - 1;
+}
+
+void SpringStore::reserve(int capacity)
+{
+	point1.reserve(capacity);
+	point2.reserve(capacity);
+	restLength.reserve(capacity);
+	stiffness.reserve(capacity);
+}
+
+void SpringStore::clear()
+{
+	point1.clear();
+	point2.clear();
+	restLength.clear();
+	stiffness.clear();
+}
+
+void SpringStore::release()
+{
+	*this = SpringStore(point1.get_allocator().arena);
+}
+
+void SpringStore::setStiffness(Real springStiffness)
+{
+	for (int s = 0; s < size(); ++s) stiffness[s] = springStiffness;
+}
+
+void SpringAdjacency::build(int numPoints, const SpringStore& store)
+{
+	const int m = store.size();
+
+	// counting pass
+	offsets.assign(numPoints + 1, 0);
+	for (int s = 0; s < m; ++s) {
+		offsets[store.point1[s] + 1]++;
+		offsets[store.point2[s] + 1]++;
+	}
+	for (int p = 0; p < numPoints; ++p) offsets[p + 1] += offsets[p];
+
+	// fill pass, keeps springs of each point in ascending order
+	springs.resize(2 * m);
+	neighbors.resize(2 * m);
+	sign.resize(2 * m);
+	std::vector<int> cursor(offsets.begin(), offsets.end() - 1);
+	for (int s = 0; s < m; ++s) {
+		const int i = store.point1[s];
+		const int j = store.point2[s];
+		int e = cursor[i]++;
+		springs[e] = s; neighbors[e] = j; sign[e] = 1;
+		e = cursor[j]++;
+		springs[e] = s; neighbors[e] = i; sign[e] = -1;
+	}
+}
+
+void SpringAdjacency::clear()
+{
+	offsets.clear();
+	springs.clear();
+	neighbors.clear();
+	sign.clear();
+}
+
+void SpringAdjacency::gatherForces(const RealArray& sfx, const RealArray& sfy, const RealArray& sfz, MassPointStore& points) const
+{
+	const int n = numPoints();
+	for (int p = 0; p < n; ++p) {
+		Real gx = 0, gy = 0, gz = 0;
+		for (int e = offsets[p]; e < offsets[p + 1]; ++e) {
+			const int s = springs[e];
+			gx += sign[e] * sfx[s];
+			gy += sign[e] * sfy[s];
+			gz += sign[e] * sfz[s];
+		}
+		points.fx[p] += gx;
+		points.fy[p] += gy;
+		points.fz[p] += gz;
+	}
+}
+
+template<class Array>
+static void permuteArray(Array& values, const std::vector<int>& order)
+{
+	std::vector<typename Array::value_type> old(values.begin(), values.end());
+	for (size_t k = 0; k < order.size(); ++k) values[k] = old[order[k]];
+}
+
+void SpringStore::permute(const std::vector<int>& order)
+{
+	permuteArray(point1, order);
+	permuteArray(point2, order);
+	permuteArray(restLength, order);
+	permuteArray(stiffness, order);
+}
+
+void SpringColoring::build(int numPoints, SpringStore& springs)
+{
+	const int m = springs.size();
+
+	// greedy needs at most 2 * maxDegree - 1 colours
+	std::vector<int> degree(numPoints, 0);
+	for (int s = 0; s < m; ++s) {
+		degree[springs.point1[s]]++;
+		degree[springs.point2[s]]++;
+	}
+	int maxDegree = 0;
+	for (int p = 0; p < numPoints; ++p) maxDegree = std::max(maxDegree, degree[p]);
+	const int words = std::max(1, (2 * maxDegree - 1 + 63) / 64);
+
+	// used[p * words ..] is a bitset of the colours already taken at point p
+	std::vector<unsigned long long> used((size_t)numPoints * words, 0);
+	std::vector<int> color(m);
+	int numColors = 0;
+	for (int s = 0; s < m; ++s) {
+		unsigned long long* a = &used[(size_t)springs.point1[s] * words];
+		unsigned long long* b = &used[(size_t)springs.point2[s] * words];
+		int c = 0;
+		for (int w = 0; w < words; ++w) {
+			unsigned long long free = ~(a[w] | b[w]);
+			if (free) {
+				c = w * 64;
+				while (!(free & 1)) { free >>= 1; c++; }
+				break;
+			}
+		}
+		a[c / 64] |= 1ull << (c % 64);
+		b[c / 64] |= 1ull << (c % 64);
+		color[s] = c;
+		numColors = std::max(numColors, c + 1);
+	}
+
+	// stable counting sort by colour
+	colorOffsets.assign(numColors + 1, 0);
+	for (int s = 0; s < m; ++s) colorOffsets[color[s] + 1]++;
+	for (int c = 0; c < numColors; ++c) colorOffsets[c + 1] += colorOffsets[c];
+	std::vector<int> order(m);
+	std::vector<int> cursor(colorOffsets.begin(), colorOffsets.end() - 1);
+	for (int s = 0; s < m; ++s) order[cursor[color[s]]++] = s;
+
+	springs.permute(order);
+}
+
+void SpringColoring::clear()
+{
+	colorOffsets.clear();
+}
@@ -0,0 +1,69 @@
+#ifndef SPRINGSTORE_h
+#define SPRINGSTORE_h
+
+#include <vector>
+#include "MassPointStore.h"
+
+// Springs stored as index pairs into a MassPointStore plus per-spring
+// rest length and stiffness. Holding indices instead of pointers keeps the
+// springs valid when points are relocated or reordered.
+class SpringStore {
+public:
+	explicit SpringStore(SceneArena* arena = nullptr);
+
+	ArenaVector<int> point1;
+	ArenaVector<int> point2;
+	RealArray restLength;
+	RealArray stiffness;
+
+	int add(int masspoint1, int masspoint2, Real initialLength, Real springStiffness);
+	void reserve(int capacity);
+	void clear();
+	// drops all storage; required before the owning arena is reset
+	void release();
+	int size() const { return (int)point1.size(); }
+
+	void setStiffness(Real springStiffness);
+	// reorders the springs so that new spring k is old spring order[k]
+	void permute(const std::vector<int>& order);
+};
+
+// Compressed sparse row adjacency from mass points to their incident springs.
+// The springs of point p are springs[offsets[p]] .. springs[offsets[p+1]-1],
+// neighbors[] holds the opposite end point of the same entry and sign[] is
+// +1 if p is point1 of that spring and -1 if it is point2, so that a
+// per-spring force buffer can be gathered as f_p = sum(sign * f_spring).
+class SpringAdjacency {
+public:
+	TaggedVector<int, MEMORY_TAG_TOPOLOGY> offsets;
+	TaggedVector<int, MEMORY_TAG_TOPOLOGY> springs;
+	TaggedVector<int, MEMORY_TAG_TOPOLOGY> neighbors;
+	TaggedVector<signed char, MEMORY_TAG_TOPOLOGY> sign;
+
+	void build(int numPoints, const SpringStore& store);
+	void clear();
+
+	int numPoints() const { return offsets.empty() ? 0 : (int)offsets.size() - 1; }
+	int degree(int p) const { return offsets[p + 1] - offsets[p]; }
+
+	// Gather-style accumulation of per-spring forces (indexed like the store)
+	// into the point forces. Every point is written exactly once.
+	void gatherForces(const RealArray& sfx, const RealArray& sfy, const RealArray& sfz, MassPointStore& points) const;
+};
+
+// Greedy edge colouring of the spring graph: no two springs of one colour
+// share a mass point, so the springs of a colour can be evaluated in
+// parallel without write conflicts. build() reorders the store so that the
+// springs of colour c are springs colorOffsets[c] .. colorOffsets[c+1]-1,
+// keeping their relative order within a colour.
+class SpringColoring {
+public:
+	TaggedVector<int, MEMORY_TAG_TOPOLOGY> colorOffsets;
+
+	void build(int numPoints, SpringStore& springs);
+	void clear();
+
+	int numColors() const { return colorOffsets.empty() ? 0 : (int)colorOffsets.size() - 1; }
+};
+
+#endif
@@ -0,0 +1,655 @@
+#include "StaticColliderSet.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <stdint.h>
+
+#include "util/vectorkernels.h"
+
+// smaller inputs are tested on the calling thread
+static const int MIN_POINTS_PER_CHUNK = 4096;
+// The grid stays coarse: a collider reaches few cells and a cell holds
+// runs of points long enough for the vector kernels.
+static const int COLLIDERS_PER_CELL = 2;
+static const int MAX_CELLS_PER_AXIS = 32;
+
+// fields of each shape in Columns::field
+enum {
+	PLANE_NX, PLANE_NY, PLANE_NZ, PLANE_OFFSET,
+};
+enum {
+	SPHERE_X, SPHERE_Y, SPHERE_Z, SPHERE_RADIUS,
+};
+enum {
+	BOX_LO_X, BOX_LO_Y, BOX_LO_Z, BOX_HI_X, BOX_HI_Y, BOX_HI_Z,
+};
+enum {
+	CAPSULE_X, CAPSULE_Y, CAPSULE_Z,    // a
+	CAPSULE_DX, CAPSULE_DY, CAPSULE_DZ, // b - a
+	CAPSULE_RADIUS,
+	CAPSULE_INV_LENGTH2,                // 1 / |b - a|^2, 0 for a sphere
+};
+
+static const int FIELDS[COLLIDER_SHAPE_COUNT] = { 4, 4, 6, 8 };
+
+// points [begin, end) of three coordinate arrays
+struct PointRun {
+	const Real* x; const Real* y; const Real* z;
+	int begin, end;
+};
+
+// Writes the indices of the points of the run that overlap the collider
+// with parameters v and returns how many there are. hits has room for the
+// whole run.
+typedef int (*HitKernel)(const PointRun& p, const Real* v, Real radius, int* hits);
+// Depth and normal of a point the kernel reported.
+typedef void (*ContactBuilder)(Real x, Real y, Real z, const Real* v, Real radius, ColliderContact& contact);
+
+// Scalar kernels. The vector kernels evaluate the same expressions in the
+// same order, so both find the same overlaps.
+
+static int planeHitsScalar(const PointRun& p, const Real* v, Real radius, int* hits)
+{
+	int count = 0;
+	for (int i = p.begin; i < p.end; ++i) {
+		const Real s = v[PLANE_NX] * p.x[i] + v[PLANE_NY] * p.y[i] + v[PLANE_NZ] * p.z[i] - v[PLANE_OFFSET];
+		hits[count] = i;
+		count += s < radius;
+	}
+	return count;
+}
+
+static int sphereHitsScalar(const PointRun& p, const Real* v, Real radius, int* hits)
+{
+	const Real reach = v[SPHERE_RADIUS] + radius;
+	const Real reach2 = reach * reach;
+	int count = 0;
+	for (int i = p.begin; i < p.end; ++i) {
+		const Real dx = p.x[i] - v[SPHERE_X];
+		const Real dy = p.y[i] - v[SPHERE_Y];
+		const Real dz = p.z[i] - v[SPHERE_Z];
+		hits[count] = i;
+		count += dx * dx + dy * dy + dz * dz < reach2;
+	}
+	return count;
+}
+
+static int boxHitsScalar(const PointRun& p, const Real* v, Real radius, int* hits)
+{
+	const Real radius2 = radius * radius;
+	int count = 0;
+	for (int i = p.begin; i < p.end; ++i) {
+		// offset from the closest point of the box, zero inside
+		const Real dx = p.x[i] - std::min(std::max(p.x[i], v[BOX_LO_X]), v[BOX_HI_X]);
+		const Real dy = p.y[i] - std::min(std::max(p.y[i], v[BOX_LO_Y]), v[BOX_HI_Y]);
+		const Real dz = p.z[i] - std::min(std::max(p.z[i], v[BOX_LO_Z]), v[BOX_HI_Z]);
+		hits[count] = i;
+		count += dx * dx + dy * dy + dz * dz < radius2;
+	}
+	return count;
+}
+
+static int capsuleHitsScalar(const PointRun& p, const Real* v, Real radius, int* hits)
+{
+	const Real reach = v[CAPSULE_RADIUS] + radius;
+	const Real reach2 = reach * reach;
+	int count = 0;
+	for (int i = p.begin; i < p.end; ++i) {
+		const Real ex = p.x[i] - v[CAPSULE_X];
+		const Real ey = p.y[i] - v[CAPSULE_Y];
+		const Real ez = p.z[i] - v[CAPSULE_Z];
+		// closest point of the segment at a + t (b - a)
+		Real t = (ex * v[CAPSULE_DX] + ey * v[CAPSULE_DY] + ez * v[CAPSULE_DZ]) * v[CAPSULE_INV_LENGTH2];
+		t = std::min(std::max(t, (Real)0), (Real)1);
+		const Real dx = ex - v[CAPSULE_DX] * t;
+		const Real dy = ey - v[CAPSULE_DY] * t;
+		const Real dz = ez - v[CAPSULE_DZ] * t;
+		hits[count] = i;
+		count += dx * dx + dy * dy + dz * dz < reach2;
+	}
+	return count;
+}
+
+#ifdef GP_X86
+
+// Indices of the set lanes of a comparison of points i .. i + 3, the lanes
+// past the end of the run dropped.
+static inline int appendLanes(int mask, int i, int end, int* hits, int count)
+{
+	if (end - i < 4) mask &= (1 << (end - i)) - 1;
+	for (int lane = 0; mask; ++lane, mask >>= 1) {
+		if (mask & 1) hits[count++] = i + lane;
+	}
+	return count;
+}
+
+// Four coordinates from i on; the last block of a run reads zeros past its
+// end instead of calling the scalar kernel, whose SSE code would pay for
+// the dirty upper halves of the AVX registers.
+GP_TARGET("avx2")
+static inline __m256d loadRun(const Real* a, int i, int end)
+{
+	if (end - i >= 4) return _mm256_loadu_pd(a + i);
+	const __m256i lanes = _mm256_cmpgt_epi64(_mm256_set1_epi64x(end - i), _mm256_setr_epi64x(0, 1, 2, 3));
+	return _mm256_maskload_pd(a + i, lanes);
+}
+
+GP_TARGET("avx2")
+static int planeHitsAVX2(const PointRun& p, const Real* v, Real radius, int* hits)
+{
+	const __m256d nx = _mm256_set1_pd(v[PLANE_NX]);
+	const __m256d ny = _mm256_set1_pd(v[PLANE_NY]);
+	const __m256d nz = _mm256_set1_pd(v[PLANE_NZ]);
+	const __m256d offset = _mm256_set1_pd(v[PLANE_OFFSET]);
+	const __m256d r = _mm256_set1_pd(radius);
+	int count = 0;
+	for (int i = p.begin; i < p.end; i += 4) {
+		const __m256d s = _mm256_sub_pd(_mm256_add_pd(_mm256_add_pd(
+			_mm256_mul_pd(nx, loadRun(p.x, i, p.end)),
+			_mm256_mul_pd(ny, loadRun(p.y, i, p.end))),
+			_mm256_mul_pd(nz, loadRun(p.z, i, p.end))), offset);
+		const int mask = _mm256_movemask_pd(_mm256_cmp_pd(s, r, _CMP_LT_OQ));
+		if (mask) count = appendLanes(mask, i, p.end, hits, count);
+	}
+	return count;
+}
+
+GP_TARGET("avx2")
+static inline __m256d distance2AVX2(__m256d dx, __m256d dy, __m256d dz)
+{
+	return _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(dx, dx), _mm256_mul_pd(dy, dy)), _mm256_mul_pd(dz, dz));
+}
+
+GP_TARGET("avx2")
+static int sphereHitsAVX2(const PointRun& p, const Real* v, Real radius, int* hits)
+{
+	const __m256d cx = _mm256_set1_pd(v[SPHERE_X]);
+	const __m256d cy = _mm256_set1_pd(v[SPHERE_Y]);
+	const __m256d cz = _mm256_set1_pd(v[SPHERE_Z]);
+	const Real reach = v[SPHERE_RADIUS] + radius;
+	const __m256d reach2 = _mm256_set1_pd(reach * reach);
+	int count = 0;
+	for (int i = p.begin; i < p.end; i += 4) {
+		const __m256d d2 = distance2AVX2(
+			_mm256_sub_pd(loadRun(p.x, i, p.end), cx),
+			_mm256_sub_pd(loadRun(p.y, i, p.end), cy),
+			_mm256_sub_pd(loadRun(p.z, i, p.end), cz));
+		const int mask = _mm256_movemask_pd(_mm256_cmp_pd(d2, reach2, _CMP_LT_OQ));
+		if (mask) count = appendLanes(mask, i, p.end, hits, count);
+	}
+	return count;
+}
+
+GP_TARGET("avx2")
+static int boxHitsAVX2(const PointRun& p, const Real* v, Real radius, int* hits)
+{
+	const __m256d lox = _mm256_set1_pd(v[BOX_LO_X]), hix = _mm256_set1_pd(v[BOX_HI_X]);
+	const __m256d loy = _mm256_set1_pd(v[BOX_LO_Y]), hiy = _mm256_set1_pd(v[BOX_HI_Y]);
+	const __m256d loz = _mm256_set1_pd(v[BOX_LO_Z]), hiz = _mm256_set1_pd(v[BOX_HI_Z]);
+	const __m256d radius2 = _mm256_set1_pd(radius * radius);
+	int count = 0;
+	for (int i = p.begin; i < p.end; i += 4) {
+		const __m256d x = loadRun(p.x, i, p.end);
+		const __m256d y = loadRun(p.y, i, p.end);
+		const __m256d z = loadRun(p.z, i, p.end);
+		const __m256d d2 = distance2AVX2(
+			_mm256_sub_pd(x, _mm256_min_pd(_mm256_max_pd(x, lox), hix)),
+			_mm256_sub_pd(y, _mm256_min_pd(_mm256_max_pd(y, loy), hiy)),
+			_mm256_sub_pd(z, _mm256_min_pd(_mm256_max_pd(z, loz), hiz)));
+		const int mask = _mm256_movemask_pd(_mm256_cmp_pd(d2, radius2, _CMP_LT_OQ));
+		if (mask) count = appendLanes(mask, i, p.end, hits, count);
+	}
+	return count;
+}
+
+GP_TARGET("avx2")
+static int capsuleHitsAVX2(const PointRun& p, const Real* v, Real radius, int* hits)
+{
+	const __m256d ax = _mm256_set1_pd(v[CAPSULE_X]);
+	const __m256d ay = _mm256_set1_pd(v[CAPSULE_Y]);
+	const __m256d az = _mm256_set1_pd(v[CAPSULE_Z]);
+	const __m256d dx = _mm256_set1_pd(v[CAPSULE_DX]);
+	const __m256d dy = _mm256_set1_pd(v[CAPSULE_DY]);
+	const __m256d dz = _mm256_set1_pd(v[CAPSULE_DZ]);
+	const __m256d invLength2 = _mm256_set1_pd(v[CAPSULE_INV_LENGTH2]);
+	const __m256d zero = _mm256_setzero_pd();
+	const __m256d one = _mm256_set1_pd(1);
+	const Real reach = v[CAPSULE_RADIUS] + radius;
+	const __m256d reach2 = _mm256_set1_pd(reach * reach);
+	int count = 0;
+	for (int i = p.begin; i < p.end; i += 4) {
+		const __m256d ex = _mm256_sub_pd(loadRun(p.x, i, p.end), ax);
+		const __m256d ey = _mm256_sub_pd(loadRun(p.y, i, p.end), ay);
+		const __m256d ez = _mm256_sub_pd(loadRun(p.z, i, p.end), az);
+		__m256d t = _mm256_mul_pd(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ex, dx), _mm256_mul_pd(ey, dy)), _mm256_mul_pd(ez, dz)), invLength2);
+		t = _mm256_min_pd(_mm256_max_pd(t, zero), one);
+		const __m256d d2 = distance2AVX2(
+			_mm256_sub_pd(ex, _mm256_mul_pd(dx, t)),
+			_mm256_sub_pd(ey, _mm256_mul_pd(dy, t)),
+			_mm256_sub_pd(ez, _mm256_mul_pd(dz, t)));
+		const int mask = _mm256_movemask_pd(_mm256_cmp_pd(d2, reach2, _CMP_LT_OQ));
+		if (mask) count = appendLanes(mask, i, p.end, hits, count);
+	}
+	return count;
+}
+
+static const HitKernel AVX2_KERNELS[COLLIDER_SHAPE_COUNT] = { planeHitsAVX2, sphereHitsAVX2, boxHitsAVX2, capsuleHitsAVX2 };
+
+#endif // GP_X86
+
+static const HitKernel SCALAR_KERNELS[COLLIDER_SHAPE_COUNT] = { planeHitsScalar, sphereHitsScalar, boxHitsScalar, capsuleHitsScalar };
+
+static HitKernel hitKernel(ColliderShape shape, bool avx2)
+{
+#ifdef GP_X86
+	if (avx2) return AVX2_KERNELS[shape];
+#endif
+	return SCALAR_KERNELS[shape];
+}
+
+// away from the closest point q, straight up if the point sits on it
+static void contactFrom(Real dx, Real dy, Real dz, Real reach, ColliderContact& contact)
+{
+	const Real distance = sqrt(dx * dx + dy * dy + dz * dz);
+	contact.depth = reach - distance;
+	if (distance > 0) {
+		contact.nx = dx / distance;
+		contact.ny = dy / distance;
+		contact.nz = dz / distance;
+	}
+	else {
+		contact.nx = 0;
+		contact.ny = 1;
+		contact.nz = 0;
+	}
+}
+
+static void planeContact(Real x, Real y, Real z, const Real* v, Real radius, ColliderContact& contact)
+{
+	contact.depth = radius - (v[PLANE_NX] * x + v[PLANE_NY] * y + v[PLANE_NZ] * z - v[PLANE_OFFSET]);
+	contact.nx = v[PLANE_NX];
+	contact.ny = v[PLANE_NY];
+	contact.nz = v[PLANE_NZ];
+}
+
+static void sphereContact(Real x, Real y, Real z, const Real* v, Real radius, ColliderContact& contact)
+{
+	contactFrom(x - v[SPHERE_X], y - v[SPHERE_Y], z - v[SPHERE_Z], v[SPHERE_RADIUS] + radius, contact);
+}
+
+static void boxContact(Real x, Real y, Real z, const Real* v, Real radius, ColliderContact& contact)
+{
+	const Real p[3] = { x, y, z };
+	Real d[3];
+	for (int k = 0; k < 3; ++k) d[k] = p[k] - std::min(std::max(p[k], v[BOX_LO_X + k]), v[BOX_HI_X + k]);
+	if (d[0] != 0 || d[1] != 0 || d[2] != 0) {
+		contactFrom(d[0], d[1], d[2], radius, contact);
+		return;
+	}
+	// the centre is inside, out through the nearest face
+	Real nearest = p[0] - v[BOX_LO_X];
+	int axis = 0;
+	Real side = -1;
+	for (int k = 0; k < 3; ++k) {
+		const Real below = p[k] - v[BOX_LO_X + k];
+		const Real above = v[BOX_HI_X + k] - p[k];
+		if (below < nearest) {
+			nearest = below;
+			axis = k;
+			side = -1;
+		}
+		if (above < nearest) {
+			nearest = above;
+			axis = k;
+			side = 1;
+		}
+	}
+	contact.depth = nearest + radius;
+	contact.nx = axis == 0 ? side : 0;
+	contact.ny = axis == 1 ? side : 0;
+	contact.nz = axis == 2 ? side : 0;
+}
+
+static void capsuleContact(Real x, Real y, Real z, const Real* v, Real radius, ColliderContact& contact)
+{
+	const Real ex = x - v[CAPSULE_X];
+	const Real ey = y - v[CAPSULE_Y];
+	const Real ez = z - v[CAPSULE_Z];
+	Real t = (ex * v[CAPSULE_DX] + ey * v[CAPSULE_DY] + ez * v[CAPSULE_DZ]) * v[CAPSULE_INV_LENGTH2];
+	t = std::min(std::max(t, (Real)0), (Real)1);
+	contactFrom(ex - v[CAPSULE_DX] * t, ey - v[CAPSULE_DY] * t, ez - v[CAPSULE_DZ] * t, v[CAPSULE_RADIUS] + radius, contact);
+}
+
+static const ContactBuilder CONTACT_BUILDERS[COLLIDER_SHAPE_COUNT] = { planeContact, sphereContact, boxContact, capsuleContact };
+
+// world space bounds of a bounded collider
+static void colliderBounds(ColliderShape shape, const StaticColliderSet::Columns& columns, int k, Real* lo, Real* hi)
+{
+	for (int a = 0; a < 3; ++a) {
+		switch (shape) {
+		case COLLIDER_SPHERE:
+			lo[a] = columns.field[SPHERE_X + a][k] - columns.field[SPHERE_RADIUS][k];
+			hi[a] = columns.field[SPHERE_X + a][k] + columns.field[SPHERE_RADIUS][k];
+			break;
+		case COLLIDER_BOX:
+			lo[a] = columns.field[BOX_LO_X + a][k];
+			hi[a] = columns.field[BOX_HI_X + a][k];
+			break;
+		default: {
+			const Real a0 = columns.field[CAPSULE_X + a][k];
+			const Real a1 = a0 + columns.field[CAPSULE_DX + a][k];
+			lo[a] = std::min(a0, a1) - columns.field[CAPSULE_RADIUS][k];
+			hi[a] = std::max(a0, a1) + columns.field[CAPSULE_RADIUS][k];
+		}
+		}
+	}
+}
+
+void StaticColliderSet::Columns::clear()
+{
+	for (auto& column : field) column.clear();
+	index.clear();
+}
+
+StaticColliderSet::StaticColliderSet()
+	: m_isDirty(true), m_margin(0)
+{
+	for (int k = 0; k < 3; ++k) {
+		m_lo[k] = 0;
+		m_invCellSize[k] = 0;
+		m_dims[k] = 0;
+	}
+}
+
+int StaticColliderSet::add(ColliderShape shape, const Real* values, int fields)
+{
+	Columns& columns = m_shapes[shape];
+	for (int f = 0; f < fields; ++f) columns.field[f].push_back(values[f]);
+	columns.index.push_back((int)columns.index.size());
+	m_isDirty = true;
+	return columns.index.back();
+}
+
+int StaticColliderSet::addPlane(const Vec3& normal, Real offset)
+{
+	const Vec3 n = normal / norm(normal);
+	const Real values[4] = { n.x, n.y, n.z, offset };
+	return add(COLLIDER_PLANE, values, 4);
+}
+
+int StaticColliderSet::addSphere(const Vec3& centre, Real radius)
+{
+	const Real values[4] = { centre.x, centre.y, centre.z, radius };
+	return add(COLLIDER_SPHERE, values, 4);
+}
+
+int StaticColliderSet::addBox(const Vec3& lo, const Vec3& hi)
+{
+	const Real values[6] = { lo.x, lo.y, lo.z, hi.x, hi.y, hi.z };
+	return add(COLLIDER_BOX, values, 6);
+}
+
+int StaticColliderSet::addCapsule(const Vec3& a, const Vec3& b, Real radius)
+{
+	const Vec3 d = b - a;
+	const Real length2 = normNoSqrt(d);
+	const Real values[8] = { a.x, a.y, a.z, d.x, d.y, d.z, radius, length2 > 0 ? 1 / length2 : 0 };
+	return add(COLLIDER_CAPSULE, values, 8);
+}
+
+void StaticColliderSet::clear()
+{
+	for (int s = 0; s < COLLIDER_SHAPE_COUNT; ++s) {
+		m_shapes[s].clear();
+		m_cells[s].clear();
+		m_cellStart[s].clear();
+	}
+	m_isDirty = true;
+}
+
+bool StaticColliderSet::empty() const
+{
+	for (int s = 0; s < COLLIDER_SHAPE_COUNT; ++s) {
+		if (!m_shapes[s].index.empty()) return false;
+	}
+	return true;
+}
+
+// cells [first, last] per axis that the box reaches, clamped to the grid
+void StaticColliderSet::cellRange(const Real* lo, const Real* hi, int* first, int* last) const
+{
+	for (int a = 0; a < 3; ++a) {
+		// clamped first, so truncating is flooring
+		const Real f = (lo[a] - m_lo[a]) * m_invCellSize[a];
+		const Real l = (hi[a] - m_lo[a]) * m_invCellSize[a];
+		first[a] = (int)std::min(std::max(f, (Real)0), (Real)(m_dims[a] - 1));
+		last[a] = (int)std::min(std::max(l, (Real)0), (Real)(m_dims[a] - 1));
+	}
+}
+
+// Cells of the volume of COLLIDERS_PER_CELL colliders, at most
+// MAX_CELLS_PER_AXIS along each axis, over the bounds grown by the margin.
+// Every bounded collider is copied into each cell its grown bounds reach,
+// so a point within the margin of it is always in one of them.
+void StaticColliderSet::build(Real margin)
+{
+	m_margin = margin;
+	m_isDirty = false;
+	int bounded = 0;
+	Real lo[3], hi[3], boundsLo[3], boundsHi[3];
+	for (int k = 0; k < 3; ++k) {
+		boundsLo[k] = std::numeric_limits<Real>::max();
+		boundsHi[k] = -std::numeric_limits<Real>::max();
+	}
+	for (int s = COLLIDER_SPHERE; s < COLLIDER_SHAPE_COUNT; ++s) {
+		for (int k = 0; k < count((ColliderShape)s); ++k) {
+			colliderBounds((ColliderShape)s, m_shapes[s], k, lo, hi);
+			for (int a = 0; a < 3; ++a) {
+				boundsLo[a] = std::min(boundsLo[a], lo[a] - margin);
+				boundsHi[a] = std::max(boundsHi[a], hi[a] + margin);
+			}
+			bounded++;
+		}
+	}
+	if (bounded == 0) {
+		for (int a = 0; a < 3; ++a) m_dims[a] = 0;
+		return;
+	}
+
+	Real volume = 1;
+	for (int a = 0; a < 3; ++a) volume *= std::max(boundsHi[a] - boundsLo[a], margin);
+	const Real cellSize = std::cbrt(volume * COLLIDERS_PER_CELL / bounded);
+	for (int a = 0; a < 3; ++a) {
+		const Real extent = boundsHi[a] - boundsLo[a];
+		m_lo[a] = boundsLo[a];
+		m_dims[a] = cellSize > 0 ? (int)std::min(std::max(std::ceil(extent / cellSize), (Real)1), (Real)MAX_CELLS_PER_AXIS) : 1;
+		m_invCellSize[a] = extent > 0 ? m_dims[a] / extent : 0;
+	}
+
+	// count the copies per cell, then place them with a cursor per cell
+	const int cells = numCells();
+	int first[3], last[3];
+	for (int s = COLLIDER_SPHERE; s < COLLIDER_SHAPE_COUNT; ++s) {
+		const Columns& source = m_shapes[s];
+		Columns& target = m_cells[s];
+		TaggedVector<int, MEMORY_TAG_COLLISION>& start = m_cellStart[s];
+		start.assign(cells + 1, 0);
+		for (int pass = 0; pass < 2; ++pass) {
+			for (int k = 0; k < count((ColliderShape)s); ++k) {
+				colliderBounds((ColliderShape)s, source, k, lo, hi);
+				for (int a = 0; a < 3; ++a) {
+					lo[a] -= margin;
+					hi[a] += margin;
+				}
+				cellRange(lo, hi, first, last);
+				for (int z = first[2]; z <= last[2]; ++z) {
+					for (int y = first[1]; y <= last[1]; ++y) {
+						for (int x = first[0]; x <= last[0]; ++x) {
+							const int cell = (z * m_dims[1] + y) * m_dims[0] + x;
+							if (pass == 0) {
+								start[cell + 1]++;
+								continue;
+							}
+							const int slot = m_cursor[cell]++;
+							for (int f = 0; f < FIELDS[s]; ++f) target.field[f][slot] = source.field[f][k];
+							target.index[slot] = k;
+						}
+					}
+				}
+			}
+			if (pass == 0) {
+				for (int c = 0; c < cells; ++c) start[c + 1] += start[c];
+				for (int f = 0; f < FIELDS[s]; ++f) target.field[f].resize(start[cells]);
+				target.index.resize(start[cells]);
+				m_cursor.assign(start.begin(), start.end() - 1);
+			}
+		}
+	}
+}
+
+// Counting sort of the points by cell, stable so that the points of a cell
+// stay in index order. Points outside the grid are out of reach of every
+// bounded collider. Truncation puts points up to a cell outside the lower
+// faces into the first cells, which only costs them a few more tests.
+void StaticColliderSet::sortPoints(const Real* px, const Real* py, const Real* pz, int n)
+{
+	const int cells = numCells();
+	m_pointCell.resize(n);
+	m_pointStart.assign(cells + 1, 0);
+	const Real dims[3] = { (Real)m_dims[0], (Real)m_dims[1], (Real)m_dims[2] };
+	int* pointCell = m_pointCell.data();
+	int* pointStart = m_pointStart.data();
+	for (int i = 0; i < n; ++i) {
+		const Real x = (px[i] - m_lo[0]) * m_invCellSize[0];
+		const Real y = (py[i] - m_lo[1]) * m_invCellSize[1];
+		const Real z = (pz[i] - m_lo[2]) * m_invCellSize[2];
+		// also catches NaN
+		const bool isInside = x > -1 && x < dims[0] && y > -1 && y < dims[1] && z > -1 && z < dims[2];
+		const int cell = isInside ? ((int)z * m_dims[1] + (int)y) * m_dims[0] + (int)x : -1;
+		pointCell[i] = cell;
+		if (isInside) pointStart[cell + 1]++;
+	}
+	for (int c = 0; c < cells; ++c) m_pointStart[c + 1] += m_pointStart[c];
+	const int inside = m_pointStart[cells];
+	m_sx.resize(inside);
+	m_sy.resize(inside);
+	m_sz.resize(inside);
+	m_sortedIndex.resize(inside);
+	m_cursor.assign(m_pointStart.begin(), m_pointStart.end() - 1);
+	int* cursor = m_cursor.data();
+	for (int i = 0; i < n; ++i) {
+		if (pointCell[i] < 0) continue;
+		const int slot = cursor[pointCell[i]]++;
+		m_sx[slot] = px[i];
+		m_sy[slot] = py[i];
+		m_sz[slot] = pz[i];
+		m_sortedIndex[slot] = i;
+	}
+}
+
+void StaticColliderSet::resizeChunks(int chunks, int hits)
+{
+	if ((int)m_chunkContacts.size() < chunks) {
+		m_chunkContacts.resize(chunks);
+		m_chunkHits.resize(chunks);
+	}
+	for (int c = 0; c < chunks; ++c) {
+		if ((int)m_chunkHits[c].size() < hits) m_chunkHits[c].resize(hits);
+	}
+}
+
+void StaticColliderSet::appendChunks(int chunks, ColliderContactList& contacts)
+{
+	for (int c = 0; c < chunks; ++c) contacts.insert(contacts.end(), m_chunkContacts[c].begin(), m_chunkContacts[c].end());
+}
+
+// One pass per plane over all points in index order.
+void StaticColliderSet::testPlanes(const Real* px, const Real* py, const Real* pz, int n, Real radius, ThreadPool& pool, bool avx2, ColliderContactList& contacts)
+{
+	const HitKernel kernel = hitKernel(COLLIDER_PLANE, avx2);
+	const Columns& planes = m_shapes[COLLIDER_PLANE];
+	const int chunks = std::max(1, std::min(pool.threadCount(), n / MIN_POINTS_PER_CHUNK));
+	resizeChunks(chunks, (n + chunks - 1) / chunks);
+	for (int k = 0; k < count(COLLIDER_PLANE); ++k) {
+		Real v[4];
+		for (int f = 0; f < 4; ++f) v[f] = planes.field[f][k];
+		pool.parallelFor(0, chunks, 1, [&](int firstChunk, int lastChunk) {
+			for (int c = firstChunk; c < lastChunk; ++c) {
+				ColliderContactList& list = m_chunkContacts[c];
+				list.clear();
+				const PointRun run = { px, py, pz, (int)((int64_t)n * c / chunks), (int)((int64_t)n * (c + 1) / chunks) };
+				int* hits = m_chunkHits[c].data();
+				const int found = kernel(run, v, radius, hits);
+				for (int h = 0; h < found; ++h) {
+					const int i = hits[h];
+					ColliderContact contact;
+					contact.point = i;
+					contact.shape = COLLIDER_PLANE;
+					contact.collider = k;
+					planeContact(px[i], py[i], pz[i], v, radius, contact);
+					list.push_back(contact);
+				}
+			}
+		});
+		appendChunks(chunks, contacts);
+	}
+}
+
+// Every collider of a cell against the run of points sorted into it. The
+// chunks are runs of cells with about the same number of points.
+void StaticColliderSet::testCells(ColliderShape shape, Real radius, ThreadPool& pool, bool avx2, ColliderContactList& contacts)
+{
+	const HitKernel kernel = hitKernel(shape, avx2);
+	const ContactBuilder builder = CONTACT_BUILDERS[shape];
+	const Columns& colliders = m_cells[shape];
+	const TaggedVector<int, MEMORY_TAG_COLLISION>& colliderStart = m_cellStart[shape];
+	const int cells = numCells();
+	const int inside = m_pointStart[cells];
+	const int chunks = std::max(1, std::min(pool.threadCount(), inside / MIN_POINTS_PER_CHUNK));
+	int largest = 0;
+	for (int c = 0; c < cells; ++c) largest = std::max(largest, m_pointStart[c + 1] - m_pointStart[c]);
+	resizeChunks(chunks, largest);
+	const int fields = FIELDS[shape];
+	pool.parallelFor(0, chunks, 1, [&](int firstChunk, int lastChunk) {
+		for (int c = firstChunk; c < lastChunk; ++c) {
+			ColliderContactList& list = m_chunkContacts[c];
+			list.clear();
+			const int* pointStart = m_pointStart.data();
+			const int firstCell = (int)(std::lower_bound(pointStart, pointStart + cells, (int)((int64_t)inside * c / chunks)) - pointStart);
+			const int lastCell = c + 1 == chunks ? cells : (int)(std::lower_bound(pointStart, pointStart + cells, (int)((int64_t)inside * (c + 1) / chunks)) - pointStart);
+			int* hits = m_chunkHits[c].data();
+			for (int cell = firstCell; cell < lastCell; ++cell) {
+				const PointRun run = { m_sx.data(), m_sy.data(), m_sz.data(), pointStart[cell], pointStart[cell + 1] };
+				if (run.begin == run.end) continue;
+				for (int k = colliderStart[cell]; k < colliderStart[cell + 1]; ++k) {
+					Real v[8];
+					for (int f = 0; f < fields; ++f) v[f] = colliders.field[f][k];
+					const int found = kernel(run, v, radius, hits);
+					for (int h = 0; h < found; ++h) {
+						const int slot = hits[h];
+						ColliderContact contact;
+						contact.point = m_sortedIndex[slot];
+						contact.shape = shape;
+						contact.collider = colliders.index[k];
+						builder(m_sx[slot], m_sy[slot], m_sz[slot], v, radius, contact);
+						list.push_back(contact);
+					}
+				}
+			}
+		}
+	});
+	appendChunks(chunks, contacts);
+}
+
+void StaticColliderSet::findContacts(const Real* px, const Real* py, const Real* pz, int n, Real radius, ThreadPool& pool, ColliderContactList& contacts, bool vectorised)
+{
+	contacts.clear();
+	const bool avx2 = vectorised && cpuFeatures().avx2;
+	if (m_isDirty || radius != m_margin) build(radius);
+	testPlanes(px, py, pz, n, radius, pool, avx2, contacts);
+	if (numCells() == 0) return;
+	sortPoints(px, py, pz, n);
+	for (int s = COLLIDER_SPHERE; s < COLLIDER_SHAPE_COUNT; ++s) {
+		if (count((ColliderShape)s) > 0) testCells((ColliderShape)s, radius, pool, avx2, contacts);
+	}
+}
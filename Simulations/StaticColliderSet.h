@@ -0,0 +1,105 @@
+#ifndef STATICCOLLIDERSET_h
+#define STATICCOLLIDERSET_h
+
+#include <vector>
+#include "util/vectorbase.h"
+#include "util/memorytags.h"
+#include "util/threadpool.h"
+
+using namespace GamePhysics;
+
+enum ColliderShape {
+	COLLIDER_PLANE,
+	COLLIDER_SPHERE,
+	COLLIDER_BOX,
+	COLLIDER_CAPSULE,
+	COLLIDER_SHAPE_COUNT
+};
+
+// A point overlapping a collider: moving it depth along the normal puts it
+// on the surface.
+struct ColliderContact {
+	int point;
+	int shape;    // ColliderShape
+	int collider; // index among the colliders of that shape, in the order added
+	Real depth;
+	Real nx, ny, nz;
+};
+
+typedef TaggedVector<ColliderContact, MEMORY_TAG_COLLISION> ColliderContactList;
+
+// Many static obstacles against many points, without a virtual call or a
+// switch per pair. Every shape type keeps its parameters in one array per
+// field and is tested in its own pass with a kernel that compares one
+// collider against a run of points, four at a time with AVX2; only the
+// overlapping lanes build a contact. Planes are unbounded and see every
+// point. Spheres, boxes and capsules are registered in the cells of a
+// coarse uniform grid over their bounds, and the points are sorted into the
+// same cells, so a collider only meets the points of the cells it reaches.
+//
+// Contacts go to one flat list, per shape type in the order planes,
+// spheres, boxes, capsules; within a type the order only depends on the
+// positions, not on the thread count. The grid is rebuilt when colliders
+// are added or the radius changes; storage only grows, so a steady scene
+// does not allocate.
+class StaticColliderSet {
+public:
+	StaticColliderSet();
+
+	// dot(normal, x) >= offset is free space; the normal is normalised
+	int addPlane(const Vec3& normal, Real offset);
+	int addSphere(const Vec3& centre, Real radius);
+	// axis aligned
+	int addBox(const Vec3& lo, const Vec3& hi);
+	// the points within radius of the segment from a to b
+	int addCapsule(const Vec3& a, const Vec3& b, Real radius);
+	void clear();
+	bool empty() const;
+	int count(ColliderShape shape) const { return (int)m_shapes[shape].index.size(); }
+
+	// Replaces contacts with every overlap of a sphere of the given radius
+	// around the n points with a collider. vectorised = false runs the
+	// scalar kernels, which find the same contacts.
+	void findContacts(const Real* px, const Real* py, const Real* pz, int n, Real radius, ThreadPool& pool, ColliderContactList& contacts, bool vectorised = true);
+
+	// cells of the grid as last built, 0 without bounded colliders
+	int numCells() const { return m_dims[0] * m_dims[1] * m_dims[2]; }
+
+	// parameters of one shape type, one array per field
+	struct Columns {
+		TaggedVector<Real, MEMORY_TAG_COLLISION> field[8];
+		TaggedVector<int, MEMORY_TAG_COLLISION> index;
+		void clear();
+	};
+
+private:
+	int add(ColliderShape shape, const Real* values, int fields);
+	void build(Real margin);
+	void cellRange(const Real* lo, const Real* hi, int* first, int* last) const;
+	void sortPoints(const Real* px, const Real* py, const Real* pz, int n);
+	void testPlanes(const Real* px, const Real* py, const Real* pz, int n, Real radius, ThreadPool& pool, bool avx2, ColliderContactList& contacts);
+	void testCells(ColliderShape shape, Real radius, ThreadPool& pool, bool avx2, ColliderContactList& contacts);
+	void resizeChunks(int chunks, int hits);
+	void appendChunks(int chunks, ColliderContactList& contacts);
+
+	Columns m_shapes[COLLIDER_SHAPE_COUNT]; // as added
+	Columns m_cells[COLLIDER_SHAPE_COUNT];  // bounded shapes copied into every cell they reach, in cell order
+	TaggedVector<int, MEMORY_TAG_COLLISION> m_cellStart[COLLIDER_SHAPE_COUNT]; // numCells() + 1 offsets into m_cells
+	bool m_isDirty;
+	Real m_margin;
+	Real m_lo[3];
+	Real m_invCellSize[3];
+	int m_dims[3];
+
+	// the points in cell order
+	TaggedVector<int, MEMORY_TAG_COLLISION> m_pointCell;  // by index, -1 outside the grid
+	TaggedVector<int, MEMORY_TAG_COLLISION> m_pointStart; // numCells() + 1 offsets
+	TaggedVector<Real, MEMORY_TAG_COLLISION> m_sx, m_sy, m_sz;
+	TaggedVector<int, MEMORY_TAG_COLLISION> m_sortedIndex;
+	TaggedVector<int, MEMORY_TAG_COLLISION> m_cursor; // next free slot per cell while sorting
+
+	std::vector<ColliderContactList> m_chunkContacts;
+	std::vector<TaggedVector<int, MEMORY_TAG_COLLISION>> m_chunkHits;
+};
+
+#endif
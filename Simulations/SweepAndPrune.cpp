@@ -0,0 +1,367 @@
+#include "SweepAndPrune.h"
+
+#include <algorithm>
+
+// adding more than total / REBUILD_FRACTION proxies in one update sorts from scratch
+static const int REBUILD_FRACTION = 8;
+static const int MIN_TABLE_SIZE = 64;
+
+static uint64_t pairKey(int a, int b)
+{
+	return ((uint64_t)(uint32_t)a << 32) | (uint32_t)b;
+}
+
+// Fibonacci hashing, folded so small tables see the high bits too
+static size_t homeSlot(uint64_t key, size_t mask)
+{
+	const uint64_t h = key * 0x9E3779B97F4A7C15ull;
+	return (size_t)(h ^ (h >> 32)) & mask;
+}
+
+static bool isUpper(const SweepEndpoint& e)
+{
+	return (e.data & 1) != 0;
+}
+
+// Sort order of the endpoints: by value, lower before upper bounds at equal
+// values, so boxes that touch count as overlapping.
+static bool comesBefore(const SweepEndpoint& a, const SweepEndpoint& b)
+{
+	return a.value < b.value || (a.value == b.value && !isUpper(a) && isUpper(b));
+}
+
+static bool pairLess(const ProxyPair& x, const ProxyPair& y)
+{
+	return x.a < y.a || (x.a == y.a && x.b < y.b);
+}
+
+static bool pairEqual(const ProxyPair& x, const ProxyPair& y)
+{
+	return x.a == y.a && x.b == y.b;
+}
+
+SweepAndPrune::SweepAndPrune()
+	: m_iProxies(0), m_iNewProxies(0), m_iSwaps(0), m_bRebuilt(false)
+{
+}
+
+int SweepAndPrune::addProxy(const Real lo[3], const Real hi[3])
+{
+	int proxy;
+	if (m_freeHandles.empty()) {
+		proxy = (int)m_boxes.size();
+		m_boxes.push_back(Box());
+		m_alive.push_back(0);
+	}
+	else {
+		proxy = m_freeHandles.back();
+		m_freeHandles.pop_back();
+	}
+	m_alive[proxy] = 1;
+	setBox(proxy, lo, hi);
+	// appended after all others, the next insertion sort moves them into place
+	for (int k = 0; k < 3; ++k) {
+		const SweepEndpoint lower = { lo[k], proxy << 1 };
+		const SweepEndpoint upper = { hi[k], (proxy << 1) | 1 };
+		m_axes[k].push_back(lower);
+		m_axes[k].push_back(upper);
+	}
+	m_iProxies++;
+	m_iNewProxies++;
+	return proxy;
+}
+
+void SweepAndPrune::removeProxy(int proxy)
+{
+	for (int k = 0; k < 3; ++k) {
+		TaggedVector<SweepEndpoint, MEMORY_TAG_COLLISION>& axis = m_axes[k];
+		axis.erase(std::remove_if(axis.begin(), axis.end(), [proxy](const SweepEndpoint& e) { return e.data >> 1 == proxy; }), axis.end());
+	}
+	// backwards, removePair() moves the last pair into the freed place
+	for (int i = (int)m_pairs.size() - 1; i >= 0; --i) {
+		const ProxyPair pair = m_pairs[i];
+		if (pair.a != proxy && pair.b != proxy) continue;
+		removePair(pair.a, pair.b);
+		m_removed.pop_back();
+		m_pendingRemoved.push_back(pair);
+	}
+	m_alive[proxy] = 0;
+	m_releasedHandles.push_back(proxy);
+	m_iProxies--;
+}
+
+void SweepAndPrune::setBox(int proxy, const Real lo[3], const Real hi[3])
+{
+	Box& box = m_boxes[proxy];
+	for (int k = 0; k < 3; ++k) {
+		box.lo[k] = lo[k];
+		box.hi[k] = hi[k];
+	}
+}
+
+void SweepAndPrune::update()
+{
+	m_added.clear();
+	m_removed.assign(m_pendingRemoved.begin(), m_pendingRemoved.end());
+	m_pendingRemoved.clear();
+	m_iSwaps = 0;
+	m_bRebuilt = m_iNewProxies * REBUILD_FRACTION > m_iProxies;
+	if (m_bRebuilt) {
+		rebuild();
+	}
+	else {
+		for (int k = 0; k < 3; ++k) sortAxis(k);
+	}
+	netEvents();
+	m_iNewProxies = 0;
+	m_freeHandles.insert(m_freeHandles.end(), m_releasedHandles.begin(), m_releasedHandles.end());
+	m_releasedHandles.clear();
+}
+
+bool SweepAndPrune::overlaps(int a, int b) const
+{
+	const Box& x = m_boxes[a];
+	const Box& y = m_boxes[b];
+	return x.lo[0] <= y.hi[0] && y.lo[0] <= x.hi[0]
+		&& x.lo[1] <= y.hi[1] && y.lo[1] <= x.hi[1]
+		&& x.lo[2] <= y.hi[2] && y.lo[2] <= x.hi[2];
+}
+
+// Insertion sort of one axis after the boxes moved. An endpoint moving
+// down past another is the only way two intervals change from overlapping
+// to disjoint or back on this axis: a lower bound passing an upper one may
+// start an overlap, which the other axes confirm, an upper bound passing a
+// lower one ends it.
+void SweepAndPrune::sortAxis(int axis)
+{
+	SweepEndpoint* e = m_axes[axis].data();
+	const int n = (int)m_axes[axis].size();
+	for (int i = 0; i < n; ++i) {
+		const Box& box = m_boxes[e[i].data >> 1];
+		e[i].value = isUpper(e[i]) ? box.hi[axis] : box.lo[axis];
+	}
+	for (int i = 1; i < n; ++i) {
+		const SweepEndpoint moving = e[i];
+		const int proxy = moving.data >> 1;
+		int j = i;
+		while (j > 0 && comesBefore(moving, e[j - 1])) {
+			const SweepEndpoint& other = e[j - 1];
+			if (!isUpper(moving) && isUpper(other)) {
+				if (overlaps(proxy, other.data >> 1)) addPair(proxy, other.data >> 1);
+			}
+			else if (isUpper(moving) && !isUpper(other)) {
+				removePair(proxy, other.data >> 1);
+			}
+			e[j] = other;
+			--j;
+		}
+		m_iSwaps += i - j;
+		e[j] = moving;
+	}
+}
+
+// Sorts every axis from scratch and finds the pairs by sweeping the axis
+// along which the box centres spread most: each lower bound is tested
+// against the lower bounds between it and its own upper bound. The events
+// are the difference to the previous set.
+void SweepAndPrune::rebuild()
+{
+	Real sum[3] = { 0, 0, 0 }, sumSquares[3] = { 0, 0, 0 };
+	for (int p = 0; p < (int)m_boxes.size(); ++p) {
+		if (!m_alive[p]) continue;
+		for (int k = 0; k < 3; ++k) {
+			const Real centre = (m_boxes[p].lo[k] + m_boxes[p].hi[k]) / 2;
+			sum[k] += centre;
+			sumSquares[k] += centre * centre;
+		}
+	}
+	int sweepAxis = 0;
+	Real maxVariance = -1;
+	for (int k = 0; k < 3; ++k) {
+		const Real variance = sumSquares[k] - sum[k] * sum[k] / std::max(m_iProxies, 1);
+		if (variance > maxVariance) {
+			maxVariance = variance;
+			sweepAxis = k;
+		}
+	}
+
+	for (int k = 0; k < 3; ++k) {
+		TaggedVector<SweepEndpoint, MEMORY_TAG_COLLISION>& axis = m_axes[k];
+		for (SweepEndpoint& e : axis) {
+			const Box& box = m_boxes[e.data >> 1];
+			e.value = isUpper(e) ? box.hi[k] : box.lo[k];
+		}
+		// ties broken by the handle, so the order does not depend on the history
+		std::sort(axis.begin(), axis.end(), [](const SweepEndpoint& a, const SweepEndpoint& b) {
+			return comesBefore(a, b) || (!comesBefore(b, a) && a.data < b.data);
+		});
+	}
+
+	m_scratch.assign(m_pairs.begin(), m_pairs.end());
+	std::sort(m_scratch.begin(), m_scratch.end(), pairLess);
+	m_pairs.clear();
+	const SweepEndpoint* e = m_axes[sweepAxis].data();
+	const int n = (int)m_axes[sweepAxis].size();
+	for (int i = 0; i < n; ++i) {
+		if (isUpper(e[i])) continue;
+		const int p = e[i].data >> 1;
+		for (int j = i + 1; e[j].data != (e[i].data | 1); ++j) {
+			const int q = e[j].data >> 1;
+			if (isUpper(e[j]) || !overlaps(p, q)) continue;
+			const ProxyPair pair = { std::min(p, q), std::max(p, q) };
+			m_pairs.push_back(pair);
+		}
+	}
+	std::sort(m_pairs.begin(), m_pairs.end(), pairLess);
+
+	// sized for the new set, the capacity stays
+	m_keys.clear();
+	growTable();
+
+	// merge the sorted old and new sets
+	size_t i = 0, j = 0;
+	while (i < m_scratch.size() || j < m_pairs.size()) {
+		if (j == m_pairs.size() || (i < m_scratch.size() && pairLess(m_scratch[i], m_pairs[j]))) {
+			m_removed.push_back(m_scratch[i++]);
+		}
+		else if (i == m_scratch.size() || pairLess(m_pairs[j], m_scratch[i])) {
+			m_added.push_back(m_pairs[j++]);
+		}
+		else {
+			++i;
+			++j;
+		}
+	}
+}
+
+void SweepAndPrune::addPair(int a, int b)
+{
+	if (a > b) std::swap(a, b);
+	const uint64_t key = pairKey(a, b);
+	if (findSlot(key) >= 0) return;
+	const ProxyPair pair = { a, b };
+	growTable();
+	m_pairs.push_back(pair);
+	insertKey(key, (int)m_pairs.size() - 1);
+	m_added.push_back(pair);
+}
+
+void SweepAndPrune::removePair(int a, int b)
+{
+	if (a > b) std::swap(a, b);
+	const int slot = findSlot(pairKey(a, b));
+	if (slot < 0) return;
+	const int index = m_indices[slot];
+	const ProxyPair removed = m_pairs[index];
+	eraseSlot(slot);
+	const ProxyPair last = m_pairs.back();
+	m_pairs.pop_back();
+	if (index < (int)m_pairs.size()) {
+		m_pairs[index] = last;
+		m_indices[findSlot(pairKey(last.a, last.b))] = index;
+	}
+	m_removed.push_back(removed);
+}
+
+bool SweepAndPrune::isPair(int a, int b) const
+{
+	if (a > b) std::swap(a, b);
+	return findSlot(pairKey(a, b)) >= 0;
+}
+
+int SweepAndPrune::findSlot(uint64_t key) const
+{
+	if (m_keys.empty()) return -1;
+	const size_t mask = m_keys.size() - 1;
+	for (size_t s = homeSlot(key, mask);; s = (s + 1) & mask) {
+		if (m_keys[s] == key) return (int)s;
+		if (!m_keys[s]) return -1;
+	}
+}
+
+void SweepAndPrune::insertKey(uint64_t key, int index)
+{
+	const size_t mask = m_keys.size() - 1;
+	size_t s = homeSlot(key, mask);
+	while (m_keys[s]) s = (s + 1) & mask;
+	m_keys[s] = key;
+	m_indices[s] = index;
+}
+
+// Backward shift deletion: later entries of the probe run move up into the
+// hole unless that would put them before their home slot.
+void SweepAndPrune::eraseSlot(int slot)
+{
+	const size_t mask = m_keys.size() - 1;
+	size_t hole = (size_t)slot;
+	for (size_t s = (hole + 1) & mask; m_keys[s]; s = (s + 1) & mask) {
+		const size_t home = homeSlot(m_keys[s], mask);
+		// distance from home to s covers the hole, so the entry may move there
+		if (((s - home) & mask) >= ((s - hole) & mask)) {
+			m_keys[hole] = m_keys[s];
+			m_indices[hole] = m_indices[s];
+			hole = s;
+		}
+	}
+	m_keys[hole] = 0;
+}
+
+// makes room for one more pair at most half the table full, rehashing the
+// pairs when the table grows
+void SweepAndPrune::growTable()
+{
+	size_t size = std::max(m_keys.size(), (size_t)MIN_TABLE_SIZE);
+	while (2 * (m_pairs.size() + 1) > size) size *= 2;
+	if (size == m_keys.size()) return;
+	m_keys.assign(size, 0);
+	m_indices.resize(size);
+	for (int i = 0; i < (int)m_pairs.size(); ++i) insertKey(pairKey(m_pairs[i].a, m_pairs[i].b), i);
+}
+
+// A pair may be added on one axis and removed on another within an update.
+// Per pair the events alternate, so the surplus of either kind is the net
+// change; both lists end up sorted.
+void SweepAndPrune::netEvents()
+{
+	std::sort(m_added.begin(), m_added.end(), pairLess);
+	std::sort(m_removed.begin(), m_removed.end(), pairLess);
+	size_t i = 0, j = 0, added = 0, removed = 0;
+	while (i < m_added.size() || j < m_removed.size()) {
+		ProxyPair pair;
+		if (j == m_removed.size() || (i < m_added.size() && !pairLess(m_removed[j], m_added[i]))) pair = m_added[i];
+		else pair = m_removed[j];
+		int surplus = 0;
+		while (i < m_added.size() && pairEqual(m_added[i], pair)) {
+			++i;
+			++surplus;
+		}
+		while (j < m_removed.size() && pairEqual(m_removed[j], pair)) {
+			++j;
+			--surplus;
+		}
+		if (surplus > 0) m_added[added++] = pair;
+		if (surplus < 0) m_removed[removed++] = pair;
+	}
+	m_added.resize(added);
+	m_removed.resize(removed);
+}
+
+void SweepAndPrune::clear()
+{
+	m_boxes.clear();
+	m_alive.clear();
+	m_freeHandles.clear();
+	m_releasedHandles.clear();
+	for (int k = 0; k < 3; ++k) m_axes[k].clear();
+	m_pairs.clear();
+	m_keys.clear();
+	m_indices.clear();
+	m_added.clear();
+	m_removed.clear();
+	m_pendingRemoved.clear();
+	m_scratch.clear();
+	m_iProxies = 0;
+	m_iNewProxies = 0;
+	m_iSwaps = 0;
+	m_bRebuilt = false;
+}
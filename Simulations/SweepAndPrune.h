@@ -0,0 +1,108 @@
+#ifndef SWEEPANDPRUNE_h
+#define SWEEPANDPRUNE_h
+
+#include <stdint.h>
+#include "util/vectorbase.h"
+#include "util/memorytags.h"
+
+using namespace GamePhysics;
+
+// Two proxies whose boxes overlap, a < b.
+struct ProxyPair {
+	int a, b;
+};
+
+typedef TaggedVector<ProxyPair, MEMORY_TAG_COLLISION> ProxyPairList;
+
+// Box bound of an endpoint, the proxy in the upper bits and whether it is
+// the upper bound in bit 0.
+struct SweepEndpoint {
+	Real value;
+	int data;
+};
+
+// Incremental sweep-and-prune broadphase over axis aligned boxes. Objects
+// register a proxy, move its box with setBox() and call update() once per
+// step. The endpoints of all boxes stay sorted along each axis between
+// steps; update() re-sorts them by insertion sort, which costs one swap per
+// pair of endpoints that crossed, so coherent motion is close to linear.
+// Where a lower bound moves past an upper bound, two boxes start or stop
+// overlapping on that axis, and only those pairs are tested and added to
+// or removed from the pair set.
+//
+// The broadphase knows nothing about the objects behind the proxies, so
+// any simulator can keep its bodies in one: a mass-spring system its
+// points, a rigid body system the boxes of its bodies. pairs() is the
+// current set, addedPairs() and removedPairs() the net changes of the
+// last update, for simulators that keep per pair state such as warm
+// started contacts.
+//
+// Adding many proxies at once (more than an eighth of the total) sorts
+// from scratch and sweeps along the axis of largest spread instead. The
+// result is the same, but updates stay linear only while motion is
+// coherent. Storage only grows, so a scene of constant size does not
+// allocate after the first update.
+class SweepAndPrune {
+public:
+	SweepAndPrune();
+
+	// Returns the handle of a new proxy, reusing those of removed proxies.
+	// It joins the pair set at the next update.
+	int addProxy(const Real lo[3], const Real hi[3]);
+	// Drops the proxy and its pairs now; they are reported as removed by
+	// the next update.
+	void removeProxy(int proxy);
+	// lo must not exceed hi on any axis
+	void setBox(int proxy, const Real lo[3], const Real hi[3]);
+	void update();
+	void clear();
+
+	const ProxyPairList& pairs() const { return m_pairs; }
+	const ProxyPairList& addedPairs() const { return m_added; }
+	const ProxyPairList& removedPairs() const { return m_removed; }
+	bool isPair(int a, int b) const;
+	int numProxies() const { return m_iProxies; }
+	// endpoint swaps of the last update, the measure of its cost
+	int lastSwaps() const { return m_iSwaps; }
+	// whether the last update sorted from scratch
+	bool lastRebuilt() const { return m_bRebuilt; }
+
+private:
+	struct Box {
+		Real lo[3], hi[3];
+	};
+
+	bool overlaps(int a, int b) const;
+	void sortAxis(int axis);
+	void rebuild();
+	void addPair(int a, int b);
+	void removePair(int a, int b);
+	int findSlot(uint64_t key) const;
+	void insertKey(uint64_t key, int index);
+	void eraseSlot(int slot);
+	void growTable();
+	void netEvents();
+
+	TaggedVector<Box, MEMORY_TAG_COLLISION> m_boxes;       // by handle
+	TaggedVector<unsigned char, MEMORY_TAG_COLLISION> m_alive;
+	TaggedVector<int, MEMORY_TAG_COLLISION> m_freeHandles;
+	TaggedVector<SweepEndpoint, MEMORY_TAG_COLLISION> m_axes[3];
+	ProxyPairList m_pairs;
+	// open addressing table from the pair key to its index in m_pairs,
+	// linear probing, key 0 marks a free slot
+	TaggedVector<uint64_t, MEMORY_TAG_COLLISION> m_keys;
+	TaggedVector<int, MEMORY_TAG_COLLISION> m_indices;
+	ProxyPairList m_added;
+	ProxyPairList m_removed;
+	ProxyPairList m_pendingRemoved; // pairs of proxies removed since the last update
+	ProxyPairList m_scratch;
+	// handles of removed proxies wait for the next update, so that their
+	// removed pairs are not cancelled by the pairs of a new proxy
+	TaggedVector<int, MEMORY_TAG_COLLISION> m_releasedHandles;
+	int m_iProxies;
+	int m_iNewProxies; // added since the last update
+	int m_iSwaps;
+	bool m_bRebuilt;
+};
+
+#endif
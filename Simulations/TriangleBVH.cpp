@@ -0,0 +1,454 @@
+#include "TriangleBVH.h"
+
+#include <algorithm>
+#include <limits>
+#include <stdint.h>
+
+const Real TriangleBVH::REBUILD_COST_RATIO = 1.5;
+
+// levels with fewer nodes are refitted on the calling thread
+static const int REFIT_GRAIN = 256;
+// fewer leaves are queried on the calling thread
+static const int MIN_LEAVES_PER_CHUNK = 64;
+
+static Real clamp01(Real x)
+{
+	return x < 0 ? 0 : (x > 1 ? 1 : x);
+}
+
+static void setEmpty(BVHNode& node)
+{
+	for (int k = 0; k < 3; ++k) {
+		node.lo[k] = std::numeric_limits<Real>::max();
+		node.hi[k] = -std::numeric_limits<Real>::max();
+	}
+}
+
+static void growBox(Real lo[3], Real hi[3], Real x, Real y, Real z)
+{
+	lo[0] = std::min(lo[0], x); hi[0] = std::max(hi[0], x);
+	lo[1] = std::min(lo[1], y); hi[1] = std::max(hi[1], y);
+	lo[2] = std::min(lo[2], z); hi[2] = std::max(hi[2], z);
+}
+
+static void unite(BVHNode& node, const BVHNode& a, const BVHNode& b)
+{
+	for (int k = 0; k < 3; ++k) {
+		node.lo[k] = std::min(a.lo[k], b.lo[k]);
+		node.hi[k] = std::max(a.hi[k], b.hi[k]);
+	}
+}
+
+// boxes closer than margin along every axis
+static bool overlaps(const Real aLo[3], const Real aHi[3], const Real bLo[3], const Real bHi[3], Real margin)
+{
+	return aLo[0] <= bHi[0] + margin && bLo[0] <= aHi[0] + margin
+		&& aLo[1] <= bHi[1] + margin && bLo[1] <= aHi[1] + margin
+		&& aLo[2] <= bHi[2] + margin && bLo[2] <= aHi[2] + margin;
+}
+
+static bool pointNearBox(const Vec3& p, const Real box[6], Real margin)
+{
+	return box[0] - margin <= p.x && p.x <= box[3] + margin
+		&& box[1] - margin <= p.y && p.y <= box[4] + margin
+		&& box[2] - margin <= p.z && p.z <= box[5] + margin;
+}
+
+// the boxes of two segments closer than margin along every axis
+static bool segmentBoxesOverlap(const Vec3& p1, const Vec3& q1, const Vec3& p2, const Vec3& q2, Real margin)
+{
+	return std::min(p1.x, q1.x) <= std::max(p2.x, q2.x) + margin && std::min(p2.x, q2.x) <= std::max(p1.x, q1.x) + margin
+		&& std::min(p1.y, q1.y) <= std::max(p2.y, q2.y) + margin && std::min(p2.y, q2.y) <= std::max(p1.y, q1.y) + margin
+		&& std::min(p1.z, q1.z) <= std::max(p2.z, q2.z) + margin && std::min(p2.z, q2.z) <= std::max(p1.z, q1.z) + margin;
+}
+
+static Real surfaceArea(const BVHNode& node)
+{
+	const Real dx = node.hi[0] - node.lo[0], dy = node.hi[1] - node.lo[1], dz = node.hi[2] - node.lo[2];
+	return 2 * (dx * dy + dy * dz + dz * dx);
+}
+
+static bool contains(const int* triangle, int vertex)
+{
+	return triangle[0] == vertex || triangle[1] == vertex || triangle[2] == vertex;
+}
+
+void TriangleBVH::build(const int* triangles, int numTriangles, const Real* px, const Real* py, const Real* pz)
+{
+	// refit() rebuilds from m_input itself
+	if (triangles != m_input.data()) m_input.assign(triangles, triangles + 3 * numTriangles);
+	order.resize(numTriangles);
+	m_centroids.resize(3 * numTriangles);
+	for (int t = 0; t < numTriangles; ++t) {
+		order[t] = t;
+		const int* v = &m_input[3 * t];
+		m_centroids[3 * t + 0] = (px[v[0]] + px[v[1]] + px[v[2]]) / 3;
+		m_centroids[3 * t + 1] = (py[v[0]] + py[v[1]] + py[v[2]]) / 3;
+		m_centroids[3 * t + 2] = (pz[v[0]] + pz[v[1]] + pz[v[2]]) / 3;
+	}
+	nodes.clear();
+	nodes.reserve(2 * (numTriangles / LEAF_SIZE + 1));
+	if (numTriangles > 0) buildNode(0, numTriangles, 0);
+
+	// the triangles in leaf order, so a leaf reads one run of them
+	m_triangles.resize(3 * numTriangles);
+	for (int k = 0; k < numTriangles; ++k) {
+		std::copy(&m_input[3 * order[k]], &m_input[3 * order[k]] + 3, &m_triangles[3 * k]);
+	}
+
+	// owners: the first triangle in leaf order with the vertex or edge
+	m_owned.assign(numTriangles, 0);
+	int numVertices = 0;
+	for (int i = 0; i < 3 * numTriangles; ++i) numVertices = std::max(numVertices, m_triangles[i] + 1);
+	std::vector<bool> isVertexOwned(numVertices, false);
+	std::vector<std::pair<uint64_t, int>> edges;
+	edges.reserve(3 * numTriangles);
+	for (int k = 0; k < numTriangles; ++k) {
+		const int* v = &m_triangles[3 * k];
+		for (int e = 0; e < 3; ++e) {
+			if (!isVertexOwned[v[e]]) {
+				isVertexOwned[v[e]] = true;
+				m_owned[k] |= 1 << e;
+			}
+			const int a = std::min(v[e], v[(e + 1) % 3]), b = std::max(v[e], v[(e + 1) % 3]);
+			edges.push_back(std::make_pair((uint64_t)a << 32 | (uint32_t)b, 3 * k + e));
+		}
+	}
+	std::sort(edges.begin(), edges.end());
+	for (size_t i = 0; i < edges.size(); ++i) {
+		if (i == 0 || edges[i].first != edges[i - 1].first) m_owned[edges[i].second / 3] |= 8 << (edges[i].second % 3);
+	}
+
+	// nodes by depth for the level by level refit, and the leaves
+	int maxDepth = -1;
+	for (const BVHNode& node : nodes) maxDepth = std::max(maxDepth, node.depth);
+	m_levelOffsets.assign(maxDepth + 2, 0);
+	for (const BVHNode& node : nodes) m_levelOffsets[node.depth + 1]++;
+	for (int d = 0; d <= maxDepth; ++d) m_levelOffsets[d + 1] += m_levelOffsets[d];
+	m_levelNodes.resize(nodes.size());
+	m_leaves.clear();
+	std::vector<int> cursor(m_levelOffsets.begin(), m_levelOffsets.end() - 1);
+	for (int n = 0; n < (int)nodes.size(); ++n) {
+		m_levelNodes[cursor[nodes[n].depth]++] = n;
+		if (nodes[n].count) m_leaves.push_back(n);
+	}
+
+	fitUp(px, py, pz);
+	m_builtCost = cost();
+	m_iBuilds++;
+}
+
+// Splits the centroids at the median of their widest axis.
+int TriangleBVH::buildNode(int begin, int end, int depth)
+{
+	const int index = (int)nodes.size();
+	nodes.push_back(BVHNode());
+	nodes[index].depth = depth;
+	if (end - begin <= LEAF_SIZE) {
+		nodes[index].first = begin;
+		nodes[index].count = end - begin;
+		nodes[index].escape = index + 1;
+		return index;
+	}
+
+	Real lo[3], hi[3];
+	for (int k = 0; k < 3; ++k) {
+		lo[k] = std::numeric_limits<Real>::max();
+		hi[k] = -std::numeric_limits<Real>::max();
+	}
+	for (int i = begin; i < end; ++i) {
+		const Real* c = &m_centroids[3 * order[i]];
+		growBox(lo, hi, c[0], c[1], c[2]);
+	}
+	int axis = 0;
+	if (hi[1] - lo[1] > hi[axis] - lo[axis]) axis = 1;
+	if (hi[2] - lo[2] > hi[axis] - lo[axis]) axis = 2;
+	const int middle = (begin + end) / 2;
+	const Real* centroids = m_centroids.data();
+	std::nth_element(order.begin() + begin, order.begin() + middle, order.begin() + end, [centroids, axis](int a, int b) {
+		const Real ca = centroids[3 * a + axis], cb = centroids[3 * b + axis];
+		return ca < cb || (ca == cb && a < b);
+	});
+
+	buildNode(begin, middle, depth + 1);
+	buildNode(middle, end, depth + 1);
+	nodes[index].first = -1;
+	nodes[index].count = 0;
+	nodes[index].escape = (int)nodes.size();
+	return index;
+}
+
+void TriangleBVH::fitLeaf(BVHNode& node, const Real* px, const Real* py, const Real* pz) const
+{
+	setEmpty(node);
+	for (int i = 3 * node.first; i < 3 * (node.first + node.count); ++i) {
+		const int v = m_triangles[i];
+		growBox(node.lo, node.hi, px[v], py[v], pz[v]);
+	}
+}
+
+// serial bottom-up fit, children come after their parent
+void TriangleBVH::fitUp(const Real* px, const Real* py, const Real* pz)
+{
+	for (int n = (int)nodes.size() - 1; n >= 0; --n) {
+		BVHNode& node = nodes[n];
+		if (node.count) fitLeaf(node, px, py, pz);
+		else unite(node, nodes[n + 1], nodes[nodes[n + 1].escape]);
+	}
+}
+
+bool TriangleBVH::refit(const Real* px, const Real* py, const Real* pz, ThreadPool& pool)
+{
+	if (nodes.empty()) return false;
+	// the deepest level first; the nodes of a level only read the level below
+	for (int d = (int)m_levelOffsets.size() - 2; d >= 0; --d) {
+		pool.parallelFor(m_levelOffsets[d], m_levelOffsets[d + 1], REFIT_GRAIN, [&](int begin, int end) {
+			for (int i = begin; i < end; ++i) {
+				const int n = m_levelNodes[i];
+				BVHNode& node = nodes[n];
+				if (node.count) fitLeaf(node, px, py, pz);
+				else unite(node, nodes[n + 1], nodes[nodes[n + 1].escape]);
+			}
+		});
+	}
+	if (cost() <= REBUILD_COST_RATIO * m_builtCost) return false;
+	build(m_input.data(), numTriangles(), px, py, pz);
+	return true;
+}
+
+Real TriangleBVH::cost() const
+{
+	if (nodes.empty()) return 0;
+	const Real rootArea = surfaceArea(nodes[0]);
+	if (!(rootArea > 0)) return 0;
+	Real sum = 0;
+	for (const BVHNode& node : nodes) sum += surfaceArea(node);
+	return sum / rootArea;
+}
+
+void TriangleBVH::findSelfContacts(const Real* px, const Real* py, const Real* pz, Real thickness, ThreadPool& pool, ClothContactList& contacts)
+{
+	const int numLeaves = (int)m_leaves.size();
+	const int numNodes = (int)nodes.size();
+	const int chunks = std::max(1, std::min(pool.threadCount(), numLeaves / MIN_LEAVES_PER_CHUNK));
+	if ((int)m_chunkContacts.size() < chunks) m_chunkContacts.resize(chunks);
+
+	// triangle boxes, so most pairs are rejected without touching the points
+	const int numTriangles = (int)order.size();
+	m_boxes.resize(6 * numTriangles);
+	m_corners.resize(3 * numTriangles);
+	pool.parallelFor(0, numTriangles, REFIT_GRAIN, [&](int first, int last) {
+		for (int t = first; t < last; ++t) {
+			Real* box = &m_boxes[6 * t];
+			const int* T = &m_triangles[3 * t];
+			for (int k = 0; k < 3; ++k) {
+				box[k] = std::numeric_limits<Real>::max();
+				box[3 + k] = -std::numeric_limits<Real>::max();
+			}
+			for (int k = 0; k < 3; ++k) {
+				growBox(box, box + 3, px[T[k]], py[T[k]], pz[T[k]]);
+				m_corners[3 * t + k] = Vec3(px[T[k]], py[T[k]], pz[T[k]]);
+			}
+		}
+	});
+
+	// Every leaf walks the tree for the leaves at or after it in the array,
+	// so each pair of leaves is tested once. A subtree ending before the
+	// leaf is skipped as a whole.
+	pool.parallelFor(0, chunks, 1, [&](int first, int last) {
+		for (int c = first; c < last; ++c) {
+			ClothContactList& out = m_chunkContacts[c];
+			out.clear();
+			const int leafEnd = (int)((int64_t)numLeaves * (c + 1) / chunks);
+			for (int l = (int)((int64_t)numLeaves * c / chunks); l < leafEnd; ++l) {
+				const int a = m_leaves[l];
+				const BVHNode& leaf = nodes[a];
+				int n = 0;
+				while (n < numNodes) {
+					const BVHNode& node = nodes[n];
+					if (node.escape <= a || !overlaps(leaf.lo, leaf.hi, node.lo, node.hi, thickness)) {
+						n = node.escape;
+						continue;
+					}
+					if (!node.count) {
+						++n;
+						continue;
+					}
+					for (int i = leaf.first; i < leaf.first + leaf.count; ++i) {
+						const Real* boxI = &m_boxes[6 * i];
+						if (!overlaps(boxI, boxI + 3, node.lo, node.hi, thickness)) continue;
+						for (int j = n == a ? i + 1 : node.first; j < node.first + node.count; ++j) {
+							const Real* boxJ = &m_boxes[6 * j];
+							if (overlaps(boxI, boxI + 3, boxJ, boxJ + 3, thickness)) testTriangles(i, j, thickness, out);
+						}
+					}
+					n = node.escape;
+				}
+			}
+		}
+	});
+
+	contacts.clear();
+	for (int c = 0; c < chunks; ++c) contacts.insert(contacts.end(), m_chunkContacts[c].begin(), m_chunkContacts[c].end());
+}
+
+// The features of triangles a and b (positions in order) that are owned by
+// them, closer than thickness and share no vertex. The caller has checked
+// that their boxes overlap.
+void TriangleBVH::testTriangles(int a, int b, Real thickness, ClothContactList& out) const
+{
+	const Real* boxA = &m_boxes[6 * a];
+	const Real* boxB = &m_boxes[6 * b];
+	const int* A = &m_triangles[3 * a];
+	const int* B = &m_triangles[3 * b];
+
+	const Real maxDistanceSquared = thickness * thickness;
+	const Vec3* va = &m_corners[3 * a];
+	const Vec3* vb = &m_corners[3 * b];
+	const unsigned char owned[2] = { m_owned[a], m_owned[b] };
+	const int* vertices[2] = { A, B };
+	const Vec3* positions[2] = { va, vb };
+	const Real* boxes[2] = { boxA, boxB };
+
+	// the owned vertices of each triangle against the other one
+	for (int side = 0; side < 2; ++side) {
+		const int* T = vertices[1 - side];
+		const Vec3* t = positions[1 - side];
+		const Real* box = boxes[1 - side];
+		for (int k = 0; k < 3; ++k) {
+			const int v = vertices[side][k];
+			if (!(owned[side] & (1 << k)) || contains(T, v)) continue;
+			const Vec3& p = positions[side][k];
+			if (!pointNearBox(p, box, thickness)) continue;
+			Real weights[3];
+			const Vec3 closest = closestPointOnTriangle(p, t[0], t[1], t[2], weights);
+			if (normNoSqrt(p - closest) < maxDistanceSquared) {
+				const ClothContact contact = { { v, T[0], T[1], T[2] }, false };
+				out.push_back(contact);
+			}
+		}
+	}
+
+	// owned edges against owned edges
+	for (int ea = 0; ea < 3; ++ea) {
+		if (!(owned[0] & (8 << ea))) continue;
+		const int a0 = A[ea], a1 = A[(ea + 1) % 3];
+		for (int eb = 0; eb < 3; ++eb) {
+			if (!(owned[1] & (8 << eb))) continue;
+			const int b0 = B[eb], b1 = B[(eb + 1) % 3];
+			if (a0 == b0 || a0 == b1 || a1 == b0 || a1 == b1) continue;
+			const Vec3& p1 = va[ea];
+			const Vec3& q1 = va[(ea + 1) % 3];
+			const Vec3& p2 = vb[eb];
+			const Vec3& q2 = vb[(eb + 1) % 3];
+			if (!segmentBoxesOverlap(p1, q1, p2, q2, thickness)) continue;
+			Real s, t;
+			closestPointsOnSegments(p1, q1, p2, q2, s, t);
+			const Vec3 d = (p1 + (q1 - p1) * s) - (p2 + (q2 - p2) * t);
+			if (normNoSqrt(d) < maxDistanceSquared) {
+				const ClothContact contact = { { a0, a1, b0, b1 }, true };
+				out.push_back(contact);
+			}
+		}
+	}
+}
+
+void TriangleBVH::clear()
+{
+	nodes.clear();
+	order.clear();
+	m_input.clear();
+	m_triangles.clear();
+	m_owned.clear();
+	m_levelNodes.clear();
+	m_levelOffsets.clear();
+	m_leaves.clear();
+	m_boxes.clear();
+	m_chunkContacts.clear();
+	m_centroids.clear();
+	m_builtCost = 0;
+}
+
+// Ericson, Real-Time Collision Detection, 5.1.5
+Vec3 closestPointOnTriangle(const Vec3& p, const Vec3& a, const Vec3& b, const Vec3& c, Real weights[3])
+{
+	const Vec3 ab = b - a, ac = c - a, ap = p - a;
+	const Real d1 = dot(ab, ap), d2 = dot(ac, ap);
+	if (d1 <= 0 && d2 <= 0) {
+		weights[0] = 1; weights[1] = 0; weights[2] = 0;
+		return a;
+	}
+	const Vec3 bp = p - b;
+	const Real d3 = dot(ab, bp), d4 = dot(ac, bp);
+	if (d3 >= 0 && d4 <= d3) {
+		weights[0] = 0; weights[1] = 1; weights[2] = 0;
+		return b;
+	}
+	const Real vc = d1 * d4 - d3 * d2;
+	if (vc <= 0 && d1 >= 0 && d3 <= 0) {
+		const Real v = d1 / (d1 - d3);
+		weights[0] = 1 - v; weights[1] = v; weights[2] = 0;
+		return a + ab * v;
+	}
+	const Vec3 cp = p - c;
+	const Real d5 = dot(ab, cp), d6 = dot(ac, cp);
+	if (d6 >= 0 && d5 <= d6) {
+		weights[0] = 0; weights[1] = 0; weights[2] = 1;
+		return c;
+	}
+	const Real vb = d5 * d2 - d1 * d6;
+	if (vb <= 0 && d2 >= 0 && d6 <= 0) {
+		const Real w = d2 / (d2 - d6);
+		weights[0] = 1 - w; weights[1] = 0; weights[2] = w;
+		return a + ac * w;
+	}
+	const Real va = d3 * d6 - d5 * d4;
+	if (va <= 0 && d4 - d3 >= 0 && d5 - d6 >= 0) {
+		const Real w = (d4 - d3) / ((d4 - d3) + (d5 - d6));
+		weights[0] = 0; weights[1] = 1 - w; weights[2] = w;
+		return b + (c - b) * w;
+	}
+	const Real sum = va + vb + vc;
+	if (!(sum > 0)) { // degenerate triangle
+		weights[0] = 1; weights[1] = 0; weights[2] = 0;
+		return a;
+	}
+	const Real v = vb / sum, w = vc / sum;
+	weights[0] = 1 - v - w; weights[1] = v; weights[2] = w;
+	return a + ab * v + ac * w;
+}
+
+// Ericson, Real-Time Collision Detection, 5.1.9
+void closestPointsOnSegments(const Vec3& p1, const Vec3& q1, const Vec3& p2, const Vec3& q2, Real& s, Real& t)
+{
+	const Real EPSILON = 1e-12;
+	const Vec3 d1 = q1 - p1, d2 = q2 - p2, r = p1 - p2;
+	const Real a = dot(d1, d1), e = dot(d2, d2), f = dot(d2, r);
+	if (a <= EPSILON && e <= EPSILON) {
+		s = t = 0;
+		return;
+	}
+	if (a <= EPSILON) {
+		s = 0;
+		t = clamp01(f / e);
+		return;
+	}
+	const Real c = dot(d1, r);
+	if (e <= EPSILON) {
+		t = 0;
+		s = clamp01(-c / a);
+		return;
+	}
+	const Real b = dot(d1, d2);
+	const Real denominator = a * e - b * b;
+	s = denominator > 0 ? clamp01((b * f - c * e) / denominator) : 0;
+	t = (b * s + f) / e;
+	if (t < 0) {
+		t = 0;
+		s = clamp01(-c / a);
+	}
+	else if (t > 1) {
+		t = 1;
+		s = clamp01((b - c) / a);
+	}
+}
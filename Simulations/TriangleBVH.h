@@ -0,0 +1,112 @@
+#ifndef TRIANGLEBVH_h
+#define TRIANGLEBVH_h
+
+#include <vector>
+#include "util/vectorbase.h"
+#include "util/memorytags.h"
+#include "util/threadpool.h"
+
+using namespace GamePhysics;
+
+// Node of a TriangleBVH, 64 bytes. Nodes are stored in depth first order:
+// the first child of an inner node follows it and escape is the node after
+// its subtree, so the second child is the first child's escape. Traversals
+// walk the array forwards without a stack.
+struct BVHNode {
+	Real lo[3], hi[3];
+	int escape;
+	int first;  // leaves: first triangle in TriangleBVH::order
+	int count;  // leaves: number of triangles, 0 for inner nodes
+	int depth;
+};
+
+// Self-collision of two cloth features closer than the thickness.
+// Point-triangle: vertex[0] is the point, vertex[1..3] the triangle.
+// Edge-edge: vertex[0..1] and vertex[2..3] are the edges.
+struct ClothContact {
+	int vertex[4];
+	bool isEdgeEdge;
+};
+
+typedef TaggedVector<ClothContact, MEMORY_TAG_COLLISION> ClothContactList;
+
+// Bounding volume hierarchy over the triangles of a cloth. The tree is built
+// once from the topology; as the cloth moves, refit() recomputes the boxes
+// bottom-up, one depth level after the other with the nodes of a level in
+// parallel, and rebuilds instead when the boxes have grown too loose.
+//
+// findSelfContacts() reports every vertex-triangle and edge-edge pair
+// closer than the thickness, except features sharing a vertex: the
+// triangles around a vertex touch it by construction. Every vertex and
+// edge is tested on behalf of one owning triangle only, so each contact
+// is reported once.
+class TriangleBVH {
+public:
+	TaggedVector<BVHNode, MEMORY_TAG_COLLISION> nodes;
+	TaggedVector<int, MEMORY_TAG_COLLISION> order; // triangle indices, leaves own consecutive ranges
+
+	// Builds the tree over numTriangles triangles (three point indices each)
+	// at the current positions.
+	void build(const int* triangles, int numTriangles, const Real* px, const Real* py, const Real* pz);
+	// Updates the boxes to the current positions. Rebuilds the tree when
+	// its cost has grown REBUILD_COST_RATIO times over the cost at the
+	// last build; returns true then.
+	bool refit(const Real* px, const Real* py, const Real* pz, ThreadPool& pool);
+	// Replaces contacts with the features closer than thickness, in an
+	// order that does not depend on the thread count.
+	void findSelfContacts(const Real* px, const Real* py, const Real* pz, Real thickness, ThreadPool& pool, ClothContactList& contacts);
+	void clear();
+	// Calls visit(t) for the triangles t (indices into the build input)
+	// in the leaves whose boxes overlap [lo, hi], for static meshes that
+	// are queried instead of tested against themselves.
+	template<class F>
+	void forEachTriangle(const Real lo[3], const Real hi[3], const F& visit) const
+	{
+		int n = 0;
+		while (n < (int)nodes.size()) {
+			const BVHNode& node = nodes[n];
+			if (node.lo[0] > hi[0] || lo[0] > node.hi[0] || node.lo[1] > hi[1] || lo[1] > node.hi[1] || node.lo[2] > hi[2] || lo[2] > node.hi[2]) {
+				n = node.escape;
+				continue;
+			}
+			for (int i = node.first; i < node.first + node.count; ++i) visit(order[i]);
+			++n; // the first child, or for a leaf its escape
+		}
+	}
+
+	int numTriangles() const { return (int)order.size(); }
+	int numBuilds() const { return m_iBuilds; }
+	// Sum of the node surface areas over the root's; larger means boxes
+	// overlap more and queries visit more nodes.
+	Real cost() const;
+
+	static const int LEAF_SIZE = 4;
+	static const Real REBUILD_COST_RATIO;
+
+private:
+	int buildNode(int begin, int end, int depth);
+	void fitLeaf(BVHNode& node, const Real* px, const Real* py, const Real* pz) const;
+	void testTriangles(int a, int b, Real thickness, ClothContactList& out) const;
+	void fitUp(const Real* px, const Real* py, const Real* pz);
+
+	TaggedVector<int, MEMORY_TAG_COLLISION> m_input;     // the triangles as given, for rebuilds
+	TaggedVector<int, MEMORY_TAG_COLLISION> m_triangles; // three point indices per entry of order
+	// bits 0-2: this triangle owns its vertex 0-2, bits 3-5: its edge 01, 12, 20
+	TaggedVector<unsigned char, MEMORY_TAG_COLLISION> m_owned;
+	TaggedVector<int, MEMORY_TAG_COLLISION> m_levelNodes;   // node indices grouped by depth
+	TaggedVector<int, MEMORY_TAG_COLLISION> m_levelOffsets;
+	TaggedVector<int, MEMORY_TAG_COLLISION> m_leaves;       // leaf node indices in array order
+	TaggedVector<Real, MEMORY_TAG_COLLISION> m_boxes;       // lo and hi of every triangle in order
+	TaggedVector<Vec3, MEMORY_TAG_COLLISION> m_corners;     // positions of the triangle points, in order
+	std::vector<ClothContactList> m_chunkContacts;
+	std::vector<Real> m_centroids; // build scratch
+	Real m_builtCost = 0;
+	int m_iBuilds = 0;
+};
+
+// Closest point to p on the triangle abc and its barycentric weights.
+Vec3 closestPointOnTriangle(const Vec3& p, const Vec3& a, const Vec3& b, const Vec3& c, Real weights[3]);
+// Closest points p1 + s (q1 - p1) and p2 + t (q2 - p2) of two segments.
+void closestPointsOnSegments(const Vec3& p1, const Vec3& q1, const Vec3& p2, const Vec3& q2, Real& s, Real& t);
+
+#endif
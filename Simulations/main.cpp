@@ -14,6 +14,11 @@
 // Internal includes
 #include "util/util.h"
 #include "util/FFmpeg.h"
+#include "util/profiler.h"
+#include "util/trace.h"
+#include "util/memorytags.h"
+#include "util/frametimes.h"
+#include "util/logger.h"
 
 using namespace DirectX;
 using namespace GamePhysics;
@@ -43,6 +48,10 @@ Simulator * g_pSimulator;
 float 	g_fTimestep = 0.001;
 #ifdef ADAPTIVESTEP
 float   g_fTimeFactor = 1;
+// simulators with error control substep internally, the others use fixed g_fTimestep steps
+bool    g_bAdaptiveSimulator = false;
+// longest frame that is simulated in full, only hit by stalls like window drags or breakpoints
+const float MAX_FRAME_TIME = 0.25f;
 #endif
 bool  g_bDraw = true;
 int g_iTestCase = 0;
@@ -51,6 +60,15 @@ bool  g_bSimulateByStep = false;
 bool firstTime = true;
 // Video recorder
 FFmpeg* g_pFFmpegVideoRecorder = nullptr;
+// seconds per block of the frame time dump (F6)
+const double FRAME_TIME_DUMP_INTERVAL = 10.0;
+
+// one simulation step, timed for the frame time distributions
+void simulateStep(float timeStep)
+{
+	FrameTimer timer(FRAME_STAGE_SIMULATION);
+	g_pSimulator->simulateTimestep(timeStep);
+}
 
 
 void initTweakBar(){
@@ -160,6 +178,29 @@ void CALLBACK OnKeyboard( UINT nChar, bool bKeyDown, bool bAltDown, void* pUserC
 				if(bAltDown) DXUTToggleFullScreen();
 				break;
 			}
+            // F6: Toggle dumping frame time percentiles for soak tests
+            case VK_F6:
+            {
+                static bool s_dumping = false;
+                if (!s_dumping) {
+                    static int nr = 0;
+                    std::stringstream ss;
+                    ss << "FrameTimes" << std::setfill('0') << std::setw(4) << nr++ << ".csv";
+                    s_dumping = frameTimesStartDump(ss.str(), FRAME_TIME_DUMP_INTERVAL);
+                    if (s_dumping) std::cout << "Dumping frame times to " << ss.str() << std::endl;
+                } else {
+                    frameTimesStopDump();
+                    s_dumping = false;
+                    std::cout << frameTimesReport();
+                }
+                break;
+            }
+            // F7: Print memory usage per subsystem
+            case VK_F7:
+            {
+                std::cout << memoryReport();
+                break;
+            }
             // F8: Take screenshot
 			case VK_F8:
 			{
@@ -176,6 +217,20 @@ void CALLBACK OnKeyboard( UINT nChar, bool bKeyDown, bool bAltDown, void* pUserC
                 std::wcout << L"Screenshot written to " << ss.str() << std::endl;
 				break;
 			}
+            // F9: Toggle timeline trace recording
+            case VK_F9:
+            {
+                if (!traceIsActive()) {
+                    static int nr = 0;
+                    std::stringstream ss;
+                    ss << "Trace" << std::setfill('0') << std::setw(4) << nr++ << ".json";
+                    if (traceStart(ss.str())) std::cout << "Recording trace to " << ss.str() << std::endl;
+                } else {
+                    traceStop();
+                    std::cout << "Trace written, " << traceDroppedEvents() << " events dropped" << std::endl;
+                }
+                break;
+            }
             // F10: Toggle video recording
             case VK_F10:
             {
@@ -239,6 +294,11 @@ LRESULT CALLBACK MsgProc( HWND hWnd, UINT uMsg, WPARAM wParam, LPARAM lParam,
 //--------------------------------------------------------------------------------------
 void CALLBACK OnFrameMove( double dTime, float fElapsedTime, void* pUserContext )
 {
+	// the previous frame is complete, stream it to the trace file
+	traceFlush();
+	frameTimesMarkFrame();
+	frameTimesPoll();
+	PROFILE_ZONE("OnFrameMove");
 	UpdateWindowTitle(L"Demo");
 	g_pDUC->update(fElapsedTime);
 	if (g_iPreTestCase != g_iTestCase){// test case changed
@@ -252,31 +312,37 @@ void CALLBACK OnFrameMove( double dTime, float fElapsedTime, void* pUserContext
 		g_pSimulator->initUI(g_pDUC);
 		g_iPreTestCase = g_iTestCase;
 	}
+	// simulators may retune the fixed step, e.g. from their energy drift
+	g_fTimestep = g_pSimulator->suggestTimestep(g_fTimestep);
 	if(!g_bSimulateByStep){
 #ifdef ADAPTIVESTEP
 		g_pSimulator->externalForcesCalculations(fElapsedTime);
-		static float timeAcc = 0;
-		timeAcc += fElapsedTime * g_fTimeFactor;
-		int maxIter = 10;
-		while (timeAcc > g_fTimestep)
+		float frameTime = min(fElapsedTime, MAX_FRAME_TIME) * g_fTimeFactor;
+		if (g_bAdaptiveSimulator)
 		{
-			if (maxIter > 0)
+			// one call covers the whole frame, the step size follows the error estimate
+			simulateStep(frameTime);
+		}
+		else
+		{
+			static float timeAcc = 0;
+			timeAcc += frameTime;
+			while (timeAcc > g_fTimestep)
 			{
-				g_pSimulator->simulateTimestep(g_fTimestep);
-				maxIter--;
+				simulateStep(g_fTimestep);
+				timeAcc -= g_fTimestep;
 			}
-			timeAcc -= g_fTimestep;
 		}
 #else
 		g_pSimulator->externalForcesCalculations(g_fTimestep);
-		g_pSimulator->simulateTimestep(g_fTimestep);
+		simulateStep(g_fTimestep);
 #endif
 	}else{
 		if(DXUTIsKeyDown(VK_SPACE))
-			g_pSimulator->simulateTimestep(g_fTimestep);
+			simulateStep(g_fTimestep);
 		if(DXUTIsKeyDown('S') && firstTime)
 		{
-			g_pSimulator->simulateTimestep(g_fTimestep);
+			simulateStep(g_fTimestep);
 			firstTime = false;
 		}else{
 			if(!DXUTIsKeyDown('S')) 
@@ -292,29 +358,37 @@ void CALLBACK OnD3D11FrameRender( ID3D11Device* pd3dDevice, ID3D11DeviceContext*
                                   double fTime, float fElapsedTime, void* pUserContext )
 {
     HRESULT hr;
+	PROFILE_ZONE("OnFrameRender");
+	{
+		FrameTimer renderTimer(FRAME_STAGE_RENDER);
 
-	// Clear render target and depth stencil
-	float ClearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		// Clear render target and depth stencil
+		float ClearColor[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
 
-	ID3D11RenderTargetView* pRTV = DXUTGetD3D11RenderTargetView();
-	ID3D11DepthStencilView* pDSV = DXUTGetD3D11DepthStencilView();
-	pd3dImmediateContext->ClearRenderTargetView( pRTV, ClearColor );
-	pd3dImmediateContext->ClearDepthStencilView( pDSV, D3D11_CLEAR_DEPTH, 1.0f, 0 );
+		ID3D11RenderTargetView* pRTV = DXUTGetD3D11RenderTargetView();
+		ID3D11DepthStencilView* pDSV = DXUTGetD3D11DepthStencilView();
+		pd3dImmediateContext->ClearRenderTargetView( pRTV, ClearColor );
+		pd3dImmediateContext->ClearDepthStencilView( pDSV, D3D11_CLEAR_DEPTH, 1.0f, 0 );
 
-    // Draw floor
-    g_pDUC->DrawFloor(pd3dImmediateContext);
+		// Draw floor
+		g_pDUC->DrawFloor(pd3dImmediateContext);
 
-    // Draw axis box
-     g_pDUC->DrawBoundingBox(pd3dImmediateContext);
+		// Draw axis box
+		g_pDUC->DrawBoundingBox(pd3dImmediateContext);
 
-	// Draw Simulator
-	if(g_bDraw)g_pSimulator->drawFrame(pd3dImmediateContext);
+		// Draw Simulator
+		if(g_bDraw)g_pSimulator->drawFrame(pd3dImmediateContext);
 
-	// Draw GUI
-    TwDraw();
+		// Draw GUI
+		{
+			PROFILE_ZONE("TwDraw");
+			TwDraw();
+		}
+	}
 
     if (g_pFFmpegVideoRecorder) 
     {
+        FrameTimer captureTimer(FRAME_STAGE_CAPTURE);
         V(g_pFFmpegVideoRecorder->AddFrame(pd3dImmediateContext, DXUTGetD3D11RenderTargetView()));
     }
 }
@@ -334,6 +408,8 @@ int main(int argc, char* argv[])
 	std::wcout << L"---- DEBUG BUILD ----\n\n";
 #endif
 
+	profilerSetThreadName("main");
+
 	// Set general DXUT callbacks
 	DXUTSetCallbackMsgProc( MsgProc );
 	DXUTSetCallbackMouse( OnMouse, true );
@@ -371,6 +447,10 @@ int main(int argc, char* argv[])
 	//g_pSimulator= new SPHSystemSimulator();
 #endif
 	g_pSimulator->reset();
+	frameTimesReset();
+#ifdef ADAPTIVESTEP
+	g_bAdaptiveSimulator = g_pSimulator->setAdaptiveStepping(true);
+#endif
 
     // Init DXUT and create device
 	DXUTInit( true, true, NULL ); // Parse the command line, show msgboxes on error, no extra command line params
@@ -381,6 +461,13 @@ int main(int argc, char* argv[])
     
 	DXUTMainLoop(); // Enter into the DXUT render loop
 	DXUTShutdown(); // Shuts down DXUT (includes calls to OnD3D11ReleasingSwapChain() and OnD3D11DestroyDevice())
+	traceStop();
+	logShutdown();
+	frameTimesStopDump();
+	std::cout << frameTimesReport();
+#ifndef GAMEPHYSICS_NO_PROFILE
+	std::cout << profilerReport();
+#endif
 	
 	return DXUTGetExitCode();
 }
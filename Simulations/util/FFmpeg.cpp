@@ -1,4 +1,5 @@
 #include "FFmpeg.h"
+#include "profiler.h"
 
 #include <iostream>
 #include <sstream>
@@ -102,9 +103,12 @@ HRESULT FFmpeg::StartRecording(ID3D11Device* pd3dDevice, ID3D11RenderTargetView*
     // 3) Allocate buffers
     m_width  = desc.Width;
     m_height = desc.Height;
-    m_buffer[0].resize(m_width * m_height * sizeof(uint32_t));
     m_buffer[1].resize(m_width * m_height * sizeof(uint32_t));
-    m_buffer[2].resize(m_width * m_height * sizeof(uint32_t));
+    if (m_mode == MODE_INTERPOLATE)
+    {
+        m_buffer[0].resize(m_width * m_height * sizeof(uint32_t));
+        m_buffer[2].resize(m_width * m_height * sizeof(uint32_t));
+    }
     m_frame = -1;
 
     StartRecording_Return:
@@ -123,9 +127,9 @@ void FFmpeg::StopRecording()
     
     if (m_pStaging) {m_pStaging ->Release(); m_pStaging  = nullptr; }
 
-    m_buffer[0].swap(std::vector<uint8_t>());
-    m_buffer[1].swap(std::vector<uint8_t>());
-    m_buffer[2].swap(std::vector<uint8_t>());
+    FrameBuffer().swap(m_buffer[0]);
+    FrameBuffer().swap(m_buffer[1]);
+    FrameBuffer().swap(m_buffer[2]);
     m_timestamp[0].QuadPart = m_timestamp[1].QuadPart = 0;
     m_frequency.QuadPart = 0;
     m_startTime.QuadPart = 0;
@@ -138,6 +142,7 @@ void FFmpeg::StopRecording()
 HRESULT FFmpeg::AddFrame(ID3D11DeviceContext* pd3dContext, ID3D11RenderTargetView* pRenderTargetView)
 {
     if (!ms_bFFmpegInstalled) { return S_OK; }
+    PROFILE_ZONE("FFmpeg::AddFrame");
         
     HRESULT hr;
 
@@ -148,7 +153,7 @@ HRESULT FFmpeg::AddFrame(ID3D11DeviceContext* pd3dContext, ID3D11RenderTargetVie
     pTex2D->Release();
 
     // 2) Download staging texture from GPU to buffer
-    m_buffer[0].swap(m_buffer[1]);
+    if (m_mode == MODE_INTERPOLATE) m_buffer[0].swap(m_buffer[1]);
     uint32_t* pixels = (uint32_t*)(m_buffer[1].data());
 
     D3D11_MAPPED_SUBRESOURCE mapped;
@@ -5,6 +5,7 @@
 #include <cstdint>
 #include <vector>
 #include <Windows.h>
+#include "memorytags.h"
 
 struct ID3D11Device;
 struct ID3D11DeviceContext;
@@ -50,7 +51,9 @@ public:
 private:
     FILE*                m_pFILE;
     ID3D11Texture2D*     m_pStaging;
-    std::vector<uint8_t> m_buffer[3];
+    typedef TaggedVector<uint8_t, MEMORY_TAG_RECORDER> FrameBuffer;
+    // [1] latest frame; [0] previous and [2] blended frame, MODE_INTERPOLATE only
+    FrameBuffer          m_buffer[3];
     LARGE_INTEGER        m_timestamp[2];
     LARGE_INTEGER        m_frequency;
     LARGE_INTEGER        m_startTime;
@@ -0,0 +1,77 @@
+#ifndef __alignedalloc_h__
+#define __alignedalloc_h__
+
+#include <cstddef>
+#include <cstdlib>
+#include <new>
+#include <atomic>
+
+#if defined(WIN32) || defined(_WIN32)
+#  include <malloc.h>
+#endif
+
+// Cache line / AVX-512 register width, used as default alignment for all
+// structure-of-arrays buffers so that SIMD kernels can use aligned loads.
+#define GP_SIMD_ALIGNMENT 64
+
+// Number of alignedMalloc calls so far. Lets tests check that steady-state
+// stepping does not touch the heap, as these bypass operator new.
+inline std::atomic<size_t>& alignedAllocationCount()
+{
+	static std::atomic<size_t> count(0);
+	return count;
+}
+
+inline void* alignedMalloc(size_t bytes, size_t alignment)
+{
+	alignedAllocationCount()++;
+#if defined(WIN32) || defined(_WIN32)
+	return _aligned_malloc(bytes, alignment);
+#else
+	void* p = nullptr;
+	if (posix_memalign(&p, alignment, bytes) != 0) return nullptr;
+	return p;
+#endif
+}
+
+inline void alignedFree(void* p)
+{
+#if defined(WIN32) || defined(_WIN32)
+	_aligned_free(p);
+#else
+	free(p);
+#endif
+}
+
+// Minimal std::allocator replacement returning over-aligned memory.
+template<class T, size_t Alignment = GP_SIMD_ALIGNMENT>
+class AlignedAllocator
+{
+public:
+	typedef T value_type;
+
+	template<class U> struct rebind { typedef AlignedAllocator<U, Alignment> other; };
+
+	AlignedAllocator() {}
+	template<class U> AlignedAllocator(const AlignedAllocator<U, Alignment>&) {}
+
+	T* allocate(size_t n)
+	{
+		if (n == 0) return nullptr;
+		void* p = alignedMalloc(n * sizeof(T), Alignment);
+		if (!p) throw std::bad_alloc();
+		return static_cast<T*>(p);
+	}
+
+	void deallocate(T* p, size_t)
+	{
+		if (p) alignedFree(p);
+	}
+};
+
+template<class T, class U, size_t A>
+inline bool operator==(const AlignedAllocator<T, A>&, const AlignedAllocator<U, A>&) { return true; }
+template<class T, class U, size_t A>
+inline bool operator!=(const AlignedAllocator<T, A>&, const AlignedAllocator<U, A>&) { return false; }
+
+#endif
@@ -0,0 +1,73 @@
+#include "arena.h"
+
+#include <algorithm>
+
+// blocks grow geometrically up to this size, larger requests get their own block
+static const size_t MAX_BLOCK_SIZE = 64 * 1024 * 1024;
+
+SceneArena::SceneArena(size_t initialBlockSize)
+	: m_current(0), m_offset(0), m_nextBlockSize(initialBlockSize), m_bytesReserved(0), m_bytesInUse(0)
+{
+	std::fill(m_tagBytes, m_tagBytes + MEMORY_TAG_COUNT, 0);
+}
+
+SceneArena::~SceneArena()
+{
+	release();
+}
+
+void* SceneArena::allocate(size_t bytes, size_t alignment, MemoryTag tag)
+{
+	// try the current block, then any block kept from an earlier scene
+	while (m_current < m_blocks.size()) {
+		Block& b = m_blocks[m_current];
+		size_t start = (m_offset + alignment - 1) & ~(alignment - 1);
+		if (start + bytes <= b.size) {
+			// the alignment padding is charged to the request
+			const size_t used = start + bytes - m_offset;
+			m_bytesInUse += used;
+			m_tagBytes[tag] += used;
+			memoryTrackHandOut(MEMORY_TAG_SCENE_ARENA, tag, used);
+			m_offset = start + bytes;
+			return b.data + start;
+		}
+		m_bytesInUse += b.size - m_offset;
+		m_current++;
+		m_offset = 0;
+	}
+
+	Block b;
+	b.size = std::max(m_nextBlockSize, bytes + alignment);
+	b.data = static_cast<char*>(alignedMalloc(b.size, GP_SIMD_ALIGNMENT));
+	if (!b.data) throw std::bad_alloc();
+	memoryTrackAllocation(MEMORY_TAG_SCENE_ARENA, b.size);
+	m_blocks.push_back(b);
+	m_bytesReserved += b.size;
+	m_nextBlockSize = std::min(m_nextBlockSize * 2, MAX_BLOCK_SIZE);
+
+	m_current = m_blocks.size() - 1;
+	m_offset = 0;
+	return allocate(bytes, alignment, tag);
+}
+
+void SceneArena::reset()
+{
+	for (int t = 0; t < MEMORY_TAG_COUNT; ++t) {
+		if (m_tagBytes[t]) memoryTrackTakeBack(MEMORY_TAG_SCENE_ARENA, (MemoryTag)t, m_tagBytes[t]);
+		m_tagBytes[t] = 0;
+	}
+	m_current = 0;
+	m_offset = 0;
+	m_bytesInUse = 0;
+}
+
+void SceneArena::release()
+{
+	reset();
+	for (size_t i = 0; i < m_blocks.size(); ++i) {
+		memoryTrackFree(MEMORY_TAG_SCENE_ARENA, m_blocks[i].size);
+		alignedFree(m_blocks[i].data);
+	}
+	m_blocks.clear();
+	m_bytesReserved = 0;
+}
@@ -0,0 +1,111 @@
+#ifndef __arena_h__
+#define __arena_h__
+
+#include <cstddef>
+#include <type_traits>
+#include <vector>
+#include "alignedalloc.h"
+#include "memorytags.h"
+
+/*
+// simple example:
+
+SceneArena arena;
+ArenaVector<double> xs((ArenaAllocator<double>(&arena, MEMORY_TAG_POINTS)));
+xs.push_back(1.0);
+
+// drop all references into the arena, then rewind it in O(1)
+ArenaVector<double>(ArenaAllocator<double>(&arena)).swap(xs);
+arena.reset();
+
+*/
+
+// Bump allocator owning all memory of one scene.
+// Memory is handed out from a list of large blocks and never freed
+// individually. reset() rewinds to the first block in O(1) and keeps every
+// block, so reloading a scene of similar size does not touch the heap again.
+// The blocks count as MEMORY_TAG_SCENE_ARENA; bytes handed out move to the
+// tag of the request until the next reset.
+class SceneArena
+{
+public:
+	explicit SceneArena(size_t initialBlockSize = 256 * 1024);
+	~SceneArena();
+
+	void* allocate(size_t bytes, size_t alignment = GP_SIMD_ALIGNMENT, MemoryTag tag = MEMORY_TAG_OTHER);
+	void reset();
+	void release();
+
+	// bytes obtained from the system (sum of all block sizes)
+	size_t bytesReserved() const { return m_bytesReserved; }
+	// bytes handed out since the last reset, including alignment padding
+	size_t bytesInUse() const { return m_bytesInUse; }
+	size_t numBlocks() const { return m_blocks.size(); }
+
+private:
+	struct Block {
+		char*  data;
+		size_t size;
+	};
+
+	SceneArena(const SceneArena&);
+	SceneArena& operator=(const SceneArena&);
+
+	std::vector<Block> m_blocks;
+	size_t m_current;
+	size_t m_offset;
+	size_t m_nextBlockSize;
+	size_t m_bytesReserved;
+	size_t m_bytesInUse;
+	size_t m_tagBytes[MEMORY_TAG_COUNT]; // handed out per tag since the last reset
+};
+
+// std allocator adapter for SceneArena. Deallocation is a no-op; memory comes
+// back when the arena is reset. Without an arena it falls back to aligned heap
+// memory so that the containers can also be used standalone. Either way the
+// memory is accounted under tag.
+template<class T>
+class ArenaAllocator
+{
+public:
+	typedef T value_type;
+	typedef std::true_type propagate_on_container_copy_assignment;
+	typedef std::true_type propagate_on_container_move_assignment;
+	typedef std::true_type propagate_on_container_swap;
+
+	template<class U> struct rebind { typedef ArenaAllocator<U> other; };
+
+	ArenaAllocator() : arena(nullptr), tag(MEMORY_TAG_OTHER) {}
+	explicit ArenaAllocator(SceneArena* arena, MemoryTag tag = MEMORY_TAG_OTHER) : arena(arena), tag(tag) {}
+	template<class U> ArenaAllocator(const ArenaAllocator<U>& o) : arena(o.arena), tag(o.tag) {}
+
+	T* allocate(size_t n)
+	{
+		if (n == 0) return nullptr;
+		if (arena) return static_cast<T*>(arena->allocate(n * sizeof(T), GP_SIMD_ALIGNMENT, tag));
+		void* p = alignedMalloc(n * sizeof(T), GP_SIMD_ALIGNMENT);
+		if (!p) throw std::bad_alloc();
+		memoryTrackAllocation(tag, n * sizeof(T));
+		return static_cast<T*>(p);
+	}
+
+	void deallocate(T* p, size_t n)
+	{
+		if (arena || !p) return;
+		memoryTrackFree(tag, n * sizeof(T));
+		alignedFree(p);
+	}
+
+	SceneArena* arena;
+	MemoryTag tag;
+};
+
+template<class T, class U>
+inline bool operator==(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return a.arena == b.arena && a.tag == b.tag; }
+template<class T, class U>
+inline bool operator!=(const ArenaAllocator<T>& a, const ArenaAllocator<U>& b) { return !(a == b); }
+
+template<class T>
+using ArenaVector = std::vector<T, ArenaAllocator<T> >;
+
+#endif
@@ -0,0 +1,75 @@
+#include "cpuinfo.h"
+
+#ifdef GP_X86
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  else
+#    include <cpuid.h>
+#  endif
+#endif
+
+#ifdef GP_X86
+static void cpuid(int leaf, int subleaf, unsigned int regs[4])
+{
+#if defined(_MSC_VER)
+	int r[4];
+	__cpuidex(r, leaf, subleaf);
+	for (int i = 0; i < 4; ++i) regs[i] = (unsigned int)r[i];
+#else
+	__cpuid_count(leaf, subleaf, regs[0], regs[1], regs[2], regs[3]);
+#endif
+}
+
+static unsigned long long xgetbv0()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int lo, hi;
+	__asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+	return ((unsigned long long)hi << 32) | lo;
+#endif
+}
+#endif
+
+static CpuFeatures detect()
+{
+	CpuFeatures f = {};
+#ifdef GP_X86
+	unsigned int r[4];
+	cpuid(0, 0, r);
+	const unsigned int maxLeaf = r[0];
+
+	cpuid(1, 0, r);
+	f.sse2 = (r[3] & (1u << 26)) != 0;
+	const bool osxsave = (r[2] & (1u << 27)) != 0;
+	const bool cpuAvx = (r[2] & (1u << 28)) != 0;
+	const bool cpuFma = (r[2] & (1u << 12)) != 0;
+
+	// the OS has to save the wider registers on context switches
+	const unsigned long long xcr0 = osxsave ? xgetbv0() : 0;
+	const bool ymmState = (xcr0 & 0x6) == 0x6;
+	const bool zmmState = (xcr0 & 0xe6) == 0xe6;
+
+	f.avx = cpuAvx && ymmState;
+	f.fma = f.avx && cpuFma;
+	if (maxLeaf >= 7) {
+		cpuid(7, 0, r);
+		f.avx2 = f.avx && (r[1] & (1u << 5)) != 0;
+		f.avx512f = zmmState && (r[1] & (1u << 16)) != 0;
+	}
+
+	cpuid((int)0x80000000, 0, r);
+	if (r[0] >= 0x80000007) {
+		cpuid((int)0x80000007, 0, r);
+		f.invariantTsc = (r[3] & (1u << 8)) != 0;
+	}
+#endif
+	return f;
+}
+
+const CpuFeatures& cpuFeatures()
+{
+	static const CpuFeatures features = detect();
+	return features;
+}
@@ -0,0 +1,23 @@
+#ifndef __cpuinfo_h__
+#define __cpuinfo_h__
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#  define GP_X86 1
+#endif
+
+// Instruction set extensions usable by this process, i.e. supported by the
+// CPU and with their register state enabled by the operating system.
+struct CpuFeatures
+{
+	bool sse2;
+	bool avx;
+	bool avx2;
+	bool fma;
+	bool avx512f;
+	bool invariantTsc; // the time stamp counter ticks at a constant rate in all power states
+};
+
+// detected once on first use
+const CpuFeatures& cpuFeatures();
+
+#endif
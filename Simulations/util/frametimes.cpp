@@ -0,0 +1,164 @@
+#include "frametimes.h"
+#include "profiler.h"
+
+#include <cstdio>
+#include <fstream>
+
+namespace {
+
+const char* const STAGE_NAMES[FRAME_STAGE_COUNT] = { "frame", "sim", "render", "capture" };
+
+LatencyHistogram s_total[FRAME_STAGE_COUNT];
+LatencyHistogram s_interval[FRAME_STAGE_COUNT];
+LatencyHistogram s_dumpPeriod[FRAME_STAGE_COUNT];
+
+uint64_t s_lastFrameTicks = 0;
+
+std::ofstream s_dumpFile;
+uint64_t s_dumpStartTicks = 0;
+uint64_t s_nextDumpTicks = 0;
+uint64_t s_dumpIntervalTicks = 0;
+
+double milliseconds(uint64_t nanoseconds)
+{
+	return nanoseconds * 1e-6;
+}
+
+uint64_t nanosecondsSince(uint64_t startTicks)
+{
+	return (uint64_t)((profilerTicks() - startTicks) * profilerNanosecondsPerTick());
+}
+
+// one line per stage with samples in the current dump period
+void writeDumpBlock()
+{
+	char line[160];
+	const double seconds = nanosecondsSince(s_dumpStartTicks) * 1e-9;
+	for (int s = 0; s < FRAME_STAGE_COUNT; ++s) {
+		LatencyHistogram& h = s_dumpPeriod[s];
+		if (!h.count()) continue;
+		std::snprintf(line, sizeof(line), "%.3f,%s,%llu,%.4f,%.4f,%.4f,%.4f\n", seconds, STAGE_NAMES[s], (unsigned long long)h.count(),
+			milliseconds(h.percentile(50)), milliseconds(h.percentile(95)), milliseconds(h.percentile(99)), milliseconds(h.max()));
+		s_dumpFile << line;
+		h.reset();
+	}
+	s_dumpFile.flush();
+}
+
+}
+
+const char* frameStageName(FrameStage stage)
+{
+	return stage >= 0 && stage < FRAME_STAGE_COUNT ? STAGE_NAMES[stage] : "invalid";
+}
+
+void frameTimesRecord(FrameStage stage, uint64_t nanoseconds)
+{
+	s_total[stage].record(nanoseconds);
+	s_interval[stage].record(nanoseconds);
+	if (s_dumpFile.is_open()) s_dumpPeriod[stage].record(nanoseconds);
+}
+
+void frameTimesMarkFrame()
+{
+	const uint64_t now = profilerTicks();
+	if (s_lastFrameTicks) frameTimesRecord(FRAME_STAGE_FRAME, (uint64_t)((now - s_lastFrameTicks) * profilerNanosecondsPerTick()));
+	s_lastFrameTicks = now;
+}
+
+const LatencyHistogram& frameTimesTotal(FrameStage stage)
+{
+	return s_total[stage];
+}
+
+const LatencyHistogram& frameTimesInterval(FrameStage stage)
+{
+	return s_interval[stage];
+}
+
+void frameTimesStartInterval()
+{
+	for (int s = 0; s < FRAME_STAGE_COUNT; ++s) s_interval[s].reset();
+}
+
+void frameTimesReset()
+{
+	for (int s = 0; s < FRAME_STAGE_COUNT; ++s) s_total[s].reset();
+	frameTimesStartInterval();
+	// the next frame starts a new measurement
+	s_lastFrameTicks = 0;
+	// the first call calibrates the clock, which should not land in a sample
+	profilerNanosecondsPerTick();
+}
+
+std::string frameTimesReport()
+{
+	std::string report;
+	char line[160];
+	std::snprintf(line, sizeof(line), "%-10s %10s %10s %10s %10s %10s\n", "stage", "count", "p50 ms", "p95 ms", "p99 ms", "max ms");
+	report += line;
+	for (int s = 0; s < FRAME_STAGE_COUNT; ++s) {
+		const LatencyHistogram& h = s_total[s];
+		if (!h.count()) continue;
+		std::snprintf(line, sizeof(line), "%-10s %10llu %10.3f %10.3f %10.3f %10.3f\n", STAGE_NAMES[s], (unsigned long long)h.count(),
+			milliseconds(h.percentile(50)), milliseconds(h.percentile(95)), milliseconds(h.percentile(99)), milliseconds(h.max()));
+		report += line;
+	}
+	return report;
+}
+
+std::string frameTimesIntervalSummary()
+{
+	std::string summary;
+	char part[64];
+	for (int s = 0; s < FRAME_STAGE_COUNT; ++s) {
+		const LatencyHistogram& h = s_interval[s];
+		if (!h.count()) continue;
+		std::snprintf(part, sizeof(part), "%s%s %.2f/%.2f ms", summary.empty() ? "" : ", ", STAGE_NAMES[s],
+			milliseconds(h.percentile(50)), milliseconds(h.percentile(99)));
+		summary += part;
+	}
+	return summary;
+}
+
+bool frameTimesStartDump(const std::string& path, double intervalSeconds)
+{
+	frameTimesStopDump();
+	s_dumpFile.open(path.c_str(), std::ios::out | std::ios::trunc);
+	if (!s_dumpFile) return false;
+	s_dumpFile << "seconds,stage,count,p50_ms,p95_ms,p99_ms,max_ms\n";
+	s_dumpFile.flush();
+	for (int s = 0; s < FRAME_STAGE_COUNT; ++s) s_dumpPeriod[s].reset();
+	s_dumpIntervalTicks = (uint64_t)(intervalSeconds * 1e9 / profilerNanosecondsPerTick());
+	s_dumpStartTicks = profilerTicks();
+	s_nextDumpTicks = s_dumpStartTicks + s_dumpIntervalTicks;
+	return true;
+}
+
+void frameTimesStopDump()
+{
+	if (!s_dumpFile.is_open()) return;
+	// the last, partial period
+	writeDumpBlock();
+	s_dumpFile.close();
+}
+
+void frameTimesPoll()
+{
+	if (!s_dumpFile.is_open()) return;
+	const uint64_t now = profilerTicks();
+	if (now < s_nextDumpTicks) return;
+	// a stalled caller writes one block for the whole stall
+	while (s_nextDumpTicks <= now) s_nextDumpTicks += s_dumpIntervalTicks ? s_dumpIntervalTicks : 1;
+	writeDumpBlock();
+}
+
+FrameTimer::FrameTimer(FrameStage stage)
+	: m_stage(stage), m_start(profilerTicks())
+{
+}
+
+FrameTimer::~FrameTimer()
+{
+	frameTimesRecord(m_stage, nanosecondsSince(m_start));
+}
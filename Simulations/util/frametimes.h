@@ -0,0 +1,82 @@
+#ifndef __frametimes_h__
+#define __frametimes_h__
+
+#include <stdint.h>
+#include <string>
+#include "histogram.h"
+
+/*
+// simple example:
+
+frameTimesStartDump("soak.csv", 10.0);     // optional, one block of lines every 10 s
+for (;;) {
+	frameTimesMarkFrame();
+	{
+		FrameTimer timer(FRAME_STAGE_SIMULATION);
+		simulator->simulateTimestep(dt);
+	}
+	...
+	frameTimesPoll();                      // writes the dump when it is due
+}
+std::cout << frameTimesReport();           // p50, p95, p99 and max per stage
+
+*/
+
+// Duration distributions of the frame loop, one LatencyHistogram per stage.
+// Every sample goes into a total since the start (or frameTimesReset()) and
+// into an interval that the caller restarts, e.g. once per window title
+// update, so a live view shows recent spikes instead of a long average.
+// Meant for the thread running the frame loop; nothing here locks.
+
+enum FrameStage {
+	FRAME_STAGE_FRAME,      // whole frame, from one frame start to the next
+	FRAME_STAGE_SIMULATION, // one simulateTimestep call
+	FRAME_STAGE_RENDER,
+	FRAME_STAGE_CAPTURE,    // video recorder
+	FRAME_STAGE_COUNT
+};
+
+const char* frameStageName(FrameStage stage);
+
+void frameTimesRecord(FrameStage stage, uint64_t nanoseconds);
+// Call at the start of every frame; records the time since the previous call
+// as FRAME_STAGE_FRAME.
+void frameTimesMarkFrame();
+// samples since the start or the last reset
+const LatencyHistogram& frameTimesTotal(FrameStage stage);
+// samples since the last frameTimesStartInterval()
+const LatencyHistogram& frameTimesInterval(FrameStage stage);
+void frameTimesStartInterval();
+// also calibrates the clock, so call it before the timed loop
+void frameTimesReset();
+
+// Table of count, p50, p95, p99 and max in ms per stage with samples.
+std::string frameTimesReport();
+// "sim 0.41/1.20 ms" per stage with samples, p50/p99 of the interval
+std::string frameTimesIntervalSummary();
+
+// Soak tests: appends CSV lines (seconds since the start of the dump, stage,
+// count, p50, p95, p99, max in ms) with the distribution of every elapsed
+// period of intervalSeconds to path. The file is written by frameTimesPoll()
+// and flushed after every block; frameTimesStopDump() writes the last,
+// partial period. Returns false if path cannot be written.
+bool frameTimesStartDump(const std::string& path, double intervalSeconds);
+void frameTimesStopDump();
+void frameTimesPoll();
+
+// Records the time from construction to destruction into stage.
+class FrameTimer
+{
+public:
+	explicit FrameTimer(FrameStage stage);
+	~FrameTimer();
+
+private:
+	FrameTimer(const FrameTimer&);
+	FrameTimer& operator=(const FrameTimer&);
+
+	FrameStage m_stage;
+	uint64_t m_start;
+};
+
+#endif
@@ -0,0 +1,89 @@
+#include "histogram.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#ifdef _MSC_VER
+#  include <intrin.h>
+#endif
+
+namespace {
+
+// index of the highest set bit, value must not be 0
+int highestBit(uint64_t value)
+{
+#ifdef _MSC_VER
+	unsigned long index;
+	_BitScanReverse64(&index, value);
+	return (int)index;
+#else
+	return 63 - __builtin_clzll(value);
+#endif
+}
+
+// Values below 128 have a bucket each; above, a value keeps its top 7 bits
+// (64..127) and the bucket is shift * 64 + those bits.
+int bucketOf(uint64_t value)
+{
+	if (value < 128) return (int)value;
+	const int shift = highestBit(value) - 6;
+	return shift * 64 + (int)(value >> shift);
+}
+
+uint64_t bucketUpperBound(int bucket)
+{
+	if (bucket < 128) return (uint64_t)bucket;
+	const int shift = bucket / 64 - 1;
+	const uint64_t bits = (uint64_t)(bucket - shift * 64);
+	return ((bits + 1) << shift) - 1;
+}
+
+}
+
+LatencyHistogram::LatencyHistogram()
+{
+	reset();
+}
+
+void LatencyHistogram::record(uint64_t nanoseconds)
+{
+	const uint64_t value = std::min<uint64_t>(nanoseconds, LATENCY_HISTOGRAM_MAX_NS - 1);
+	m_buckets[bucketOf(value)]++;
+	m_count++;
+	m_sum += nanoseconds;
+	m_min = std::min(m_min, nanoseconds);
+	m_max = std::max(m_max, nanoseconds);
+}
+
+void LatencyHistogram::reset()
+{
+	std::memset(m_buckets, 0, sizeof(m_buckets));
+	m_count = 0;
+	m_sum = 0;
+	m_min = UINT64_MAX;
+	m_max = 0;
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+	for (int b = 0; b < LATENCY_HISTOGRAM_BUCKETS; ++b) m_buckets[b] += other.m_buckets[b];
+	m_count += other.m_count;
+	m_sum += other.m_sum;
+	m_min = std::min(m_min, other.m_min);
+	m_max = std::max(m_max, other.m_max);
+}
+
+uint64_t LatencyHistogram::percentile(double percent) const
+{
+	if (m_count == 0) return 0;
+	// rank of the sample, 1 based, at least the first one
+	const double exact = std::min(std::max(percent, 0.0), 100.0) / 100.0 * m_count;
+	const uint64_t rank = std::max<uint64_t>(1, (uint64_t)std::ceil(exact));
+	uint64_t seen = 0;
+	for (int b = 0; b < LATENCY_HISTOGRAM_BUCKETS; ++b) {
+		seen += m_buckets[b];
+		if (seen >= rank) return std::min(bucketUpperBound(b), m_max);
+	}
+	return m_max;
+}
@@ -0,0 +1,54 @@
+#ifndef __histogram_h__
+#define __histogram_h__
+
+#include <stdint.h>
+
+/*
+// simple example:
+
+LatencyHistogram steps;
+for (...) {
+	uint64_t start = now_ns();
+	step();
+	steps.record(now_ns() - start);
+}
+printf("p99 %.3f ms, max %.3f ms\n", steps.percentile(99) * 1e-6, steps.max() * 1e-6);
+
+*/
+
+// Fixed size log-linear histogram of durations in nanoseconds, in the style
+// of HdrHistogram: values keep their 7 most significant bits, so every
+// bucket is at most 1/64 (1.6%) wide relative to its values, from 1 ns up to
+// LATENCY_HISTOGRAM_MAX_NS; longer values are clamped into the last bucket.
+// Recording is a few integer operations and never allocates, so it can run
+// every step. min, max and mean are exact.
+#define LATENCY_HISTOGRAM_MAX_NS (1ull << 40) // about 18 minutes
+#define LATENCY_HISTOGRAM_BUCKETS ((40 - 6) * 64 + 64)
+
+class LatencyHistogram
+{
+public:
+	LatencyHistogram();
+
+	void record(uint64_t nanoseconds);
+	void reset();
+	// adds the samples of other
+	void merge(const LatencyHistogram& other);
+
+	uint64_t count() const { return m_count; }
+	uint64_t min() const { return m_count ? m_min : 0; }
+	uint64_t max() const { return m_max; }
+	double mean() const { return m_count ? (double)m_sum / m_count : 0; }
+	// Smallest value that percent of the samples do not exceed, as the upper
+	// end of its bucket but never above max(). 0 without samples.
+	uint64_t percentile(double percent) const;
+
+private:
+	uint64_t m_buckets[LATENCY_HISTOGRAM_BUCKETS];
+	uint64_t m_count;
+	uint64_t m_sum;
+	uint64_t m_min;
+	uint64_t m_max;
+};
+
+#endif
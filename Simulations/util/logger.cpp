@@ -0,0 +1,326 @@
+#include "logger.h"
+#include "memorytags.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+enum RecordType : uint32_t {
+	RECORD_TEXT,   // payload: the characters
+	RECORD_EVENT,  // payload: double value, then the name
+	RECORD_POINTS, // payload: int32 first, count, then count values of px, py, pz, vx, vy, vz
+};
+
+struct RecordHeader
+{
+	uint64_t sequence; // global order of the records of all threads
+	uint32_t type;
+	uint32_t bytes;    // payload, padded to 8 bytes
+};
+
+// One writer, the owning thread, and one reader, the formatter. head and tail
+// count all bytes ever written and read; byte i lives at i % LOG_RING_BYTES.
+struct LogRing
+{
+	TaggedVector<char, MEMORY_TAG_DIAGNOSTICS> buffer;
+	std::atomic<uint64_t> head;
+	std::atomic<uint64_t> tail;
+	std::atomic<uint64_t> written; // tail once the text of the records reached the output
+};
+
+struct Piece
+{
+	const void* data;
+	size_t bytes;
+};
+
+std::mutex s_registryMutex;
+// rings are never freed, like the profiler's
+std::vector<std::unique_ptr<LogRing>> s_rings;
+thread_local LogRing* t_ring = nullptr;
+
+std::atomic<uint64_t> s_sequence(0);
+uint64_t s_nextSequence = 0; // of the next record to write, formatter thread only
+std::atomic<uint64_t> s_dropped(0);
+std::atomic<std::ostream*> s_output(&std::cout);
+
+std::mutex s_threadMutex;
+std::thread s_thread;
+std::atomic<bool> s_bRunning(false);
+std::atomic<bool> s_bStop(false);
+std::atomic<bool> s_bReady(false);
+
+// text is written out in pieces of about this size, so the formatter's
+// buffers are sized once and it does not allocate while it runs
+const size_t TEXT_BATCH_BYTES = 64 * 1024;
+const size_t LINE_BYTES = 192;
+
+LogRing& localRing()
+{
+	if (!t_ring) {
+		std::unique_ptr<LogRing> ring(new LogRing());
+		ring->buffer.resize(LOG_RING_BYTES);
+		ring->head = 0;
+		ring->tail = 0;
+		ring->written = 0;
+		std::lock_guard<std::mutex> lock(s_registryMutex);
+		t_ring = ring.get();
+		s_rings.push_back(std::move(ring));
+	}
+	return *t_ring;
+}
+
+// refills rings, which keeps its capacity
+void collectRings(std::vector<LogRing*>& rings)
+{
+	std::lock_guard<std::mutex> lock(s_registryMutex);
+	rings.clear();
+	for (const auto& ring : s_rings) rings.push_back(ring.get());
+}
+
+void writeText(std::string& text)
+{
+	std::ostream* out = s_output.load();
+	if (out && !text.empty()) {
+		out->write(text.data(), text.size());
+		out->flush();
+	}
+	text.clear();
+}
+
+void copyIn(LogRing& ring, uint64_t position, const void* data, size_t bytes)
+{
+	const size_t offset = (size_t)(position % LOG_RING_BYTES);
+	const size_t first = std::min(bytes, (size_t)LOG_RING_BYTES - offset);
+	std::memcpy(&ring.buffer[offset], data, first);
+	if (first < bytes) std::memcpy(&ring.buffer[0], (const char*)data + first, bytes - first);
+}
+
+void copyOut(const LogRing& ring, uint64_t position, void* data, size_t bytes)
+{
+	const size_t offset = (size_t)(position % LOG_RING_BYTES);
+	const size_t first = std::min(bytes, (size_t)LOG_RING_BYTES - offset);
+	std::memcpy(data, &ring.buffer[offset], first);
+	if (first < bytes) std::memcpy((char*)data + first, &ring.buffer[0], bytes - first);
+}
+
+// formats the records of all rings in sequence order; false if there were
+// none. A thread takes its sequence number before it publishes the record, so
+// a lower number may still be on its way while a higher one is visible:
+// isWaiting tells that the pass stopped at such a gap.
+bool drain(const std::vector<LogRing*>& rings, std::string& text, std::vector<char>& payload, bool& isWaiting)
+{
+	bool any = false;
+	isWaiting = false;
+	for (;;) {
+		LogRing* next = nullptr;
+		RecordHeader header, candidate;
+		for (LogRing* ring : rings) {
+			const uint64_t tail = ring->tail.load(std::memory_order_relaxed);
+			if (tail == ring->head.load(std::memory_order_acquire)) continue;
+			copyOut(*ring, tail, &candidate, sizeof(candidate));
+			if (!next || candidate.sequence < header.sequence) {
+				next = ring;
+				header = candidate;
+			}
+		}
+		if (!next) break;
+		if (header.sequence != s_nextSequence) {
+			isWaiting = true;
+			break;
+		}
+		any = true;
+		++s_nextSequence;
+
+		const uint64_t tail = next->tail.load(std::memory_order_relaxed);
+		payload.resize(header.bytes);
+		copyOut(*next, tail + sizeof(header), payload.data(), header.bytes);
+		next->tail.store(tail + sizeof(header) + header.bytes, std::memory_order_release);
+
+		char line[LINE_BYTES];
+		if (header.type == RECORD_TEXT) {
+			text.append(payload.data(), strnlen(payload.data(), header.bytes));
+			text += '\n';
+		}
+		else if (header.type == RECORD_EVENT) {
+			double value;
+			std::memcpy(&value, payload.data(), sizeof(value));
+			const char* name = payload.data() + sizeof(value);
+			std::snprintf(line, sizeof(line), "%.*s = %g\n", (int)strnlen(name, header.bytes - sizeof(value)), name, value);
+			text += line;
+		}
+		else if (header.type == RECORD_POINTS) {
+			int32_t range[2];
+			std::memcpy(range, payload.data(), sizeof(range));
+			const double* columns = (const double*)(payload.data() + sizeof(range));
+			const int count = range[1];
+			for (int i = 0; i < count; ++i) {
+				std::snprintf(line, sizeof(line), "Point %d: position = <%f,%f,%f>; velocity = <%f,%f,%f>\n", range[0] + i,
+					columns[i], columns[count + i], columns[2 * count + i],
+					columns[3 * count + i], columns[4 * count + i], columns[5 * count + i]);
+				text += line;
+				if (text.size() >= TEXT_BATCH_BYTES) writeText(text);
+			}
+		}
+		if (text.size() >= TEXT_BATCH_BYTES) writeText(text);
+	}
+	return any;
+}
+
+void formatterLoop()
+{
+	profilerSetThreadName("log");
+	std::vector<LogRing*> rings;
+	rings.reserve(64);
+	std::string text;
+	text.reserve(TEXT_BATCH_BYTES + LOG_TEXT_MAX + LINE_BYTES);
+	std::vector<char> payload;
+	payload.reserve(2 * sizeof(int32_t) + 6 * LOG_POINTS_PER_RECORD * sizeof(double));
+	s_bReady = true;
+
+	uint64_t reportedDrops = 0;
+	for (;;) {
+		const bool isStopping = s_bStop.load();
+		collectRings(rings);
+		bool isWaiting;
+		const bool any = drain(rings, text, payload, isWaiting);
+		const uint64_t dropped = s_dropped.load(std::memory_order_relaxed);
+		if (dropped != reportedDrops) {
+			text += "(" + std::to_string(dropped - reportedDrops) + " log records dropped, queue full)\n";
+			reportedDrops = dropped;
+		}
+		writeText(text);
+		for (LogRing* ring : rings) ring->written.store(ring->tail.load(std::memory_order_relaxed), std::memory_order_release);
+		if (isWaiting) {
+			// the missing record is being copied right now
+			std::this_thread::yield();
+		}
+		else if (!any) {
+			// the last pass after the stop request found nothing left
+			if (isStopping) break;
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+}
+
+void ensureStarted()
+{
+	if (s_bRunning.load(std::memory_order_acquire)) return;
+	std::lock_guard<std::mutex> lock(s_threadMutex);
+	if (s_bRunning.load()) return;
+	s_bStop = false;
+	s_bReady = false;
+	s_thread = std::thread(formatterLoop);
+	// the formatter sets itself up before the caller goes on, so its few
+	// allocations do not land in the middle of a simulation step
+	while (!s_bReady.load()) std::this_thread::yield();
+	s_bRunning = true;
+}
+
+// appends one record made of pieces to the caller's ring
+void push(RecordType type, const Piece* pieces, int count)
+{
+	ensureStarted();
+	size_t bytes = 0;
+	for (int i = 0; i < count; ++i) bytes += pieces[i].bytes;
+	const size_t padded = (bytes + 7) & ~(size_t)7;
+	const size_t needed = sizeof(RecordHeader) + padded;
+
+	LogRing& ring = localRing();
+	const uint64_t head = ring.head.load(std::memory_order_relaxed);
+	if (needed > LOG_RING_BYTES - (head - ring.tail.load(std::memory_order_acquire))) {
+		s_dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	RecordHeader header;
+	header.sequence = s_sequence.fetch_add(1, std::memory_order_relaxed);
+	header.type = type;
+	header.bytes = (uint32_t)padded;
+	copyIn(ring, head, &header, sizeof(header));
+	uint64_t position = head + sizeof(header);
+	for (int i = 0; i < count; ++i) {
+		copyIn(ring, position, pieces[i].data, pieces[i].bytes);
+		position += pieces[i].bytes;
+	}
+	// text is read up to the first zero
+	const uint64_t zeros = 0;
+	copyIn(ring, position, &zeros, padded - bytes);
+	ring.head.store(head + needed, std::memory_order_release);
+}
+
+// stops the formatter when the program ends without logShutdown()
+struct ShutdownAtExit
+{
+	~ShutdownAtExit() { logShutdown(); }
+} s_shutdownAtExit;
+
+}
+
+void logSetOutput(std::ostream* out)
+{
+	s_output = out;
+}
+
+void logText(const char* text)
+{
+	const Piece piece = { text, strnlen(text, LOG_TEXT_MAX) };
+	push(RECORD_TEXT, &piece, 1);
+}
+
+void logEvent(const char* name, double value)
+{
+	const Piece pieces[] = { { &value, sizeof(value) }, { name, strnlen(name, LOG_TEXT_MAX) } };
+	push(RECORD_EVENT, pieces, 2);
+}
+
+void logPointStates(const double* px, const double* py, const double* pz,
+	const double* vx, const double* vy, const double* vz, int first, int count)
+{
+	for (int begin = first; begin < first + count; begin += LOG_POINTS_PER_RECORD) {
+		const int32_t range[2] = { begin, std::min(LOG_POINTS_PER_RECORD, first + count - begin) };
+		const size_t bytes = range[1] * sizeof(double);
+		const Piece pieces[] = { { range, sizeof(range) },
+			{ px + begin, bytes }, { py + begin, bytes }, { pz + begin, bytes },
+			{ vx + begin, bytes }, { vy + begin, bytes }, { vz + begin, bytes } };
+		push(RECORD_POINTS, pieces, 7);
+	}
+}
+
+void logFlush()
+{
+	if (!s_bRunning.load()) return;
+	std::vector<LogRing*> rings;
+	collectRings(rings);
+	std::vector<std::pair<LogRing*, uint64_t>> targets;
+	for (LogRing* ring : rings) targets.push_back(std::make_pair(ring, ring->head.load(std::memory_order_acquire)));
+	for (const auto& target : targets) {
+		while (target.first->written.load(std::memory_order_acquire) < target.second && s_bRunning.load()) {
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+}
+
+void logShutdown()
+{
+	std::lock_guard<std::mutex> lock(s_threadMutex);
+	if (!s_bRunning.load()) return;
+	s_bStop = true;
+	s_thread.join();
+	s_bRunning = false;
+}
+
+uint64_t logDroppedRecords()
+{
+	return s_dropped.load();
+}
@@ -0,0 +1,49 @@
+#ifndef __logger_h__
+#define __logger_h__
+
+#include <stdint.h>
+#include <ostream>
+
+/*
+// simple example:
+
+logText("Euler:");
+logPointStates(px.data(), py.data(), pz.data(), vx.data(), vy.data(), vz.data(), 0, n);
+logEvent("energy drift", 0.012);
+...
+logFlush();                // waits until the lines above are written
+logShutdown();             // at exit, drains the queues and stops the thread
+
+*/
+
+// Asynchronous log. Callers only copy binary records into a queue of their
+// own thread; a background thread formats them and writes the text to the
+// output, so a dump of a large scene does not stall the step that logs it.
+// The queues are fixed size single producer rings: a record that does not
+// fit is dropped and counted instead of blocking the caller, and the output
+// notes how many were lost. Records of all threads are written in the order
+// they were logged. The formatter thread starts with the first record.
+
+#define LOG_RING_BYTES (4u << 20)      // per logging thread
+#define LOG_TEXT_MAX 256               // longer text is cut
+#define LOG_POINTS_PER_RECORD 256      // logPointStates splits into records of this size
+
+// where the text goes, std::cout by default; nullptr discards it
+void logSetOutput(std::ostream* out);
+
+void logText(const char* text);
+// "name = value"
+void logEvent(const char* name, double value);
+// "Point i: position = <x,y,z>; velocity = <x,y,z>" for i in [first, first + count),
+// reading the structure-of-arrays columns of a MassPointStore
+void logPointStates(const double* px, const double* py, const double* pz,
+	const double* vx, const double* vy, const double* vz, int first, int count);
+
+// Blocks until every record logged before the call is written.
+void logFlush();
+// Drains the queues and stops the formatter thread; logging again restarts it.
+void logShutdown();
+// records lost to full queues since the start
+uint64_t logDroppedRecords();
+
+#endif
@@ -4,7 +4,9 @@
  *
  *****************************************************************************/
 #include "vectorbase.h"
+#ifndef GAMEPHYSICS_HEADLESS
 #include <DirectXMath.h>
+#endif
 
 #ifndef MATRICES_H
 
@@ -20,8 +22,10 @@ class matrix4x4
 		inline matrix4x4(void );
 		// Copy-Constructor
 		inline matrix4x4(const matrix4x4<Scalar> &v );
+#ifndef GAMEPHYSICS_HEADLESS
 		// DirectX
 		inline matrix4x4(DirectX::XMMATRIX &m);
+#endif
 		// construct a matrix from one Scalar
 		inline matrix4x4(Scalar);
 		// construct a matrix from three Scalars
@@ -89,10 +93,12 @@ class matrix4x4
 		inline void initScaling(Scalar x, Scalar y, Scalar z);
 
 
+#ifndef GAMEPHYSICS_HEADLESS
 		inline Vec3 transformVectorNormal(Vec3 v);
 		inline Vec3 transformVector(Vec3 v);
 		inline DirectX::XMMATRIX toDirectXMatrix();
-		inline matrix4x4<Scalar> matrix4x4<Scalar>::inverse();
+		inline matrix4x4<Scalar> inverse();
+#endif
 
 		//! from 16 value array (init id if all 0)
 		inline void initFromArray(Scalar *array);
@@ -184,14 +190,16 @@ inline matrix4x4<Scalar>::matrix4x4( const matrix4x4<Scalar> &v )
   value[3][0] = v.value[3][0]; value[3][1] = v.value[3][1]; value[3][2] = v.value[3][2]; value[3][3] = v.value[3][3];
 }
 
+#ifndef GAMEPHYSICS_HEADLESS
 template<class Scalar>
 inline matrix4x4<Scalar>::matrix4x4(DirectX::XMMATRIX &m )
 {
 	for(int i =0;i<4;i++)
 	{
-		value[i][0] = XMVectorGetX(m.r[i]); value[i][1] = XMVectorGetY(m.r[i]); value[i][2] = XMVectorGetZ(m.r[i]); value[i][3] = XMVectorGetW(m.r[i]);
+		value[i][0] = DirectX::XMVectorGetX(m.r[i]); value[i][1] = DirectX::XMVectorGetY(m.r[i]); value[i][2] = DirectX::XMVectorGetZ(m.r[i]); value[i][3] = DirectX::XMVectorGetW(m.r[i]);
 	}
 }
+#endif
 
 
 /*************************************************************************
@@ -737,6 +745,7 @@ matrix4x4<Scalar>::initScaling(Scalar x, Scalar y, Scalar z)
 	value[1][1] = y;
 	value[2][2] = z;
 }
+#ifndef GAMEPHYSICS_HEADLESS
 // I will Think About cleaner way
 template<class Scalar>
 inline Vec3
@@ -763,7 +772,7 @@ inline matrix4x4<Scalar>
 matrix4x4<Scalar>::inverse()
 {
 	DirectX::XMMATRIX out = DirectX::XMMatrixInverse(nullptr,this->toDirectXMatrix());
-	Mat4 m(out);
+	matrix4x4<Scalar> m(out);
 	return m;
 }
 
@@ -771,12 +780,13 @@ template<class Scalar>
 inline DirectX::XMMATRIX
 matrix4x4<Scalar>::toDirectXMatrix()
 {
-	XMMATRIX m = XMMatrixSet(this->value[0][0],this->value[0][1],this->value[0][2],this->value[0][3],
+	DirectX::XMMATRIX m = DirectX::XMMatrixSet(this->value[0][0],this->value[0][1],this->value[0][2],this->value[0][3],
 							 this->value[1][0],this->value[1][1],this->value[1][2],this->value[1][3],
 							 this->value[2][0],this->value[2][1],this->value[2][2],this->value[2][3],
 							 this->value[3][0],this->value[3][1],this->value[3][2],this->value[3][3]);
 	return m;
 }
+#endif
 
 
 //! from 16 value array (init id if all 0)
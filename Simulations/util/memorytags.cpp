@@ -0,0 +1,111 @@
+#include "memorytags.h"
+
+#include <atomic>
+#include <cstdio>
+
+namespace {
+
+struct TagCounters
+{
+	std::atomic<int64_t> current;
+	std::atomic<int64_t> peak;
+	std::atomic<uint64_t> allocations;
+	std::atomic<uint64_t> frees;
+};
+
+// zero initialised as a static
+TagCounters s_tags[MEMORY_TAG_COUNT];
+
+const char* const TAG_NAMES[MEMORY_TAG_COUNT] = {
+	"scene arena (free)",
+	"points",
+	"springs",
+	"topology",
+	"solver",
+	"collision",
+	"diagnostics",
+	"recorder",
+	"other",
+};
+
+void add(MemoryTag tag, int64_t bytes)
+{
+	TagCounters& c = s_tags[tag];
+	const int64_t current = c.current.fetch_add(bytes, std::memory_order_relaxed) + bytes;
+	int64_t peak = c.peak.load(std::memory_order_relaxed);
+	while (current > peak && !c.peak.compare_exchange_weak(peak, current, std::memory_order_relaxed)) {
+	}
+}
+
+}
+
+const char* memoryTagName(MemoryTag tag)
+{
+	return tag >= 0 && tag < MEMORY_TAG_COUNT ? TAG_NAMES[tag] : "invalid";
+}
+
+void memoryTrackAllocation(MemoryTag tag, size_t bytes)
+{
+	add(tag, (int64_t)bytes);
+	s_tags[tag].allocations.fetch_add(1, std::memory_order_relaxed);
+}
+
+void memoryTrackFree(MemoryTag tag, size_t bytes)
+{
+	add(tag, -(int64_t)bytes);
+	s_tags[tag].frees.fetch_add(1, std::memory_order_relaxed);
+}
+
+void memoryTrackHandOut(MemoryTag pool, MemoryTag user, size_t bytes)
+{
+	add(pool, -(int64_t)bytes);
+	memoryTrackAllocation(user, bytes);
+}
+
+void memoryTrackTakeBack(MemoryTag pool, MemoryTag user, size_t bytes)
+{
+	memoryTrackFree(user, bytes);
+	add(pool, (int64_t)bytes);
+}
+
+MemoryTagStats memoryTagStats(MemoryTag tag)
+{
+	const TagCounters& c = s_tags[tag];
+	MemoryTagStats stats;
+	stats.currentBytes = c.current.load(std::memory_order_relaxed);
+	stats.peakBytes = c.peak.load(std::memory_order_relaxed);
+	stats.allocations = c.allocations.load(std::memory_order_relaxed);
+	stats.frees = c.frees.load(std::memory_order_relaxed);
+	return stats;
+}
+
+int64_t memoryTotalBytes()
+{
+	int64_t total = 0;
+	for (int t = 0; t < MEMORY_TAG_COUNT; ++t) total += s_tags[t].current.load(std::memory_order_relaxed);
+	return total;
+}
+
+void memoryResetPeaks()
+{
+	for (int t = 0; t < MEMORY_TAG_COUNT; ++t) {
+		s_tags[t].peak.store(s_tags[t].current.load(std::memory_order_relaxed), std::memory_order_relaxed);
+	}
+}
+
+std::string memoryReport()
+{
+	std::string report;
+	char line[160];
+	std::snprintf(line, sizeof(line), "%-20s %14s %14s %12s %12s\n", "memory tag", "current KiB", "peak KiB", "allocations", "frees");
+	report += line;
+	for (int t = 0; t < MEMORY_TAG_COUNT; ++t) {
+		const MemoryTagStats s = memoryTagStats((MemoryTag)t);
+		std::snprintf(line, sizeof(line), "%-20s %14.1f %14.1f %12llu %12llu\n", memoryTagName((MemoryTag)t),
+			s.currentBytes / 1024.0, s.peakBytes / 1024.0, (unsigned long long)s.allocations, (unsigned long long)s.frees);
+		report += line;
+	}
+	std::snprintf(line, sizeof(line), "%-20s %14.1f\n", "total", memoryTotalBytes() / 1024.0);
+	report += line;
+	return report;
+}
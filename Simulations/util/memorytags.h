@@ -0,0 +1,103 @@
+#ifndef __memorytags_h__
+#define __memorytags_h__
+
+#include <cstddef>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "alignedalloc.h"
+
+/*
+// simple example:
+
+TaggedVector<int, MEMORY_TAG_TOPOLOGY> offsets; // counted while it holds memory
+offsets.resize(1000);
+
+MemoryTagStats stats = memoryTagStats(MEMORY_TAG_TOPOLOGY);
+std::cout << stats.currentBytes << " bytes, peak " << stats.peakBytes << "\n";
+std::cout << memoryReport();
+
+*/
+
+// Process wide memory accounting by subsystem. Containers allocate through
+// a tagged allocator, which adds to the current and peak bytes and the
+// allocation count of its tag; all counters are atomics, so accounting
+// takes no lock. A pool such as the SceneArena counts the memory it holds
+// under its own tag and hands bytes over to the tag of the container using
+// them, so the tags add up to the memory actually taken from the system.
+
+enum MemoryTag {
+	MEMORY_TAG_SCENE_ARENA,  // arena blocks not handed out yet
+	MEMORY_TAG_POINTS,
+	MEMORY_TAG_SPRINGS,
+	MEMORY_TAG_TOPOLOGY,     // adjacency and colouring
+	MEMORY_TAG_SOLVER,       // integrator and solver scratch, saved states
+	MEMORY_TAG_COLLISION,    // broadphase structures and contact lists
+	MEMORY_TAG_DIAGNOSTICS,  // energy history and other monitoring
+	MEMORY_TAG_RECORDER,     // video frame buffers
+	MEMORY_TAG_OTHER,
+	MEMORY_TAG_COUNT
+};
+
+struct MemoryTagStats
+{
+	int64_t currentBytes;
+	int64_t peakBytes;   // since start or the last memoryResetPeaks()
+	uint64_t allocations;
+	uint64_t frees;
+};
+
+const char* memoryTagName(MemoryTag tag);
+
+void memoryTrackAllocation(MemoryTag tag, size_t bytes);
+void memoryTrackFree(MemoryTag tag, size_t bytes);
+// A pool handing bytes to a user counts as an allocation of the user, not
+// as a free of the pool; taking them back counts as a free of the user.
+void memoryTrackHandOut(MemoryTag pool, MemoryTag user, size_t bytes);
+void memoryTrackTakeBack(MemoryTag pool, MemoryTag user, size_t bytes);
+
+MemoryTagStats memoryTagStats(MemoryTag tag);
+// current bytes of all tags
+int64_t memoryTotalBytes();
+// sets every peak to the current value
+void memoryResetPeaks();
+// one line per tag with current, peak, allocations and frees
+std::string memoryReport();
+
+// std allocator adapter counting into Tag, aligned like AlignedAllocator.
+template<class T, MemoryTag Tag>
+class TaggedAllocator
+{
+public:
+	typedef T value_type;
+	template<class U> struct rebind { typedef TaggedAllocator<U, Tag> other; };
+
+	TaggedAllocator() {}
+	template<class U> TaggedAllocator(const TaggedAllocator<U, Tag>&) {}
+
+	T* allocate(size_t n)
+	{
+		if (n == 0) return nullptr;
+		void* p = alignedMalloc(n * sizeof(T), GP_SIMD_ALIGNMENT);
+		if (!p) throw std::bad_alloc();
+		memoryTrackAllocation(Tag, n * sizeof(T));
+		return static_cast<T*>(p);
+	}
+
+	void deallocate(T* p, size_t n)
+	{
+		if (!p) return;
+		memoryTrackFree(Tag, n * sizeof(T));
+		alignedFree(p);
+	}
+};
+
+template<class T, class U, MemoryTag Tag>
+inline bool operator==(const TaggedAllocator<T, Tag>&, const TaggedAllocator<U, Tag>&) { return true; }
+template<class T, class U, MemoryTag Tag>
+inline bool operator!=(const TaggedAllocator<T, Tag>&, const TaggedAllocator<U, Tag>&) { return false; }
+
+template<class T, MemoryTag Tag>
+using TaggedVector = std::vector<T, TaggedAllocator<T, Tag> >;
+
+#endif
@@ -0,0 +1,198 @@
+#include "metrics.h"
+#include "memorytags.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#  ifndef NOMINMAX
+#    define NOMINMAX
+#  endif
+#  include <windows.h>
+#endif
+
+namespace {
+
+struct MetricInfo
+{
+	const char* name; // without the gamephysics_ prefix
+	const char* help;
+};
+
+const MetricInfo METRICS[METRIC_COUNT] = {
+	{ "steps_total", "Simulation steps." },
+	{ "substeps_total", "Integrator steps, including the substeps of adaptive stepping." },
+	{ "rejected_substeps_total", "Adaptive steps rejected and retried with a smaller step." },
+	{ "force_evaluations_total", "Force evaluations." },
+	{ "solver_iterations_total", "Iterations of the implicit solver." },
+	{ "collision_pairs_total", "Contacts resolved." },
+	{ "simulated_seconds", "Simulated time of the last step." },
+	{ "energy_drift_ratio", "Relative energy drift while the energy monitor runs." },
+	{ "points", "Mass points of the scene." },
+	{ "springs", "Springs of the scene." },
+};
+
+std::atomic<uint64_t> s_counters[METRIC_COUNTER_COUNT];
+std::atomic<double> s_gauges[METRIC_COUNT - METRIC_COUNTER_COUNT];
+
+typedef std::chrono::steady_clock Clock;
+
+// previous metricsText() call, for the rates
+std::mutex s_textMutex;
+Clock::time_point s_lastTextTime = Clock::now();
+uint64_t s_lastCounters[METRIC_COUNTER_COUNT];
+
+std::mutex s_exportMutex;
+std::condition_variable s_exportWake;
+std::thread s_exportThread;
+std::string s_exportPath;
+std::chrono::milliseconds s_exportInterval(0);
+bool s_bExportStop = false;
+
+void appendMetric(std::string& text, const char* name, const char* help, const char* type)
+{
+	text += "# HELP gamephysics_";
+	text += name;
+	text += " ";
+	text += help;
+	text += "\n# TYPE gamephysics_";
+	text += name;
+	text += " ";
+	text += type;
+	text += "\n";
+}
+
+void appendValue(std::string& text, const char* name, const char* labels, double value)
+{
+	char line[160];
+	std::snprintf(line, sizeof(line), "gamephysics_%s%s %.17g\n", name, labels, value);
+	text += line;
+}
+
+// replaces path through a temporary file, so readers see the old or the new text
+bool writeFile(const std::string& path, const std::string& text)
+{
+	const std::string temporary = path + ".tmp";
+	{
+		std::ofstream out(temporary.c_str(), std::ios::out | std::ios::trunc | std::ios::binary);
+		if (!out) return false;
+		out << text;
+		if (!out) return false;
+	}
+#ifdef _WIN32
+	return MoveFileExA(temporary.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+	return std::rename(temporary.c_str(), path.c_str()) == 0;
+#endif
+}
+
+void exportLoop()
+{
+	std::unique_lock<std::mutex> lock(s_exportMutex);
+	for (;;) {
+		const bool isStopping = s_exportWake.wait_for(lock, s_exportInterval, []() { return s_bExportStop; });
+		writeFile(s_exportPath, metricsText());
+		if (isStopping) break;
+	}
+}
+
+// a joinable std::thread must not be destroyed
+struct StopAtExit
+{
+	~StopAtExit() { metricsStopExport(); }
+} s_stopAtExit;
+
+}
+
+const char* metricName(Metric metric)
+{
+	return metric >= 0 && metric < METRIC_COUNT ? METRICS[metric].name : "invalid";
+}
+
+void metricAdd(Metric counter, uint64_t amount)
+{
+	s_counters[counter].fetch_add(amount, std::memory_order_relaxed);
+}
+
+void metricSet(Metric gauge, double value)
+{
+	s_gauges[gauge - METRIC_COUNTER_COUNT].store(value, std::memory_order_relaxed);
+}
+
+double metricValue(Metric metric)
+{
+	if (metric < METRIC_COUNTER_COUNT) return (double)s_counters[metric].load(std::memory_order_relaxed);
+	return s_gauges[metric - METRIC_COUNTER_COUNT].load(std::memory_order_relaxed);
+}
+
+std::string metricsText()
+{
+	// one consistent read of the counters for the totals and the rates
+	uint64_t counters[METRIC_COUNTER_COUNT];
+	for (int m = 0; m < METRIC_COUNTER_COUNT; ++m) counters[m] = s_counters[m].load(std::memory_order_relaxed);
+
+	std::string text;
+	for (int m = 0; m < METRIC_COUNT; ++m) {
+		const bool isCounter = m < METRIC_COUNTER_COUNT;
+		appendMetric(text, METRICS[m].name, METRICS[m].help, isCounter ? "counter" : "gauge");
+		appendValue(text, METRICS[m].name, "", isCounter ? (double)counters[m] : metricValue((Metric)m));
+	}
+
+	double seconds;
+	uint64_t steps, substeps;
+	{
+		std::lock_guard<std::mutex> lock(s_textMutex);
+		const Clock::time_point now = Clock::now();
+		seconds = std::chrono::duration<double>(now - s_lastTextTime).count();
+		steps = counters[METRIC_STEPS] - s_lastCounters[METRIC_STEPS];
+		substeps = counters[METRIC_SUBSTEPS] - s_lastCounters[METRIC_SUBSTEPS];
+		s_lastTextTime = now;
+		for (int m = 0; m < METRIC_COUNTER_COUNT; ++m) s_lastCounters[m] = counters[m];
+	}
+	appendMetric(text, "steps_per_second", "Steps per second since the previous export.", "gauge");
+	appendValue(text, "steps_per_second", "", seconds > 0 ? steps / seconds : 0);
+	appendMetric(text, "substeps_per_step", "Integrator steps per simulation step since the previous export.", "gauge");
+	appendValue(text, "substeps_per_step", "", steps ? (double)substeps / steps : 0);
+
+	char labels[64];
+	appendMetric(text, "memory_bytes", "Memory in use per subsystem.", "gauge");
+	for (int tag = 0; tag < MEMORY_TAG_COUNT; ++tag) {
+		std::snprintf(labels, sizeof(labels), "{subsystem=\"%s\"}", memoryTagName((MemoryTag)tag));
+		appendValue(text, "memory_bytes", labels, (double)memoryTagStats((MemoryTag)tag).currentBytes);
+	}
+	appendMetric(text, "memory_peak_bytes", "Peak memory per subsystem.", "gauge");
+	for (int tag = 0; tag < MEMORY_TAG_COUNT; ++tag) {
+		std::snprintf(labels, sizeof(labels), "{subsystem=\"%s\"}", memoryTagName((MemoryTag)tag));
+		appendValue(text, "memory_peak_bytes", labels, (double)memoryTagStats((MemoryTag)tag).peakBytes);
+	}
+	return text;
+}
+
+bool metricsStartExport(const std::string& path, double intervalSeconds)
+{
+	metricsStopExport();
+	if (!writeFile(path, metricsText())) return false;
+	std::lock_guard<std::mutex> lock(s_exportMutex);
+	s_exportPath = path;
+	s_exportInterval = std::chrono::milliseconds(std::max(1LL, (long long)(intervalSeconds * 1000)));
+	s_bExportStop = false;
+	s_exportThread = std::thread(exportLoop);
+	return true;
+}
+
+void metricsStopExport()
+{
+	{
+		std::lock_guard<std::mutex> lock(s_exportMutex);
+		if (!s_exportThread.joinable()) return;
+		s_bExportStop = true;
+	}
+	s_exportWake.notify_all();
+	s_exportThread.join();
+}
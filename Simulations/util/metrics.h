@@ -0,0 +1,61 @@
+#ifndef __metrics_h__
+#define __metrics_h__
+
+#include <stdint.h>
+#include <string>
+
+/*
+// simple example:
+
+metricsStartExport("sim.prom", 5.0);   // rewritten every 5 s by a background thread
+for (...) {
+	metricAdd(METRIC_STEPS);            // a relaxed atomic add, no lock
+	metricSet(METRIC_ENERGY_DRIFT, drift);
+}
+metricsStopExport();
+
+*/
+
+// Process wide simulation metrics for long headless runs. The simulation
+// updates counters and gauges with relaxed atomics; an exporter thread
+// periodically renders them in the Prometheus text format, together with
+// the memory per subsystem (util/memorytags.h) and rates over the last
+// export interval, and replaces the file atomically. Point a node_exporter
+// textfile collector at it, or just watch the file.
+
+enum Metric {
+	// counters, only ever grow
+	METRIC_STEPS,              // simulateTimestep calls
+	METRIC_SUBSTEPS,           // integrator steps, more than steps with adaptive stepping
+	METRIC_REJECTED_SUBSTEPS,  // adaptive steps retried with a smaller step
+	METRIC_FORCE_EVALUATIONS,
+	METRIC_SOLVER_ITERATIONS,  // implicit solver iterations
+	METRIC_COLLISION_PAIRS,    // contacts resolved, e.g. point and floor
+	METRIC_COUNTER_COUNT,
+	// gauges, the last value set
+	METRIC_SIMULATED_SECONDS = METRIC_COUNTER_COUNT,
+	METRIC_ENERGY_DRIFT,       // relative, see EnergyMonitor
+	METRIC_POINTS,
+	METRIC_SPRINGS,
+	METRIC_COUNT
+};
+
+const char* metricName(Metric metric);
+
+void metricAdd(Metric counter, uint64_t amount = 1);
+void metricSet(Metric gauge, double value);
+double metricValue(Metric metric);
+
+// Prometheus text exposition of all metrics and the memory per subsystem.
+// The rates (steps per second, substeps per step) cover the time since the
+// previous call, or since the start for the first one.
+std::string metricsText();
+
+// Starts a thread rewriting path every intervalSeconds (through a temporary
+// file and a rename, so readers never see half a file). Returns false if
+// path cannot be written. A running export is stopped first.
+bool metricsStartExport(const std::string& path, double intervalSeconds);
+// Writes the file one last time and stops the thread.
+void metricsStopExport();
+
+#endif
@@ -0,0 +1,340 @@
+#include "perfcounters.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <mutex>
+
+#ifdef __linux__
+#  include <linux/perf_event.h>
+#  include <sys/syscall.h>
+#  include <unistd.h>
+#endif
+
+namespace {
+
+struct PhaseTotals
+{
+	const char* name;
+	uint64_t calls;
+	uint64_t ticks;
+	double counters[PERF_COUNTER_COUNT];
+	bool counted[PERF_COUNTER_COUNT]; // received a value at least once
+};
+
+// Owned by the registry, so the totals outlive their thread. The counters
+// themselves are closed when the thread exits.
+struct ThreadCounters
+{
+	std::mutex mutex; // guards phases against collection, never contended otherwise
+	std::vector<PhaseTotals> phases;
+	uint32_t thread;
+	int fds[PERF_COUNTER_COUNT];  // -1 where the counter could not be opened
+	int slot[PERF_COUNTER_COUNT]; // position in the group read
+	int leader;                   // fd read for the whole group, -1 without counters
+	std::string failure;          // why no counter could be opened
+};
+
+struct LocalCounters
+{
+	ThreadCounters* counters = nullptr;
+	~LocalCounters();
+};
+
+std::mutex s_registryMutex;
+std::vector<std::unique_ptr<ThreadCounters>> s_threads;
+std::atomic<bool> s_bEnabled(false);
+std::string s_status = "performance counters are not enabled";
+std::string s_dumpPath;
+bool s_bDumpRegistered = false;
+thread_local LocalCounters t_local;
+
+#ifdef __linux__
+const uint64_t EVENT_CONFIGS[PERF_COUNTER_COUNT] = {
+	PERF_COUNT_HW_CPU_CYCLES,
+	PERF_COUNT_HW_INSTRUCTIONS,
+	PERF_COUNT_HW_CACHE_REFERENCES,
+	PERF_COUNT_HW_CACHE_MISSES,
+	PERF_COUNT_HW_BRANCH_INSTRUCTIONS,
+	PERF_COUNT_HW_BRANCH_MISSES,
+};
+
+int openCounter(uint64_t config, int groupFd)
+{
+	perf_event_attr attr;
+	std::memset(&attr, 0, sizeof(attr));
+	attr.size = sizeof(attr);
+	attr.type = PERF_TYPE_HARDWARE;
+	attr.config = config;
+	// user space only, which the default perf_event_paranoid level allows
+	attr.exclude_kernel = 1;
+	attr.exclude_hv = 1;
+	attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+	return (int)syscall(__NR_perf_event_open, &attr, 0, -1, groupFd, 0);
+}
+#endif
+
+void openCounters(ThreadCounters& c)
+{
+	int opened = 0;
+	for (int i = 0; i < PERF_COUNTER_COUNT; ++i) c.fds[i] = c.slot[i] = -1;
+	c.leader = -1;
+#ifdef __linux__
+	int error = 0;
+	for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+		const int fd = openCounter(EVENT_CONFIGS[i], c.leader);
+		if (fd < 0) {
+			error = errno;
+			continue;
+		}
+		if (c.leader < 0) c.leader = fd;
+		c.fds[i] = fd;
+		c.slot[i] = opened++;
+	}
+	if (opened) return;
+	c.failure = std::string("perf_event_open failed: ") + std::strerror(error);
+	if (error == EACCES || error == EPERM) c.failure += " (lower /proc/sys/kernel/perf_event_paranoid or grant CAP_PERFMON)";
+	else if (error == ENOSYS) c.failure += " (the syscall is blocked, e.g. by a container seccomp profile)";
+	else if (error == ENOENT || error == EOPNOTSUPP) c.failure += " (no hardware counters, e.g. in a virtual machine)";
+#else
+	(void)opened;
+	c.failure = "hardware counters need Linux perf_event_open";
+#endif
+}
+
+void closeCounters(ThreadCounters& c)
+{
+#ifdef __linux__
+	for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+		if (c.fds[i] >= 0) close(c.fds[i]);
+	}
+#endif
+	std::lock_guard<std::mutex> lock(c.mutex);
+	for (int i = 0; i < PERF_COUNTER_COUNT; ++i) c.fds[i] = c.slot[i] = -1;
+	c.leader = -1;
+}
+
+LocalCounters::~LocalCounters()
+{
+	if (counters) closeCounters(*counters);
+}
+
+ThreadCounters& localCounters()
+{
+	if (!t_local.counters) {
+		std::unique_ptr<ThreadCounters> counters(new ThreadCounters());
+		counters->thread = profilerThreadIndex();
+		openCounters(*counters);
+		std::lock_guard<std::mutex> lock(s_registryMutex);
+		t_local.counters = counters.get();
+		s_threads.push_back(std::move(counters));
+	}
+	return *t_local.counters;
+}
+
+// Counter values in PerfCounter order followed by the time the group was
+// enabled and running. False if the thread has no counters.
+bool readCounters(const ThreadCounters& c, uint64_t* values)
+{
+#ifdef __linux__
+	if (c.leader < 0) return false;
+	// nr, time enabled, time running, one value per group member
+	uint64_t buffer[3 + PERF_COUNTER_COUNT];
+	if (read(c.leader, buffer, sizeof(buffer)) < (ssize_t)(3 * sizeof(uint64_t))) return false;
+	for (int i = 0; i < PERF_COUNTER_COUNT; ++i) values[i] = c.slot[i] >= 0 ? buffer[3 + c.slot[i]] : 0;
+	values[PERF_COUNTER_COUNT] = buffer[1];
+	values[PERF_COUNTER_COUNT + 1] = buffer[2];
+	return true;
+#else
+	(void)c;
+	(void)values;
+	return false;
+#endif
+}
+
+PhaseTotals& phaseTotals(ThreadCounters& c, const char* name)
+{
+	for (PhaseTotals& phase : c.phases) {
+		if (phase.name == name) return phase;
+	}
+	PhaseTotals phase = PhaseTotals();
+	phase.name = name;
+	c.phases.push_back(phase);
+	return c.phases.back();
+}
+
+void dumpReport()
+{
+	const std::string report = perfCountersReport();
+	if (s_dumpPath.empty()) {
+		std::fputs(report.c_str(), stdout);
+		std::fflush(stdout);
+		return;
+	}
+	FILE* file = std::fopen(s_dumpPath.c_str(), "w");
+	if (!file) {
+		std::fprintf(stderr, "cannot write %s\n", s_dumpPath.c_str());
+		return;
+	}
+	std::fputs(report.c_str(), file);
+	std::fclose(file);
+}
+
+}
+
+double PerfPhaseStats::instructionsPerCycle() const
+{
+	return has(PERF_CYCLES) && has(PERF_INSTRUCTIONS) && counters[PERF_CYCLES] > 0 ? counters[PERF_INSTRUCTIONS] / counters[PERF_CYCLES] : -1;
+}
+
+double PerfPhaseStats::cacheMissRate() const
+{
+	return has(PERF_CACHE_REFERENCES) && has(PERF_CACHE_MISSES) && counters[PERF_CACHE_REFERENCES] > 0 ? counters[PERF_CACHE_MISSES] / counters[PERF_CACHE_REFERENCES] : -1;
+}
+
+double PerfPhaseStats::branchMissRate() const
+{
+	return has(PERF_BRANCHES) && has(PERF_BRANCH_MISSES) && counters[PERF_BRANCHES] > 0 ? counters[PERF_BRANCH_MISSES] / counters[PERF_BRANCHES] : -1;
+}
+
+double PerfPhaseStats::bytesPerSecond() const
+{
+	// every last level miss moves one 64 byte line from memory
+	return has(PERF_CACHE_MISSES) && seconds > 0 ? counters[PERF_CACHE_MISSES] * 64 / seconds : -1;
+}
+
+bool perfCountersSetEnabled(bool enabled)
+{
+	if (!enabled) {
+		s_bEnabled = false;
+		return false;
+	}
+	ThreadCounters& c = localCounters();
+	{
+		std::lock_guard<std::mutex> lock(s_registryMutex);
+		s_status = c.failure;
+	}
+	s_bEnabled = true;
+	return c.leader >= 0;
+}
+
+bool perfCountersIsEnabled()
+{
+	return s_bEnabled.load(std::memory_order_relaxed);
+}
+
+std::string perfCountersStatus()
+{
+	std::lock_guard<std::mutex> lock(s_registryMutex);
+	return s_status;
+}
+
+void perfCountersCollect(std::vector<PerfPhaseStats>& stats)
+{
+	const double secondsPerTick = profilerNanosecondsPerTick() * 1e-9;
+	stats.clear();
+	std::lock_guard<std::mutex> lock(s_registryMutex);
+	for (const auto& c : s_threads) {
+		std::lock_guard<std::mutex> threadLock(c->mutex);
+		for (const PhaseTotals& phase : c->phases) {
+			PerfPhaseStats s;
+			s.phase = phase.name;
+			s.thread = c->thread;
+			s.calls = phase.calls;
+			s.seconds = phase.ticks * secondsPerTick;
+			for (int i = 0; i < PERF_COUNTER_COUNT; ++i) s.counters[i] = phase.counted[i] ? phase.counters[i] : -1;
+			stats.push_back(s);
+		}
+	}
+}
+
+void perfCountersClear()
+{
+	std::lock_guard<std::mutex> lock(s_registryMutex);
+	for (const auto& c : s_threads) {
+		std::lock_guard<std::mutex> threadLock(c->mutex);
+		c->phases.clear();
+	}
+}
+
+std::string perfCountersReport()
+{
+	std::vector<PerfPhaseStats> stats;
+	perfCountersCollect(stats);
+	std::vector<std::string> names;
+	profilerThreadNames(names);
+
+	std::string report;
+	const std::string status = perfCountersStatus();
+	if (!status.empty()) report += status + ", showing calls and time only\n";
+
+	char line[200];
+	char cells[4][16];
+	uint32_t thread = ~0u;
+	for (const PerfPhaseStats& s : stats) {
+		if (s.thread != thread) {
+			thread = s.thread;
+			std::snprintf(line, sizeof(line), "counters of thread %u %s\n%-24s %10s %12s %8s %10s %10s %10s\n", thread,
+				thread < names.size() ? names[thread].c_str() : "", "phase", "calls", "total ms", "IPC", "LLC miss", "br. miss", "GB/s");
+			report += line;
+		}
+		const double values[4] = { s.instructionsPerCycle(), s.cacheMissRate() * 100, s.branchMissRate() * 100, s.bytesPerSecond() * 1e-9 };
+		const char* formats[4] = { "%.2f", "%.2f%%", "%.2f%%", "%.2f" };
+		for (int i = 0; i < 4; ++i) {
+			if (values[i] >= 0) std::snprintf(cells[i], sizeof(cells[i]), formats[i], values[i]);
+			else std::snprintf(cells[i], sizeof(cells[i]), "n/a");
+		}
+		std::snprintf(line, sizeof(line), "%-24s %10llu %12.3f %8s %10s %10s %10s\n", s.phase, (unsigned long long)s.calls,
+			s.seconds * 1e3, cells[0], cells[1], cells[2], cells[3]);
+		report += line;
+	}
+	return report;
+}
+
+void perfCountersDumpAtExit(const char* path)
+{
+	std::lock_guard<std::mutex> lock(s_registryMutex);
+	s_dumpPath = path ? path : "";
+	if (!s_bDumpRegistered) {
+		std::atexit(dumpReport);
+		s_bDumpRegistered = true;
+	}
+}
+
+PerfPhase::PerfPhase(const char* name)
+	: m_name(name), m_bActive(perfCountersIsEnabled()), m_bCounting(false), m_startTicks(0)
+{
+	if (!m_bActive) return;
+	ThreadCounters& c = localCounters();
+	m_startTicks = profilerTicks();
+	// last, so the phase's own bookkeeping is not counted
+	m_bCounting = readCounters(c, m_start);
+}
+
+PerfPhase::~PerfPhase()
+{
+	if (!m_bActive) return;
+	uint64_t end[PERF_COUNTER_COUNT + 2];
+	ThreadCounters& c = *t_local.counters;
+	const bool isCounting = m_bCounting && readCounters(c, end);
+	const uint64_t endTicks = profilerTicks();
+
+	std::lock_guard<std::mutex> lock(c.mutex);
+	PhaseTotals& phase = phaseTotals(c, m_name);
+	phase.calls++;
+	phase.ticks += endTicks - m_startTicks;
+	const uint64_t enabled = end[PERF_COUNTER_COUNT] - m_start[PERF_COUNTER_COUNT];
+	const uint64_t running = end[PERF_COUNTER_COUNT + 1] - m_start[PERF_COUNTER_COUNT + 1];
+	// a group the PMU could not schedule in this interval has no data
+	if (!isCounting || running == 0) return;
+	// the kernel multiplexes groups when there are more than counters
+	const double scale = (double)enabled / running;
+	for (int i = 0; i < PERF_COUNTER_COUNT; ++i) {
+		if (c.slot[i] < 0) continue;
+		phase.counters[i] += (end[i] - m_start[i]) * scale;
+		phase.counted[i] = true;
+	}
+}
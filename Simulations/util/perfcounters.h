@@ -0,0 +1,103 @@
+#ifndef __perfcounters_h__
+#define __perfcounters_h__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "profiler.h"
+
+/*
+// simple example:
+
+if (!perfCountersSetEnabled(true))
+	std::cerr << perfCountersStatus() << "\n"; // phases still count calls and time
+perfCountersDumpAtExit();
+
+void computeForces()
+{
+	PERF_PHASE("computeForces");
+	...
+}
+
+*/
+
+// Hardware performance counters per phase and thread. Every thread opens
+// its own group of Linux perf_event_open counters (user space only) on its
+// first phase; a phase reads the group when it starts and ends and adds the
+// difference to its totals. A read is a system call, so phases belong
+// around whole passes, not inner loops. While disabled a phase costs one
+// atomic load.
+//
+// Where the kernel refuses the counters (perf_event_paranoid, containers
+// without the syscall, other platforms) phases still record calls and time,
+// and perfCountersStatus() says why. Counters the PMU cannot schedule or
+// does not have are reported as unavailable. Memory bandwidth is estimated
+// from last level cache misses, one cache line each.
+//
+// Defining GAMEPHYSICS_NO_PROFILE turns PERF_PHASE into nothing.
+
+enum PerfCounter {
+	PERF_CYCLES,
+	PERF_INSTRUCTIONS,
+	PERF_CACHE_REFERENCES, // last level cache accesses
+	PERF_CACHE_MISSES,     // last level cache misses
+	PERF_BRANCHES,
+	PERF_BRANCH_MISSES,
+	PERF_COUNTER_COUNT
+};
+
+struct PerfPhaseStats
+{
+	const char* phase; // the PERF_PHASE name
+	uint32_t thread;   // profiler thread index, see profilerThreadNames()
+	uint64_t calls;
+	double seconds;
+	// scaled for multiplexing, negative where the counter was unavailable
+	double counters[PERF_COUNTER_COUNT];
+
+	bool has(PerfCounter counter) const { return counters[counter] >= 0; }
+	double instructionsPerCycle() const;
+	double cacheMissRate() const;
+	double branchMissRate() const;
+	double bytesPerSecond() const;
+};
+
+// Enabling probes the counters on the calling thread and returns whether
+// they work. Phases entered while disabled are not recorded.
+bool perfCountersSetEnabled(bool enabled);
+bool perfCountersIsEnabled();
+// why hardware counters are unavailable, empty if they work
+std::string perfCountersStatus();
+
+// Totals of every phase and thread, ordered by thread, then by first finished call.
+void perfCountersCollect(std::vector<PerfPhaseStats>& stats);
+void perfCountersClear();
+// Table of the collected totals with IPC, miss rates and bandwidth.
+std::string perfCountersReport();
+// Writes perfCountersReport() to path, stdout if null, when the process exits.
+void perfCountersDumpAtExit(const char* path = nullptr);
+
+class PerfPhase
+{
+public:
+	explicit PerfPhase(const char* name);
+	~PerfPhase();
+
+private:
+	PerfPhase(const PerfPhase&);
+	PerfPhase& operator=(const PerfPhase&);
+
+	const char* m_name;
+	bool m_bActive;
+	bool m_bCounting; // the start values were read
+	uint64_t m_startTicks;
+	uint64_t m_start[PERF_COUNTER_COUNT + 2]; // counters, time enabled, time running
+};
+
+#ifdef GAMEPHYSICS_NO_PROFILE
+#  define PERF_PHASE(name) ((void)0)
+#else
+#  define PERF_PHASE(name) PerfPhase PROFILE_CONCAT(perfPhase, __LINE__)(name)
+#endif
+
+#endif
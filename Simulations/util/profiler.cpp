@@ -0,0 +1,253 @@
+#include "profiler.h"
+#include "cpuinfo.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <memory>
+#include <mutex>
+
+#ifdef GP_X86
+#  if defined(_MSC_VER)
+#    include <intrin.h>
+#  else
+#    include <x86intrin.h>
+#  endif
+#endif
+
+namespace {
+
+// Written only by its thread. head counts all events ever written, the
+// event with index i lives in slot i % PROFILER_RING_SIZE.
+struct ThreadRing
+{
+	ProfileEvent events[PROFILER_RING_SIZE];
+	std::atomic<uint64_t> head;
+	std::atomic<uint64_t> cleared; // events below this index were dropped by profilerClear
+	uint32_t depth;
+	uint32_t index;
+	char name[32];
+};
+
+std::mutex s_registryMutex;
+// rings are never freed, a thread that exits leaves its events readable
+std::vector<std::unique_ptr<ThreadRing>> s_rings;
+std::atomic<bool> s_bEnabled(true);
+thread_local ThreadRing* t_ring = nullptr;
+
+const bool s_bUseTsc = cpuFeatures().invariantTsc;
+
+uint64_t steadyNanoseconds()
+{
+	return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+// reference points for the TSC calibration
+const uint64_t s_calibrationNs = steadyNanoseconds();
+const uint64_t s_calibrationTicks = profilerTicks();
+
+ThreadRing& localRing()
+{
+	if (!t_ring) {
+		std::unique_ptr<ThreadRing> ring(new ThreadRing());
+		ring->head = 0;
+		ring->cleared = 0;
+		ring->depth = 0;
+		ring->name[0] = '\0';
+		std::lock_guard<std::mutex> lock(s_registryMutex);
+		ring->index = (uint32_t)s_rings.size();
+		t_ring = ring.get();
+		s_rings.push_back(std::move(ring));
+	}
+	return *t_ring;
+}
+
+// Appends the events with index in [begin, head) of a ring, minus those the
+// owner overwrote while they were copied; returns how many were dropped.
+uint64_t copyRing(const ThreadRing& ring, uint64_t begin, uint64_t head, std::vector<ProfileEvent>& events)
+{
+	const size_t first = events.size();
+	for (uint64_t i = begin; i < head; ++i) {
+		events.push_back(ring.events[i % PROFILER_RING_SIZE]);
+	}
+	const uint64_t after = ring.head.load(std::memory_order_acquire);
+	if (after < begin + PROFILER_RING_SIZE) return 0;
+	const uint64_t overwritten = std::min(after - PROFILER_RING_SIZE + 1 - begin, head - begin);
+	events.erase(events.begin() + first, events.begin() + first + (size_t)overwritten);
+	return overwritten;
+}
+
+}
+
+uint64_t profilerTicks()
+{
+#ifdef GP_X86
+	if (s_bUseTsc) return __rdtsc();
+#endif
+	return steadyNanoseconds();
+}
+
+double profilerNanosecondsPerTick()
+{
+	if (!s_bUseTsc) return 1.0;
+	static double nsPerTick = 0;
+	static std::mutex calibrationMutex;
+	std::lock_guard<std::mutex> lock(calibrationMutex);
+	if (nsPerTick == 0) {
+		// measure the TSC rate against the steady clock over at least 20 ms
+		uint64_t ns, ticks;
+		do {
+			ns = steadyNanoseconds();
+			ticks = profilerTicks();
+		} while (ns - s_calibrationNs < 20000000);
+		nsPerTick = (double)(ns - s_calibrationNs) / (double)(ticks - s_calibrationTicks);
+	}
+	return nsPerTick;
+}
+
+void profilerSetEnabled(bool enabled)
+{
+	s_bEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool profilerIsEnabled()
+{
+	return s_bEnabled.load(std::memory_order_relaxed);
+}
+
+void profilerCollect(std::vector<ProfileEvent>& events)
+{
+	events.clear();
+	std::lock_guard<std::mutex> lock(s_registryMutex);
+	for (const auto& ring : s_rings) {
+		const uint64_t head = ring->head.load(std::memory_order_acquire);
+		const uint64_t cleared = ring->cleared.load(std::memory_order_relaxed);
+		uint64_t begin = head > PROFILER_RING_SIZE ? head - PROFILER_RING_SIZE : 0;
+		copyRing(*ring, std::max(begin, cleared), head, events);
+	}
+	std::stable_sort(events.begin(), events.end(), [](const ProfileEvent& a, const ProfileEvent& b) {
+		if (a.thread != b.thread) return a.thread < b.thread;
+		if (a.start != b.start) return a.start < b.start;
+		return a.depth < b.depth;
+	});
+}
+
+void profilerClear()
+{
+	std::lock_guard<std::mutex> lock(s_registryMutex);
+	for (const auto& ring : s_rings) {
+		ring->cleared.store(ring->head.load(std::memory_order_acquire), std::memory_order_relaxed);
+	}
+}
+
+std::string profilerReport()
+{
+	struct Node { uint32_t depth; const char* name; uint64_t calls, ticks, childTicks; };
+
+	std::vector<ProfileEvent> events;
+	profilerCollect(events);
+	std::vector<std::string> names;
+	profilerThreadNames(names);
+	const double msPerTick = profilerNanosecondsPerTick() * 1e-6;
+
+	std::string report;
+	char line[160];
+	size_t e = 0;
+	while (e < events.size()) {
+		const uint32_t thread = events[e].thread;
+		// the path of names from the root identifies a node, '\1' sorts a
+		// parent right before its children
+		std::map<std::string, Node> nodes;
+		std::vector<std::string> stack;
+		for (; e < events.size() && events[e].thread == thread; ++e) {
+			const ProfileEvent& ev = events[e];
+			// parents that are still open have no event yet
+			stack.resize(ev.depth, std::string("(open)"));
+			std::string path = ev.depth ? stack.back() + '\1' + ev.name : std::string(ev.name);
+			Node& node = nodes.emplace(path, Node{ ev.depth, ev.name, 0, 0, 0 }).first->second;
+			node.calls++;
+			node.ticks += ev.end - ev.start;
+			if (ev.depth) {
+				auto parent = nodes.find(stack.back());
+				if (parent != nodes.end()) parent->second.childTicks += ev.end - ev.start;
+			}
+			stack.push_back(path);
+		}
+
+		std::snprintf(line, sizeof(line), "profile of thread %u %s\n%-40s %10s %12s %12s %12s\n", thread, names[thread].c_str(), "zone", "calls", "total ms", "mean us", "self ms");
+		report += line;
+		for (const auto& entry : nodes) {
+			const Node& node = entry.second;
+			const std::string name = std::string(2 * node.depth, ' ') + node.name;
+			std::snprintf(line, sizeof(line), "%-40s %10llu %12.3f %12.3f %12.3f\n", name.c_str(), (unsigned long long)node.calls,
+				node.ticks * msPerTick, node.ticks * msPerTick * 1e3 / node.calls, (node.ticks - node.childTicks) * msPerTick);
+			report += line;
+		}
+	}
+	return report;
+}
+
+uint64_t profilerDrain(std::vector<uint64_t>& cursors, std::vector<ProfileEvent>& events)
+{
+	uint64_t dropped = 0;
+	std::lock_guard<std::mutex> lock(s_registryMutex);
+	cursors.resize(s_rings.size(), 0);
+	for (size_t r = 0; r < s_rings.size(); ++r) {
+		const uint64_t head = s_rings[r]->head.load(std::memory_order_acquire);
+		uint64_t begin = cursors[r];
+		if (head - begin > PROFILER_RING_SIZE) {
+			dropped += head - PROFILER_RING_SIZE - begin;
+			begin = head - PROFILER_RING_SIZE;
+		}
+		dropped += copyRing(*s_rings[r], begin, head, events);
+		cursors[r] = head;
+	}
+	return dropped;
+}
+
+void profilerSetThreadName(const char* name)
+{
+	ThreadRing& ring = localRing();
+	std::lock_guard<std::mutex> lock(s_registryMutex);
+	std::strncpy(ring.name, name, sizeof(ring.name) - 1);
+	ring.name[sizeof(ring.name) - 1] = '\0';
+}
+
+void profilerThreadNames(std::vector<std::string>& names)
+{
+	std::lock_guard<std::mutex> lock(s_registryMutex);
+	names.clear();
+	for (const auto& ring : s_rings) names.push_back(ring->name);
+}
+
+uint32_t profilerThreadIndex()
+{
+	return localRing().index;
+}
+
+ProfileZone::ProfileZone(const char* name)
+	: m_name(name), m_start(0), m_bActive(profilerIsEnabled())
+{
+	if (!m_bActive) return;
+	localRing().depth++;
+	m_start = profilerTicks();
+}
+
+ProfileZone::~ProfileZone()
+{
+	if (!m_bActive) return;
+	const uint64_t end = profilerTicks();
+	ThreadRing& ring = *t_ring;
+	const uint64_t head = ring.head.load(std::memory_order_relaxed);
+	ProfileEvent& event = ring.events[head % PROFILER_RING_SIZE];
+	event.name = m_name;
+	event.start = m_start;
+	event.end = end;
+	event.depth = --ring.depth;
+	event.thread = ring.index;
+	ring.head.store(head + 1, std::memory_order_release);
+}
@@ -0,0 +1,96 @@
+#ifndef __profiler_h__
+#define __profiler_h__
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+/*
+// simple example:
+
+void step()
+{
+	PROFILE_ZONE("step");
+	{
+		PROFILE_ZONE("forces"); // nested, shows up below "step"
+		...
+	}
+}
+
+// later, from any thread
+std::cout << profilerReport();
+
+*/
+
+// Scoped zone profiler. Every thread records finished zones into its own
+// ring buffer of PROFILER_RING_SIZE events, so recording takes no lock and
+// never allocates after the first zone of a thread; when the ring is full the
+// oldest events are overwritten. Timestamps come from RDTSC when the CPU has
+// an invariant TSC and from the steady clock otherwise.
+//
+// Defining GAMEPHYSICS_NO_PROFILE turns PROFILE_ZONE into nothing, so the
+// instrumented code has no profiling cost at all.
+
+#define PROFILER_RING_SIZE (1 << 15)
+
+struct ProfileEvent
+{
+	const char* name; // must be a string literal or otherwise outlive the profiler
+	uint64_t start;   // ticks
+	uint64_t end;
+	uint32_t depth;   // number of enclosing zones on the same thread
+	uint32_t thread;  // profiler thread index, 0 for the first thread that recorded
+};
+
+// raw timestamp, convert with profilerNanosecondsPerTick()
+uint64_t profilerTicks();
+double profilerNanosecondsPerTick();
+
+// Recording can be paused at runtime, zones entered while paused are dropped.
+void profilerSetEnabled(bool enabled);
+bool profilerIsEnabled();
+
+// Copies the events currently held by all rings, ordered by thread and start.
+void profilerCollect(std::vector<ProfileEvent>& events);
+// Drops all recorded events. Zones that are open right now are still recorded.
+void profilerClear();
+// Per thread tree of zones with calls, total, mean and self time.
+std::string profilerReport();
+
+// Streaming readout for the trace recorder: appends the events recorded
+// since cursors[thread] and advances the cursors. Rings of threads that are
+// not in cursors yet are read from their start. Returns the number of
+// events that were overwritten before they could be read.
+uint64_t profilerDrain(std::vector<uint64_t>& cursors, std::vector<ProfileEvent>& events);
+
+// Name of the calling thread in reports and traces, at most 31 characters.
+void profilerSetThreadName(const char* name);
+// names indexed by ProfileEvent::thread, empty for unnamed threads
+void profilerThreadNames(std::vector<std::string>& names);
+// ProfileEvent::thread of the calling thread
+uint32_t profilerThreadIndex();
+
+class ProfileZone
+{
+public:
+	explicit ProfileZone(const char* name);
+	~ProfileZone();
+
+private:
+	ProfileZone(const ProfileZone&);
+	ProfileZone& operator=(const ProfileZone&);
+
+	const char* m_name;
+	uint64_t m_start;
+	bool m_bActive;
+};
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_(a, b)
+#ifdef GAMEPHYSICS_NO_PROFILE
+#  define PROFILE_ZONE(name) ((void)0)
+#else
+#  define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__)(name)
+#endif
+
+#endif
@@ -0,0 +1,107 @@
+#include "threadpool.h"
+#include "perfcounters.h"
+#include "profiler.h"
+
+#include <algorithm>
+#include <string>
+
+ThreadPool::ThreadPool(int threads)
+	: m_iThreads(1), m_iGeneration(0), m_iPending(0), m_bStop(false),
+	  m_func(nullptr), m_body(nullptr), m_iBegin(0), m_iEnd(0), m_iChunkSize(0)
+{
+	setThreadCount(threads);
+}
+
+ThreadPool::~ThreadPool()
+{
+	stopWorkers();
+}
+
+void ThreadPool::setThreadCount(int threads)
+{
+	if (threads <= 0) threads = std::max(1, (int)std::thread::hardware_concurrency());
+	if (threads == m_iThreads) return;
+	stopWorkers();
+	m_iThreads = threads;
+}
+
+void ThreadPool::startWorkers()
+{
+	m_bStop = false;
+	m_workers.reserve(m_iThreads - 1);
+	for (int t = 1; t < m_iThreads; ++t) {
+		m_workers.push_back(std::thread(&ThreadPool::workerLoop, this, t));
+	}
+}
+
+void ThreadPool::stopWorkers()
+{
+	if (m_workers.empty()) return;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_bStop = true;
+	}
+	m_wake.notify_all();
+	for (size_t t = 0; t < m_workers.size(); ++t) m_workers[t].join();
+	m_workers.clear();
+}
+
+void ThreadPool::runChunk(int chunk)
+{
+	const int begin = m_iBegin + chunk * m_iChunkSize;
+	const int end = std::min(begin + m_iChunkSize, m_iEnd);
+	if (begin >= end) return;
+	PROFILE_ZONE("parallelFor");
+	PERF_PHASE("parallelFor");
+	m_func(m_body, begin, end);
+}
+
+void ThreadPool::workerLoop(int chunk)
+{
+	profilerSetThreadName(("worker " + std::to_string(chunk)).c_str());
+	unsigned int seen = 0;
+	for (;;) {
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_wake.wait(lock, [&]() { return m_bStop || m_iGeneration != seen; });
+			if (m_bStop) return;
+			seen = m_iGeneration;
+		}
+		runChunk(chunk);
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			if (--m_iPending == 0) m_done.notify_one();
+		}
+	}
+}
+
+void ThreadPool::run(int begin, int end, int grain, RangeFunc func, const void* body)
+{
+	const int n = end - begin;
+	grain = std::max(grain, 1);
+	if (m_iThreads <= 1 || n < 2 * grain) {
+		if (n > 0) func(body, begin, end);
+		return;
+	}
+	if (m_workers.empty()) startWorkers();
+
+	// one chunk per thread, rounded up to whole grains
+	int grains = (n + grain - 1) / grain;
+	int chunkSize = ((grains + m_iThreads - 1) / m_iThreads) * grain;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_func = func;
+		m_body = body;
+		m_iBegin = begin;
+		m_iEnd = end;
+		m_iChunkSize = chunkSize;
+		m_iPending = (int)m_workers.size();
+		m_iGeneration++;
+	}
+	m_wake.notify_all();
+
+	runChunk(0);
+
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_done.wait(lock, [&]() { return m_iPending == 0; });
+}
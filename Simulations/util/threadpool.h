@@ -0,0 +1,71 @@
+#ifndef __threadpool_h__
+#define __threadpool_h__
+
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+/*
+// simple example:
+
+ThreadPool pool(4);
+pool.parallelFor(0, n, 1024, [&](int begin, int end) {
+	for (int i = begin; i < end; ++i) out[i] = f(in[i]);
+});
+
+*/
+
+// Fixed set of worker threads for data parallel loops.
+// parallelFor splits a range into one contiguous chunk per thread, runs
+// them and returns when all are done. The calling thread takes the first
+// chunk. The split only depends on the range, grain and thread count, so
+// the same call always hands the same indices to the same chunk. Workers
+// are started on first use and parallelFor does not allocate.
+class ThreadPool
+{
+public:
+	explicit ThreadPool(int threads = 1);
+	~ThreadPool();
+
+	// 0 picks the number of hardware threads
+	void setThreadCount(int threads);
+	int threadCount() const { return m_iThreads; }
+
+	// body(begin, end) is called for disjoint subranges covering [begin, end).
+	// Ranges shorter than two grains run on the calling thread; chunk
+	// boundaries are multiples of grain away from begin.
+	template<class F>
+	void parallelFor(int begin, int end, int grain, const F& body)
+	{
+		run(begin, end, grain, &invoke<F>, &body);
+	}
+
+private:
+	typedef void (*RangeFunc)(const void* body, int begin, int end);
+
+	template<class F>
+	static void invoke(const void* body, int begin, int end) { (*static_cast<const F*>(body))(begin, end); }
+
+	void run(int begin, int end, int grain, RangeFunc func, const void* body);
+	void runChunk(int chunk);
+	void startWorkers();
+	void stopWorkers();
+	void workerLoop(int chunk);
+
+	int m_iThreads;
+	std::vector<std::thread> m_workers;
+	std::mutex m_mutex;
+	std::condition_variable m_wake;
+	std::condition_variable m_done;
+	unsigned int m_iGeneration;
+	int m_iPending;
+	bool m_bStop;
+
+	// current job
+	RangeFunc m_func;
+	const void* m_body;
+	int m_iBegin, m_iEnd, m_iChunkSize;
+};
+
+#endif
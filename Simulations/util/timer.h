@@ -18,14 +18,15 @@ std::cout << "Time passed "<< myTimer.update().time <<" milliseconds\n";
 */
 
 
-#if defined(WIN32) || defined(_WIN32)
-#  include <windows.h>
-#else
-#   include <sys/time.h>
-#endif
+// Superseded by the zone profiler in util/profiler.h, which is what the
+// simulation loop is instrumented with. MuTime is kept for quick one-off
+// measurements; it reads the monotonic steady clock and keeps fractional
+// milliseconds.
+
+#include <chrono>
 
 struct MuTime {
-	MuTime() {}
+	MuTime() : time(0) {}
 	MuTime operator-(const MuTime& a) { MuTime b; b.time = time - a.time; return b; };
 	MuTime operator+(const MuTime& a) { MuTime b; b.time = time + a.time; return b; };
 	MuTime operator/(unsigned long a) { MuTime b; b.time = time / a; return b; };
@@ -35,22 +36,7 @@ struct MuTime {
 	
 	void clear() { time = 0; }
 	void get() { 
-	#if defined(WIN32) || defined(_WIN32)
-		LARGE_INTEGER liTimerFrequency;
-		LARGE_INTEGER liLastTime;
-		QueryPerformanceFrequency(&liTimerFrequency);		
-		QueryPerformanceCounter(&liLastTime);
-		double timepass = (double)liLastTime.QuadPart;
-		timepass /= (double)liTimerFrequency.QuadPart;
-		time = (timepass * 1000);
-	#else
-		struct timeval tv;
-		struct timezone tz;
-		tz.tz_minuteswest = 0;
-		tz.tz_dsttime = 0;
-		gettimeofday(&tv, &tz);
-		time = (tv.tv_sec * 1000) + (tv.tv_usec / 1000);
-	#endif    
+		time = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
 	}
 
 	MuTime update(){
@@ -59,7 +45,7 @@ struct MuTime {
 		return *this - o;
 	}
 
-	unsigned long time;
+	double time; // milliseconds
 };
 
 #endif
\ No newline at end of file
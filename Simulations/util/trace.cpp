@@ -0,0 +1,164 @@
+#include "trace.h"
+#include "profiler.h"
+
+#include <atomic>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct CounterSample
+{
+	const char* name;
+	uint64_t ticks;
+	double value;
+};
+
+std::mutex s_traceMutex;
+std::atomic<bool> s_bActive(false);
+std::ofstream s_file;
+bool s_bWasProfilerEnabled = true;
+uint64_t s_baseTicks = 0;
+double s_usPerTick = 0;
+uint64_t s_dropped = 0;
+bool s_bFirstEvent = true;
+std::vector<uint64_t> s_cursors;
+std::vector<ProfileEvent> s_events;     // reused between flushes
+std::vector<CounterSample> s_counters;  // reserved to TRACE_MAX_PENDING_COUNTERS
+std::vector<bool> s_threadNamed;
+
+// names are program literals, escaping quotes and backslashes is enough
+std::string escaped(const char* text)
+{
+	std::string out;
+	for (; *text; ++text) {
+		if (*text == '"' || *text == '\\') out += '\\';
+		out += *text;
+	}
+	return out;
+}
+
+double microseconds(uint64_t ticks)
+{
+	return (double)(int64_t)(ticks - s_baseTicks) * s_usPerTick;
+}
+
+void writeEvent(const char* json)
+{
+	s_file << (s_bFirstEvent ? "\n" : ",\n") << json;
+	s_bFirstEvent = false;
+}
+
+// expects s_traceMutex to be held
+void flushLocked()
+{
+	char line[256];
+	s_events.clear();
+	s_dropped += profilerDrain(s_cursors, s_events);
+
+	std::vector<std::string> names;
+	profilerThreadNames(names);
+	s_threadNamed.resize(names.size(), false);
+	for (size_t t = 0; t < names.size(); ++t) {
+		if (s_threadNamed[t] || names[t].empty()) continue;
+		std::snprintf(line, sizeof(line), "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":\"%s\"}}",
+			(unsigned)t, escaped(names[t].c_str()).c_str());
+		writeEvent(line);
+		s_threadNamed[t] = true;
+	}
+
+	for (const ProfileEvent& e : s_events) {
+		// zones that were already open when the trace started
+		if (e.start < s_baseTicks) continue;
+		std::snprintf(line, sizeof(line), "{\"name\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%u}",
+			escaped(e.name).c_str(), microseconds(e.start), (e.end - e.start) * s_usPerTick, e.thread);
+		writeEvent(line);
+	}
+
+	for (const CounterSample& c : s_counters) {
+		std::snprintf(line, sizeof(line), "{\"name\":\"%s\",\"ph\":\"C\",\"ts\":%.3f,\"pid\":1,\"args\":{\"value\":%.17g}}",
+			escaped(c.name).c_str(), microseconds(c.ticks), c.value);
+		writeEvent(line);
+	}
+	s_counters.clear();
+}
+
+}
+
+bool traceStart(const std::string& path)
+{
+	if (traceIsActive()) traceStop();
+
+	std::lock_guard<std::mutex> lock(s_traceMutex);
+	s_file.open(path.c_str(), std::ios::out | std::ios::trunc);
+	if (!s_file) return false;
+	s_file << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+	s_bFirstEvent = true;
+	writeEvent("{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"args\":{\"name\":\"Game Physics\"}}");
+
+	s_usPerTick = profilerNanosecondsPerTick() * 1e-3;
+	s_dropped = 0;
+	s_counters.clear();
+	s_counters.reserve(TRACE_MAX_PENDING_COUNTERS);
+	s_threadNamed.clear();
+	// skip everything recorded before the start
+	s_cursors.clear();
+	profilerDrain(s_cursors, s_events);
+	s_baseTicks = profilerTicks();
+
+	s_bWasProfilerEnabled = profilerIsEnabled();
+	profilerSetEnabled(true);
+	s_bActive = true;
+	return true;
+}
+
+void traceStop()
+{
+	std::lock_guard<std::mutex> lock(s_traceMutex);
+	if (!s_bActive) return;
+	s_bActive = false;
+	profilerSetEnabled(s_bWasProfilerEnabled);
+	flushLocked();
+	if (s_dropped) {
+		char line[160];
+		std::snprintf(line, sizeof(line), "{\"name\":\"dropped events: %llu\",\"ph\":\"i\",\"s\":\"g\",\"ts\":%.3f,\"pid\":1,\"tid\":0}",
+			(unsigned long long)s_dropped, microseconds(profilerTicks()));
+		writeEvent(line);
+	}
+	s_file << "\n]}\n";
+	s_file.close();
+}
+
+bool traceIsActive()
+{
+	return s_bActive.load(std::memory_order_relaxed);
+}
+
+void traceFlush()
+{
+	if (!traceIsActive()) return;
+	std::lock_guard<std::mutex> lock(s_traceMutex);
+	if (s_bActive) flushLocked();
+}
+
+void traceCounter(const char* name, double value)
+{
+	if (!traceIsActive()) return;
+	const uint64_t ticks = profilerTicks();
+	std::lock_guard<std::mutex> lock(s_traceMutex);
+	if (s_counters.size() < TRACE_MAX_PENDING_COUNTERS) {
+		CounterSample sample = { name, ticks, value };
+		s_counters.push_back(sample);
+	}
+	else {
+		s_dropped++;
+	}
+}
+
+uint64_t traceDroppedEvents()
+{
+	std::lock_guard<std::mutex> lock(s_traceMutex);
+	return s_dropped;
+}
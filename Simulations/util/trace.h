@@ -0,0 +1,43 @@
+#ifndef __trace_h__
+#define __trace_h__
+
+#include <stdint.h>
+#include <string>
+
+/*
+// simple example:
+
+traceStart("trace.json");
+for (...) {
+	simulate();            // PROFILE_ZONEs inside
+	traceCounter("points", n);
+	traceFlush();          // once per frame or step
+}
+traceStop();               // then open trace.json in ui.perfetto.dev or chrome://tracing
+
+*/
+
+// Timeline recorder writing the Chrome trace event format. It streams the
+// profiler zones of all threads (see util/profiler.h) as complete events,
+// plus counter tracks and thread names, to the file on every traceFlush().
+// Memory stays bounded: zones wait in the fixed size profiler rings and at
+// most TRACE_MAX_PENDING_COUNTERS counter samples are buffered between two
+// flushes; anything beyond that is dropped and counted.
+
+#define TRACE_MAX_PENDING_COUNTERS 4096
+
+// Opens path and starts recording, enabling the profiler while it runs.
+// A running trace is finished first. Returns false if the file cannot be written.
+bool traceStart(const std::string& path);
+// Flushes and closes the file, restoring the previous profiler state.
+void traceStop();
+bool traceIsActive();
+
+// Writes everything recorded since the last flush.
+void traceFlush();
+// Adds a sample to the counter track name (a string literal) at the current time.
+void traceCounter(const char* name, double value);
+// zones and counters lost in the current or last trace
+uint64_t traceDroppedEvents();
+
+#endif
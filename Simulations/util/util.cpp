@@ -1,4 +1,5 @@
 #include "util.h"
+#include "frametimes.h"
 
 #include <Windows.h>
 
@@ -50,9 +51,12 @@ void UpdateWindowTitle(const std::wstring& appName)
 
 	// update window title if something relevant changed
 	if (update) {
+		// p50/p99 per stage since the last update
+		const std::string stages = frameTimesIntervalSummary();
+		frameTimesStartInterval();
 		const size_t len = 512;
 		wchar_t str[len];
-		swprintf_s(str, len, L"%s %ux%u @ %.2f fps / %.2f ms", appName.c_str(), s_windowWidth, s_windowHeight, s_fps, s_mspf);
+		swprintf_s(str, len, L"%s %ux%u @ %.2f fps / %.2f ms | %S", appName.c_str(), s_windowWidth, s_windowHeight, s_fps, s_mspf, stages.c_str());
 		SetWindowText(DXUTGetHWND(), str);
 	}
 }
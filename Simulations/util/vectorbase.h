@@ -16,7 +16,9 @@
 #include <stdlib.h>
 #include <iostream>
 #include <sstream>
+#ifndef GAMEPHYSICS_HEADLESS
 #include <DirectXMath.h>
+#endif
 
 // if min/max are still around...
 #ifdef WIN32
@@ -79,7 +81,9 @@ public:
   inline vector3Dim();
   // Copy-Constructor
   inline vector3Dim(const vector3Dim<Scalar> &v );
+#ifndef GAMEPHYSICS_HEADLESS
   inline vector3Dim(DirectX::XMVECTOR &v );
+#endif
   inline vector3Dim(const float *);
   inline vector3Dim(const double *);
   // construct a vector from one Scalar
@@ -200,9 +204,11 @@ public:
     // Return the index of the minimal coordinate value.
     inline int minComponentId(void) const;
 	
+#ifndef GAMEPHYSICS_HEADLESS
 	inline DirectX::XMVECTOR toDirectXVector() const{
 	  return DirectX::XMVectorSet(x,y,z,1);
   }
+#endif
 
 	// zero element
    static const vector3Dim<Scalar> ZERO;
@@ -258,6 +264,7 @@ inline vector3Dim<Scalar>::vector3Dim( const vector3Dim<Scalar> &v )
 	value[2] = v.value[2];
 }
 
+#ifndef GAMEPHYSICS_HEADLESS
 template<class Scalar>
 inline vector3Dim<Scalar>::vector3Dim( DirectX::XMVECTOR &v )
 {
@@ -265,6 +272,7 @@ inline vector3Dim<Scalar>::vector3Dim( DirectX::XMVECTOR &v )
 	value[1] = DirectX::XMVectorGetY(v);
 	value[2] = DirectX::XMVectorGetZ(v);
 }
+#endif
 	template<class Scalar>
 inline vector3Dim<Scalar>::vector3Dim( const float *fvalue)
 {
@@ -1140,9 +1148,9 @@ typedef vector3Dim<int>     nVec3i;
 template<class T> inline nVec3i vec2I(T v) { return nVec3i((int)v[0],(int)v[1],(int)v[2]); }
 template<class T> inline nVec3i vec2I(T v0, T v1, T v2) { return nVec3i((int)v0,(int)v1,(int)v2); }
 template<class T> inline nVec3d vec2D(T v) { return nVec3d(v[0],v[1],v[2]); }
-template<class T> inline nVec3i vec2D(T v0, T v1, T v2) { return nVec3d((double)v0,(double)v1,(double)v2); }
+template<class T> inline nVec3d vec2D(T v0, T v1, T v2) { return nVec3d((double)v0,(double)v1,(double)v2); }
 template<class T> inline nVec3f vec2F(T v) { return nVec3f(v[0],v[1],v[2]); }
-template<class T> inline nVec3i vec2F(T v0, T v1, T v2) { return nVec3f((float)v0,(float)v1,(float)v2); }
+template<class T> inline nVec3f vec2F(T v0, T v1, T v2) { return nVec3f((float)v0,(float)v1,(float)v2); }
 template<class T> inline nVec3i vecround(T v) { return nVec3i((int)round(v[0]),(int)round(v[1]),(int)round(v[2])); }
 
 
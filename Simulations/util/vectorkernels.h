@@ -0,0 +1,32 @@
+#ifndef __vectorkernels_h__
+#define __vectorkernels_h__
+
+// Setup for translation units with hand vectorised kernels next to scalar
+// ones. Include it from .cpp files only and after the standard headers: the
+// pragma below applies to the rest of the including file.
+
+#include "cpuinfo.h"
+
+#ifdef GP_X86
+#  include <immintrin.h>
+#endif
+
+// Contracting a * b + c into an FMA rounds once instead of twice, so the
+// vector and scalar kernels would no longer agree bit for bit.
+#if defined(_MSC_VER)
+#  pragma fp_contract(off)
+#elif defined(__clang__)
+#  pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#  pragma GCC optimize("fp-contract=off")
+#endif
+
+// GCC and clang only emit AVX code in functions marked for it; MSVC accepts
+// the intrinsics anywhere.
+#if defined(__GNUC__)
+#  define GP_TARGET(isa) __attribute__((target(isa)))
+#else
+#  define GP_TARGET(isa)
+#endif
+
+#endif
@@ -0,0 +1,83 @@
+#include "CppUnitTest.h"
+#include "MassSpringSystemSimulator.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace SimulatorTester
+{
+	TEST_CLASS(AdaptiveStepTests)
+	{
+	public:
+		// two points of mass 10 on a spring of rest length 1
+		MassSpringSystemSimulator* pairSetup(float stiffness, Vec3 v0, Vec3 v1, float length) {
+			MassSpringSystemSimulator * msss = new MassSpringSystemSimulator();
+			msss->setMass(10.0f);
+			msss->setDampingFactor(0.0f);
+			msss->setStiffness(stiffness);
+			int p0 = msss->addMassPoint(Vec3(0.0, 0.0f, 0), v0, false);
+			int p1 = msss->addMassPoint(Vec3(0.0, length, 0), v1, false);
+			msss->addSpring(p0, p1, 1.0);
+			return msss;
+		}
+
+		TEST_METHOD(TestAdaptiveCoversWholeInterval)
+		{
+			MassSpringSystemSimulator * msss = pairSetup(40.0f, Vec3(-1, 0, 0), Vec3(1, 0, 0), 2.0f);
+			msss->setIntegrator(DORMAND_PRINCE);
+			msss->setAdaptiveStepping(true);
+			for (int i = 0; i < 4; i++) msss->simulateTimestep(0.5f);
+			Assert::AreEqual(2.0, msss->getAdaptiveStepStats().simulatedTime, 1e-9, L"Adaptive stepping dropped time", LINE_INFO());
+			delete msss;
+		}
+
+		TEST_METHOD(TestCalmSceneTakesLargeSteps)
+		{
+			// relaxed spring moving as a whole: no error, the step grows to its limit
+			MassSpringSystemSimulator * msss = pairSetup(40.0f, Vec3(1, 0, 0), Vec3(1, 0, 0), 1.0f);
+			msss->setIntegrator(DORMAND_PRINCE);
+			msss->setAdaptiveStepping(true);
+			msss->setAdaptiveStepLimits(1e-6f, 0.05f);
+			msss->simulateTimestep(1.0f);
+			const AdaptiveStepStats& stats = msss->getAdaptiveStepStats();
+			Assert::IsTrue(stats.acceptedSteps < 30, L"Calm scene took too many steps", LINE_INFO());
+			Assert::AreEqual(0, stats.rejectedSteps, L"Calm scene rejected steps", LINE_INFO());
+			Assert::AreEqual(0.05, stats.largestStep, 1e-6, L"Step did not grow to the limit", LINE_INFO());
+			delete msss;
+		}
+
+		TEST_METHOD(TestStiffSpringGetsSubsteps)
+		{
+			MassSpringSystemSimulator * calm = pairSetup(40.0f, Vec3(-1, 0, 0), Vec3(1, 0, 0), 2.0f);
+			MassSpringSystemSimulator * stiff = pairSetup(1e4f, Vec3(-1, 0, 0), Vec3(1, 0, 0), 2.0f);
+			calm->setIntegrator(DORMAND_PRINCE);
+			stiff->setIntegrator(DORMAND_PRINCE);
+			calm->setAdaptiveStepping(true);
+			stiff->setAdaptiveStepping(true);
+			calm->simulateTimestep(1.0f);
+			stiff->simulateTimestep(1.0f);
+			Assert::IsTrue(stiff->getAdaptiveStepStats().acceptedSteps > 2 * calm->getAdaptiveStepStats().acceptedSteps,
+				L"Stiff spring should need many more steps", LINE_INFO());
+			delete calm;
+			delete stiff;
+		}
+
+		TEST_METHOD(TestAdaptiveMatchesReference)
+		{
+			int integrators[] = { HEUN, DORMAND_PRINCE, VELOCITY_VERLET, RK4 };
+			for (int integrator : integrators) {
+				MassSpringSystemSimulator * adaptive = pairSetup(400.0f, Vec3(-1, 0, 0), Vec3(1, 0, 0), 2.0f);
+				MassSpringSystemSimulator * reference = pairSetup(400.0f, Vec3(-1, 0, 0), Vec3(1, 0, 0), 2.0f);
+				adaptive->setIntegrator(integrator);
+				adaptive->setAdaptiveStepping(true);
+				adaptive->setAdaptiveTolerances(1e-6f, 1e-6f);
+				reference->setIntegrator(RK4);
+				adaptive->simulateTimestep(1.0f);
+				for (int i = 0; i < 10000; i++) reference->simulateTimestep(1e-4f);
+				Vec3 d = adaptive->getPositionOfMassPoint(1) - reference->getPositionOfMassPoint(1);
+				Assert::AreEqual(0.0f, (float)norm(d), 1e-4f, L"Adaptive result deviates from the reference", LINE_INFO());
+				delete adaptive;
+				delete reference;
+			}
+		}
+	};
+}
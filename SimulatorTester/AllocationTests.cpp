@@ -0,0 +1,106 @@
+#include "CppUnitTest.h"
+#include "MassSpringSystemSimulator.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+// Counts every global operator new in this test module. Aligned buffers go
+// through alignedMalloc and are counted separately by alignedAllocationCount().
+static std::atomic<size_t> g_heapAllocations(0);
+
+void* operator new(size_t bytes)
+{
+	g_heapAllocations++;
+	if (void* p = malloc(bytes ? bytes : 1)) return p;
+	throw std::bad_alloc();
+}
+
+void* operator new[](size_t bytes)
+{
+	return operator new(bytes);
+}
+
+void operator delete(void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+	free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+	free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+	free(p);
+}
+
+namespace SimulatorTester
+{
+	TEST_CLASS(AllocationTests)
+	{
+	public:
+		static size_t allocationCount() {
+			return g_heapAllocations.load() + alignedAllocationCount().load();
+		}
+
+		// steps the Demo4 scene (gravity, collisions, teapot springs) and
+		// returns the number of allocations once the buffers are warm
+		size_t steadyStateAllocations(int integrator, bool adaptive = false) {
+			MassSpringSystemSimulator * msss = new MassSpringSystemSimulator();
+			msss->notifyCaseChanged(3);
+			msss->setIntegrator(integrator);
+			msss->setAdaptiveStepping(adaptive);
+			// the first step prints the state and sizes all scratch buffers
+			for (int i = 0; i < 3; i++) msss->simulateTimestep(0.005f);
+
+			size_t before = allocationCount();
+			for (int i = 0; i < 200; i++) msss->simulateTimestep(0.005f);
+			size_t allocations = allocationCount() - before;
+			delete msss;
+			return allocations;
+		}
+
+		TEST_METHOD(TestCounterSeesAllocations)
+		{
+			// the volatile sink keeps the optimiser from eliding the new and delete pair
+			size_t heapBefore = g_heapAllocations.load();
+			int* volatile sink = new int(1);
+			delete sink;
+			Assert::IsTrue(g_heapAllocations.load() > heapBefore, L"operator new is not counted", LINE_INFO());
+			size_t alignedBefore = alignedAllocationCount().load();
+			RealArray a(16);
+			Assert::IsTrue(alignedAllocationCount().load() > alignedBefore, L"alignedMalloc is not counted", LINE_INFO());
+		}
+
+		TEST_METHOD(TestRungeKuttaDoesNotAllocate)
+		{
+			int integrators[] = { MIDPOINT, HEUN, RK4, DORMAND_PRINCE };
+			for (int integrator : integrators) {
+				Assert::AreEqual((size_t)0, steadyStateAllocations(integrator), L"Runge-Kutta step allocated in steady state", LINE_INFO());
+			}
+		}
+
+		TEST_METHOD(TestOtherIntegratorsDoNotAllocate)
+		{
+			int integrators[] = { EULER, LEAPFROG, VELOCITY_VERLET, YOSHIDA4, IMPLICIT_EULER };
+			for (int integrator : integrators) {
+				Assert::AreEqual((size_t)0, steadyStateAllocations(integrator), L"Integrator allocated in steady state", LINE_INFO());
+			}
+		}
+
+		TEST_METHOD(TestAdaptiveSteppingDoesNotAllocate)
+		{
+			Assert::AreEqual((size_t)0, steadyStateAllocations(DORMAND_PRINCE, true), L"Embedded error stepping allocated", LINE_INFO());
+			Assert::AreEqual((size_t)0, steadyStateAllocations(VELOCITY_VERLET, true), L"Step doubling allocated", LINE_INFO());
+		}
+	};
+}
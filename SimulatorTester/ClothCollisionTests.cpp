@@ -0,0 +1,199 @@
+#include "CppUnitTest.h"
+#include "MassSpringSystemSimulator.h"
+#include "TriangleBVH.h"
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <tuple>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace SimulatorTester
+{
+	TEST_CLASS(ClothCollisionTests)
+	{
+	public:
+		std::vector<Real> px, py, pz;
+		std::vector<int> triangles;
+
+		// n x n grid of points in the xz plane at height y, two triangles per quad
+		void addSheet(int n, Real spacing, Real x0, Real y, Real z0) {
+			const int first = (int)px.size();
+			for (int i = 0; i < n; ++i) {
+				for (int j = 0; j < n; ++j) {
+					px.push_back(x0 + j * spacing);
+					py.push_back(y);
+					pz.push_back(z0 + i * spacing);
+				}
+			}
+			for (int i = 0; i + 1 < n; ++i) {
+				for (int j = 0; j + 1 < n; ++j) {
+					const int p = first + i * n + j;
+					const int quad[6] = { p, p + 1, p + n + 1, p, p + n + 1, p + n };
+					triangles.insert(triangles.end(), quad, quad + 6);
+				}
+			}
+		}
+
+		bool contains(const BVHNode& node, Real x, Real y, Real z) {
+			return node.lo[0] <= x && x <= node.hi[0] && node.lo[1] <= y && y <= node.hi[1] && node.lo[2] <= z && z <= node.hi[2];
+		}
+
+		TEST_METHOD(TestRefitBoundsEveryTriangle)
+		{
+			addSheet(24, 1, 0, 0, 0);
+			TriangleBVH bvh;
+			const int numTriangles = (int)triangles.size() / 3;
+			bvh.build(triangles.data(), numTriangles, px.data(), py.data(), pz.data());
+			std::mt19937 rng(3);
+			std::uniform_real_distribution<Real> offset(-0.2, 0.2);
+			for (size_t i = 0; i < px.size(); ++i) {
+				px[i] += offset(rng);
+				py[i] += offset(rng);
+				pz[i] += offset(rng);
+			}
+			ThreadPool pool(2);
+			Assert::IsFalse(bvh.refit(px.data(), py.data(), pz.data(), pool), L"Small motion rebuilt the tree", LINE_INFO());
+
+			int covered = 0;
+			for (int n = 0; n < (int)bvh.nodes.size(); ++n) {
+				const BVHNode& node = bvh.nodes[n];
+				if (!node.count) {
+					const BVHNode& left = bvh.nodes[n + 1];
+					const BVHNode& right = bvh.nodes[left.escape];
+					for (int k = 0; k < 3; ++k) {
+						Assert::IsTrue(node.lo[k] == std::min(left.lo[k], right.lo[k]) && node.hi[k] == std::max(left.hi[k], right.hi[k]), L"Inner box is not the union of its children", LINE_INFO());
+					}
+					continue;
+				}
+				for (int i = node.first; i < node.first + node.count; ++i) {
+					const int* v = &triangles[3 * bvh.order[i]];
+					for (int k = 0; k < 3; ++k) Assert::IsTrue(contains(node, px[v[k]], py[v[k]], pz[v[k]]), L"Leaf misses a vertex", LINE_INFO());
+					covered++;
+				}
+			}
+			Assert::AreEqual(numTriangles, covered, L"Leaves do not cover the triangles once", LINE_INFO());
+		}
+
+		TEST_METHOD(TestRebuildsWhenBoxesDegrade)
+		{
+			addSheet(24, 1, 0, 0, 0);
+			TriangleBVH bvh;
+			bvh.build(triangles.data(), (int)triangles.size() / 3, px.data(), py.data(), pz.data());
+			// scramble the sheet, neighbouring triangles end up far apart
+			std::mt19937 rng(5);
+			std::shuffle(px.begin(), px.end(), rng);
+			std::shuffle(pz.begin(), pz.end(), rng);
+			ThreadPool pool(1);
+			Assert::IsTrue(bvh.refit(px.data(), py.data(), pz.data(), pool), L"Degraded tree not rebuilt", LINE_INFO());
+			Assert::AreEqual(2, bvh.numBuilds(), L"Build count", LINE_INFO());
+			Assert::IsFalse(bvh.refit(px.data(), py.data(), pz.data(), pool), L"Fresh tree rebuilt again", LINE_INFO());
+		}
+
+		TEST_METHOD(TestContactsMatchBruteForce)
+		{
+			// two sheets 0.05 apart, the upper one shifted and slightly tilted
+			addSheet(12, 0.3, 0, 0, 0);
+			addSheet(12, 0.3, 0.1, 0.05, 0.07);
+			for (size_t i = 144; i < px.size(); ++i) py[i] += 0.01 * px[i];
+			const Real thickness = 0.1;
+			const int numTriangles = (int)triangles.size() / 3;
+
+			typedef std::tuple<int, int, int, int> Key;
+			std::set<Key> expected;
+			std::set<std::pair<int, int>> edges;
+			for (int t = 0; t < numTriangles; ++t) {
+				for (int e = 0; e < 3; ++e) {
+					const int a = triangles[3 * t + e], b = triangles[3 * t + (e + 1) % 3];
+					edges.insert(std::make_pair(std::min(a, b), std::max(a, b)));
+				}
+			}
+			for (int v = 0; v < (int)px.size(); ++v) {
+				for (int t = 0; t < numTriangles; ++t) {
+					const int* T = &triangles[3 * t];
+					if (T[0] == v || T[1] == v || T[2] == v) continue;
+					Real weights[3];
+					const Vec3 p(px[v], py[v], pz[v]);
+					const Vec3 q = closestPointOnTriangle(p, Vec3(px[T[0]], py[T[0]], pz[T[0]]), Vec3(px[T[1]], py[T[1]], pz[T[1]]), Vec3(px[T[2]], py[T[2]], pz[T[2]]), weights);
+					if (normNoSqrt(p - q) < thickness * thickness) expected.insert(Key(v, t, -1, 0));
+				}
+			}
+			for (auto a = edges.begin(); a != edges.end(); ++a) {
+				for (auto b = std::next(a); b != edges.end(); ++b) {
+					if (a->first == b->first || a->first == b->second || a->second == b->first || a->second == b->second) continue;
+					const Vec3 p1(px[a->first], py[a->first], pz[a->first]), q1(px[a->second], py[a->second], pz[a->second]);
+					const Vec3 p2(px[b->first], py[b->first], pz[b->first]), q2(px[b->second], py[b->second], pz[b->second]);
+					Real s, t;
+					closestPointsOnSegments(p1, q1, p2, q2, s, t);
+					if (normNoSqrt((p1 + (q1 - p1) * s) - (p2 + (q2 - p2) * t)) < thickness * thickness) expected.insert(Key(a->first, a->second, b->first, b->second));
+				}
+			}
+
+			TriangleBVH bvh;
+			bvh.build(triangles.data(), numTriangles, px.data(), py.data(), pz.data());
+			ThreadPool pool(2);
+			ClothContactList contacts;
+			bvh.findSelfContacts(px.data(), py.data(), pz.data(), thickness, pool, contacts);
+			std::set<Key> found;
+			for (const ClothContact& contact : contacts) {
+				const int* v = contact.vertex;
+				Key key;
+				if (contact.isEdgeEdge) {
+					std::pair<int, int> a(std::min(v[0], v[1]), std::max(v[0], v[1])), b(std::min(v[2], v[3]), std::max(v[2], v[3]));
+					if (b < a) std::swap(a, b);
+					key = Key(a.first, a.second, b.first, b.second);
+				}
+				else {
+					int t = 0;
+					while (!(triangles[3 * t] == v[1] && triangles[3 * t + 1] == v[2] && triangles[3 * t + 2] == v[3])) ++t;
+					key = Key(v[0], t, -1, 0);
+				}
+				Assert::IsTrue(found.insert(key).second, L"Contact reported twice", LINE_INFO());
+			}
+			Assert::IsTrue(expected.size() > 100, L"Sheets barely touch", LINE_INFO());
+			Assert::IsTrue(expected == found, L"Contacts differ from the brute force search", LINE_INFO());
+		}
+
+		TEST_METHOD(TestFallingSheetStopsOnFixedSheet)
+		{
+			MassSpringSystemSimulator sim;
+			sim.setConsoleLogging(false);
+			sim.setIntegrator(EULER);
+			sim.setSelfCollisionEnabled(true);
+			// the upper sheet is smaller and offset by half a quad, so its
+			// vertices land inside the triangles of the lower one
+			const int sizes[2] = { 8, 7 };
+			for (int sheet = 0; sheet < 2; ++sheet) {
+				const int n = sizes[sheet];
+				const int first = sim.getNumberOfMassPoints();
+				const Real offset = sheet ? 0.25 : 0;
+				for (int i = 0; i < n; ++i) {
+					for (int j = 0; j < n; ++j) {
+						sim.addMassPoint(Vec3(j * 0.5 + offset, sheet * 0.5, i * 0.5 + offset), Vec3(0, sheet ? -1 : 0, 0), sheet == 0);
+					}
+				}
+				for (int i = 0; i + 1 < n; ++i) {
+					for (int j = 0; j + 1 < n; ++j) {
+						const int p = first + i * n + j;
+						sim.addSpring(p, p + 1, 0.5f);
+						sim.addSpring(p, p + n, 0.5f);
+						sim.addTriangle(p, p + 1, p + n + 1);
+						sim.addTriangle(p, p + n + 1, p + n);
+					}
+				}
+			}
+			int contacts = 0;
+			for (int step = 0; step < 100; ++step) {
+				sim.simulateTimestep(0.01f);
+				contacts += sim.getLastSelfContacts();
+			}
+			Assert::IsTrue(contacts > 0, L"Sheets never touched", LINE_INFO());
+			for (int i = 64; i < sim.getNumberOfMassPoints(); ++i) {
+				Assert::IsTrue(sim.getPositionOfMassPoint(i).y > 0.05, L"Upper sheet passed through", LINE_INFO());
+				Assert::IsTrue(sim.getVelocityOfMassPoint(i).y > -0.1, L"Upper sheet still falling", LINE_INFO());
+			}
+		}
+	};
+}
@@ -0,0 +1,110 @@
+#include "CppUnitTest.h"
+#include "MassSpringSystemSimulator.h"
+#include "CollisionGeometry.h"
+
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace SimulatorTester
+{
+	TEST_CLASS(ContinuousCollisionTests)
+	{
+	public:
+		// a single free point, no gravity
+		void setupPoint(MassSpringSystemSimulator& sim, Vec3 position, Vec3 velocity) {
+			sim.setConsoleLogging(false);
+			sim.setIntegrator(EULER);
+			sim.addMassPoint(position, velocity, false);
+		}
+
+		TEST_METHOD(TestFastPointDoesNotTunnelThroughThinBox)
+		{
+			// 2 m per step against a 5 cm plate
+			MassSpringSystemSimulator swept, discrete;
+			MassSpringSystemSimulator* sims[2] = { &swept, &discrete };
+			for (MassSpringSystemSimulator* sim : sims) {
+				setupPoint(*sim, Vec3(0, 1, 0), Vec3(0, -100, 0));
+				sim->addCollisionBox(Vec3(-1, 0, -1), Vec3(1, 0.05, 1));
+				sim->setCollisionResponse(0, 0);
+			}
+			swept.setContinuousCollisionEnabled(true);
+			swept.simulateTimestep(0.02f);
+			discrete.simulateTimestep(0.02f);
+			Assert::IsTrue(discrete.getPositionOfMassPoint(0).y < -0.9, L"Discrete test caught the point", LINE_INFO());
+			Assert::AreEqual(1, swept.getLastStaticContacts(), L"Contacts", LINE_INFO());
+			Assert::AreEqual(0.15, swept.getPositionOfMassPoint(0).y, 1e-6, L"Point not stopped on the plate", LINE_INFO());
+			Assert::AreEqual(0.0, swept.getVelocityOfMassPoint(0).y, 1e-9, L"Approaching velocity kept", LINE_INFO());
+		}
+
+		TEST_METHOD(TestFloorBounceReflectsRestOfStep)
+		{
+			MassSpringSystemSimulator sim;
+			setupPoint(sim, Vec3(0, 0, 0), Vec3(0, -10, 0));
+			sim.setCollisionEnabled(true);
+			sim.setContinuousCollisionEnabled(true);
+			sim.setCollisionResponse(0.5f, 0);
+			// touches the floor (y = -1 plus the radius) at 90% of the step,
+			// the last 0.1 m come back at half the speed
+			sim.simulateTimestep(0.1f);
+			Assert::AreEqual(5.0, sim.getVelocityOfMassPoint(0).y, 1e-9, L"Wrong rebound speed", LINE_INFO());
+			Assert::AreEqual(-0.85, sim.getPositionOfMassPoint(0).y, 1e-6, L"Rest of the step not reflected", LINE_INFO());
+		}
+
+		TEST_METHOD(TestFrictionSlowsSliding)
+		{
+			MassSpringSystemSimulator sim;
+			setupPoint(sim, Vec3(0, -0.6, 0), Vec3(4, -2, 0));
+			sim.setCollisionEnabled(true);
+			sim.setContinuousCollisionEnabled(true);
+			sim.setCollisionResponse(0, 0.5f);
+			sim.simulateTimestep(0.5f);
+			// the normal change of 2 m/s takes up to 0.5 * 2 m/s off the tangential 4 m/s
+			Assert::AreEqual(3.0, sim.getVelocityOfMassPoint(0).x, 1e-9, L"Wrong friction", LINE_INFO());
+			Assert::AreEqual(0.0, sim.getVelocityOfMassPoint(0).y, 1e-9, L"Point bounced", LINE_INFO());
+			Assert::AreEqual(-0.9, sim.getPositionOfMassPoint(0).y, 1e-6, L"Point not on the floor", LINE_INFO());
+		}
+
+		TEST_METHOD(TestMeshStopsPointOnEitherSide)
+		{
+			// a unit square in the plane x = 0, hit from both sides
+			const Vec3 vertices[4] = { Vec3(0, -1, -1), Vec3(0, 1, -1), Vec3(0, 1, 1), Vec3(0, -1, 1) };
+			const int indices[6] = { 0, 1, 2, 0, 2, 3 };
+			CollisionGeometry geometry;
+			geometry.addMesh(vertices, 4, indices, 2);
+			SweepHit hit;
+			Assert::IsTrue(geometry.sweep(Vec3(-1, 0.3, 0.2), Vec3(3, 0.3, 0.2), 0.2, hit), L"Missed from the front", LINE_INFO());
+			Assert::AreEqual(0.2, hit.t, 1e-12, L"Wrong time of impact", LINE_INFO());
+			Assert::AreEqual(-1.0, hit.normal.x, 1e-12, L"Wrong normal", LINE_INFO());
+			Assert::IsTrue(geometry.sweep(Vec3(1, 0, 0), Vec3(-1, 0, 0), 0.2, hit), L"Missed through the shared edge", LINE_INFO());
+			Assert::AreEqual(0.4, hit.t, 1e-12, L"Wrong time of impact", LINE_INFO());
+			Assert::AreEqual(1.0, hit.normal.x, 1e-12, L"Wrong normal", LINE_INFO());
+			Assert::IsFalse(geometry.sweep(Vec3(-1, 2, 0), Vec3(1, 2, 0), 0.2, hit), L"Hit beside the mesh", LINE_INFO());
+
+			MassSpringSystemSimulator sim;
+			setupPoint(sim, Vec3(-1, 0.3, 0.2), Vec3(200, 0, 0));
+			sim.addCollisionMesh(std::vector<Vec3>(vertices, vertices + 4), std::vector<int>(indices, indices + 6));
+			sim.setContinuousCollisionEnabled(true);
+			sim.setCollisionResponse(1, 0);
+			sim.simulateTimestep(0.02f);
+			// 4 m per step: 0.9 m to the contact at the point radius, 3.1 m back
+			Assert::AreEqual(-3.2, sim.getPositionOfMassPoint(0).x, 1e-6, L"Point not reflected", LINE_INFO());
+			Assert::AreEqual(-200.0, sim.getVelocityOfMassPoint(0).x, 1e-9, L"Elastic bounce lost speed", LINE_INFO());
+		}
+
+		TEST_METHOD(TestPushOutOfBoxAndPlane)
+		{
+			CollisionGeometry geometry;
+			geometry.addPlane(Vec3(0, 1, 0), 0);
+			geometry.addBox(Vec3(1, 0, 0), Vec3(2, 1, 1));
+			Vec3 normal;
+			Vec3 inPlane(-1, 0.05, 0);
+			Assert::AreEqual(1, geometry.pushOut(inPlane, 0.1, normal), L"Plane pushes", LINE_INFO());
+			Assert::AreEqual(0.1, inPlane.y, 1e-12, L"Not on the plane", LINE_INFO());
+			Vec3 inBox(1.5, 0.5, 0.95);
+			Assert::AreEqual(1, geometry.pushOut(inBox, 0.1, normal), L"Box pushes", LINE_INFO());
+			Assert::AreEqual(1.1, inBox.z, 1e-12, L"Not pushed through the nearest face", LINE_INFO());
+			Assert::AreEqual(1.0, normal.z, 0.0, L"Wrong normal", LINE_INFO());
+		}
+	};
+}
@@ -0,0 +1,134 @@
+#include "CppUnitTest.h"
+#include "MassSpringSystemSimulator.h"
+#include "SceneBuilder.h"
+
+#include <cmath>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace SimulatorTester
+{
+	TEST_CLASS(EnergyMonitorTests)
+	{
+	public:
+		TEST_METHOD(TestHistoryAndDrift)
+		{
+			EnergyMonitor monitor;
+			monitor.setHistoryLength(4);
+			for (int i = 0; i < 6; i++) {
+				EnergySample sample = EnergySample();
+				sample.time = i;
+				sample.kinetic = 10;
+				sample.elastic = 10 + i;
+				monitor.record(sample);
+			}
+			Assert::AreEqual(4, monitor.historySize(), L"History is not bounded", LINE_INFO());
+			Assert::AreEqual(5.0, monitor.latest().time, L"Wrong latest sample", LINE_INFO());
+			Assert::AreEqual(2.0, monitor.sample(3).time, L"Wrong oldest sample", LINE_INFO());
+			Assert::AreEqual(0.0, monitor.reference().time, L"Reference was overwritten", LINE_INFO());
+			Assert::AreEqual(5.0 / 20.0, monitor.drift(), 1e-12, L"Wrong relative drift", LINE_INFO());
+		}
+
+		TEST_METHOD(TestFusedEnergyMatchesDirect)
+		{
+			MassSpringSystemSimulator sim;
+			sim.setConsoleLogging(false);
+			sim.setMass(2);
+			sim.setStiffness(50);
+			sim.setGravityEnabled(true);
+			sim.addMassPoint(Vec3(0, 1, 0), Vec3(1, 0, 0), false);
+			sim.addMassPoint(Vec3(0, 3, 0), Vec3(0, 0, -2), false);
+			sim.addSpring(0, 1, 1.5);
+			sim.setEnergyMonitoring(true);
+			sim.simulateTimestep(0.001f);
+
+			// the sample describes the state before the step
+			const EnergySample& sample = sim.getEnergyMonitor().reference();
+			Assert::AreEqual(0.5 * 2 * (1 + 4), sample.kinetic, 1e-12, L"Wrong kinetic energy", LINE_INFO());
+			Assert::AreEqual(0.5 * 50 * 0.5 * 0.5, sample.elastic, 1e-12, L"Wrong elastic energy", LINE_INFO());
+			Assert::AreEqual(9.81 * 2 * (1 + 3), sample.gravity, 1e-12, L"Wrong gravitational energy", LINE_INFO());
+			Assert::AreEqual(2.0, sample.momentum.x, 1e-12, L"Wrong momentum x", LINE_INFO());
+			Assert::AreEqual(-4.0, sample.momentum.z, 1e-12, L"Wrong momentum z", LINE_INFO());
+		}
+
+		TEST_METHOD(TestVerletConservesEnergyAndMomentum)
+		{
+			MassSpringSystemSimulator sim;
+			sim.setConsoleLogging(false);
+			buildRandomGraph(&sim, 200, 4);
+			sim.setIntegrator(VELOCITY_VERLET);
+			sim.setEnergyMonitoring(true);
+			int warnings = 0;
+			sim.getEnergyMonitor().onDrift = [&warnings](const EnergySample&, Real) { warnings++; };
+			for (int i = 0; i < 1000; i++) sim.simulateTimestep(0.002f);
+
+			const EnergyMonitor& monitor = sim.getEnergyMonitor();
+			Assert::IsTrue(monitor.reference().elastic > 0, L"Scene starts without energy", LINE_INFO());
+			Assert::IsTrue(fabs(monitor.drift()) < 1e-3, L"Velocity Verlet drifted", LINE_INFO());
+			Assert::IsTrue(monitor.momentumDrift() < 1e-9, L"Momentum is not conserved", LINE_INFO());
+			Assert::AreEqual(0, warnings, L"Drift callback fired", LINE_INFO());
+		}
+
+		TEST_METHOD(TestEulerDriftFiresCallbackOnce)
+		{
+			MassSpringSystemSimulator sim;
+			sim.setConsoleLogging(false);
+			buildRandomGraph(&sim, 200, 4);
+			sim.setIntegrator(EULER);
+			sim.setEnergyMonitoring(true);
+			int warnings = 0;
+			Real reportedDrift = 0;
+			sim.getEnergyMonitor().onDrift = [&](const EnergySample&, Real drift) { warnings++; reportedDrift = drift; };
+			for (int i = 0; i < 500; i++) sim.simulateTimestep(0.01f);
+
+			Assert::AreEqual(1, warnings, L"Callback is not edge triggered", LINE_INFO());
+			Assert::IsTrue(reportedDrift > 0.01, L"Explicit Euler should gain energy", LINE_INFO());
+		}
+
+		TEST_METHOD(TestAutoTimestep)
+		{
+			MassSpringSystemSimulator unstable, calm;
+			unstable.setConsoleLogging(false);
+			calm.setConsoleLogging(false);
+			buildRandomGraph(&unstable, 200, 4);
+			buildRandomGraph(&calm, 200, 4);
+			unstable.setIntegrator(EULER);
+			calm.setIntegrator(VELOCITY_VERLET);
+			unstable.setAutoTimestep(true);
+			calm.setAutoTimestep(true);
+
+			float unstableStep = 0.05f, calmStep = 1e-4f;
+			for (int i = 0; i < 2000; i++) {
+				unstableStep = unstable.suggestTimestep(unstableStep);
+				unstable.simulateTimestep(unstableStep);
+				calmStep = calm.suggestTimestep(calmStep);
+				calm.simulateTimestep(calmStep);
+			}
+			Assert::IsTrue(unstableStep < 0.01f, L"Step of a drifting scene was not reduced", LINE_INFO());
+			Assert::IsTrue(calmStep > 1e-4f, L"Step of a conservative scene was not raised", LINE_INFO());
+			Vec3 p = unstable.getPositionOfMassPoint(0);
+			Assert::IsTrue(std::isfinite(p.x) && std::isfinite(p.y) && std::isfinite(p.z), L"Auto dt diverged", LINE_INFO());
+		}
+
+		TEST_METHOD(TestParallelEnergyMatchesSerial)
+		{
+			// enough springs for the threaded force path
+			MassSpringSystemSimulator serial, parallel;
+			serial.setConsoleLogging(false);
+			parallel.setConsoleLogging(false);
+			buildRandomGraph(&serial, 5000, 4);
+			buildRandomGraph(&parallel, 5000, 4);
+			serial.setThreadCount(1);
+			parallel.setThreadCount(3);
+			serial.setEnergyMonitoring(true);
+			parallel.setEnergyMonitoring(true);
+			for (int i = 0; i < 5; i++) {
+				serial.simulateTimestep(0.001f);
+				parallel.simulateTimestep(0.001f);
+			}
+			const Real a = serial.getEnergyMonitor().latest().elastic;
+			const Real b = parallel.getEnergyMonitor().latest().elastic;
+			Assert::AreEqual(a, b, 1e-9 * a, L"Parallel spring energy differs", LINE_INFO());
+		}
+	};
+}
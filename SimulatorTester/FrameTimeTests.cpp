@@ -0,0 +1,106 @@
+#include "CppUnitTest.h"
+#include "util/frametimes.h"
+#include "util/histogram.h"
+
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace SimulatorTester
+{
+	TEST_CLASS(FrameTimeTests)
+	{
+	public:
+		TEST_METHOD(TestPercentilesWithinBucketWidth)
+		{
+			LatencyHistogram histogram;
+			// 1 us .. 10 ms in 1 us steps
+			for (uint64_t i = 1; i <= 10000; i++) histogram.record(i * 1000);
+			const double expected[] = { 50, 90, 95, 99, 99.9 };
+			for (double percent : expected) {
+				const double exact = percent * 100 * 1000;
+				const double relative = (histogram.percentile(percent) - exact) / exact;
+				Assert::IsTrue(relative >= 0 && relative < 1.0 / 64, L"Percentile outside its bucket", LINE_INFO());
+			}
+			Assert::AreEqual((uint64_t)10000000, histogram.percentile(100), L"p100 is not the max", LINE_INFO());
+			Assert::AreEqual((uint64_t)1000, histogram.min(), L"Wrong min", LINE_INFO());
+			Assert::AreEqual((uint64_t)10000000, histogram.max(), L"Wrong max", LINE_INFO());
+			Assert::AreEqual(5000500.0, histogram.mean(), 1e-6, L"Wrong mean", LINE_INFO());
+		}
+
+		TEST_METHOD(TestTailIsNotAveragedAway)
+		{
+			LatencyHistogram histogram;
+			for (int i = 0; i < 990; i++) histogram.record(1000000);
+			for (int i = 0; i < 10; i++) histogram.record(50000000);
+			Assert::IsTrue(histogram.percentile(50) <= 1000000 * 65 / 64, L"Median moved by the spikes", LINE_INFO());
+			Assert::IsTrue(histogram.percentile(99) <= 1000000 * 65 / 64, L"p99 includes the top 1%", LINE_INFO());
+			Assert::AreEqual((uint64_t)50000000, histogram.percentile(99.5), L"Spikes missing above p99", LINE_INFO());
+		}
+
+		TEST_METHOD(TestEmptyMergeAndClamp)
+		{
+			LatencyHistogram a, b;
+			Assert::AreEqual((uint64_t)0, a.percentile(99), L"Empty histogram has a percentile", LINE_INFO());
+			Assert::AreEqual((uint64_t)0, a.min(), L"Empty histogram has a min", LINE_INFO());
+
+			a.record(10);
+			b.record(LATENCY_HISTOGRAM_MAX_NS * 2);
+			a.merge(b);
+			Assert::AreEqual((uint64_t)2, a.count(), L"Merge lost samples", LINE_INFO());
+			Assert::AreEqual((uint64_t)10, a.min(), L"Merge lost the min", LINE_INFO());
+			Assert::AreEqual((uint64_t)(LATENCY_HISTOGRAM_MAX_NS * 2), a.max(), L"Max is not exact", LINE_INFO());
+			Assert::IsTrue(a.percentile(100) >= LATENCY_HISTOGRAM_MAX_NS / 2, L"Overflow not clamped into the last bucket", LINE_INFO());
+
+			a.reset();
+			Assert::AreEqual((uint64_t)0, a.count(), L"Reset kept samples", LINE_INFO());
+		}
+
+		TEST_METHOD(TestIntervalRestartsButTotalKeeps)
+		{
+			frameTimesReset();
+			for (int i = 0; i < 10; i++) frameTimesRecord(FRAME_STAGE_RENDER, 2000000);
+			frameTimesStartInterval();
+			frameTimesRecord(FRAME_STAGE_RENDER, 4000000);
+			Assert::AreEqual((uint64_t)11, frameTimesTotal(FRAME_STAGE_RENDER).count(), L"Total lost samples", LINE_INFO());
+			Assert::AreEqual((uint64_t)1, frameTimesInterval(FRAME_STAGE_RENDER).count(), L"Interval not restarted", LINE_INFO());
+			Assert::IsTrue(frameTimesIntervalSummary().find("render 4.00/4.00 ms") != std::string::npos, L"Wrong summary", LINE_INFO());
+			Assert::IsTrue(frameTimesReport().find("render") != std::string::npos, L"Stage missing in report", LINE_INFO());
+			Assert::IsTrue(frameTimesReport().find("capture") == std::string::npos, L"Stage without samples reported", LINE_INFO());
+			{
+				FrameTimer timer(FRAME_STAGE_CAPTURE);
+			}
+			Assert::AreEqual((uint64_t)1, frameTimesTotal(FRAME_STAGE_CAPTURE).count(), L"Timer not recorded", LINE_INFO());
+			frameTimesReset();
+		}
+
+		TEST_METHOD(TestDumpWritesPeriods)
+		{
+			const std::string path = "frame_time_dump_test.csv";
+			frameTimesReset();
+			Assert::IsTrue(frameTimesStartDump(path, 0.001), L"Dump not started", LINE_INFO());
+			frameTimesRecord(FRAME_STAGE_SIMULATION, 1000000);
+			std::this_thread::sleep_for(std::chrono::milliseconds(5));
+			frameTimesPoll();
+			frameTimesRecord(FRAME_STAGE_SIMULATION, 3000000);
+			frameTimesStopDump();
+
+			std::ifstream in(path);
+			std::string header, first, second, extra;
+			std::getline(in, header);
+			std::getline(in, first);
+			std::getline(in, second);
+			Assert::IsTrue(header.compare(0, 8, "seconds,") == 0, L"Missing header", LINE_INFO());
+			Assert::IsTrue(first.find(",sim,1,1.0000,") != std::string::npos, L"First period wrong", LINE_INFO());
+			Assert::IsTrue(second.find(",sim,1,3.0000,") != std::string::npos, L"Partial period not written on stop", LINE_INFO());
+			Assert::IsTrue(!std::getline(in, extra), L"Unexpected lines", LINE_INFO());
+			in.close();
+			std::remove(path.c_str());
+			frameTimesReset();
+		}
+	};
+}
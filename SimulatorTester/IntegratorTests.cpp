@@ -0,0 +1,264 @@
+#include "CppUnitTest.h"
+#include "MassSpringSystemSimulator.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace SimulatorTester
+{
+	TEST_CLASS(IntegratorTests)
+	{
+	public:
+		// same two-point oscillator as the public tests
+		void oscillatorSetup(MassSpringSystemSimulator* &msss, float stiffness = 40.0f) {
+			if (msss) delete msss;
+			msss = new MassSpringSystemSimulator();
+			msss->setMass(10.0f);
+			msss->setDampingFactor(0.0f);
+			msss->setStiffness(stiffness);
+			int p0 = msss->addMassPoint(Vec3(0.0, 0.0f, 0), Vec3(-1.0, 0.0f, 0), false);
+			int p1 = msss->addMassPoint(Vec3(0.0, 2.0f, 0), Vec3(1.0, 0.0f, 0), false);
+			msss->addSpring(p0, p1, 1.0);
+		}
+
+		double oscillatorEnergy(MassSpringSystemSimulator* msss, double stiffness = 40.0) {
+			Vec3 v0 = msss->getVelocityOfMassPoint(0);
+			Vec3 v1 = msss->getVelocityOfMassPoint(1);
+			double kinetic = 0.5 * 10.0 * (dot(v0, v0) + dot(v1, v1));
+			double stretch = norm(msss->getPositionOfMassPoint(0) - msss->getPositionOfMassPoint(1)) - 1.0;
+			return kinetic + 0.5 * stiffness * stretch * stretch;
+		}
+
+		// relative energy error after a long run at 10x the default test step
+		double energyDrift(int integrator, float timeStep, int steps) {
+			MassSpringSystemSimulator * msss = NULL;
+			oscillatorSetup(msss);
+			msss->setIntegrator(integrator);
+			double e0 = oscillatorEnergy(msss);
+			double maxDrift = 0;
+			for (int i = 0; i < steps; i++) {
+				msss->simulateTimestep(timeStep);
+				maxDrift = max(maxDrift, fabs(oscillatorEnergy(msss) - e0) / e0);
+			}
+			delete msss;
+			return maxDrift;
+		}
+
+		// position error after steps against RK4 run at a tenth of the step
+		double positionError(int integrator, float timeStep, int steps) {
+			MassSpringSystemSimulator * msss = NULL;
+			MassSpringSystemSimulator * reference = NULL;
+			oscillatorSetup(msss);
+			oscillatorSetup(reference);
+			msss->setIntegrator(integrator);
+			reference->setIntegrator(RK4);
+			for (int i = 0; i < steps; i++) msss->simulateTimestep(timeStep);
+			for (int i = 0; i < 10 * steps; i++) reference->simulateTimestep(timeStep / 10);
+			double error = norm(msss->getPositionOfMassPoint(1) - reference->getPositionOfMassPoint(1));
+			delete msss;
+			delete reference;
+			return error;
+		}
+
+		TEST_METHOD(TestVelocityVerletMatchesEulerForOneTinyStep)
+		{
+			MassSpringSystemSimulator * msss = NULL;
+			oscillatorSetup(msss);
+			msss->setIntegrator(VELOCITY_VERLET);
+			msss->simulateTimestep(1e-5f);
+			Assert::AreEqual(-1e-5f, (float)msss->getPositionOfMassPoint(0).x, 1e-7f, L"Mass Point at index 0, X value is wrong !!", LINE_INFO());
+			Assert::AreEqual(2.0f, (float)msss->getPositionOfMassPoint(1).y, 1e-6f, L"Mass Point at index 1, Y value is wrong !!", LINE_INFO());
+			delete msss;
+		}
+
+		TEST_METHOD(TestDampingChangeDropsCachedForces)
+		{
+			// the first Verlet step leaves the forces of the new positions cached
+			MassSpringSystemSimulator * undamped = NULL;
+			MassSpringSystemSimulator * damped = NULL;
+			oscillatorSetup(undamped);
+			oscillatorSetup(damped);
+			undamped->setIntegrator(VELOCITY_VERLET);
+			damped->setIntegrator(VELOCITY_VERLET);
+			undamped->simulateTimestep(0.05f);
+			damped->simulateTimestep(0.05f);
+			damped->setDampingFactor(5.0f);
+			undamped->simulateTimestep(0.05f);
+			damped->simulateTimestep(0.05f);
+			double difference = norm(undamped->getPositionOfMassPoint(0) - damped->getPositionOfMassPoint(0));
+			Assert::IsTrue(difference > 1e-6, L"Drift used forces of the old damping", LINE_INFO());
+			delete undamped;
+			delete damped;
+		}
+
+		TEST_METHOD(TestLeapfrogStartsWithHalfKick)
+		{
+			// the spring pulls point 0 up with a = 40 * (2 - 1) / 10
+			MassSpringSystemSimulator * msss = NULL;
+			oscillatorSetup(msss);
+			msss->setIntegrator(LEAPFROG);
+			msss->simulateTimestep(0.1f);
+			Assert::AreEqual(0.02, msss->getPositionOfMassPoint(0).y, 1e-7, L"Drift without the half kick velocity", LINE_INFO());
+			delete msss;
+		}
+
+		TEST_METHOD(TestLeapfrogReportsSynchronisedVelocities)
+		{
+			// the getter and the energy monitor see the velocities at the
+			// positions, as velocity Verlet keeps them
+			MassSpringSystemSimulator * leapfrog = NULL;
+			MassSpringSystemSimulator * verlet = NULL;
+			oscillatorSetup(leapfrog);
+			oscillatorSetup(verlet);
+			leapfrog->setIntegrator(LEAPFROG);
+			verlet->setIntegrator(VELOCITY_VERLET);
+			leapfrog->setEnergyMonitoring(true);
+			verlet->setEnergyMonitoring(true);
+			for (int i = 0; i < 200; i++) {
+				leapfrog->simulateTimestep(0.05f);
+				verlet->simulateTimestep(0.05f);
+			}
+			for (int p = 0; p < 2; p++) {
+				Assert::AreEqual(0.0, norm(leapfrog->getVelocityOfMassPoint(p) - verlet->getVelocityOfMassPoint(p)), 1e-9, L"Velocity half a step behind", LINE_INFO());
+			}
+			Assert::AreEqual(verlet->getEnergyMonitor().drift(), leapfrog->getEnergyMonitor().drift(), 1e-9, L"Energy of the lagging velocities", LINE_INFO());
+			delete leapfrog;
+			delete verlet;
+		}
+
+		TEST_METHOD(TestLeapfrogSynchronisesOnSwitch)
+		{
+			// staggered leapfrog is kick-drift-kick with the half kicks merged
+			MassSpringSystemSimulator * leapfrog = NULL;
+			MassSpringSystemSimulator * verlet = NULL;
+			oscillatorSetup(leapfrog);
+			oscillatorSetup(verlet);
+			leapfrog->setIntegrator(LEAPFROG);
+			verlet->setIntegrator(VELOCITY_VERLET);
+			for (int i = 0; i < 10; i++) {
+				leapfrog->simulateTimestep(0.05f);
+				verlet->simulateTimestep(0.05f);
+			}
+			leapfrog->setIntegrator(VELOCITY_VERLET);
+			leapfrog->simulateTimestep(0.05f);
+			verlet->simulateTimestep(0.05f);
+			for (int p = 0; p < 2; p++) {
+				Assert::AreEqual(0.0, norm(leapfrog->getPositionOfMassPoint(p) - verlet->getPositionOfMassPoint(p)), 1e-9, L"Positions differ", LINE_INFO());
+				Assert::AreEqual(0.0, norm(leapfrog->getVelocityOfMassPoint(p) - verlet->getVelocityOfMassPoint(p)), 1e-9, L"Velocities still staggered", LINE_INFO());
+			}
+			delete leapfrog;
+			delete verlet;
+		}
+
+		TEST_METHOD(TestLeapfrogEnergyBounded)
+		{
+			double drift = energyDrift(LEAPFROG, 0.05f, 20000);
+			Assert::IsTrue(drift < 0.1, L"Leapfrog energy drift too large", LINE_INFO());
+		}
+
+		TEST_METHOD(TestVelocityVerletEnergyBounded)
+		{
+			double drift = energyDrift(VELOCITY_VERLET, 0.05f, 20000);
+			Assert::IsTrue(drift < 0.01, L"Velocity Verlet energy drift too large", LINE_INFO());
+		}
+
+		TEST_METHOD(TestYoshida4EnergyBounded)
+		{
+			double drift = energyDrift(YOSHIDA4, 0.05f, 20000);
+			Assert::IsTrue(drift < 0.001, L"Yoshida energy drift too large", LINE_INFO());
+		}
+
+		TEST_METHOD(TestYoshida4MoreAccurateThanVerlet)
+		{
+			double verlet = energyDrift(VELOCITY_VERLET, 0.05f, 2000);
+			double yoshida = energyDrift(YOSHIDA4, 0.05f, 2000);
+			Assert::IsTrue(yoshida < verlet, L"Yoshida should be more accurate than velocity Verlet", LINE_INFO());
+		}
+
+		TEST_METHOD(TestImplicitEulerStableForStiffSprings)
+		{
+			// explicit methods need dt < 2/sqrt(k/m_reduced) ~ 4.5e-3 here;
+			// critical damping is about 2 sqrt(k m_reduced) ~ 4.5e3
+			const float stiffness = 1e6f;
+			const float dampings[] = { 0.0f, 1e4f, 1e5f };
+			for (float damping : dampings) {
+				MassSpringSystemSimulator * msss = NULL;
+				oscillatorSetup(msss, stiffness);
+				msss->setDampingFactor(damping);
+				msss->setIntegrator(IMPLICIT_EULER);
+				double e0 = oscillatorEnergy(msss, stiffness);
+				for (int i = 0; i < 600; i++) {
+					msss->simulateTimestep(1.0f / 60.0f);
+					double e = oscillatorEnergy(msss, stiffness);
+					Assert::IsTrue(e == e && e <= e0 * (1 + 1e-6), L"Implicit Euler gained energy on a stiff spring", LINE_INFO());
+				}
+				Assert::IsTrue(msss->getLastSolverIterations() < 200, L"CG did not converge", LINE_INFO());
+				delete msss;
+			}
+		}
+
+		TEST_METHOD(TestImplicitEulerConvergesToVerlet)
+		{
+			MassSpringSystemSimulator * implicitSim = NULL;
+			MassSpringSystemSimulator * verletSim = NULL;
+			oscillatorSetup(implicitSim);
+			oscillatorSetup(verletSim);
+			implicitSim->setIntegrator(IMPLICIT_EULER);
+			verletSim->setIntegrator(VELOCITY_VERLET);
+			for (int i = 0; i < 1000; i++) {
+				implicitSim->simulateTimestep(0.0001f);
+				verletSim->simulateTimestep(0.0001f);
+			}
+			Vec3 d = implicitSim->getPositionOfMassPoint(1) - verletSim->getPositionOfMassPoint(1);
+			Assert::AreEqual(0.0f, (float)norm(d), 1e-4f, L"Implicit Euler deviates from Verlet at small steps", LINE_INFO());
+			delete implicitSim;
+			delete verletSim;
+		}
+
+		TEST_METHOD(TestRungeKutta4Accurate)
+		{
+			double drift = energyDrift(RK4, 0.05f, 2000);
+			Assert::IsTrue(drift < 1e-3, L"RK4 energy drift too large", LINE_INFO());
+		}
+
+		TEST_METHOD(TestDormandPrinceMoreAccurateThanRungeKutta4)
+		{
+			double rk4 = energyDrift(RK4, 0.05f, 2000);
+			double dopri = energyDrift(DORMAND_PRINCE, 0.05f, 2000);
+			Assert::IsTrue(dopri < rk4, L"Dormand-Prince should be more accurate than RK4", LINE_INFO());
+		}
+
+		TEST_METHOD(TestHeunIsSecondOrder)
+		{
+			// halving the step should roughly quarter the error at a fixed time
+			double coarse = positionError(HEUN, 0.02f, 50);
+			double fine = positionError(HEUN, 0.01f, 100);
+			Assert::IsTrue(coarse / fine > 3.0 && coarse / fine < 5.0, L"Heun is not second order", LINE_INFO());
+		}
+
+		TEST_METHOD(TestEulerEnergyGrows)
+		{
+			double drift = energyDrift(EULER, 0.05f, 2000);
+			Assert::IsTrue(drift > 0.5, L"Explicit Euler was expected to gain energy at this step size", LINE_INFO());
+		}
+
+		TEST_METHOD(TestOnlyDemo1IgnoresSteps)
+		{
+			// a simulator built directly has never selected a case and steps
+			MassSpringSystemSimulator* msss = NULL;
+			oscillatorSetup(msss);
+			msss->setConsoleLogging(false);
+			msss->simulateTimestep(0.005f);
+			Assert::IsTrue(msss->getPositionOfMassPoint(0).x < 0, L"Direct simulator did not step", LINE_INFO());
+			// Demo1 shows its precomputed step only
+			msss->notifyCaseChanged(0);
+			const Vec3 shown = msss->getPositionOfMassPoint(0);
+			msss->simulateTimestep(0.005f);
+			Assert::IsTrue(norm(msss->getPositionOfMassPoint(0) - shown) == 0, L"Demo1 stepped", LINE_INFO());
+			msss->notifyCaseChanged(1);
+			const Vec3 start = msss->getPositionOfMassPoint(0);
+			msss->simulateTimestep(0.005f);
+			Assert::IsFalse(norm(msss->getPositionOfMassPoint(0) - start) == 0, L"Demo2 did not step", LINE_INFO());
+			delete msss;
+		}
+	};
+}
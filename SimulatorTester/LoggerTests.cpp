@@ -0,0 +1,106 @@
+#include "CppUnitTest.h"
+#include "MassSpringSystemSimulator.h"
+#include "util/logger.h"
+
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace SimulatorTester
+{
+	TEST_CLASS(LoggerTests)
+	{
+	public:
+		// runs body with the log written into the returned string
+		template <class Body>
+		std::string capture(Body body) {
+			std::stringstream out;
+			logFlush();
+			logSetOutput(&out);
+			body();
+			logFlush();
+			logSetOutput(&std::cout);
+			return out.str();
+		}
+
+		int countLines(const std::string& text, const std::string& prefix) {
+			int count = 0;
+			std::istringstream in(text);
+			std::string line;
+			while (std::getline(in, line)) count += line.compare(0, prefix.size(), prefix) == 0;
+			return count;
+		}
+
+		TEST_METHOD(TestFormatsRecordsInOrder)
+		{
+			const double px[] = { 1, 2 }, py[] = { 0, 0.5 }, pz[] = { 0, 0 };
+			const double vx[] = { 0, 0 }, vy[] = { -1, 0 }, vz[] = { 0, 0.25 };
+			const std::string text = capture([&]() {
+				logText("Euler:");
+				logPointStates(px, py, pz, vx, vy, vz, 0, 2);
+				logEvent("energy drift", 0.5);
+			});
+			Assert::AreEqual(std::string(
+				"Euler:\n"
+				"Point 0: position = <1.000000,0.000000,0.000000>; velocity = <0.000000,-1.000000,0.000000>\n"
+				"Point 1: position = <2.000000,0.500000,0.000000>; velocity = <0.000000,0.000000,0.250000>\n"
+				"energy drift = 0.5\n"), text, L"Wrong log text", LINE_INFO());
+		}
+
+		TEST_METHOD(TestFullQueueDropsWholeRecords)
+		{
+			// about 10 MB of records, more than one ring holds
+			const int n = LOG_POINTS_PER_RECORD * 800;
+			std::vector<double> zeros(n, 0.0);
+			const uint64_t droppedBefore = logDroppedRecords();
+			const std::string text = capture([&]() {
+				const double* z = zeros.data();
+				logPointStates(z, z, z, z, z, z, 0, n);
+			});
+			const uint64_t dropped = logDroppedRecords() - droppedBefore;
+			Assert::AreEqual((int64_t)n, (int64_t)countLines(text, "Point ") + (int64_t)dropped * LOG_POINTS_PER_RECORD, L"Points lost without being counted", LINE_INFO());
+			if (dropped) Assert::IsTrue(text.find("log records dropped") != std::string::npos, L"Drops not reported", LINE_INFO());
+		}
+
+		TEST_METHOD(TestThreadsKeepTheirOrder)
+		{
+			const std::string text = capture([&]() {
+				std::vector<std::thread> threads;
+				for (int t = 0; t < 2; ++t) {
+					threads.emplace_back([t]() {
+						const char* names[] = { "a", "b" };
+						for (int i = 0; i < 100; ++i) logEvent(names[t], i);
+					});
+				}
+				for (auto& thread : threads) thread.join();
+			});
+			for (const char* name : { "a", "b" }) {
+				int expected = 0;
+				std::istringstream in(text);
+				std::string line;
+				while (std::getline(in, line)) {
+					if (line.compare(0, 4, std::string(name) + " = ") != 0) continue;
+					Assert::AreEqual(expected++, std::stoi(line.substr(4)), L"Records of a thread out of order", LINE_INFO());
+				}
+				Assert::AreEqual(100, expected, L"Records missing", LINE_INFO());
+			}
+		}
+
+		TEST_METHOD(TestFirstStepIsLogged)
+		{
+			const std::string text = capture([&]() {
+				MassSpringSystemSimulator sim;
+				sim.addMassPoint(Vec3(0, 0, 0), Vec3(), false);
+				sim.addMassPoint(Vec3(0, 2, 0), Vec3(), false);
+				sim.addSpring(0, 1, 1);
+				sim.simulateTimestep(0.01f);
+				sim.simulateTimestep(0.01f);
+			});
+			Assert::AreEqual(2, countLines(text, "Point "), L"First step not logged once", LINE_INFO());
+		}
+	};
+}
@@ -0,0 +1,80 @@
+#include "CppUnitTest.h"
+#include "MassSpringSystemSimulator.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace SimulatorTester
+{
+	TEST_CLASS(MassSpringTopologyTests)
+	{
+	public:
+		// 0 - 1 - 2 chain plus a 0 - 2 diagonal
+		void triangleSceneSetup(MassSpringSystemSimulator* &msss) {
+			if (msss) delete msss;
+			msss = new MassSpringSystemSimulator();
+			msss->setMass(10.0f);
+			msss->setStiffness(40.0f);
+			int p0 = msss->addMassPoint(Vec3(0, 0, 0), Vec3(0, 0, 0), false);
+			int p1 = msss->addMassPoint(Vec3(1, 0, 0), Vec3(0, 0, 0), false);
+			int p2 = msss->addMassPoint(Vec3(1, 1, 0), Vec3(0, 0, 0), false);
+			msss->addSpring(p0, p1, 1.0);
+			msss->addSpring(p1, p2, 1.0);
+			msss->addSpring(p0, p2, 1.0);
+		}
+
+		TEST_METHOD(TestSpringAdjacencyDegrees)
+		{
+			MassSpringSystemSimulator * msss = NULL;
+			triangleSceneSetup(msss);
+			const SpringAdjacency& adj = msss->getSpringAdjacency();
+			Assert::AreEqual(3, adj.numPoints(), L"Adjacency has wrong number of points", LINE_INFO());
+			Assert::AreEqual(2, adj.degree(0), L"Point 0 should have 2 springs", LINE_INFO());
+			Assert::AreEqual(2, adj.degree(1), L"Point 1 should have 2 springs", LINE_INFO());
+			Assert::AreEqual(2, adj.degree(2), L"Point 2 should have 2 springs", LINE_INFO());
+			// springs of point 0 in insertion order: 0 (to 1) and 2 (to 2)
+			Assert::AreEqual(0, adj.springs[adj.offsets[0]], L"First spring of point 0 is wrong", LINE_INFO());
+			Assert::AreEqual(1, adj.neighbors[adj.offsets[0]], L"First neighbor of point 0 is wrong", LINE_INFO());
+			Assert::AreEqual(2, adj.springs[adj.offsets[0] + 1], L"Second spring of point 0 is wrong", LINE_INFO());
+			Assert::AreEqual(2, adj.neighbors[adj.offsets[0] + 1], L"Second neighbor of point 0 is wrong", LINE_INFO());
+			delete msss;
+		}
+
+		TEST_METHOD(TestSpringAdjacencyRebuiltAfterAddSpring)
+		{
+			MassSpringSystemSimulator * msss = NULL;
+			triangleSceneSetup(msss);
+			Assert::AreEqual(2, msss->getSpringAdjacency().degree(0), L"Point 0 should have 2 springs", LINE_INFO());
+			int p3 = msss->addMassPoint(Vec3(0, 1, 0), Vec3(0, 0, 0), false);
+			msss->addSpring(0, p3, 1.0);
+			const SpringAdjacency& adj = msss->getSpringAdjacency();
+			Assert::AreEqual(4, adj.numPoints(), L"Adjacency was not rebuilt", LINE_INFO());
+			Assert::AreEqual(3, adj.degree(0), L"Point 0 should have 3 springs", LINE_INFO());
+			Assert::AreEqual(1, adj.degree(p3), L"New point should have 1 spring", LINE_INFO());
+			delete msss;
+		}
+
+		TEST_METHOD(TestTeapotIsNotAScenePoint)
+		{
+			MassSpringSystemSimulator sim;
+			sim.setConsoleLogging(false);
+			sim.notifyCaseChanged(3);
+			Assert::AreEqual(12, sim.getNumberOfMassPoints(), L"Demo4 counts the teapot", LINE_INFO());
+			Assert::AreEqual(20, sim.getNumberOfSprings(), L"Demo4 springs", LINE_INFO());
+			// a later point takes the next public index, the teapot moves behind it
+			const int p = sim.addMassPoint(Vec3(5, 5, 5), Vec3(0, 0, 0), true);
+			Assert::AreEqual(12, p, L"Index of the added point", LINE_INFO());
+			Assert::AreEqual(13, sim.getNumberOfMassPoints(), L"Point count", LINE_INFO());
+			Assert::AreEqual(5.0, sim.getPositionOfMassPoint(p).x, 0.0, L"Added point moved", LINE_INFO());
+			const SpringAdjacency& adj = sim.getSpringAdjacency();
+			Assert::AreEqual(0, adj.degree(p), L"Teapot springs left on the added point", LINE_INFO());
+			Assert::AreEqual(4, adj.degree(p + 1), L"Teapot springs lost", LINE_INFO());
+			// the colouring has reordered the springs since
+			const int q = sim.addMassPoint(Vec3(6, 5, 5), Vec3(0, 0, 0), true);
+			sim.addSpring(p, q, 1);
+			const SpringAdjacency& after = sim.getSpringAdjacency();
+			Assert::AreEqual(1, after.degree(p), L"Teapot springs left on the first added point", LINE_INFO());
+			Assert::AreEqual(1, after.degree(q), L"Teapot springs left on the second added point", LINE_INFO());
+			Assert::AreEqual(4, after.degree(q + 1), L"Teapot springs lost after reordering", LINE_INFO());
+		}
+	};
+}
@@ -0,0 +1,86 @@
+#include "CppUnitTest.h"
+#include "MassSpringSystemSimulator.h"
+#include "SceneBuilder.h"
+#include "util/memorytags.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace SimulatorTester
+{
+	TEST_CLASS(MemoryTagTests)
+	{
+	public:
+		TEST_METHOD(TestTaggedVectorCounts)
+		{
+			const MemoryTagStats before = memoryTagStats(MEMORY_TAG_OTHER);
+			memoryResetPeaks();
+			{
+				TaggedVector<double, MEMORY_TAG_OTHER> values(1000);
+				const MemoryTagStats during = memoryTagStats(MEMORY_TAG_OTHER);
+				Assert::AreEqual(before.currentBytes + 8000, during.currentBytes, L"Allocation not counted", LINE_INFO());
+				Assert::AreEqual(before.allocations + 1, during.allocations, L"Allocation count", LINE_INFO());
+			}
+			const MemoryTagStats after = memoryTagStats(MEMORY_TAG_OTHER);
+			Assert::AreEqual(before.currentBytes, after.currentBytes, L"Free not counted", LINE_INFO());
+			Assert::AreEqual(before.frees + 1, after.frees, L"Free count", LINE_INFO());
+			Assert::IsTrue(after.peakBytes >= before.currentBytes + 8000, L"Peak not kept", LINE_INFO());
+		}
+
+		TEST_METHOD(TestArenaHandsOutToTags)
+		{
+			const int64_t totalBefore = memoryTotalBytes();
+			const int64_t pointsBefore = memoryTagStats(MEMORY_TAG_POINTS).currentBytes;
+			{
+				SceneArena arena(4096);
+				MassPointStore points(&arena);
+				for (int i = 0; i < 1000; i++) points.add(Vec3(i, 0, 0), Vec3(), false, 1);
+				// the blocks are all the arena took from the system, however they are split
+				Assert::AreEqual(totalBefore + (int64_t)arena.bytesReserved(), memoryTotalBytes(), L"Arena memory counted twice", LINE_INFO());
+				// block tails skipped by a request stay with the arena
+				const int64_t charged = memoryTagStats(MEMORY_TAG_POINTS).currentBytes - pointsBefore;
+				Assert::IsTrue(charged >= 1000 * (11 * 8 + 1) && charged <= (int64_t)arena.bytesInUse(), L"Points not charged", LINE_INFO());
+
+				points.release();
+				arena.reset();
+				Assert::AreEqual(pointsBefore, memoryTagStats(MEMORY_TAG_POINTS).currentBytes, L"Reset did not take the points back", LINE_INFO());
+				Assert::AreEqual(totalBefore + (int64_t)arena.bytesReserved(), memoryTotalBytes(), L"Reset changed the reserve", LINE_INFO());
+			}
+			Assert::AreEqual(totalBefore, memoryTotalBytes(), L"Arena blocks leaked", LINE_INFO());
+		}
+
+		TEST_METHOD(TestSceneReloadIsBalanced)
+		{
+			MassSpringSystemSimulator sim;
+			sim.setConsoleLogging(false);
+			sim.notifyCaseChanged(3);
+			sim.simulateTimestep(0.01f);
+			const MemoryTagStats springs = sim.getMemoryStats(MEMORY_TAG_SPRINGS);
+			const int64_t total = memoryTotalBytes();
+			for (int i = 0; i < 5; i++) {
+				sim.notifyCaseChanged(3);
+				sim.simulateTimestep(0.01f);
+			}
+			Assert::AreEqual(springs.currentBytes, sim.getMemoryStats(MEMORY_TAG_SPRINGS).currentBytes, L"Spring memory grows on reload", LINE_INFO());
+			Assert::AreEqual(total, memoryTotalBytes(), L"Memory grows on reload", LINE_INFO());
+			Assert::IsTrue(sim.getMemoryReport().find("springs") != std::string::npos, L"Tag missing in report", LINE_INFO());
+		}
+
+		TEST_METHOD(TestExternalForceIsConsumed)
+		{
+			MassSpringSystemSimulator sim;
+			sim.setConsoleLogging(false);
+			sim.setMass(2);
+			sim.setIntegrator(EULER);
+			sim.addMassPoint(Vec3(0, 0, 0), Vec3(), false);
+
+			const int64_t total = memoryTotalBytes();
+			for (int i = 0; i < 100000; i++) sim.applyExternalForce(Vec3(0.00001, 0, 0));
+			Assert::AreEqual(total, memoryTotalBytes(), L"External forces use memory", LINE_INFO());
+
+			sim.simulateTimestep(0.1f);
+			sim.simulateTimestep(0.1f);
+			// a = F / m = 0.5 during the first step only
+			Assert::AreEqual(0.05, sim.getVelocityOfMassPoint(0).x, 1e-9, L"External force not applied once", LINE_INFO());
+		}
+	};
+}
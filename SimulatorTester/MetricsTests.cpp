@@ -0,0 +1,80 @@
+#include "CppUnitTest.h"
+#include "MassSpringSystemSimulator.h"
+#include "util/metrics.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace SimulatorTester
+{
+	TEST_CLASS(MetricsTests)
+	{
+	public:
+		TEST_METHOD(TestSimulationUpdatesCounters)
+		{
+			MassSpringSystemSimulator sim;
+			sim.setConsoleLogging(false);
+			sim.setIntegrator(IMPLICIT_EULER);
+			sim.setCollisionEnabled(true);
+			sim.setGravityEnabled(true);
+			sim.addMassPoint(Vec3(0, -5, 0), Vec3(), false);
+			sim.addMassPoint(Vec3(0, -4, 0), Vec3(), false);
+			sim.addSpring(0, 1, 1);
+
+			const double steps = metricValue(METRIC_STEPS);
+			const double substeps = metricValue(METRIC_SUBSTEPS);
+			const double iterations = metricValue(METRIC_SOLVER_ITERATIONS);
+			const double contacts = metricValue(METRIC_COLLISION_PAIRS);
+			for (int i = 0; i < 10; i++) sim.simulateTimestep(0.01f);
+
+			Assert::AreEqual(steps + 10, metricValue(METRIC_STEPS), L"Steps not counted", LINE_INFO());
+			Assert::AreEqual(substeps + 10, metricValue(METRIC_SUBSTEPS), L"Substeps not counted", LINE_INFO());
+			Assert::IsTrue(metricValue(METRIC_SOLVER_ITERATIONS) > iterations, L"Solver iterations not counted", LINE_INFO());
+			// both points start below the floor
+			Assert::IsTrue(metricValue(METRIC_COLLISION_PAIRS) >= contacts + 2, L"Contacts not counted", LINE_INFO());
+			Assert::AreEqual(2.0, metricValue(METRIC_POINTS), L"Point gauge", LINE_INFO());
+			Assert::AreEqual(0.1, metricValue(METRIC_SIMULATED_SECONDS), 1e-6, L"Time gauge", LINE_INFO());
+		}
+
+		TEST_METHOD(TestTextIsPrometheusFormat)
+		{
+			metricsText();
+			metricAdd(METRIC_STEPS, 4);
+			metricAdd(METRIC_SUBSTEPS, 8);
+			const std::string text = metricsText();
+			Assert::IsTrue(text.find("# TYPE gamephysics_steps_total counter\n") != std::string::npos, L"Counter type missing", LINE_INFO());
+			Assert::IsTrue(text.find("# TYPE gamephysics_energy_drift_ratio gauge\n") != std::string::npos, L"Gauge type missing", LINE_INFO());
+			Assert::IsTrue(text.find("gamephysics_substeps_per_step 2\n") != std::string::npos, L"Rate not since the last call", LINE_INFO());
+			Assert::IsTrue(text.find("gamephysics_memory_bytes{subsystem=\"points\"} ") != std::string::npos, L"Memory missing", LINE_INFO());
+			// every sample line is a name, an optional label set and a number
+			std::istringstream in(text);
+			std::string line;
+			while (std::getline(in, line)) {
+				if (line[0] == '#') continue;
+				const size_t space = line.rfind(' ');
+				Assert::IsTrue(line.compare(0, 12, "gamephysics_") == 0 && space != std::string::npos, L"Malformed sample", LINE_INFO());
+				std::istringstream value(line.substr(space + 1));
+				double number;
+				Assert::IsTrue((bool)(value >> number), L"Sample value is not a number", LINE_INFO());
+			}
+		}
+
+		TEST_METHOD(TestExportRewritesFile)
+		{
+			const std::string path = "metrics_export_test.prom";
+			Assert::IsTrue(metricsStartExport(path, 0.001), L"Export not started", LINE_INFO());
+			metricSet(METRIC_SPRINGS, 12345);
+			metricsStopExport();
+			std::ifstream in(path);
+			std::stringstream text;
+			text << in.rdbuf();
+			in.close();
+			std::remove(path.c_str());
+			Assert::IsTrue(text.str().find("gamephysics_springs 12345\n") != std::string::npos, L"Last values not written on stop", LINE_INFO());
+		}
+	};
+}
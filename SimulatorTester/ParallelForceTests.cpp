@@ -0,0 +1,80 @@
+#include "CppUnitTest.h"
+#include "MassSpringSystemSimulator.h"
+#include "SceneBuilder.h"
+
+#include <cstring>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace SimulatorTester
+{
+	TEST_CLASS(ParallelForceTests)
+	{
+	public:
+		TEST_METHOD(TestThreadPoolCoversRangeOnce)
+		{
+			ThreadPool pool(4);
+			std::vector<int> hits(10007, 0);
+			pool.parallelFor(0, (int)hits.size(), 64, [&](int begin, int end) {
+				for (int i = begin; i < end; i++) hits[i]++;
+			});
+			for (size_t i = 0; i < hits.size(); i++) {
+				Assert::AreEqual(1, hits[i], L"Index was not visited exactly once", LINE_INFO());
+			}
+		}
+
+		TEST_METHOD(TestSpringColoringIsConflictFree)
+		{
+			MassPointStore points;
+			SpringStore springs;
+			const int w = 40, h = 30;
+			for (int i = 0; i < w * h; i++) points.add(Vec3(i % w, i / w, 0), Vec3(), false, 1);
+			for (int i = 0; i < w * h; i++) {
+				if (i % w + 1 < w) springs.add(i, i + 1, 1, 1);
+				if (i + w < w * h) springs.add(i, i + w, 1, 1);
+				if (i % w + 1 < w && i + w < w * h) springs.add(i, i + w + 1, 1, 1);
+			}
+			const int m = springs.size();
+
+			SpringColoring coloring;
+			coloring.build(points.size(), springs);
+			Assert::AreEqual(m, springs.size(), L"Colouring lost springs", LINE_INFO());
+			Assert::AreEqual(m, coloring.colorOffsets.back(), L"Colours do not cover all springs", LINE_INFO());
+			// max degree is 6, greedy needs at most 11 colours
+			Assert::IsTrue(coloring.numColors() <= 11, L"Too many colours", LINE_INFO());
+
+			std::vector<int> lastColor(points.size(), -1);
+			for (int c = 0; c < coloring.numColors(); c++) {
+				for (int s = coloring.colorOffsets[c]; s < coloring.colorOffsets[c + 1]; s++) {
+					Assert::IsTrue(lastColor[springs.point1[s]] != c && lastColor[springs.point2[s]] != c, L"Two springs of one colour share a point", LINE_INFO());
+					lastColor[springs.point1[s]] = c;
+					lastColor[springs.point2[s]] = c;
+				}
+			}
+		}
+
+		TEST_METHOD(TestThreadedForcesMatchSingleThread)
+		{
+			MassSpringSystemSimulator * serial = new MassSpringSystemSimulator();
+			MassSpringSystemSimulator * threaded = new MassSpringSystemSimulator();
+			serial->setThreadCount(1);
+			threaded->setThreadCount(4);
+			// ~20k springs, above the parallel threshold
+			buildLattice(serial, 100, 100, 0.2f);
+			buildLattice(threaded, 100, 100, 0.2f);
+			serial->setIntegrator(MIDPOINT);
+			threaded->setIntegrator(MIDPOINT);
+			for (int i = 0; i < 10; i++) {
+				serial->simulateTimestep(0.001f);
+				threaded->simulateTimestep(0.001f);
+			}
+			for (int i = 0; i < serial->getNumberOfMassPoints(); i++) {
+				Vec3 a = serial->getPositionOfMassPoint(i);
+				Vec3 b = threaded->getPositionOfMassPoint(i);
+				Assert::IsTrue(memcmp(&a, &b, sizeof(Vec3)) == 0, L"Threaded result differs from single thread", LINE_INFO());
+			}
+			delete serial;
+			delete threaded;
+		}
+	};
+}
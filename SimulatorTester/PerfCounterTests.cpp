@@ -0,0 +1,97 @@
+#include "CppUnitTest.h"
+#include "MassSpringSystemSimulator.h"
+#include "SceneBuilder.h"
+#include "util/perfcounters.h"
+
+#include <cstring>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace SimulatorTester
+{
+	static const PerfPhaseStats* findPhase(const std::vector<PerfPhaseStats>& stats, const char* name, uint32_t thread)
+	{
+		for (const PerfPhaseStats& s : stats) {
+			if (s.thread == thread && std::strcmp(s.phase, name) == 0) return &s;
+		}
+		return nullptr;
+	}
+
+	TEST_CLASS(PerfCounterTests)
+	{
+	public:
+		TEST_METHOD(TestPhasesDegradeGracefully)
+		{
+			// must work with and without hardware counters
+			const bool hasCounters = perfCountersSetEnabled(true);
+			Assert::AreEqual(hasCounters, perfCountersStatus().empty(), L"Status does not match availability", LINE_INFO());
+			perfCountersClear();
+			{
+				PERF_PHASE("outer");
+				for (int i = 0; i < 3; i++) {
+					PERF_PHASE("inner");
+				}
+			}
+			perfCountersSetEnabled(false);
+			{
+				PERF_PHASE("disabled");
+			}
+
+			std::vector<PerfPhaseStats> stats;
+			perfCountersCollect(stats);
+			const uint32_t thread = profilerThreadIndex();
+#ifdef GAMEPHYSICS_NO_PROFILE
+			Assert::IsTrue(stats.empty(), L"Compiled out phases recorded", LINE_INFO());
+#else
+			const PerfPhaseStats* outer = findPhase(stats, "outer", thread);
+			const PerfPhaseStats* inner = findPhase(stats, "inner", thread);
+			Assert::IsTrue(outer && inner, L"Phase missing", LINE_INFO());
+			Assert::IsTrue(!findPhase(stats, "disabled", thread), L"Disabled phase recorded", LINE_INFO());
+			Assert::AreEqual(1ull, (unsigned long long)outer->calls, L"Outer calls", LINE_INFO());
+			Assert::AreEqual(3ull, (unsigned long long)inner->calls, L"Inner calls", LINE_INFO());
+			Assert::IsTrue(outer->seconds >= inner->seconds, L"Nested phase longer than its parent", LINE_INFO());
+			if (hasCounters) {
+				Assert::IsTrue(outer->has(PERF_CYCLES) || outer->has(PERF_INSTRUCTIONS), L"No counter values", LINE_INFO());
+			}
+			else {
+				for (int i = 0; i < PERF_COUNTER_COUNT; i++) {
+					Assert::IsTrue(!outer->has((PerfCounter)i), L"Value of an unavailable counter", LINE_INFO());
+				}
+				Assert::IsTrue(outer->instructionsPerCycle() < 0, L"IPC without counters", LINE_INFO());
+			}
+#endif
+			perfCountersClear();
+		}
+
+		TEST_METHOD(TestSimulationPhasesPerThread)
+		{
+			MassSpringSystemSimulator sim;
+			sim.setConsoleLogging(false);
+			buildLattice(&sim, 128, 128, 0.2f);
+			sim.setIntegrator(MIDPOINT);
+			sim.setThreadCount(2);
+			sim.simulateTimestep(0.001f);
+
+			perfCountersSetEnabled(true);
+			perfCountersClear();
+			for (int i = 0; i < 5; i++) sim.simulateTimestep(0.001f);
+			perfCountersSetEnabled(false);
+
+			std::vector<PerfPhaseStats> stats;
+			perfCountersCollect(stats);
+#ifndef GAMEPHYSICS_NO_PROFILE
+			const uint32_t thread = profilerThreadIndex();
+			const PerfPhaseStats* step = findPhase(stats, "simulateTimestep", thread);
+			const PerfPhaseStats* forces = findPhase(stats, "computeForces", thread);
+			Assert::IsTrue(step && forces, L"Simulation phase missing", LINE_INFO());
+			Assert::AreEqual(5ull, (unsigned long long)step->calls, L"Step calls", LINE_INFO());
+			Assert::AreEqual(10ull, (unsigned long long)forces->calls, L"Midpoint evaluates forces twice per step", LINE_INFO());
+			bool hasWorker = false;
+			for (const PerfPhaseStats& s : stats) hasWorker |= s.thread != thread && std::strcmp(s.phase, "parallelFor") == 0;
+			Assert::IsTrue(hasWorker, L"Worker thread phases missing", LINE_INFO());
+			Assert::IsTrue(perfCountersReport().find("computeForces") != std::string::npos, L"Phase missing in report", LINE_INFO());
+#endif
+			perfCountersClear();
+		}
+	};
+}
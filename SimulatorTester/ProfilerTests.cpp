@@ -0,0 +1,88 @@
+#include "CppUnitTest.h"
+#include "MassSpringSystemSimulator.h"
+#include "SceneBuilder.h"
+#include "util/profiler.h"
+
+#include <thread>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace SimulatorTester
+{
+	TEST_CLASS(ProfilerTests)
+	{
+	public:
+		TEST_METHOD(TestNestedZones)
+		{
+			profilerClear();
+			{
+				PROFILE_ZONE("outer");
+				for (int i = 0; i < 3; i++) {
+					PROFILE_ZONE("inner");
+				}
+			}
+			std::vector<ProfileEvent> events;
+			profilerCollect(events);
+#ifdef GAMEPHYSICS_NO_PROFILE
+			Assert::AreEqual((size_t)0, events.size(), L"Compiled out zones recorded events", LINE_INFO());
+#else
+			Assert::AreEqual((size_t)4, events.size(), L"Wrong number of events", LINE_INFO());
+			const ProfileEvent& outer = events[0];
+			Assert::AreEqual(std::string("outer"), std::string(outer.name), L"Events not ordered by start", LINE_INFO());
+			Assert::AreEqual(0u, outer.depth, L"Outer zone depth", LINE_INFO());
+			for (int i = 1; i < 4; i++) {
+				Assert::AreEqual(1u, events[i].depth, L"Inner zone depth", LINE_INFO());
+				Assert::IsTrue(events[i].start >= outer.start && events[i].end <= outer.end, L"Inner zone outside of outer zone", LINE_INFO());
+				Assert::IsTrue(events[i].start >= events[i - 1].start, L"Events not ordered by start", LINE_INFO());
+			}
+#endif
+		}
+
+		TEST_METHOD(TestRingOverwritesOldestEvents)
+		{
+			profilerClear();
+			for (int i = 0; i < PROFILER_RING_SIZE + 100; i++) {
+				PROFILE_ZONE("tiny");
+			}
+			std::vector<ProfileEvent> events;
+			profilerCollect(events);
+			Assert::IsTrue(events.size() <= PROFILER_RING_SIZE, L"Ring grew beyond its size", LINE_INFO());
+			profilerClear();
+			profilerCollect(events);
+			Assert::AreEqual((size_t)0, events.size(), L"Clear kept events", LINE_INFO());
+		}
+
+		TEST_METHOD(TestThreadsRecordSeparately)
+		{
+			profilerClear();
+			{
+				PROFILE_ZONE("main");
+			}
+			std::thread worker([]() { PROFILE_ZONE("worker"); });
+			worker.join();
+			std::vector<ProfileEvent> events;
+			profilerCollect(events);
+#ifndef GAMEPHYSICS_NO_PROFILE
+			Assert::AreEqual((size_t)2, events.size(), L"Wrong number of events", LINE_INFO());
+			Assert::IsTrue(events[0].thread != events[1].thread, L"Threads share a ring", LINE_INFO());
+#endif
+		}
+
+		TEST_METHOD(TestSimulatorZonesInReport)
+		{
+			MassSpringSystemSimulator sim;
+			sim.setConsoleLogging(false);
+			buildLattice(&sim, 10, 10, 0.1f);
+			sim.setIntegrator(MIDPOINT);
+			profilerClear();
+			for (int i = 0; i < 10; i++) sim.simulateTimestep(0.001f);
+			const std::string report = profilerReport();
+#ifndef GAMEPHYSICS_NO_PROFILE
+			Assert::IsTrue(report.find("simulateTimestep") != std::string::npos, L"simulateTimestep missing", LINE_INFO());
+			Assert::IsTrue(report.find("computeForces") != std::string::npos, L"computeForces missing", LINE_INFO());
+			Assert::IsTrue(report.find("integrate") != std::string::npos, L"integrate missing", LINE_INFO());
+			Assert::IsTrue(profilerNanosecondsPerTick() > 0, L"Tick length not positive", LINE_INFO());
+#endif
+		}
+	};
+}
@@ -0,0 +1,51 @@
+#include "CppUnitTest.h"
+#include "MassSpringSystemSimulator.h"
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace SimulatorTester
+{
+	TEST_CLASS(SceneArenaTests)
+	{
+	public:
+		TEST_METHOD(TestArenaResetKeepsBlocks)
+		{
+			SceneArena arena(1024);
+			void* first = arena.allocate(100);
+			arena.allocate(4000);
+			size_t reserved = arena.bytesReserved();
+			Assert::IsTrue(arena.bytesInUse() >= 4100, L"Arena reports too few bytes in use", LINE_INFO());
+			Assert::IsTrue(reserved >= arena.bytesInUse(), L"Arena uses more than it reserved", LINE_INFO());
+
+			arena.reset();
+			Assert::IsTrue(arena.bytesInUse() == 0, L"Arena not empty after reset", LINE_INFO());
+			Assert::IsTrue(arena.allocate(100) == first, L"Arena did not reuse its first block", LINE_INFO());
+			arena.allocate(4000);
+			Assert::IsTrue(arena.bytesReserved() == reserved, L"Arena grew although the same sizes were requested", LINE_INFO());
+		}
+
+		TEST_METHOD(TestArenaAlignment)
+		{
+			SceneArena arena;
+			for (int i = 1; i < 20; ++i) {
+				size_t address = (size_t)arena.allocate(i * 3);
+				Assert::IsTrue(address % GP_SIMD_ALIGNMENT == 0, L"Arena returned misaligned memory", LINE_INFO());
+			}
+		}
+
+		TEST_METHOD(TestSceneReloadDoesNotGrowMemory)
+		{
+			MassSpringSystemSimulator * msss = new MassSpringSystemSimulator();
+			msss->notifyCaseChanged(3);
+			size_t reserved = msss->getSceneBytesReserved();
+			size_t inUse = msss->getSceneBytesInUse();
+			Assert::IsTrue(inUse > 0, L"Scene does not use the arena", LINE_INFO());
+			for (int i = 0; i < 10; ++i) {
+				msss->notifyCaseChanged(3);
+			}
+			Assert::IsTrue(msss->getSceneBytesReserved() == reserved, L"Scene reload reserved more memory", LINE_INFO());
+			Assert::IsTrue(msss->getSceneBytesInUse() == inUse, L"Scene reload uses more memory", LINE_INFO());
+			delete msss;
+		}
+	};
+}
@@ -0,0 +1,73 @@
+#include "CppUnitTest.h"
+#include "MassSpringSystemSimulator.h"
+#include "SceneBuilder.h"
+
+#include <cmath>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace SimulatorTester
+{
+	TEST_CLASS(SceneBuilderTests)
+	{
+	public:
+		TEST_METHOD(TestBenchmarkSceneSizes)
+		{
+			MassSpringSystemSimulator chain, cloth, volume, graph;
+			buildChain(&chain, 100);
+			buildCloth(&cloth, 10, 8);
+			buildVolumeLattice(&volume, 4, 5, 6);
+			buildRandomGraph(&graph, 500, 4);
+
+			Assert::AreEqual(100, chain.getNumberOfMassPoints(), L"Chain point count", LINE_INFO());
+			Assert::AreEqual(99, chain.getNumberOfSprings(), L"Chain spring count", LINE_INFO());
+			Assert::AreEqual(80, cloth.getNumberOfMassPoints(), L"Cloth point count", LINE_INFO());
+			// structural 9*8 + 10*7, shear 2 * 9*7
+			Assert::AreEqual(268, cloth.getNumberOfSprings(), L"Cloth spring count", LINE_INFO());
+			Assert::AreEqual(120, volume.getNumberOfMassPoints(), L"Volume point count", LINE_INFO());
+			Assert::AreEqual(3*5*6 + 4*4*6 + 4*5*5, volume.getNumberOfSprings(), L"Volume spring count", LINE_INFO());
+			Assert::AreEqual(500, graph.getNumberOfMassPoints(), L"Random graph point count", LINE_INFO());
+			Assert::AreEqual(1000, graph.getNumberOfSprings(), L"Random graph spring count", LINE_INFO());
+		}
+
+		TEST_METHOD(TestBenchmarkScenesStayFinite)
+		{
+			MassSpringSystemSimulator cloth, graph;
+			cloth.setConsoleLogging(false);
+			graph.setConsoleLogging(false);
+			buildCloth(&cloth, 20, 20, 0.1f);
+			buildRandomGraph(&graph, 400, 4);
+			cloth.setIntegrator(RK4);
+			graph.setIntegrator(RK4);
+			for (int i = 0; i < 200; i++) {
+				cloth.simulateTimestep(0.001f);
+				graph.simulateTimestep(0.001f);
+			}
+			for (int i = 0; i < 400; i++) {
+				Vec3 a = cloth.getPositionOfMassPoint(i);
+				Vec3 b = graph.getPositionOfMassPoint(i);
+				Assert::IsTrue(std::isfinite(a.x) && std::isfinite(a.y) && std::isfinite(a.z), L"Cloth diverged", LINE_INFO());
+				Assert::IsTrue(std::isfinite(b.x) && std::isfinite(b.y) && std::isfinite(b.z), L"Random graph diverged", LINE_INFO());
+			}
+			// the fixed top corners of the cloth do not move
+			Vec3 corner = cloth.getPositionOfMassPoint(19 * 20);
+			Assert::AreEqual(19.0, corner.y, 0.11, L"Fixed corner moved", LINE_INFO());
+		}
+
+		TEST_METHOD(TestForceEvaluationCount)
+		{
+			MassSpringSystemSimulator sim;
+			sim.setConsoleLogging(false);
+			buildChain(&sim, 10);
+			const int integrators[] = { EULER, MIDPOINT, RK4, DORMAND_PRINCE };
+			const int evaluations[] = { 1, 2, 4, 6 };
+			for (int k = 0; k < 4; k++) {
+				sim.setIntegrator(integrators[k]);
+				sim.simulateTimestep(0.001f);
+				unsigned long long before = sim.getForceEvaluationCount();
+				sim.simulateTimestep(0.001f);
+				Assert::AreEqual((unsigned long long)evaluations[k], sim.getForceEvaluationCount() - before, L"Force evaluations per step", LINE_INFO());
+			}
+		}
+	};
+}
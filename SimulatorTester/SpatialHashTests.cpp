@@ -0,0 +1,129 @@
+#include "CppUnitTest.h"
+#include "MassSpringSystemSimulator.h"
+#include "SpatialHashGrid.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace SimulatorTester
+{
+	TEST_CLASS(SpatialHashTests)
+	{
+	public:
+		// n points uniformly in a cube with about one point per unit cell of size 0.2
+		void randomPoints(int n, std::vector<Real>& px, std::vector<Real>& py, std::vector<Real>& pz) {
+			std::mt19937 rng(7);
+			const Real size = 0.2 * cbrt((double)n);
+			std::uniform_real_distribution<Real> coordinate(-size / 2, size / 2);
+			px.resize(n);
+			py.resize(n);
+			pz.resize(n);
+			for (int i = 0; i < n; ++i) {
+				px[i] = coordinate(rng);
+				py[i] = coordinate(rng);
+				pz[i] = coordinate(rng);
+			}
+		}
+
+		TEST_METHOD(TestPairsMatchBruteForce)
+		{
+			const int n = 10000;
+			const Real distance = 0.2;
+			std::vector<Real> px, py, pz;
+			randomPoints(n, px, py, pz);
+
+			std::vector<std::pair<int, int>> expected;
+			for (int i = 0; i < n; ++i) {
+				for (int j = i + 1; j < n; ++j) {
+					const Real dx = px[j] - px[i], dy = py[j] - py[i], dz = pz[j] - pz[i];
+					if (dx * dx + dy * dy + dz * dz < distance * distance) expected.push_back(std::make_pair(i, j));
+				}
+			}
+
+			ThreadPool pool(4);
+			SpatialHashGrid grid;
+			PointPairList pairs;
+			grid.build(px.data(), py.data(), pz.data(), n, distance, pool);
+			grid.findPairs(distance, pool, pairs);
+			std::vector<std::pair<int, int>> found;
+			for (const PointPair& pair : pairs) found.push_back(std::make_pair(pair.a, pair.b));
+			std::sort(found.begin(), found.end());
+			Assert::IsTrue(!expected.empty(), L"Scene has no close pairs", LINE_INFO());
+			Assert::IsTrue(expected == found, L"Pairs differ from the brute force search", LINE_INFO());
+		}
+
+		TEST_METHOD(TestSortIsStableAndIndependentOfThreads)
+		{
+			const int n = 20000;
+			std::vector<Real> px, py, pz;
+			randomPoints(n, px, py, pz);
+
+			ThreadPool serial(1), parallel(4);
+			SpatialHashGrid a, b;
+			PointPairList pairsA, pairsB;
+			a.build(px.data(), py.data(), pz.data(), n, 0.2, serial);
+			a.findPairs(0.2, serial, pairsA);
+			b.build(px.data(), py.data(), pz.data(), n, 0.2, parallel);
+			b.findPairs(0.2, parallel, pairsB);
+
+			Assert::IsTrue(a.cellStart == b.cellStart, L"Slots depend on the thread count", LINE_INFO());
+			for (int r = 0; r < n; ++r) {
+				Assert::AreEqual(a.points[r].index, b.points[r].index, L"Sort depends on the thread count", LINE_INFO());
+			}
+			Assert::AreEqual(pairsA.size(), pairsB.size(), L"Pair count depends on the thread count", LINE_INFO());
+			for (size_t p = 0; p < pairsA.size(); ++p) {
+				Assert::IsTrue(pairsA[p].a == pairsB[p].a && pairsA[p].b == pairsB[p].b, L"Pair order depends on the thread count", LINE_INFO());
+			}
+
+			std::vector<int> seen(n, 0);
+			for (int k = 0; k < b.tableSize(); ++k) {
+				for (int r = b.cellStart[k]; r < b.cellStart[k + 1]; ++r) {
+					const GridPoint& p = b.points[r];
+					Assert::AreEqual(k, b.slots[p.index], L"Point in the wrong slot", LINE_INFO());
+					Assert::IsTrue(p.x == px[p.index] && p.y == py[p.index] && p.z == pz[p.index], L"Position not copied", LINE_INFO());
+					if (r > b.cellStart[k]) Assert::IsTrue(b.points[r - 1].index < p.index, L"Slot not in index order", LINE_INFO());
+					seen[p.index]++;
+				}
+			}
+			Assert::IsTrue(std::count(seen.begin(), seen.end(), 1) == n, L"Sorted points are not a permutation", LINE_INFO());
+		}
+
+		TEST_METHOD(TestPointsBounceApart)
+		{
+			MassSpringSystemSimulator sim;
+			sim.setConsoleLogging(false);
+			sim.setMass(1);
+			sim.setIntegrator(EULER);
+			sim.setPointCollisionEnabled(true);
+			sim.addMassPoint(Vec3(-0.5, 0, 0), Vec3(1, 0, 0), false);
+			sim.addMassPoint(Vec3(0.5, 0, 0), Vec3(-1, 0, 0), false);
+			int contacts = 0;
+			for (int i = 0; i < 100; ++i) {
+				sim.simulateTimestep(0.01f);
+				contacts += sim.getLastPointContacts();
+			}
+			Assert::IsTrue(contacts > 0, L"No contact", LINE_INFO());
+			const Vec3 d = sim.getPositionOfMassPoint(1) - sim.getPositionOfMassPoint(0);
+			Assert::IsTrue(norm(d) >= 0.2 - 1e-9, L"Points still overlap", LINE_INFO());
+			// restitution 0.5 halves the approach speed, momentum is conserved
+			Assert::AreEqual(-0.5, sim.getVelocityOfMassPoint(0).x, 1e-9, L"Wrong rebound speed", LINE_INFO());
+			Assert::AreEqual(0.0, sim.getVelocityOfMassPoint(0).x + sim.getVelocityOfMassPoint(1).x, 1e-9, L"Momentum not conserved", LINE_INFO());
+		}
+
+		TEST_METHOD(TestSpringNeighboursDoNotCollide)
+		{
+			MassSpringSystemSimulator sim;
+			sim.setConsoleLogging(false);
+			sim.setIntegrator(EULER);
+			sim.setPointCollisionEnabled(true);
+			sim.addMassPoint(Vec3(0, 0, 0), Vec3(), false);
+			sim.addMassPoint(Vec3(0.1, 0, 0), Vec3(), false);
+			sim.addSpring(0, 1, 0.1f);
+			sim.simulateTimestep(0.01f);
+			Assert::AreEqual(0, sim.getLastPointContacts(), L"Spring neighbours collided", LINE_INFO());
+		}
+	};
+}
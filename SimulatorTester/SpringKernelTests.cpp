@@ -0,0 +1,84 @@
+#include "CppUnitTest.h"
+#include "MassSpringSystemSimulator.h"
+
+#include <cstring>
+#include <random>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace SimulatorTester
+{
+	TEST_CLASS(SpringKernelTests)
+	{
+	public:
+		// random graph with random rest lengths and stiffnesses; an odd
+		// spring count exercises the scalar tail of every vector kernel
+		void randomScene(MassPointStore& points, SpringStore& springs, int numPoints, int numSprings) {
+			std::mt19937 rng(42);
+			std::uniform_real_distribution<double> u(-1.0, 1.0);
+			for (int i = 0; i < numPoints; i++) {
+				points.add(Vec3(u(rng), u(rng), u(rng)), Vec3(u(rng), u(rng), u(rng)), i % 17 == 0, 1.0 + u(rng) * 0.5);
+			}
+			std::uniform_int_distribution<int> pick(0, numPoints - 1);
+			for (int s = 0; s < numSprings; s++) {
+				int a = pick(rng);
+				int b = pick(rng);
+				if (a == b) b = (a + 1) % numPoints;
+				springs.add(a, b, 0.5 + 0.5 * u(rng), 100.0 + 50.0 * u(rng));
+			}
+		}
+
+		TEST_METHOD(TestVectorKernelsMatchScalarBitForBit)
+		{
+			MassPointStore points;
+			SpringStore springs;
+			randomScene(points, springs, 1000, 5001);
+
+			points.clearForces(true);
+			addSpringForces(SPRING_KERNEL_SCALAR, springs, points, 0.7);
+			RealArray fx = points.fx, fy = points.fy, fz = points.fz;
+
+			SpringKernelIsa isas[] = { SPRING_KERNEL_SSE2, SPRING_KERNEL_AVX2, SPRING_KERNEL_AVX512 };
+			for (SpringKernelIsa isa : isas) {
+				if (!isSpringKernelSupported(isa)) continue;
+				points.clearForces(true);
+				addSpringForces(isa, springs, points, 0.7);
+				bool same = memcmp(fx.data(), points.fx.data(), fx.size() * sizeof(Real)) == 0
+					&& memcmp(fy.data(), points.fy.data(), fy.size() * sizeof(Real)) == 0
+					&& memcmp(fz.data(), points.fz.data(), fz.size() * sizeof(Real)) == 0;
+				Assert::IsTrue(same, L"Vector spring kernel differs from the scalar reference", LINE_INFO());
+			}
+		}
+
+		TEST_METHOD(TestDampingOpposesRelativeVelocity)
+		{
+			// relaxed spring along y whose ends separate at 2 m/s
+			MassPointStore points;
+			SpringStore springs;
+			points.add(Vec3(0, 0, 0), Vec3(0, -1, 0), false, 1);
+			points.add(Vec3(0, 1, 0), Vec3(0, 1, 0), false, 1);
+			springs.add(0, 1, 1.0, 40.0);
+			points.clearForces(false);
+			addSpringForces(bestSpringKernelIsa(), springs, points, 0.5);
+			Assert::AreEqual(1.0, points.fy[0], 1e-12, L"Damping force on point 0 is wrong", LINE_INFO());
+			Assert::AreEqual(-1.0, points.fy[1], 1e-12, L"Damping force on point 1 is wrong", LINE_INFO());
+			Assert::AreEqual(0.0, points.fx[0], 1e-12, L"Damping acts across the spring", LINE_INFO());
+		}
+
+		TEST_METHOD(TestDampingRemovesEnergy)
+		{
+			MassSpringSystemSimulator * msss = new MassSpringSystemSimulator();
+			msss->setMass(10.0f);
+			msss->setDampingFactor(1.0f);
+			msss->setStiffness(40.0f);
+			int p0 = msss->addMassPoint(Vec3(0.0, 0.0f, 0), Vec3(0, 0, 0), false);
+			int p1 = msss->addMassPoint(Vec3(0.0, 2.0f, 0), Vec3(0, 0, 0), false);
+			msss->addSpring(p0, p1, 1.0);
+			msss->setIntegrator(MIDPOINT);
+			for (int i = 0; i < 20000; i++) msss->simulateTimestep(0.005f);
+			double length = norm(msss->getPositionOfMassPoint(1) - msss->getPositionOfMassPoint(0));
+			Assert::AreEqual(1.0, length, 1e-3, L"Damped spring did not settle at its rest length", LINE_INFO());
+			delete msss;
+		}
+	};
+}
@@ -0,0 +1,166 @@
+#include "CppUnitTest.h"
+#include "MassSpringSystemSimulator.h"
+#include "StaticColliderSet.h"
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <tuple>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace SimulatorTester
+{
+	TEST_CLASS(StaticColliderTests)
+	{
+	public:
+		typedef std::set<std::tuple<int, int, int>> ContactSet; // point, shape, collider
+
+		struct Sphere { Vec3 c; Real r; };
+		struct Box { Vec3 lo, hi; };
+		struct Capsule { Vec3 a, b; Real r; };
+
+		std::mt19937 rng{ 5 };
+		std::vector<Sphere> spheres;
+		std::vector<Box> boxes;
+		std::vector<Capsule> capsules;
+		std::vector<Real> px, py, pz;
+
+		Vec3 randomPoint(Real size) {
+			std::uniform_real_distribution<Real> coordinate(0, size);
+			return Vec3(coordinate(rng), coordinate(rng), coordinate(rng));
+		}
+
+		void randomScene(StaticColliderSet& set, int colliders, int points, Real size) {
+			std::uniform_real_distribution<Real> extent(0.05, 0.4);
+			for (int i = 0; i < colliders; ++i) {
+				const Vec3 c = randomPoint(size);
+				const Vec3 half(extent(rng), extent(rng), extent(rng));
+				const Real r = extent(rng);
+				spheres.push_back({ c, r });
+				set.addSphere(c, r);
+				boxes.push_back({ c - half, c + half });
+				set.addBox(c - half, c + half);
+				capsules.push_back({ c - half, c + half, r * 0.5 });
+				set.addCapsule(c - half, c + half, r * 0.5);
+			}
+			set.addPlane(Vec3(0, 1, 0), 0.2);
+			set.addPlane(Vec3(1, 0, 1), size);
+			for (int i = 0; i < points; ++i) {
+				const Vec3 p = randomPoint(size);
+				px.push_back(p.x);
+				py.push_back(p.y);
+				pz.push_back(p.z);
+			}
+		}
+
+		static Real clamp(Real x, Real lo, Real hi) { return std::min(std::max(x, lo), hi); }
+
+		ContactSet bruteForce(Real radius) {
+			ContactSet contacts;
+			const Vec3 up(0, 1, 0), diagonal = Vec3(1, 0, 1) / norm(Vec3(1, 0, 1));
+			const Real size = 6;
+			for (int i = 0; i < (int)px.size(); ++i) {
+				const Vec3 p(px[i], py[i], pz[i]);
+				if (dot(up, p) - 0.2 < radius) contacts.insert(std::make_tuple(i, (int)COLLIDER_PLANE, 0));
+				if (dot(diagonal, p) - size < radius) contacts.insert(std::make_tuple(i, (int)COLLIDER_PLANE, 1));
+				for (int k = 0; k < (int)spheres.size(); ++k) {
+					const Real reach = spheres[k].r + radius;
+					if (normNoSqrt(p - spheres[k].c) < reach * reach) contacts.insert(std::make_tuple(i, (int)COLLIDER_SPHERE, k));
+					const Vec3 q(clamp(p.x, boxes[k].lo.x, boxes[k].hi.x), clamp(p.y, boxes[k].lo.y, boxes[k].hi.y), clamp(p.z, boxes[k].lo.z, boxes[k].hi.z));
+					if (normNoSqrt(p - q) < radius * radius) contacts.insert(std::make_tuple(i, (int)COLLIDER_BOX, k));
+					const Vec3 d = capsules[k].b - capsules[k].a;
+					const Real t = clamp(dot(p - capsules[k].a, d) / normNoSqrt(d), 0, 1);
+					const Real capsuleReach = capsules[k].r + radius;
+					if (normNoSqrt(p - capsules[k].a - d * t) < capsuleReach * capsuleReach) contacts.insert(std::make_tuple(i, (int)COLLIDER_CAPSULE, k));
+				}
+			}
+			return contacts;
+		}
+
+		static ContactSet toSet(const ColliderContactList& list) {
+			ContactSet contacts;
+			for (const ColliderContact& contact : list) {
+				Assert::IsTrue(contacts.insert(std::make_tuple(contact.point, contact.shape, contact.collider)).second, L"Contact listed twice", LINE_INFO());
+				Assert::IsTrue(contact.depth > 0, L"Contact without overlap", LINE_INFO());
+			}
+			return contacts;
+		}
+
+		static bool sameContacts(const ColliderContactList& a, const ColliderContactList& b) {
+			if (a.size() != b.size()) return false;
+			for (size_t k = 0; k < a.size(); ++k) {
+				if (a[k].point != b[k].point || a[k].shape != b[k].shape || a[k].collider != b[k].collider) return false;
+				if (a[k].depth != b[k].depth || a[k].nx != b[k].nx || a[k].ny != b[k].ny || a[k].nz != b[k].nz) return false;
+			}
+			return true;
+		}
+
+		TEST_METHOD(TestContactsMatchBruteForce)
+		{
+			// odd point count, so the vector kernels leave a scalar tail
+			StaticColliderSet set;
+			randomScene(set, 60, 9999, 6);
+			const Real radius = 0.1;
+			ThreadPool serial(1), parallel(3);
+			ColliderContactList vectorised, scalar, threaded;
+			set.findContacts(px.data(), py.data(), pz.data(), (int)px.size(), radius, serial, vectorised);
+			Assert::IsTrue(set.numCells() > 1, L"No grid", LINE_INFO());
+			const ContactSet expected = bruteForce(radius);
+			Assert::IsTrue(expected.size() > 1000, L"Colliders barely reached", LINE_INFO());
+			Assert::IsTrue(toSet(vectorised) == expected, L"Contacts differ from the brute force search", LINE_INFO());
+
+			set.findContacts(px.data(), py.data(), pz.data(), (int)px.size(), radius, serial, scalar, false);
+			Assert::IsTrue(sameContacts(vectorised, scalar), L"Scalar kernels differ", LINE_INFO());
+			set.findContacts(px.data(), py.data(), pz.data(), (int)px.size(), radius, parallel, threaded);
+			Assert::IsTrue(sameContacts(vectorised, threaded), L"Order depends on the thread count", LINE_INFO());
+			for (size_t k = 1; k < vectorised.size(); ++k) {
+				Assert::IsTrue(vectorised[k - 1].shape <= vectorised[k].shape, L"Shape types interleaved", LINE_INFO());
+			}
+		}
+
+		TEST_METHOD(TestDepthAndNormal)
+		{
+			StaticColliderSet set;
+			set.addBox(Vec3(0, 0, 0), Vec3(2, 1, 1));
+			set.addSphere(Vec3(5, 0, 0), 1);
+			set.addCapsule(Vec3(0, 5, 0), Vec3(2, 5, 0), 0.5);
+			const Real x[3] = { 1.5, 5, 1 };
+			const Real y[3] = { 0.5, 1.05, 5.55 };
+			const Real z[3] = { 0.9, 0, 0 };
+			ThreadPool pool(1);
+			ColliderContactList contacts;
+			set.findContacts(x, y, z, 3, 0.1, pool, contacts);
+			Assert::AreEqual(3, (int)contacts.size(), L"Contacts", LINE_INFO());
+			// spheres, boxes, capsules
+			Assert::AreEqual(1, contacts[0].point, L"Sphere contact", LINE_INFO());
+			Assert::AreEqual(0.05, contacts[0].depth, 1e-12, L"Sphere depth", LINE_INFO());
+			Assert::AreEqual(1.0, contacts[0].ny, 1e-12, L"Sphere normal", LINE_INFO());
+			// the centre is inside the box, nearest to the face z = 1
+			Assert::AreEqual(0, contacts[1].point, L"Box contact", LINE_INFO());
+			Assert::AreEqual(0.2, contacts[1].depth, 1e-12, L"Box depth", LINE_INFO());
+			Assert::AreEqual(1.0, contacts[1].nz, 0.0, L"Box normal", LINE_INFO());
+			Assert::AreEqual(2, contacts[2].point, L"Capsule contact", LINE_INFO());
+			Assert::AreEqual(0.05, contacts[2].depth, 1e-12, L"Capsule depth", LINE_INFO());
+			Assert::AreEqual(1.0, contacts[2].ny, 1e-12, L"Capsule normal", LINE_INFO());
+		}
+
+		TEST_METHOD(TestPointsComeToRestOnColliders)
+		{
+			MassSpringSystemSimulator sim;
+			sim.setConsoleLogging(false);
+			sim.setIntegrator(EULER);
+			sim.addMassPoint(Vec3(0, 1.2, 0), Vec3(0, -2, 0), false);
+			sim.addMassPoint(Vec3(3, 1.2, 0), Vec3(0, -2, 0), false);
+			sim.getStaticColliders().addSphere(Vec3(0, 0, 0), 1);
+			sim.getStaticColliders().addBox(Vec3(2, -1, -1), Vec3(4, 1, 1));
+			sim.simulateTimestep(0.1f);
+			Assert::AreEqual(2, sim.getLastColliderContacts(), L"Contacts", LINE_INFO());
+			Assert::AreEqual(1.1, sim.getPositionOfMassPoint(0).y, 1e-12, L"Not on the sphere", LINE_INFO());
+			Assert::AreEqual(1.1, sim.getPositionOfMassPoint(1).y, 1e-12, L"Not on the box", LINE_INFO());
+			Assert::AreEqual(0.0, sim.getVelocityOfMassPoint(0).y, 1e-12, L"Approaching velocity kept", LINE_INFO());
+			Assert::AreEqual(0.0, sim.getVelocityOfMassPoint(1).y, 1e-12, L"Approaching velocity kept", LINE_INFO());
+		}
+	};
+}
@@ -0,0 +1,210 @@
+#include "CppUnitTest.h"
+#include "MassSpringSystemSimulator.h"
+#include "SweepAndPrune.h"
+
+#include <algorithm>
+#include <random>
+#include <set>
+#include <vector>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace SimulatorTester
+{
+	TEST_CLASS(SweepAndPruneTests)
+	{
+	public:
+		typedef std::set<std::pair<int, int>> PairSet;
+
+		std::mt19937 rng{ 11 };
+		std::vector<Real> lo, hi; // three per handle
+		std::vector<bool> alive;
+
+		void randomBox(int proxy, Real worldSize) {
+			std::uniform_real_distribution<Real> position(0, worldSize), size(0.1, 0.5);
+			if ((int)alive.size() <= proxy) {
+				lo.resize(3 * (proxy + 1));
+				hi.resize(3 * (proxy + 1));
+				alive.resize(proxy + 1);
+			}
+			for (int k = 0; k < 3; ++k) {
+				lo[3 * proxy + k] = position(rng);
+				hi[3 * proxy + k] = lo[3 * proxy + k] + size(rng);
+			}
+		}
+
+		PairSet bruteForce() {
+			PairSet pairs;
+			for (int a = 0; a < (int)alive.size(); ++a) {
+				for (int b = a + 1; b < (int)alive.size(); ++b) {
+					if (!alive[a] || !alive[b]) continue;
+					bool overlap = true;
+					for (int k = 0; k < 3; ++k) overlap = overlap && lo[3 * a + k] <= hi[3 * b + k] && lo[3 * b + k] <= hi[3 * a + k];
+					if (overlap) pairs.insert(std::make_pair(a, b));
+				}
+			}
+			return pairs;
+		}
+
+		static PairSet toSet(const ProxyPairList& list) {
+			PairSet pairs;
+			for (const ProxyPair& pair : list) {
+				Assert::IsTrue(pair.a < pair.b, L"Pair not ordered", LINE_INFO());
+				Assert::IsTrue(pairs.insert(std::make_pair(pair.a, pair.b)).second, L"Pair listed twice", LINE_INFO());
+			}
+			return pairs;
+		}
+
+		// the set matches the brute force search and the events its change
+		void checkUpdate(const SweepAndPrune& sap, const PairSet& before, PairSet& after) {
+			after = toSet(sap.pairs());
+			Assert::IsTrue(after == bruteForce(), L"Pairs differ from the brute force search", LINE_INFO());
+			PairSet added, removed;
+			std::set_difference(after.begin(), after.end(), before.begin(), before.end(), std::inserter(added, added.end()));
+			std::set_difference(before.begin(), before.end(), after.begin(), after.end(), std::inserter(removed, removed.end()));
+			Assert::IsTrue(toSet(sap.addedPairs()) == added, L"Wrong added pairs", LINE_INFO());
+			Assert::IsTrue(toSet(sap.removedPairs()) == removed, L"Wrong removed pairs", LINE_INFO());
+			for (const auto& pair : after) Assert::IsTrue(sap.isPair(pair.second, pair.first), L"Pair not found", LINE_INFO());
+		}
+
+		TEST_METHOD(TestPairsAndEventsMatchBruteForce)
+		{
+			const int n = 400;
+			SweepAndPrune sap;
+			for (int i = 0; i < n; ++i) {
+				randomBox(i, 4);
+				alive[i] = true;
+				Assert::AreEqual(i, sap.addProxy(&lo[3 * i], &hi[3 * i]), L"Handles not consecutive", LINE_INFO());
+			}
+			PairSet before, after;
+			sap.update();
+			Assert::IsTrue(sap.lastRebuilt(), L"Initial update not sorted from scratch", LINE_INFO());
+			checkUpdate(sap, before, after);
+			Assert::IsTrue(after.size() > 100, L"Boxes barely overlap", LINE_INFO());
+
+			std::uniform_real_distribution<Real> step(-0.05, 0.05);
+			for (int frame = 0; frame < 40; ++frame) {
+				for (int i = 0; i < n; ++i) {
+					for (int k = 0; k < 3; ++k) {
+						const Real d = step(rng);
+						lo[3 * i + k] += d;
+						hi[3 * i + k] += d;
+					}
+					sap.setBox(i, &lo[3 * i], &hi[3 * i]);
+				}
+				// a few boxes jump across the scene
+				for (int i = frame; i < n; i += 97) {
+					randomBox(i, 4);
+					sap.setBox(i, &lo[3 * i], &hi[3 * i]);
+				}
+				before.swap(after);
+				sap.update();
+				Assert::IsFalse(sap.lastRebuilt(), L"Coherent motion sorted from scratch", LINE_INFO());
+				checkUpdate(sap, before, after);
+			}
+		}
+
+		TEST_METHOD(TestRemovedProxiesLeaveThePairSet)
+		{
+			const int n = 200;
+			SweepAndPrune sap;
+			for (int i = 0; i < n; ++i) {
+				randomBox(i, 3);
+				alive[i] = true;
+				sap.addProxy(&lo[3 * i], &hi[3 * i]);
+			}
+			PairSet before, after;
+			sap.update();
+			checkUpdate(sap, before, after);
+
+			for (int i = 0; i < n; i += 3) {
+				sap.removeProxy(i);
+				alive[i] = false;
+			}
+			// a replacement may not take a removed handle before the update
+			randomBox(n, 3);
+			alive[n] = true;
+			Assert::AreEqual(n, sap.addProxy(&lo[3 * n], &hi[3 * n]), L"Handle reused before the update", LINE_INFO());
+			before.swap(after);
+			sap.update();
+			Assert::AreEqual(n - (n + 2) / 3 + 1, sap.numProxies(), L"Proxy count", LINE_INFO());
+			checkUpdate(sap, before, after);
+
+			// few new proxies are sorted in incrementally
+			const int reused = sap.addProxy(&lo[0], &hi[0]);
+			Assert::IsTrue(reused < n && reused % 3 == 0, L"Removed handle not reused", LINE_INFO());
+			for (int k = 0; k < 3; ++k) {
+				lo[3 * reused + k] = lo[k];
+				hi[3 * reused + k] = hi[k];
+			}
+			alive[reused] = true;
+			before.swap(after);
+			sap.update();
+			Assert::IsFalse(sap.lastRebuilt(), L"Single proxy sorted from scratch", LINE_INFO());
+			checkUpdate(sap, before, after);
+		}
+
+		TEST_METHOD(TestBroadphasesResolveTheSameContacts)
+		{
+			// head-on pairs along a diagonal, each pair far from the others,
+			// so the order in which a broadphase lists them does not matter
+			MassSpringSystemSimulator grid, sweep;
+			MassSpringSystemSimulator* sims[2] = { &grid, &sweep };
+			for (MassSpringSystemSimulator* sim : sims) {
+				sim->setConsoleLogging(false);
+				sim->setIntegrator(EULER);
+				sim->setPointCollisionEnabled(true);
+				for (int i = 0; i < 20; ++i) {
+					const Vec3 centre(i, 0.5 * i, -0.3 * i);
+					const Vec3 velocity(0.5 + 0.05 * i, 0.1, 0);
+					sim->addMassPoint(centre - Vec3(0.5, 0, 0), velocity, false);
+					sim->addMassPoint(centre + Vec3(0.5, 0.05, 0), -velocity, false);
+				}
+			}
+			sweep.setPointBroadphase(POINT_BROADPHASE_SWEEP_AND_PRUNE);
+			int contacts = 0;
+			for (int step = 0; step < 100; ++step) {
+				grid.simulateTimestep(0.01f);
+				sweep.simulateTimestep(0.01f);
+				Assert::AreEqual(grid.getLastPointContacts(), sweep.getLastPointContacts(), L"Contact counts differ", LINE_INFO());
+				contacts += grid.getLastPointContacts();
+			}
+			Assert::IsTrue(contacts >= 20, L"Pairs did not collide", LINE_INFO());
+			for (int i = 0; i < grid.getNumberOfMassPoints(); ++i) {
+				Assert::IsTrue(norm(grid.getPositionOfMassPoint(i) - sweep.getPositionOfMassPoint(i)) == 0, L"Positions differ", LINE_INFO());
+			}
+		}
+
+		TEST_METHOD(TestPointsAddedAfterTheTeapotKeepTheirProxies)
+		{
+			// a point added to Demo4 takes the teapot's slot, so the proxy of
+			// that slot changes from the teapot to the new point
+			MassSpringSystemSimulator grid, sweep;
+			MassSpringSystemSimulator* sims[2] = { &grid, &sweep };
+			for (MassSpringSystemSimulator* sim : sims) {
+				sim->setConsoleLogging(false);
+				sim->notifyCaseChanged(3);
+				sim->setPointCollisionEnabled(true);
+			}
+			sweep.setPointBroadphase(POINT_BROADPHASE_SWEEP_AND_PRUNE);
+			grid.simulateTimestep(0.005f);
+			sweep.simulateTimestep(0.005f);
+			int contacts = 0;
+			for (MassSpringSystemSimulator* sim : sims) {
+				// one next to the teapot, one on top of the first scene point
+				sim->addMassPoint(Vec3(0.02, 1.5, 0), Vec3(0, 0, 0), false);
+				sim->addMassPoint(sim->getPositionOfMassPoint(0) + Vec3(0.02, 0, 0), Vec3(0, 0, 0), false);
+			}
+			for (int step = 0; step < 20; ++step) {
+				grid.simulateTimestep(0.005f);
+				sweep.simulateTimestep(0.005f);
+				Assert::AreEqual(grid.getLastPointContacts(), sweep.getLastPointContacts(), L"Contact counts differ", LINE_INFO());
+				contacts += grid.getLastPointContacts();
+			}
+			Assert::IsTrue(contacts > 0, L"Added points did not collide", LINE_INFO());
+			for (int i = 0; i < grid.getNumberOfMassPoints(); ++i) {
+				Assert::AreEqual(0.0, norm(grid.getPositionOfMassPoint(i) - sweep.getPositionOfMassPoint(i)), 1e-9, L"Positions differ", LINE_INFO());
+			}
+		}
+	};
+}
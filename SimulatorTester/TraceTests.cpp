@@ -0,0 +1,67 @@
+#include "CppUnitTest.h"
+#include "MassSpringSystemSimulator.h"
+#include "SceneBuilder.h"
+#include "util/profiler.h"
+#include "util/trace.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+
+using namespace Microsoft::VisualStudio::CppUnitTestFramework;
+
+namespace SimulatorTester
+{
+	TEST_CLASS(TraceTests)
+	{
+	public:
+		static std::string readFile(const char* path)
+		{
+			std::ifstream in(path);
+			std::stringstream ss;
+			ss << in.rdbuf();
+			return ss.str();
+		}
+
+		TEST_METHOD(TestTraceContainsZonesAndCounters)
+		{
+			const char* path = "TestTrace.json";
+			MassSpringSystemSimulator sim;
+			sim.setConsoleLogging(false);
+			buildLattice(&sim, 10, 10, 0.1f);
+			sim.setIntegrator(MIDPOINT);
+
+			Assert::IsTrue(traceStart(path), L"Trace file could not be opened", LINE_INFO());
+			Assert::IsTrue(traceIsActive(), L"Trace not active after start", LINE_INFO());
+			for (int i = 0; i < 5; i++) {
+				sim.simulateTimestep(0.001f);
+				traceFlush();
+			}
+			traceStop();
+			Assert::IsFalse(traceIsActive(), L"Trace still active after stop", LINE_INFO());
+
+			const std::string json = readFile(path);
+			std::remove(path);
+			Assert::IsTrue(json.find("\"traceEvents\":[") != std::string::npos, L"Not a Chrome trace", LINE_INFO());
+			Assert::IsTrue(json.find("\"name\":\"points\",\"ph\":\"C\"") != std::string::npos, L"Point counter missing", LINE_INFO());
+			Assert::IsTrue(json.rfind("]}") != std::string::npos, L"Trace not closed", LINE_INFO());
+#ifndef GAMEPHYSICS_NO_PROFILE
+			Assert::IsTrue(json.find("\"name\":\"simulateTimestep\",\"ph\":\"X\"") != std::string::npos, L"Step zone missing", LINE_INFO());
+#endif
+			Assert::AreEqual((uint64_t)0, traceDroppedEvents(), L"Events dropped", LINE_INFO());
+		}
+
+		TEST_METHOD(TestCounterBufferIsBounded)
+		{
+			const char* path = "TestTraceBounded.json";
+			Assert::IsTrue(traceStart(path), L"Trace file could not be opened", LINE_INFO());
+			for (int i = 0; i < TRACE_MAX_PENDING_COUNTERS + 10; i++) traceCounter("value", i);
+			Assert::AreEqual((uint64_t)10, traceDroppedEvents(), L"Counters beyond the buffer not dropped", LINE_INFO());
+			traceFlush();
+			traceCounter("value", 0);
+			Assert::AreEqual((uint64_t)10, traceDroppedEvents(), L"Flush did not empty the buffer", LINE_INFO());
+			traceStop();
+			std::remove(path);
+		}
+	};
+}